@@ -0,0 +1,138 @@
+#include "AppSettings.h"
+
+#include <stdexcept>
+
+
+namespace {
+    uint64_t parseNumber(const std::string& option, const std::string& value) {
+        size_t parsed = 0;
+        uint64_t number = 0;
+        try {
+            number = std::stoull(value, &parsed);
+        } catch (const std::exception&) {
+            parsed = 0;
+        }
+        if (parsed == 0 || parsed != value.size()) {
+            throw std::runtime_error("ERROR: " + option + " expects a number, got '" + value + "'");
+        }
+        return number;
+    }
+}
+
+
+VulkanEngine::AppSettings
+VulkanEngine::AppSettings::fromCommandLine(int argc, char** argv) {
+    AppSettings settings;
+
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        auto nextValue = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::runtime_error("ERROR: " + option + " expects a value");
+            }
+            return argv[++i];
+        };
+
+        if (option == "--headless") {
+            settings.headless = true;
+        } else if (option == "--benchmark") {
+            settings.benchmark = true;
+        } else if (option == "--benchmark-pipelines") {
+            settings.benchmarkPipelines = true;
+        } else if (option == "--frames") {
+            settings.frameCount = parseNumber(option, nextValue());
+        } else if (option == "--size") {
+            std::string value = nextValue();
+            size_t separator = value.find('x');
+            if (separator == std::string::npos) {
+                throw std::runtime_error("ERROR: --size expects WxH, got '" + value + "'");
+            }
+            settings.width = static_cast<uint32_t>(parseNumber(option, value.substr(0, separator)));
+            settings.height = static_cast<uint32_t>(parseNumber(option, value.substr(separator + 1)));
+            if (settings.width == 0 || settings.height == 0) {
+                throw std::runtime_error("ERROR: --size must not be zero");
+            }
+        } else if (option == "--dump") {
+            settings.dumpDirectory = nextValue();
+        } else if (option == "--dump-format") {
+            std::string value = nextValue();
+            if (value == "png") {
+                settings.dumpFormat = FrameDumpFormat::Png;
+            } else if (value == "raw") {
+                settings.dumpFormat = FrameDumpFormat::Raw;
+            } else {
+                throw std::runtime_error("ERROR: --dump-format expects png or raw, got '" + value + "'");
+            }
+        } else if (option == "--dump-every") {
+            settings.dumpInterval = parseNumber(option, nextValue());
+            if (settings.dumpInterval == 0) {
+                throw std::runtime_error("ERROR: --dump-every must not be zero");
+            }
+        } else if (option == "--trace") {
+            settings.tracePath = nextValue();
+        } else if (option == "--present-mode") {
+            std::string value = nextValue();
+            if (value == "auto") {
+                settings.presentMode = PresentMode::Auto;
+            } else if (value == "fifo") {
+                settings.presentMode = PresentMode::Fifo;
+            } else if (value == "fifo-relaxed") {
+                settings.presentMode = PresentMode::FifoRelaxed;
+            } else if (value == "mailbox") {
+                settings.presentMode = PresentMode::Mailbox;
+            } else if (value == "immediate") {
+                settings.presentMode = PresentMode::Immediate;
+            } else {
+                throw std::runtime_error("ERROR: unknown present mode '" + value + "'");
+            }
+        } else if (option == "--frames-in-flight") {
+            settings.framesInFlight = static_cast<uint32_t>(parseNumber(option, nextValue()));
+            if (settings.framesInFlight == 0 || settings.framesInFlight > MAX_FRAMES_IN_FLIGHT) {
+                throw std::runtime_error("ERROR: --frames-in-flight must be between 1 and " + std::to_string(MAX_FRAMES_IN_FLIGHT));
+            }
+        } else if (option == "--fps-limit") {
+            settings.fpsLimit = static_cast<double>(parseNumber(option, nextValue()));
+        } else if (option == "--textures") {
+            settings.textureDirectory = nextValue();
+        } else if (option == "--texture-budget") {
+            settings.textureBudgetMb = parseNumber(option, nextValue());
+        } else if (option == "--mesh") {
+            settings.meshPath = nextValue();
+        } else if (option == "--quantize-vertices") {
+            settings.quantizeVertices = true;
+        } else if (option == "--meshlets") {
+            std::string value = nextValue();
+            if (value == "off") {
+                settings.meshletMode = MeshletMode::Off;
+            } else if (value == "auto") {
+                settings.meshletMode = MeshletMode::Auto;
+            } else if (value == "mesh") {
+                settings.meshletMode = MeshletMode::MeshShader;
+            } else if (value == "compute") {
+                settings.meshletMode = MeshletMode::Compute;
+            } else {
+                throw std::runtime_error("ERROR: unknown meshlet mode '" + value + "'");
+            }
+        } else if (option == "--no-occlusion") {
+            settings.occlusionCulling = false;
+        } else if (option == "--verify-culling") {
+            settings.verifyCulling = true;
+        } else if (option == "--legacy-render-passes") {
+            settings.dynamicRendering = false;
+        } else {
+            throw std::runtime_error("ERROR: unknown option " + option);
+        }
+    }
+
+    if (!settings.dumpDirectory.empty() && !settings.headless) {
+        throw std::runtime_error("ERROR: --dump requires --headless");
+    }
+    if (settings.benchmarkPipelines && !settings.headless) {
+        throw std::runtime_error("ERROR: --benchmark-pipelines requires --headless");
+    }
+    if (settings.verifyCulling && (!settings.headless || settings.meshletMode != MeshletMode::Off)) {
+        throw std::runtime_error("ERROR: --verify-culling requires --headless and no --meshlets");
+    }
+
+    return settings;
+}
@@ -0,0 +1,100 @@
+#ifndef APPSETTINGS_H
+#define APPSETTINGS_H
+
+
+#include <cstdint>
+#include <string>
+
+
+namespace VulkanEngine {
+
+    enum class FrameDumpFormat
+    {
+        Png,
+        Raw
+    };
+
+    // Auto keeps the old behaviour, mailbox when the surface has it and fifo otherwise.
+    enum class PresentMode
+    {
+        Auto,
+        Fifo,
+        FifoRelaxed,
+        Mailbox,
+        Immediate
+    };
+
+    // Auto draws with mesh shaders when the device has them and falls back to the compute path.
+    enum class MeshletMode
+    {
+        Off,
+        Auto,
+        MeshShader,
+        Compute
+    };
+
+// Launch options, parsed from the command line:
+//   --headless            render into offscreen images, no window or surface
+//   --size WxH            render resolution
+//   --frames N            stop after N frames, 0 runs until the window is closed
+//   --benchmark           print frame timings when the run ends
+//   --benchmark-pipelines build the pipelines with an empty and with the loaded cache, print
+//                         both times and exit (headless only)
+//   --dump DIR            write frames to DIR (headless only)
+//   --dump-format png|raw file format of the dumped frames
+//   --dump-every N        dump every Nth frame
+//   --trace FILE          write a Chrome trace of the run to FILE
+//   --present-mode MODE   auto, fifo, fifo-relaxed, mailbox or immediate
+//   --frames-in-flight N  frames the CPU may run ahead of the GPU, 1 to MAX_FRAMES_IN_FLIGHT
+//   --fps-limit N         cap the frame rate on the CPU, 0 leaves it uncapped
+//   --textures DIR        stream every image in DIR and spread them over the scene
+//   --texture-budget MB   GPU memory the streamed textures may keep resident
+//   --mesh FILE           draw a mesh file (see Tools/MeshCooker.cpp) instead of the built in quad
+//   --quantize-vertices   upload the mesh as 20 byte QuantizedVertex instead of 44 byte Vertex
+//   --meshlets MODE       off, auto, mesh or compute: cull and draw the mesh per meshlet
+//   --no-occlusion        skip the depth prepass and Hi-Z occlusion culling, frustum culling only
+//   --verify-culling      check every frame's gpu frustum cull against a cpu reference and exit
+//                         with 1 on a mismatch (headless, without --meshlets)
+//   --legacy-render-passes
+//                         render passes, framebuffers and the original barriers and submits even
+//                         when the device has dynamic rendering and synchronization2
+struct AppSettings {
+    static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+
+    bool headless = false;
+    uint32_t width = 800;
+    uint32_t height = 600;
+    uint64_t frameCount = 0;
+    bool benchmark = false;
+    bool benchmarkPipelines = false;
+    bool verifyCulling = false;
+
+    std::string dumpDirectory;
+    FrameDumpFormat dumpFormat = FrameDumpFormat::Png;
+    uint64_t dumpInterval = 1;
+
+    std::string tracePath;
+
+    PresentMode presentMode = PresentMode::Auto;
+    uint32_t framesInFlight = 2;
+    double fpsLimit = 0.0;
+
+    std::string textureDirectory;
+    uint64_t textureBudgetMb = 256;
+
+    std::string meshPath;
+    bool quantizeVertices = false;
+    MeshletMode meshletMode = MeshletMode::Off;
+    bool occlusionCulling = true;
+    bool dynamicRendering = true;
+
+    bool isDumping() const { return headless && !dumpDirectory.empty(); }
+    bool shouldDump(uint64_t frame) const { return isDumping() && frame % dumpInterval == 0; }
+
+    // Throws std::runtime_error on unknown or malformed options.
+    static AppSettings fromCommandLine(int argc, char** argv);
+};
+
+} // VulkanEngine
+
+#endif //APPSETTINGS_H
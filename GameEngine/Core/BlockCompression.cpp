@@ -0,0 +1,467 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+
+namespace {
+    constexpr uint32_t BC7_WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    // fills a zeroed block least significant bit first, the order every BCn format uses
+    class BitWriter {
+    public:
+        explicit BitWriter(uint8_t* out) : mOut(out) {}
+
+        void write(uint32_t value, uint32_t bits) {
+            for (uint32_t i = 0; i < bits; i++, mBit++) {
+                if ((value >> i) & 1) {
+                    mOut[mBit >> 3] |= static_cast<uint8_t>(1 << (mBit & 7));
+                }
+            }
+        }
+
+    private:
+        uint8_t* mOut;
+        uint32_t mBit = 0;
+    };
+
+    void toFloat(const uint8_t* rgba, float pixels[16][4]) {
+        for (uint32_t i = 0; i < 16; i++) {
+            for (uint32_t c = 0; c < 4; c++) {
+                pixels[i][c] = rgba[i * 4 + c];
+            }
+        }
+    }
+
+    // Mean and dominant direction of the first channels components, by power iteration on the
+    // covariance. The axis is left at zero for a flat block.
+    void principalAxis(const float pixels[16][4], uint32_t channels, float mean[4], float axis[4]) {
+        for (uint32_t c = 0; c < 4; c++) {
+            mean[c] = 0.0f;
+            axis[c] = 0.0f;
+        }
+        for (uint32_t i = 0; i < 16; i++) {
+            for (uint32_t c = 0; c < channels; c++) {
+                mean[c] += pixels[i][c] / 16.0f;
+            }
+        }
+
+        float covariance[4][4] = {};
+        for (uint32_t i = 0; i < 16; i++) {
+            for (uint32_t a = 0; a < channels; a++) {
+                for (uint32_t b = 0; b < channels; b++) {
+                    covariance[a][b] += (pixels[i][a] - mean[a]) * (pixels[i][b] - mean[b]);
+                }
+            }
+        }
+
+        // start from the channel that varies most, it is never orthogonal to the answer
+        uint32_t widest = 0;
+        for (uint32_t c = 1; c < channels; c++) {
+            widest = covariance[c][c] > covariance[widest][widest] ? c : widest;
+        }
+        if (covariance[widest][widest] <= 0.0f) {
+            return;
+        }
+        for (uint32_t c = 0; c < channels; c++) {
+            axis[c] = covariance[widest][c];
+        }
+
+        for (uint32_t iteration = 0; iteration < 8; iteration++) {
+            float next[4] = {};
+            float length = 0.0f;
+            for (uint32_t a = 0; a < channels; a++) {
+                for (uint32_t b = 0; b < channels; b++) {
+                    next[a] += covariance[a][b] * axis[b];
+                }
+                length += next[a] * next[a];
+            }
+            length = std::sqrt(length);
+            if (length <= 0.0f) {
+                return;
+            }
+            for (uint32_t c = 0; c < channels; c++) {
+                axis[c] = next[c] / length;
+            }
+        }
+    }
+
+    uint16_t packRgb565(const float* colour) {
+        uint32_t r = static_cast<uint32_t>(colour[0] * 31.0f / 255.0f + 0.5f);
+        uint32_t g = static_cast<uint32_t>(colour[1] * 63.0f / 255.0f + 0.5f);
+        uint32_t b = static_cast<uint32_t>(colour[2] * 31.0f / 255.0f + 0.5f);
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+
+    void unpackRgb565(uint16_t packed, int* colour) {
+        int r = (packed >> 11) & 31;
+        int g = (packed >> 5) & 63;
+        int b = packed & 31;
+        colour[0] = (r << 3) | (r >> 2);
+        colour[1] = (g << 2) | (g >> 4);
+        colour[2] = (b << 3) | (b >> 2);
+    }
+
+    // The BC1 colour block, also the second half of BC3. Endpoints are the two texels furthest
+    // apart along the principal axis, always in four colour order so BC3 decodes it the same.
+    void encodeColourBlock(const uint8_t* rgba, uint8_t* block) {
+        float pixels[16][4];
+        toFloat(rgba, pixels);
+        float mean[4];
+        float axis[4];
+        principalAxis(pixels, 3, mean, axis);
+
+        uint32_t lowest = 0;
+        uint32_t highest = 0;
+        float lowestProjection = 0.0f;
+        float highestProjection = 0.0f;
+        for (uint32_t i = 0; i < 16; i++) {
+            float projection = 0.0f;
+            for (uint32_t c = 0; c < 3; c++) {
+                projection += (pixels[i][c] - mean[c]) * axis[c];
+            }
+            if (i == 0 || projection < lowestProjection) {
+                lowest = i;
+                lowestProjection = projection;
+            }
+            if (i == 0 || projection > highestProjection) {
+                highest = i;
+                highestProjection = projection;
+            }
+        }
+
+        uint16_t colour0 = packRgb565(pixels[highest]);
+        uint16_t colour1 = packRgb565(pixels[lowest]);
+        if (colour0 < colour1) {
+            std::swap(colour0, colour1);
+        }
+
+        uint32_t indices = 0;
+        if (colour0 != colour1) {
+            int palette[4][3];
+            unpackRgb565(colour0, palette[0]);
+            unpackRgb565(colour1, palette[1]);
+            for (uint32_t c = 0; c < 3; c++) {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+
+            for (uint32_t i = 0; i < 16; i++) {
+                uint32_t best = 0;
+                int bestError = INT32_MAX;
+                for (uint32_t entry = 0; entry < 4; entry++) {
+                    int error = 0;
+                    for (uint32_t c = 0; c < 3; c++) {
+                        int difference = rgba[i * 4 + c] - palette[entry][c];
+                        error += difference * difference;
+                    }
+                    if (error < bestError) {
+                        best = entry;
+                        bestError = error;
+                    }
+                }
+                indices |= best << (i * 2);
+            }
+        }
+
+        block[0] = static_cast<uint8_t>(colour0);
+        block[1] = static_cast<uint8_t>(colour0 >> 8);
+        block[2] = static_cast<uint8_t>(colour1);
+        block[3] = static_cast<uint8_t>(colour1 >> 8);
+        for (uint32_t i = 0; i < 4; i++) {
+            block[4 + i] = static_cast<uint8_t>(indices >> (i * 8));
+        }
+    }
+
+    // One channel in eight value mode: the block's min and max with six steps between them.
+    void encodeBc4(const uint8_t* rgba, uint32_t channel, uint8_t* block) {
+        int lowest = 255;
+        int highest = 0;
+        for (uint32_t i = 0; i < 16; i++) {
+            lowest = std::min<int>(lowest, rgba[i * 4 + channel]);
+            highest = std::max<int>(highest, rgba[i * 4 + channel]);
+        }
+
+        std::memset(block, 0, 8);
+        block[0] = static_cast<uint8_t>(highest);
+        block[1] = static_cast<uint8_t>(lowest);
+        if (highest == lowest) {
+            return;
+        }
+
+        int palette[8];
+        palette[0] = highest;
+        palette[1] = lowest;
+        for (int step = 1; step < 7; step++) {
+            palette[step + 1] = ((7 - step) * highest + step * lowest) / 7;
+        }
+
+        BitWriter writer(block + 2);
+        for (uint32_t i = 0; i < 16; i++) {
+            int value = rgba[i * 4 + channel];
+            uint32_t best = 0;
+            for (uint32_t entry = 1; entry < 8; entry++) {
+                best = std::abs(value - palette[entry]) < std::abs(value - palette[best]) ? entry : best;
+            }
+            writer.write(best, 3);
+        }
+    }
+
+    // A mode 6 endpoint is 7 bits per channel plus a p-bit shared by its four channels.
+    void quantizeBc7Endpoint(const float* endpoint, uint32_t* quantized, uint32_t& pBit) {
+        float bestError = 0.0f;
+        for (uint32_t p = 0; p < 2; p++) {
+            uint32_t candidate[4];
+            float error = 0.0f;
+            for (uint32_t c = 0; c < 4; c++) {
+                float value = std::clamp(endpoint[c], 0.0f, 255.0f);
+                candidate[c] = static_cast<uint32_t>(std::clamp(std::lround((value - p) / 2.0f), 0l, 127l));
+                float difference = float((candidate[c] << 1) | p) - value;
+                error += difference * difference;
+            }
+            if (p == 0 || error < bestError) {
+                bestError = error;
+                pBit = p;
+                std::memcpy(quantized, candidate, sizeof(candidate));
+            }
+        }
+    }
+
+    // Nearest of the 16 interpolated colours for every texel, returns the summed squared error.
+    uint32_t chooseBc7Indices(const uint8_t* rgba, const uint32_t* endpoint0, uint32_t p0, const uint32_t* endpoint1, uint32_t p1, uint32_t* indices) {
+        int palette[16][4];
+        for (uint32_t c = 0; c < 4; c++) {
+            int e0 = static_cast<int>((endpoint0[c] << 1) | p0);
+            int e1 = static_cast<int>((endpoint1[c] << 1) | p1);
+            for (uint32_t i = 0; i < 16; i++) {
+                palette[i][c] = ((64 - int(BC7_WEIGHTS[i])) * e0 + int(BC7_WEIGHTS[i]) * e1 + 32) >> 6;
+            }
+        }
+
+        uint32_t total = 0;
+        for (uint32_t i = 0; i < 16; i++) {
+            uint32_t best = 0;
+            uint32_t bestError = UINT32_MAX;
+            for (uint32_t entry = 0; entry < 16; entry++) {
+                uint32_t error = 0;
+                for (uint32_t c = 0; c < 4; c++) {
+                    int difference = rgba[i * 4 + c] - palette[entry][c];
+                    error += static_cast<uint32_t>(difference * difference);
+                }
+                if (error < bestError) {
+                    best = entry;
+                    bestError = error;
+                }
+            }
+            indices[i] = best;
+            total += bestError;
+        }
+        return total;
+    }
+
+    // Interpolated colours pulled onto the texels with the current indices as weights.
+    bool refitBc7Endpoints(const float pixels[16][4], const uint32_t* indices, float* endpoint0, float* endpoint1) {
+        float a = 0.0f;
+        float b = 0.0f;
+        float c = 0.0f;
+        float right0[4] = {};
+        float right1[4] = {};
+        for (uint32_t i = 0; i < 16; i++) {
+            float w = BC7_WEIGHTS[indices[i]] / 64.0f;
+            a += (1.0f - w) * (1.0f - w);
+            b += (1.0f - w) * w;
+            c += w * w;
+            for (uint32_t channel = 0; channel < 4; channel++) {
+                right0[channel] += (1.0f - w) * pixels[i][channel];
+                right1[channel] += w * pixels[i][channel];
+            }
+        }
+
+        float determinant = a * c - b * b;
+        if (std::abs(determinant) < 1e-6f) {
+            return false;
+        }
+        for (uint32_t channel = 0; channel < 4; channel++) {
+            endpoint0[channel] = (c * right0[channel] - b * right1[channel]) / determinant;
+            endpoint1[channel] = (a * right1[channel] - b * right0[channel]) / determinant;
+        }
+        return true;
+    }
+}
+
+
+void
+VulkanEngine::BlockCompression::encodeBc1(const uint8_t* rgba, uint8_t* block) {
+    encodeColourBlock(rgba, block);
+}
+
+
+void
+VulkanEngine::BlockCompression::encodeBc3(const uint8_t* rgba, uint8_t* block) {
+    encodeBc4(rgba, 3, block);
+    encodeColourBlock(rgba, block + 8);
+}
+
+
+void
+VulkanEngine::BlockCompression::encodeBc5(const uint8_t* rgba, uint8_t* block) {
+    encodeBc4(rgba, 0, block);
+    encodeBc4(rgba, 1, block + 8);
+}
+
+
+void
+VulkanEngine::BlockCompression::encodeBc7(const uint8_t* rgba, uint8_t* block) {
+    float pixels[16][4];
+    toFloat(rgba, pixels);
+    float mean[4];
+    float axis[4];
+    principalAxis(pixels, 4, mean, axis);
+
+    float lowest = 0.0f;
+    float highest = 0.0f;
+    for (uint32_t i = 0; i < 16; i++) {
+        float projection = 0.0f;
+        for (uint32_t c = 0; c < 4; c++) {
+            projection += (pixels[i][c] - mean[c]) * axis[c];
+        }
+        lowest = std::min(lowest, projection);
+        highest = std::max(highest, projection);
+    }
+
+    float endpoint0[4];
+    float endpoint1[4];
+    for (uint32_t c = 0; c < 4; c++) {
+        endpoint0[c] = mean[c] + axis[c] * lowest;
+        endpoint1[c] = mean[c] + axis[c] * highest;
+    }
+
+    uint32_t quantized0[4];
+    uint32_t quantized1[4];
+    uint32_t p0 = 0;
+    uint32_t p1 = 0;
+    uint32_t indices[16];
+    quantizeBc7Endpoint(endpoint0, quantized0, p0);
+    quantizeBc7Endpoint(endpoint1, quantized1, p1);
+    uint32_t error = chooseBc7Indices(rgba, quantized0, p0, quantized1, p1, indices);
+
+    // one least squares pass, kept only when it helps
+    if (error > 0 && refitBc7Endpoints(pixels, indices, endpoint0, endpoint1)) {
+        uint32_t refit0[4];
+        uint32_t refit1[4];
+        uint32_t refitP0 = 0;
+        uint32_t refitP1 = 0;
+        uint32_t refitIndices[16];
+        quantizeBc7Endpoint(endpoint0, refit0, refitP0);
+        quantizeBc7Endpoint(endpoint1, refit1, refitP1);
+        uint32_t refitError = chooseBc7Indices(rgba, refit0, refitP0, refit1, refitP1, refitIndices);
+        if (refitError < error) {
+            std::memcpy(quantized0, refit0, sizeof(refit0));
+            std::memcpy(quantized1, refit1, sizeof(refit1));
+            std::memcpy(indices, refitIndices, sizeof(refitIndices));
+            p0 = refitP0;
+            p1 = refitP1;
+        }
+    }
+
+    // the first index is stored without its top bit, swap the endpoints when it is set
+    if (indices[0] >= 8) {
+        std::swap(quantized0, quantized1);
+        std::swap(p0, p1);
+        for (auto& index : indices) {
+            index = 15 - index;
+        }
+    }
+
+    std::memset(block, 0, 16);
+    BitWriter writer(block);
+    writer.write(1 << 6, 7);
+    for (uint32_t c = 0; c < 4; c++) {
+        writer.write(quantized0[c], 7);
+        writer.write(quantized1[c], 7);
+    }
+    writer.write(p0, 1);
+    writer.write(p1, 1);
+    writer.write(indices[0], 3);
+    for (uint32_t i = 1; i < 16; i++) {
+        writer.write(indices[i], 4);
+    }
+}
+
+
+VulkanEngine::TextureData
+VulkanEngine::BlockCompression::compress(const TextureData& texture, TextureFormat format, JobSystem* jobs) {
+    if (texture.format != TextureFormat::Rgba8) {
+        throw std::runtime_error("ERROR: only RGBA8 textures can be block compressed");
+    }
+    if (format == TextureFormat::Bc5 && texture.srgb) {
+        throw std::runtime_error("ERROR: BC5 has no sRGB format, cook two channel data as linear");
+    }
+    if (format == TextureFormat::Rgba8) {
+        return texture;
+    }
+
+    void (*encode)(const uint8_t*, uint8_t*) = nullptr;
+    switch (format) {
+    case TextureFormat::Bc1:
+        encode = encodeBc1;
+        break;
+    case TextureFormat::Bc3:
+        encode = encodeBc3;
+        break;
+    case TextureFormat::Bc5:
+        encode = encodeBc5;
+        break;
+    default:
+        encode = encodeBc7;
+        break;
+    }
+
+    TextureData result;
+    result.width = texture.width;
+    result.height = texture.height;
+    result.format = format;
+    result.srgb = texture.srgb;
+
+    const uint32_t blockBytes = getBlockBytes(format);
+    size_t total = 0;
+    for (const auto& mip : texture.mips) {
+        size_t size = size_t((mip.width + 3) / 4) * ((mip.height + 3) / 4) * blockBytes;
+        result.mips.push_back({mip.width, mip.height, total, size});
+        total += size;
+    }
+    result.pixels.resize(total);
+
+    const uint8_t* source = texture.getPixels();
+    for (size_t level = 0; level < texture.mips.size(); level++) {
+        const TextureMip& src = texture.mips[level];
+        uint8_t* dst = result.pixels.data() + result.mips[level].offset;
+        uint32_t blocksX = (src.width + 3) / 4;
+        uint32_t blocksY = (src.height + 3) / 4;
+
+        auto encodeRows = [&](uint32_t first, uint32_t last) {
+            uint8_t texels[16 * 4];
+            for (uint32_t by = first; by < last; by++) {
+                for (uint32_t bx = 0; bx < blocksX; bx++) {
+                    for (uint32_t y = 0; y < 4; y++) {
+                        uint32_t sy = std::min(by * 4 + y, src.height - 1);
+                        for (uint32_t x = 0; x < 4; x++) {
+                            uint32_t sx = std::min(bx * 4 + x, src.width - 1);
+                            std::memcpy(texels + (y * 4 + x) * 4, source + src.offset + (size_t(sy) * src.width + sx) * 4, 4);
+                        }
+                    }
+                    encode(texels, dst + (size_t(by) * blocksX + bx) * blockBytes);
+                }
+            }
+        };
+
+        if (jobs != nullptr) {
+            jobs->parallelFor(0, blocksY, 4, encodeRows);
+        } else {
+            encodeRows(0, blocksY);
+        }
+    }
+    return result;
+}
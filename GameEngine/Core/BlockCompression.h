@@ -0,0 +1,28 @@
+#ifndef BLOCKCOMPRESSION_H
+#define BLOCKCOMPRESSION_H
+
+
+#include <cstdint>
+#include "TextureData.h"
+#include "JobSystem.h"
+
+
+namespace VulkanEngine {
+
+// BCn encoders for the TextureCooker, one 4x4 block of row major RGBA8 texels at a time. BC7 only
+// uses mode 6.
+namespace BlockCompression {
+
+    void encodeBc1(const uint8_t* rgba, uint8_t* block);
+    void encodeBc3(const uint8_t* rgba, uint8_t* block);
+    void encodeBc5(const uint8_t* rgba, uint8_t* block);
+    void encodeBc7(const uint8_t* rgba, uint8_t* block);
+
+    // Encodes every level of an RGBA8 texture, block rows on the job system when one is given.
+    TextureData compress(const TextureData& texture, TextureFormat format, JobSystem* jobs = nullptr);
+
+} // BlockCompression
+
+} // VulkanEngine
+
+#endif //BLOCKCOMPRESSION_H
@@ -0,0 +1,219 @@
+#include "EntityRegistry.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+
+
+namespace {
+    std::mutex gComponentMutex;
+    size_t gComponentSizes[VulkanEngine::MAX_COMPONENT_TYPES];
+    uint32_t gComponentCount = 0;
+
+    size_t alignUp(size_t value, size_t alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+
+VulkanEngine::ComponentId
+VulkanEngine::detail::registerComponent(size_t size) {
+    std::lock_guard<std::mutex> lock(gComponentMutex);
+    if (gComponentCount == MAX_COMPONENT_TYPES) {
+        throw std::runtime_error("ERROR: too many component types");
+    }
+    gComponentSizes[gComponentCount] = size;
+    return gComponentCount++;
+}
+
+
+size_t
+VulkanEngine::detail::componentSize(ComponentId id) {
+    return gComponentSizes[id];
+}
+
+
+VulkanEngine::EntityRegistry::~EntityRegistry() {
+    for (Archetype* archetype : mArchetypes) {
+        for (const Chunk& chunk : archetype->chunks) {
+            ::operator delete(chunk.data, std::align_val_t(ENTITY_COLUMN_ALIGNMENT));
+        }
+        delete archetype;
+    }
+    for (uint8_t* data : mFreeChunks) {
+        ::operator delete(data, std::align_val_t(ENTITY_COLUMN_ALIGNMENT));
+    }
+}
+
+
+void
+VulkanEngine::EntityRegistry::destroy(Entity entity) {
+    if (!isAlive(entity)) {
+        return;
+    }
+    EntityRecord& record = mRecords[entity.index];
+    removeRow(record.archetype, record.chunk, record.row);
+
+    record.archetype = nullptr;
+    record.generation++;
+    mFreeIndices.push_back(entity.index);
+    mEntityCount--;
+}
+
+
+bool
+VulkanEngine::EntityRegistry::isAlive(Entity entity) const {
+    return entity.index < mRecords.size()
+        && mRecords[entity.index].archetype != nullptr
+        && mRecords[entity.index].generation == entity.generation;
+}
+
+
+VulkanEngine::EntityRegistry::Archetype*
+VulkanEngine::EntityRegistry::findOrCreateArchetype(ComponentMask mask) {
+    auto found = mArchetypeByMask.find(mask);
+    if (found != mArchetypeByMask.end()) {
+        return found->second;
+    }
+
+    Archetype* archetype = new Archetype();
+    archetype->mask = mask;
+    std::fill(std::begin(archetype->columnOffsets), std::end(archetype->columnOffsets), UINT32_MAX);
+
+    size_t rowSize = sizeof(Entity);
+    for (ComponentId id = 0; id < MAX_COMPONENT_TYPES; id++) {
+        if (mask & (ComponentMask(1) << id)) {
+            archetype->components.push_back(id);
+            rowSize += detail::componentSize(id);
+        }
+    }
+
+    // leave room to start every column on a cache line
+    size_t padding = ENTITY_COLUMN_ALIGNMENT * (archetype->components.size() + 1);
+    if (padding + rowSize > ENTITY_CHUNK_SIZE) {
+        delete archetype;
+        throw std::runtime_error("ERROR: component set does not fit in an entity chunk");
+    }
+    archetype->capacity = static_cast<uint32_t>((ENTITY_CHUNK_SIZE - padding) / rowSize);
+
+    // the entity column comes first, followed by the components in id order
+    size_t offset = sizeof(Entity) * archetype->capacity;
+    for (ComponentId id : archetype->components) {
+        offset = alignUp(offset, ENTITY_COLUMN_ALIGNMENT);
+        archetype->columnOffsets[id] = static_cast<uint32_t>(offset);
+        offset += detail::componentSize(id) * archetype->capacity;
+    }
+
+    mArchetypes.push_back(archetype);
+    mArchetypeByMask[mask] = archetype;
+    return archetype;
+}
+
+
+VulkanEngine::Entity
+VulkanEngine::EntityRegistry::allocateEntity() {
+    uint32_t index;
+    if (!mFreeIndices.empty()) {
+        index = mFreeIndices.back();
+        mFreeIndices.pop_back();
+    } else {
+        index = static_cast<uint32_t>(mRecords.size());
+        mRecords.push_back(EntityRecord{});
+    }
+    mEntityCount++;
+    return Entity{index, mRecords[index].generation};
+}
+
+
+void
+VulkanEngine::EntityRegistry::insertRow(Archetype* archetype, Entity entity, EntityRecord& record) {
+    if (archetype->chunks.empty() || archetype->chunks.back().count == archetype->capacity) {
+        archetype->chunks.push_back(Chunk{allocateChunk(), 0});
+    }
+    Chunk& chunk = archetype->chunks.back();
+    uint32_t row = chunk.count++;
+    entities(chunk)[row] = entity;
+    archetype->entityCount++;
+
+    record.archetype = archetype;
+    record.chunk = static_cast<uint32_t>(archetype->chunks.size() - 1);
+    record.row = row;
+}
+
+
+void
+VulkanEngine::EntityRegistry::removeRow(Archetype* archetype, uint32_t chunkIndex, uint32_t row) {
+    Chunk& last = archetype->chunks.back();
+    Chunk& chunk = archetype->chunks[chunkIndex];
+    uint32_t lastRow = last.count - 1;
+
+    // fill the hole with the archetype's last row so the chunks stay dense
+    if (&chunk != &last || row != lastRow) {
+        Entity moved = entities(last)[lastRow];
+        entities(chunk)[row] = moved;
+        for (ComponentId id : archetype->components) {
+            size_t size = detail::componentSize(id);
+            uint32_t offset = archetype->columnOffsets[id];
+            memcpy(chunk.data + offset + row * size, last.data + offset + lastRow * size, size);
+        }
+        mRecords[moved.index].chunk = chunkIndex;
+        mRecords[moved.index].row = row;
+    }
+
+    last.count--;
+    archetype->entityCount--;
+    if (last.count == 0) {
+        mFreeChunks.push_back(last.data);
+        archetype->chunks.pop_back();
+    }
+}
+
+
+void
+VulkanEngine::EntityRegistry::moveEntity(Entity entity, ComponentMask mask) {
+    EntityRecord& record = mRecords[entity.index];
+    Archetype* source = record.archetype;
+    uint32_t sourceChunk = record.chunk;
+    uint32_t sourceRow = record.row;
+
+    Archetype* target = findOrCreateArchetype(mask);
+    insertRow(target, entity, record);
+
+    const Chunk& from = source->chunks[sourceChunk];
+    const Chunk& to = target->chunks[record.chunk];
+    for (ComponentId id : target->components) {
+        if (source->mask & (ComponentMask(1) << id)) {
+            size_t size = detail::componentSize(id);
+            memcpy(to.data + target->columnOffsets[id] + record.row * size,
+                   from.data + source->columnOffsets[id] + sourceRow * size, size);
+        }
+    }
+
+    removeRow(source, sourceChunk, sourceRow);
+}
+
+
+const VulkanEngine::EntityRegistry::QueryCache&
+VulkanEngine::EntityRegistry::matchArchetypes(ComponentMask mask) {
+    QueryCache& cache = mQueries[mask];
+    for (; cache.seenArchetypes < mArchetypes.size(); cache.seenArchetypes++) {
+        Archetype* archetype = mArchetypes[cache.seenArchetypes];
+        if ((archetype->mask & mask) == mask) {
+            cache.archetypes.push_back(archetype);
+        }
+    }
+    return cache;
+}
+
+
+uint8_t*
+VulkanEngine::EntityRegistry::allocateChunk() {
+    if (!mFreeChunks.empty()) {
+        uint8_t* data = mFreeChunks.back();
+        mFreeChunks.pop_back();
+        return data;
+    }
+    return static_cast<uint8_t*>(::operator new(ENTITY_CHUNK_SIZE, std::align_val_t(ENTITY_COLUMN_ALIGNMENT)));
+}
@@ -0,0 +1,274 @@
+#ifndef ENTITYREGISTRY_H
+#define ENTITYREGISTRY_H
+
+
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+#include <EASTL/vector.h>
+#include <EASTL/hash_map.h>
+#include "JobSystem.h"
+
+
+namespace VulkanEngine {
+
+    constexpr uint32_t MAX_COMPONENT_TYPES = 64;
+    constexpr size_t ENTITY_CHUNK_SIZE = 16 * 1024;
+    constexpr size_t ENTITY_COLUMN_ALIGNMENT = 64;
+
+    using ComponentId = uint32_t;
+    using ComponentMask = uint64_t;
+
+    // Index into the registry plus the generation it was handed out with, so a handle to a
+    // destroyed entity never aliases whatever reuses its slot.
+    struct Entity
+    {
+        uint32_t index = UINT32_MAX;
+        uint32_t generation = 0;
+
+        bool operator==(const Entity& other) const { return index == other.index && generation == other.generation; }
+        bool operator!=(const Entity& other) const { return !(*this == other); }
+    };
+
+    namespace detail {
+        ComponentId registerComponent(size_t size);
+        size_t componentSize(ComponentId id);
+    }
+
+    // Ids are handed out on first use and are shared by every registry in the process.
+    template<typename T>
+    ComponentId componentId() {
+        static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>,
+                      "components are moved with memcpy and never destroyed");
+        static_assert(alignof(T) <= ENTITY_COLUMN_ALIGNMENT, "component is aligned beyond a chunk column");
+        static const ComponentId id = detail::registerComponent(sizeof(T));
+        return id;
+    }
+
+    template<typename... Ts>
+    ComponentMask componentMask() {
+        return (ComponentMask(0) | ... | (ComponentMask(1) << componentId<std::remove_const_t<Ts>>()));
+    }
+
+// Archetype based entity storage in chunks of one column per component. Component pointers are
+// only valid until the next create, destroy, add or remove, none of which is thread safe.
+class EntityRegistry {
+public:
+    EntityRegistry() = default;
+    ~EntityRegistry();
+
+    EntityRegistry(const EntityRegistry&) = delete;
+    EntityRegistry& operator=(const EntityRegistry&) = delete;
+
+    template<typename... Ts>
+    Entity create(const Ts&... components);
+    void destroy(Entity entity);
+    bool isAlive(Entity entity) const;
+
+    template<typename T>
+    void add(Entity entity, const T& component);
+    template<typename T>
+    void remove(Entity entity);
+    template<typename T>
+    bool has(Entity entity) const;
+    // nullptr when the entity is dead or lacks the component
+    template<typename T>
+    T* get(Entity entity);
+
+    uint32_t getEntityCount() const { return mEntityCount; }
+
+    // Number of entities that have all of Ts.
+    template<typename... Ts>
+    uint32_t count();
+
+    // function(Ts&... components) for every entity that has all of Ts.
+    template<typename... Ts, typename Function>
+    void each(Function&& function);
+
+    // function(uint32_t firstIndex, uint32_t count, Ts*... columns) once per chunk, firstIndex
+    // counting the matching entities in iteration order.
+    template<typename... Ts, typename Function>
+    void eachChunk(Function&& function);
+
+    // Same as eachChunk, with the chunks spread over the job system.
+    template<typename... Ts, typename Function>
+    void parallelEachChunk(JobSystem& jobs, Function&& function);
+
+private:
+    struct Chunk
+    {
+        uint8_t* data;
+        uint32_t count;
+    };
+
+    struct Archetype
+    {
+        ComponentMask mask;
+        uint32_t capacity;
+        uint32_t entityCount = 0;
+        uint32_t columnOffsets[MAX_COMPONENT_TYPES];
+        eastl::vector<ComponentId> components;
+        eastl::vector<Chunk> chunks;
+    };
+
+    struct EntityRecord
+    {
+        Archetype* archetype = nullptr;
+        uint32_t chunk = 0;
+        uint32_t row = 0;
+        uint32_t generation = 0;
+    };
+
+    // archetypes only ever get added, so a query just has to look at the ones created since it last ran
+    struct QueryCache
+    {
+        eastl::vector<Archetype*> archetypes;
+        size_t seenArchetypes = 0;
+    };
+
+    struct ChunkRef
+    {
+        Archetype* archetype;
+        Chunk* chunk;
+        uint32_t firstIndex;
+    };
+
+    Archetype* findOrCreateArchetype(ComponentMask mask);
+    Entity allocateEntity();
+    void insertRow(Archetype* archetype, Entity entity, EntityRecord& record);
+    void removeRow(Archetype* archetype, uint32_t chunkIndex, uint32_t row);
+    void moveEntity(Entity entity, ComponentMask mask);
+    const QueryCache& matchArchetypes(ComponentMask mask);
+    uint8_t* allocateChunk();
+
+    static Entity* entities(const Chunk& chunk) { return reinterpret_cast<Entity*>(chunk.data); }
+
+    template<typename T>
+    static T* column(const Archetype& archetype, const Chunk& chunk) {
+        return reinterpret_cast<T*>(chunk.data + archetype.columnOffsets[componentId<std::remove_const_t<T>>()]);
+    }
+
+    eastl::vector<Archetype*> mArchetypes;
+    eastl::hash_map<ComponentMask, Archetype*> mArchetypeByMask;
+    eastl::hash_map<ComponentMask, QueryCache> mQueries;
+    eastl::vector<EntityRecord> mRecords;
+    eastl::vector<uint32_t> mFreeIndices;
+    eastl::vector<uint8_t*> mFreeChunks;
+    eastl::vector<ChunkRef> mChunkRefs;
+    uint32_t mEntityCount = 0;
+};
+
+
+template<typename... Ts>
+Entity
+EntityRegistry::create(const Ts&... components) {
+    Archetype* archetype = findOrCreateArchetype(componentMask<Ts...>());
+    Entity entity = allocateEntity();
+    EntityRecord& record = mRecords[entity.index];
+    insertRow(archetype, entity, record);
+
+    const Chunk& chunk = archetype->chunks[record.chunk];
+    ((column<Ts>(*archetype, chunk)[record.row] = components), ...);
+    return entity;
+}
+
+
+template<typename T>
+void
+EntityRegistry::add(Entity entity, const T& component) {
+    if (!isAlive(entity)) {
+        return;
+    }
+    if (!has<T>(entity)) {
+        moveEntity(entity, mRecords[entity.index].archetype->mask | componentMask<T>());
+    }
+    *get<T>(entity) = component;
+}
+
+
+template<typename T>
+void
+EntityRegistry::remove(Entity entity) {
+    if (has<T>(entity)) {
+        moveEntity(entity, mRecords[entity.index].archetype->mask & ~componentMask<T>());
+    }
+}
+
+
+template<typename T>
+bool
+EntityRegistry::has(Entity entity) const {
+    return isAlive(entity) && (mRecords[entity.index].archetype->mask & componentMask<T>()) != 0;
+}
+
+
+template<typename T>
+T*
+EntityRegistry::get(Entity entity) {
+    if (!has<T>(entity)) {
+        return nullptr;
+    }
+    const EntityRecord& record = mRecords[entity.index];
+    return column<T>(*record.archetype, record.archetype->chunks[record.chunk]) + record.row;
+}
+
+
+template<typename... Ts>
+uint32_t
+EntityRegistry::count() {
+    uint32_t total = 0;
+    for (Archetype* archetype : matchArchetypes(componentMask<Ts...>()).archetypes) {
+        total += archetype->entityCount;
+    }
+    return total;
+}
+
+
+template<typename... Ts, typename Function>
+void
+EntityRegistry::each(Function&& function) {
+    eachChunk<Ts...>([&function](uint32_t, uint32_t count, Ts*... columns) {
+        for (uint32_t i = 0; i < count; i++) {
+            function(columns[i]...);
+        }
+    });
+}
+
+
+template<typename... Ts, typename Function>
+void
+EntityRegistry::eachChunk(Function&& function) {
+    uint32_t firstIndex = 0;
+    for (Archetype* archetype : matchArchetypes(componentMask<Ts...>()).archetypes) {
+        for (const Chunk& chunk : archetype->chunks) {
+            function(firstIndex, chunk.count, column<Ts>(*archetype, chunk)...);
+            firstIndex += chunk.count;
+        }
+    }
+}
+
+
+template<typename... Ts, typename Function>
+void
+EntityRegistry::parallelEachChunk(JobSystem& jobs, Function&& function) {
+    mChunkRefs.clear();
+    uint32_t firstIndex = 0;
+    for (Archetype* archetype : matchArchetypes(componentMask<Ts...>()).archetypes) {
+        for (Chunk& chunk : archetype->chunks) {
+            mChunkRefs.push_back(ChunkRef{archetype, &chunk, firstIndex});
+            firstIndex += chunk.count;
+        }
+    }
+
+    // a chunk is already a few hundred rows, one per job is enough to amortise scheduling
+    jobs.parallelFor(0, static_cast<uint32_t>(mChunkRefs.size()), 1, [this, &function](uint32_t first, uint32_t last) {
+        for (uint32_t i = first; i < last; i++) {
+            const ChunkRef& ref = mChunkRefs[i];
+            function(ref.firstIndex, ref.chunk->count, column<Ts>(*ref.archetype, *ref.chunk)...);
+        }
+    });
+}
+
+} // VulkanEngine
+
+#endif //ENTITYREGISTRY_H
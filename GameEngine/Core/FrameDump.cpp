@@ -0,0 +1,42 @@
+#include "FrameDump.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+
+std::string
+VulkanEngine::FrameDump::getFileName(FrameDumpFormat format, uint64_t frame, uint32_t width, uint32_t height) {
+    char name[64];
+    if (format == FrameDumpFormat::Png) {
+        snprintf(name, sizeof(name), "frame_%06llu.png", static_cast<unsigned long long>(frame));
+    } else {
+        snprintf(name, sizeof(name), "frame_%06llu_%ux%u.rgba", static_cast<unsigned long long>(frame), width, height);
+    }
+    return name;
+}
+
+
+void
+VulkanEngine::FrameDump::write(const std::string& directory, FrameDumpFormat format, uint64_t frame,
+                               const uint8_t* pixels, uint32_t width, uint32_t height) {
+    std::filesystem::create_directories(directory);
+    std::string path = (std::filesystem::path(directory) / getFileName(format, frame, width, height)).string();
+
+    if (format == FrameDumpFormat::Png) {
+        if (!stbi_write_png(path.c_str(), static_cast<int>(width), static_cast<int>(height), 4, pixels, static_cast<int>(width * 4))) {
+            throw std::runtime_error("ERROR: failed to write " + path);
+        }
+        return;
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(pixels), std::streamsize(width) * height * 4);
+    if (!file) {
+        throw std::runtime_error("ERROR: failed to write " + path);
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef FRAMEDUMP_H
+#define FRAMEDUMP_H
+
+
+#include <cstdint>
+#include <string>
+#include "AppSettings.h"
+
+
+namespace VulkanEngine {
+
+// Writes read back RGBA8 frames to disk as png, or as raw bytes with the size in the file name.
+namespace FrameDump {
+
+    std::string getFileName(FrameDumpFormat format, uint64_t frame, uint32_t width, uint32_t height);
+
+    void write(const std::string& directory, FrameDumpFormat format, uint64_t frame,
+               const uint8_t* pixels, uint32_t width, uint32_t height);
+
+} // FrameDump
+
+} // VulkanEngine
+
+#endif //FRAMEDUMP_H
@@ -0,0 +1,86 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+
+namespace {
+    // starting spin margin and its bounds, in nanoseconds
+    constexpr int64_t INITIAL_SPIN_MARGIN = 2000000;
+    constexpr int64_t MIN_SPIN_MARGIN = 200000;
+    constexpr int64_t MAX_SPIN_MARGIN = 4000000;
+}
+
+
+VulkanEngine::FramePacer::FramePacer(double targetFps)
+    : mSpinMargin(INITIAL_SPIN_MARGIN) {
+    setTargetFps(targetFps);
+}
+
+
+void
+VulkanEngine::FramePacer::setTargetFps(double fps) {
+    mPeriod = fps > 0.0 ? static_cast<int64_t>(1e9 / fps) : 0;
+    mNextDeadline = 0;
+}
+
+
+void
+VulkanEngine::FramePacer::waitForNextFrame(const std::function<void()>& idle) {
+    if (mPeriod == 0) {
+        return;
+    }
+
+    PROFILE_SCOPE("Frame limiter");
+
+    int64_t now = Profiler::now();
+    if (mNextDeadline == 0 || now > mNextDeadline + mPeriod) {
+        // first frame, or too far behind to catch up without a burst
+        mNextDeadline = now + mPeriod;
+    }
+
+    int64_t sleepUntil = mNextDeadline - mSpinMargin;
+    if (now < sleepUntil) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(sleepUntil - now));
+        int64_t overshoot = Profiler::now() - sleepUntil;
+
+        // grow quickly on a late wakeup, shrink slowly while sleeps stay precise
+        int64_t wanted = overshoot + overshoot / 2;
+        mSpinMargin = wanted > mSpinMargin ? wanted : mSpinMargin - (mSpinMargin - wanted) / 16;
+        mSpinMargin = std::clamp(mSpinMargin, MIN_SPIN_MARGIN, MAX_SPIN_MARGIN);
+    }
+
+    while (Profiler::now() < mNextDeadline) {
+        if (idle) {
+            idle();
+        }
+    }
+
+    mNextDeadline += mPeriod;
+}
+
+
+void
+VulkanEngine::FramePacer::markInput(uint64_t frame) {
+    mPending[frame % PENDING_SLOTS] = {frame, Profiler::now()};
+}
+
+
+void
+VulkanEngine::FramePacer::markPresented(uint64_t frame) {
+    PendingFrame& pending = mPending[frame % PENDING_SLOTS];
+    if (pending.frame != frame) {
+        return;
+    }
+
+    mLatency[mLatencyCount % LATENCY_HISTORY] = (Profiler::now() - pending.inputTime) / 1e6;
+    mLatencyCount++;
+    pending.frame = UINT64_MAX;
+}
+
+
+VulkanEngine::FrameStats
+VulkanEngine::FramePacer::getLatencyStats() const {
+    return Profiler::summarize(mLatency, static_cast<uint32_t>(std::min<uint64_t>(mLatencyCount, LATENCY_HISTORY)));
+}
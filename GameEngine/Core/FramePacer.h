@@ -0,0 +1,54 @@
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+
+#include <cstdint>
+#include <functional>
+#include "Profiler.h"
+
+
+namespace VulkanEngine {
+
+// CPU side frame limiter, sleeping then spinning to the next deadline, and input to present
+// latency bookkeeping. Main thread only.
+class FramePacer {
+public:
+    static constexpr uint32_t LATENCY_HISTORY = 256;
+
+    explicit FramePacer(double targetFps = 0.0);
+
+    // 0 disables the limiter.
+    void setTargetFps(double fps);
+    double getTargetFps() const { return mPeriod > 0 ? 1e9 / mPeriod : 0.0; }
+
+    // idle runs repeatedly while spinning, use it for cheap polling.
+    void waitForNextFrame(const std::function<void()>& idle = {});
+
+    void markInput(uint64_t frame);
+    void markPresented(uint64_t frame);
+
+    FrameStats getLatencyStats() const;
+    double getSpinMarginMs() const { return mSpinMargin / 1e6; }
+
+private:
+    // frames older than this many in flight are no longer tracked
+    static constexpr uint32_t PENDING_SLOTS = 16;
+
+    struct PendingFrame
+    {
+        uint64_t frame = UINT64_MAX;
+        int64_t inputTime = 0;
+    };
+
+    int64_t mPeriod = 0;
+    int64_t mNextDeadline = 0;
+    int64_t mSpinMargin;
+
+    PendingFrame mPending[PENDING_SLOTS];
+    double mLatency[LATENCY_HISTORY] = {};
+    uint64_t mLatencyCount = 0;
+};
+
+} // VulkanEngine
+
+#endif //FRAMEPACER_H
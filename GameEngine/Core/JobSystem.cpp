@@ -0,0 +1,287 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <string>
+#include "Profiler.h"
+
+
+namespace {
+    thread_local const VulkanEngine::JobSystem* tJobSystem = nullptr;
+    thread_local uint32_t tThreadIndex = 0;
+
+    constexpr uint32_t SPIN_COUNT = 64;
+}
+
+
+VulkanEngine::JobSystem::JobSystem(uint32_t workerCount) {
+    mQueues.resize(workerCount + 1);
+    for (auto& queue : mQueues) {
+        queue = std::make_unique<WorkStealingDeque<Job>>();
+    }
+
+    // the constructing thread is the main thread and owns queue 0
+    tJobSystem = this;
+    tThreadIndex = 0;
+    Profiler::setThreadName("Main thread");
+
+    for (uint32_t i = 1; i <= workerCount; i++) {
+        mThreads.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+
+VulkanEngine::JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+        mStopping.store(true);
+        mWakeGeneration++;
+    }
+    mSleepCondition.notify_all();
+
+    for (auto& thread : mThreads) {
+        thread.join();
+    }
+
+    // anything left over was never waited on
+    for (uint32_t i = 0; i < mQueues.size(); i++) {
+        while (Job* job = mQueues[i]->steal()) {
+            delete job;
+        }
+    }
+    for (Job* job : mSubmitQueue) {
+        delete job;
+    }
+
+    if (tJobSystem == this) {
+        tJobSystem = nullptr;
+    }
+}
+
+
+uint32_t
+VulkanEngine::JobSystem::defaultWorkerCount() {
+    uint32_t hardwareThreads = std::thread::hardware_concurrency();
+    return hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+}
+
+
+bool
+VulkanEngine::JobSystem::isMainThread() const {
+    return tJobSystem == this && tThreadIndex == 0;
+}
+
+
+void
+VulkanEngine::JobSystem::run(JobFunction function, JobCounter* counter) {
+    if (counter != nullptr) {
+        counter->pending.fetch_add(1, std::memory_order_relaxed);
+    }
+    push(new Job{std::move(function), counter});
+}
+
+
+void
+VulkanEngine::JobSystem::wait(JobCounter& counter) {
+    uint32_t threadIndex = currentThreadIndex();
+    while (!counter.isDone()) {
+        if (threadIndex != UINT32_MAX) {
+            if (Job* job = findJob(threadIndex)) {
+                execute(job);
+                continue;
+            }
+        }
+        std::this_thread::yield();
+    }
+
+    if (counter.error) {
+        std::exception_ptr error = counter.error;
+        counter.error = nullptr;
+        counter.failed.clear();
+        std::rethrow_exception(error);
+    }
+}
+
+
+void
+VulkanEngine::JobSystem::parallelFor(uint32_t begin, uint32_t end, uint32_t grainSize, const RangeFunction& function) {
+    if (begin >= end) {
+        return;
+    }
+    grainSize = std::max(grainSize, 1u);
+
+    // the first chunk runs on the calling thread, the rest are up for grabs
+    JobCounter counter;
+    for (uint32_t first = begin + grainSize; first < end; first += grainSize) {
+        uint32_t last = std::min(first + grainSize, end);
+        run([&function, first, last] { function(first, last); }, &counter);
+    }
+
+    try {
+        function(begin, std::min(begin + grainSize, end));
+    } catch (...) {
+        if (!counter.failed.test_and_set()) {
+            counter.error = std::current_exception();
+        }
+    }
+    wait(counter);
+}
+
+
+void
+VulkanEngine::JobSystem::runOnMainThread(JobFunction function) {
+    if (isMainThread()) {
+        function();
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mMainMutex);
+    mMainQueue.push_back(std::move(function));
+}
+
+
+void
+VulkanEngine::JobSystem::pumpMainThread() {
+    std::vector<JobFunction> functions;
+    {
+        std::lock_guard<std::mutex> lock(mMainMutex);
+        functions.swap(mMainQueue);
+    }
+    for (auto& function : functions) {
+        function();
+    }
+
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(mMainMutex);
+        error.swap(mUncountedError);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+
+void
+VulkanEngine::JobSystem::push(Job* job) {
+    uint32_t threadIndex = currentThreadIndex();
+    if (threadIndex == UINT32_MAX) {
+        std::lock_guard<std::mutex> lock(mSubmitMutex);
+        mSubmitQueue.push_back(job);
+        mSubmitCount.fetch_add(1, std::memory_order_seq_cst);
+    } else if (!mQueues[threadIndex]->push(job)) {
+        // deque is full, no point queueing behind thousands of other jobs
+        execute(job);
+        return;
+    }
+    wakeWorkers();
+}
+
+
+VulkanEngine::JobSystem::Job*
+VulkanEngine::JobSystem::findJob(uint32_t threadIndex) {
+    if (Job* job = mQueues[threadIndex]->pop()) {
+        return job;
+    }
+
+    if (mSubmitCount.load(std::memory_order_acquire) > 0) {
+        std::lock_guard<std::mutex> lock(mSubmitMutex);
+        if (!mSubmitQueue.empty()) {
+            Job* job = mSubmitQueue.front();
+            mSubmitQueue.pop_front();
+            mSubmitCount.fetch_sub(1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+
+    // start stealing from the neighbour so threads do not all hammer queue 0
+    uint32_t queueCount = static_cast<uint32_t>(mQueues.size());
+    for (uint32_t i = 1; i < queueCount; i++) {
+        if (Job* job = mQueues[(threadIndex + i) % queueCount]->steal()) {
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+
+void
+VulkanEngine::JobSystem::execute(Job* job) {
+    JobCounter* counter = job->counter;
+    try {
+        job->function();
+    } catch (...) {
+        if (counter == nullptr) {
+            // nobody waits for it, keep it for the main thread instead of terminating the worker
+            std::lock_guard<std::mutex> lock(mMainMutex);
+            if (!mUncountedError) {
+                mUncountedError = std::current_exception();
+            }
+        } else if (!counter->failed.test_and_set()) {
+            counter->error = std::current_exception();
+        }
+    }
+    delete job;
+
+    if (counter != nullptr) {
+        counter->pending.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+
+void
+VulkanEngine::JobSystem::workerLoop(uint32_t threadIndex) {
+    tJobSystem = this;
+    tThreadIndex = threadIndex;
+    Profiler::setThreadName(("Worker " + std::to_string(threadIndex)).c_str());
+
+    while (!mStopping.load(std::memory_order_relaxed)) {
+        Job* job = nullptr;
+        for (uint32_t spin = 0; spin < SPIN_COUNT && job == nullptr; spin++) {
+            job = findJob(threadIndex);
+            if (job == nullptr) {
+                std::this_thread::yield();
+            }
+        }
+        if (job != nullptr) {
+            execute(job);
+            continue;
+        }
+
+        // announce that we are about to sleep, then look once more so a push that
+        // missed the announcement cannot leave its job stranded
+        std::unique_lock<std::mutex> lock(mSleepMutex);
+        uint64_t generation = mWakeGeneration;
+        mSleepers.fetch_add(1, std::memory_order_seq_cst);
+        lock.unlock();
+
+        job = findJob(threadIndex);
+        if (job != nullptr) {
+            mSleepers.fetch_sub(1, std::memory_order_relaxed);
+            execute(job);
+            continue;
+        }
+
+        lock.lock();
+        mSleepCondition.wait(lock, [&] { return mStopping.load() || mWakeGeneration != generation; });
+        mSleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+
+void
+VulkanEngine::JobSystem::wakeWorkers() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (mSleepers.load(std::memory_order_seq_cst) == 0) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+        mWakeGeneration++;
+    }
+    mSleepCondition.notify_one();
+}
+
+
+uint32_t
+VulkanEngine::JobSystem::currentThreadIndex() const {
+    return tJobSystem == this ? tThreadIndex : UINT32_MAX;
+}
@@ -0,0 +1,95 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "WorkStealingDeque.h"
+
+
+namespace VulkanEngine {
+
+    // Tracks a group of jobs. wait() returns once every job run against it has finished and
+    // rethrows the first exception any of them threw.
+    struct JobCounter
+    {
+        std::atomic<uint32_t> pending{0};
+        std::exception_ptr error;
+        std::atomic_flag failed = ATOMIC_FLAG_INIT;
+
+        bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+    };
+
+// Work-stealing scheduler, one deque per thread including the main one. Waiting runs other jobs
+// instead of blocking. Main-thread-only calls go through runOnMainThread() and pumpMainThread().
+class JobSystem {
+public:
+    using JobFunction = std::function<void()>;
+    using RangeFunction = std::function<void(uint32_t first, uint32_t last)>;
+
+    explicit JobSystem(uint32_t workerCount = defaultWorkerCount());
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    static uint32_t defaultWorkerCount();
+
+    // Worker threads plus the main thread.
+    uint32_t getThreadCount() const { return static_cast<uint32_t>(mQueues.size()); }
+    bool isMainThread() const;
+
+    void run(JobFunction function, JobCounter* counter = nullptr);
+    void wait(JobCounter& counter);
+
+    // Splits [begin, end) into chunks of at most grainSize and runs them in parallel,
+    // returning once all of them are done. The calling thread takes part.
+    void parallelFor(uint32_t begin, uint32_t end, uint32_t grainSize, const RangeFunction& function);
+
+    void runOnMainThread(JobFunction function);
+    // Also rethrows the first exception of a job run without a counter since the last call.
+    void pumpMainThread();
+
+private:
+    struct Job
+    {
+        JobFunction function;
+        JobCounter* counter;
+    };
+
+    void push(Job* job);
+    Job* findJob(uint32_t threadIndex);
+    void execute(Job* job);
+    void workerLoop(uint32_t threadIndex);
+    void wakeWorkers();
+    uint32_t currentThreadIndex() const;
+
+    std::vector<std::unique_ptr<WorkStealingDeque<Job>>> mQueues;
+    std::vector<std::thread> mThreads;
+
+    // jobs submitted from threads that do not belong to the system
+    std::mutex mSubmitMutex;
+    std::deque<Job*> mSubmitQueue;
+    std::atomic<uint32_t> mSubmitCount{0};
+
+    std::mutex mMainMutex;
+    std::vector<JobFunction> mMainQueue;
+    std::exception_ptr mUncountedError;
+
+    std::mutex mSleepMutex;
+    std::condition_variable mSleepCondition;
+    uint64_t mWakeGeneration = 0;
+    std::atomic<uint32_t> mSleepers{0};
+    std::atomic<bool> mStopping{false};
+};
+
+} // VulkanEngine
+
+#endif //JOBSYSTEM_H
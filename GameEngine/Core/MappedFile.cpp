@@ -0,0 +1,97 @@
+#include "MappedFile.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+#ifdef _WIN32
+
+VulkanEngine::MappedFile::MappedFile(const std::string& path) : mPath(path) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("ERROR: failed to open " + path);
+    }
+    mFile = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        throw std::runtime_error("ERROR: failed to read the size of " + path);
+    }
+    mSize = static_cast<size_t>(size.QuadPart);
+    if (mSize == 0) {
+        // empty files cannot be mapped, nothing to read anyway
+        return;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* view = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (view == nullptr) {
+        if (mapping != nullptr) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        throw std::runtime_error("ERROR: failed to map " + path);
+    }
+    mMapping = mapping;
+    mData = static_cast<const uint8_t*>(view);
+}
+
+
+VulkanEngine::MappedFile::~MappedFile() {
+    if (mData != nullptr) {
+        UnmapViewOfFile(mData);
+    }
+    if (mMapping != nullptr) {
+        CloseHandle(static_cast<HANDLE>(mMapping));
+    }
+    CloseHandle(static_cast<HANDLE>(mFile));
+}
+
+#else
+
+VulkanEngine::MappedFile::MappedFile(const std::string& path) : mPath(path) {
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        throw std::runtime_error("ERROR: failed to open " + path);
+    }
+
+    struct stat info;
+    if (fstat(file, &info) != 0) {
+        close(file);
+        throw std::runtime_error("ERROR: failed to read the size of " + path);
+    }
+    mSize = static_cast<size_t>(info.st_size);
+    if (mSize == 0) {
+        // empty files cannot be mapped, nothing to read anyway
+        close(file);
+        return;
+    }
+
+    // the mapping keeps the file referenced, the descriptor is not needed past this point
+    void* view = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (view == MAP_FAILED) {
+        throw std::runtime_error("ERROR: failed to map " + path);
+    }
+    mData = static_cast<const uint8_t*>(view);
+}
+
+
+VulkanEngine::MappedFile::~MappedFile() {
+    if (mData != nullptr) {
+        munmap(const_cast<uint8_t*>(mData), mSize);
+    }
+}
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+namespace VulkanEngine {
+
+// Read only view of a whole file through the OS page cache.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* getData() const { return mData; }
+    size_t getSize() const { return mSize; }
+    const std::string& getPath() const { return mPath; }
+
+private:
+    std::string mPath;
+    const uint8_t* mData = nullptr;
+    size_t mSize = 0;
+#ifdef _WIN32
+    void* mFile = nullptr;
+    void* mMapping = nullptr;
+#endif
+};
+
+} // VulkanEngine
+
+#endif //MAPPEDFILE_H
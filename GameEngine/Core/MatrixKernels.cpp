@@ -0,0 +1,298 @@
+#include "MatrixKernels.h"
+
+#include <cstring>
+
+#if defined(__AVX2__)
+#define MATRIX_KERNELS_AVX2
+#define MATRIX_KERNELS_SSE
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MATRIX_KERNELS_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define MATRIX_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(__GNUC__)
+// vector types lose their alignment attribute as template arguments, which is harmless here
+#pragma GCC diagnostic ignored "-Wignored-attributes"
+#endif
+
+
+namespace {
+    using VulkanEngine::TransformStreams;
+
+    // the twelve elements of a TRS matrix that are not constant, one lane per node
+    template<typename V>
+    struct Columns
+    {
+        V c0x, c0y, c0z;
+        V c1x, c1y, c1z;
+        V c2x, c2y, c2z;
+        V tx, ty, tz;
+    };
+
+    // Written once against a small set of lane operations so every instruction set runs the
+    // same formula: the rotation matrix of a unit quaternion with each column scaled.
+    template<typename Ops>
+    Columns<typename Ops::V> composeColumns(const TransformStreams& t, uint32_t i) {
+        using V = typename Ops::V;
+        V x = Ops::load(t.rotationX + i);
+        V y = Ops::load(t.rotationY + i);
+        V z = Ops::load(t.rotationZ + i);
+        V w = Ops::load(t.rotationW + i);
+        V sx = Ops::load(t.scaleX + i);
+        V sy = Ops::load(t.scaleY + i);
+        V sz = Ops::load(t.scaleZ + i);
+        V one = Ops::set1(1.0f);
+        V two = Ops::set1(2.0f);
+
+        V xx = Ops::mul(x, x), yy = Ops::mul(y, y), zz = Ops::mul(z, z);
+        V xy = Ops::mul(x, y), xz = Ops::mul(x, z), yz = Ops::mul(y, z);
+        V wx = Ops::mul(w, x), wy = Ops::mul(w, y), wz = Ops::mul(w, z);
+
+        Columns<V> c;
+        c.c0x = Ops::mul(Ops::sub(one, Ops::mul(two, Ops::add(yy, zz))), sx);
+        c.c0y = Ops::mul(Ops::mul(two, Ops::add(xy, wz)), sx);
+        c.c0z = Ops::mul(Ops::mul(two, Ops::sub(xz, wy)), sx);
+        c.c1x = Ops::mul(Ops::mul(two, Ops::sub(xy, wz)), sy);
+        c.c1y = Ops::mul(Ops::sub(one, Ops::mul(two, Ops::add(xx, zz))), sy);
+        c.c1z = Ops::mul(Ops::mul(two, Ops::add(yz, wx)), sy);
+        c.c2x = Ops::mul(Ops::mul(two, Ops::add(xz, wy)), sz);
+        c.c2y = Ops::mul(Ops::mul(two, Ops::sub(yz, wx)), sz);
+        c.c2z = Ops::mul(Ops::sub(one, Ops::mul(two, Ops::add(xx, yy))), sz);
+        c.tx = Ops::load(t.positionX + i);
+        c.ty = Ops::load(t.positionY + i);
+        c.tz = Ops::load(t.positionZ + i);
+        return c;
+    }
+
+    struct ScalarOps
+    {
+        using V = float;
+        static V load(const float* p) { return *p; }
+        static V set1(float v) { return v; }
+        static V add(V a, V b) { return a + b; }
+        static V sub(V a, V b) { return a - b; }
+        static V mul(V a, V b) { return a * b; }
+    };
+
+#if defined(MATRIX_KERNELS_SSE)
+    struct SseOps
+    {
+        using V = __m128;
+        static V load(const float* p) { return _mm_loadu_ps(p); }
+        static V set1(float v) { return _mm_set1_ps(v); }
+        static V add(V a, V b) { return _mm_add_ps(a, b); }
+        static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+        static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+    };
+
+    // turns one column of four nodes, held as x/y/z/w lanes, into that column of each matrix
+    void storeColumn4(__m128 x, __m128 y, __m128 z, __m128 w, float* matrix) {
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        _mm_storeu_ps(matrix, x);
+        _mm_storeu_ps(matrix + 16, y);
+        _mm_storeu_ps(matrix + 32, z);
+        _mm_storeu_ps(matrix + 48, w);
+    }
+
+    void storeBatch4(const Columns<__m128>& c, float* matrices) {
+        __m128 zero = _mm_setzero_ps();
+        storeColumn4(c.c0x, c.c0y, c.c0z, zero, matrices);
+        storeColumn4(c.c1x, c.c1y, c.c1z, zero, matrices + 4);
+        storeColumn4(c.c2x, c.c2y, c.c2z, zero, matrices + 8);
+        storeColumn4(c.tx, c.ty, c.tz, _mm_set1_ps(1.0f), matrices + 12);
+    }
+#endif
+
+#if defined(MATRIX_KERNELS_AVX2)
+    struct Avx2Ops
+    {
+        using V = __m256;
+        static V load(const float* p) { return _mm256_loadu_ps(p); }
+        static V set1(float v) { return _mm256_set1_ps(v); }
+        static V add(V a, V b) { return _mm256_add_ps(a, b); }
+        static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+        static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    };
+
+    Columns<__m128> half(const Columns<__m256>& c, bool high) {
+        auto pick = [high](__m256 v) { return high ? _mm256_extractf128_ps(v, 1) : _mm256_castps256_ps128(v); };
+        return Columns<__m128>{pick(c.c0x), pick(c.c0y), pick(c.c0z),
+                               pick(c.c1x), pick(c.c1y), pick(c.c1z),
+                               pick(c.c2x), pick(c.c2y), pick(c.c2z),
+                               pick(c.tx), pick(c.ty), pick(c.tz)};
+    }
+#endif
+
+#if defined(MATRIX_KERNELS_NEON)
+    struct NeonOps
+    {
+        using V = float32x4_t;
+        static V load(const float* p) { return vld1q_f32(p); }
+        static V set1(float v) { return vdupq_n_f32(v); }
+        static V add(V a, V b) { return vaddq_f32(a, b); }
+        static V sub(V a, V b) { return vsubq_f32(a, b); }
+        static V mul(V a, V b) { return vmulq_f32(a, b); }
+    };
+
+    void storeColumn4(float32x4_t x, float32x4_t y, float32x4_t z, float32x4_t w, float* matrix) {
+        float32x4x2_t xy = vtrnq_f32(x, y);
+        float32x4x2_t zw = vtrnq_f32(z, w);
+        vst1q_f32(matrix, vcombine_f32(vget_low_f32(xy.val[0]), vget_low_f32(zw.val[0])));
+        vst1q_f32(matrix + 16, vcombine_f32(vget_low_f32(xy.val[1]), vget_low_f32(zw.val[1])));
+        vst1q_f32(matrix + 32, vcombine_f32(vget_high_f32(xy.val[0]), vget_high_f32(zw.val[0])));
+        vst1q_f32(matrix + 48, vcombine_f32(vget_high_f32(xy.val[1]), vget_high_f32(zw.val[1])));
+    }
+
+    void storeBatch4(const Columns<float32x4_t>& c, float* matrices) {
+        float32x4_t zero = vdupq_n_f32(0.0f);
+        storeColumn4(c.c0x, c.c0y, c.c0z, zero, matrices);
+        storeColumn4(c.c1x, c.c1y, c.c1z, zero, matrices + 4);
+        storeColumn4(c.c2x, c.c2y, c.c2z, zero, matrices + 8);
+        storeColumn4(c.tx, c.ty, c.tz, vdupq_n_f32(1.0f), matrices + 12);
+    }
+#endif
+}
+
+
+const char*
+VulkanEngine::MatrixKernels::getInstructionSet() {
+#if defined(MATRIX_KERNELS_AVX2)
+    return "AVX2";
+#elif defined(MATRIX_KERNELS_SSE)
+    return "SSE2";
+#elif defined(MATRIX_KERNELS_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
+
+
+void
+VulkanEngine::MatrixKernels::composeTRS(const TransformStreams& transforms, uint32_t first, uint32_t count, float* matrices) {
+    uint32_t i = first;
+    uint32_t end = first + count;
+#if defined(MATRIX_KERNELS_AVX2)
+    for (; i + 8 <= end; i += 8) {
+        Columns<__m256> c = composeColumns<Avx2Ops>(transforms, i);
+        storeBatch4(half(c, false), matrices + size_t(i) * 16);
+        storeBatch4(half(c, true), matrices + size_t(i + 4) * 16);
+    }
+#endif
+#if defined(MATRIX_KERNELS_SSE)
+    for (; i + 4 <= end; i += 4) {
+        storeBatch4(composeColumns<SseOps>(transforms, i), matrices + size_t(i) * 16);
+    }
+#elif defined(MATRIX_KERNELS_NEON)
+    for (; i + 4 <= end; i += 4) {
+        storeBatch4(composeColumns<NeonOps>(transforms, i), matrices + size_t(i) * 16);
+    }
+#endif
+    composeTRSScalar(transforms, i, end - i, matrices);
+}
+
+
+void
+VulkanEngine::MatrixKernels::multiplyParents(float* matrices, const uint32_t* parents, uint32_t first, uint32_t count) {
+#if defined(MATRIX_KERNELS_AVX2)
+    for (uint32_t i = first; i < first + count; i++) {
+        const float* parent = matrices + size_t(parents[i]) * 16;
+        float* matrix = matrices + size_t(i) * 16;
+        __m256 p0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(parent));
+        __m256 p1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(parent + 4));
+        __m256 p2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(parent + 8));
+        __m256 p3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(parent + 12));
+        // two columns of the child per register
+        for (uint32_t column = 0; column < 16; column += 8) {
+            __m256 local = _mm256_loadu_ps(matrix + column);
+            __m256 result = _mm256_mul_ps(p0, _mm256_shuffle_ps(local, local, 0x00));
+            result = _mm256_add_ps(result, _mm256_mul_ps(p1, _mm256_shuffle_ps(local, local, 0x55)));
+            result = _mm256_add_ps(result, _mm256_mul_ps(p2, _mm256_shuffle_ps(local, local, 0xAA)));
+            result = _mm256_add_ps(result, _mm256_mul_ps(p3, _mm256_shuffle_ps(local, local, 0xFF)));
+            _mm256_storeu_ps(matrix + column, result);
+        }
+    }
+#elif defined(MATRIX_KERNELS_SSE)
+    for (uint32_t i = first; i < first + count; i++) {
+        const float* parent = matrices + size_t(parents[i]) * 16;
+        float* matrix = matrices + size_t(i) * 16;
+        __m128 p0 = _mm_loadu_ps(parent);
+        __m128 p1 = _mm_loadu_ps(parent + 4);
+        __m128 p2 = _mm_loadu_ps(parent + 8);
+        __m128 p3 = _mm_loadu_ps(parent + 12);
+        for (uint32_t column = 0; column < 16; column += 4) {
+            __m128 local = _mm_loadu_ps(matrix + column);
+            __m128 result = _mm_mul_ps(p0, _mm_shuffle_ps(local, local, _MM_SHUFFLE(0, 0, 0, 0)));
+            result = _mm_add_ps(result, _mm_mul_ps(p1, _mm_shuffle_ps(local, local, _MM_SHUFFLE(1, 1, 1, 1))));
+            result = _mm_add_ps(result, _mm_mul_ps(p2, _mm_shuffle_ps(local, local, _MM_SHUFFLE(2, 2, 2, 2))));
+            result = _mm_add_ps(result, _mm_mul_ps(p3, _mm_shuffle_ps(local, local, _MM_SHUFFLE(3, 3, 3, 3))));
+            _mm_storeu_ps(matrix + column, result);
+        }
+    }
+#elif defined(MATRIX_KERNELS_NEON)
+    for (uint32_t i = first; i < first + count; i++) {
+        const float* parent = matrices + size_t(parents[i]) * 16;
+        float* matrix = matrices + size_t(i) * 16;
+        float32x4_t p0 = vld1q_f32(parent);
+        float32x4_t p1 = vld1q_f32(parent + 4);
+        float32x4_t p2 = vld1q_f32(parent + 8);
+        float32x4_t p3 = vld1q_f32(parent + 12);
+        for (uint32_t column = 0; column < 16; column += 4) {
+            float32x4_t local = vld1q_f32(matrix + column);
+            float32x4_t result = vmulq_n_f32(p0, vgetq_lane_f32(local, 0));
+            result = vmlaq_n_f32(result, p1, vgetq_lane_f32(local, 1));
+            result = vmlaq_n_f32(result, p2, vgetq_lane_f32(local, 2));
+            result = vmlaq_n_f32(result, p3, vgetq_lane_f32(local, 3));
+            vst1q_f32(matrix + column, result);
+        }
+    }
+#else
+    multiplyParentsScalar(matrices, parents, first, count);
+#endif
+}
+
+
+void
+VulkanEngine::MatrixKernels::storeMatrices(const float* matrices, const uint32_t* indices, uint32_t count, void* destination, size_t stride) {
+    uint8_t* bytes = static_cast<uint8_t*>(destination);
+    for (uint32_t i = 0; i < count; i++) {
+        memcpy(bytes + i * stride, matrices + size_t(indices[i]) * 16, sizeof(float) * 16);
+    }
+}
+
+
+void
+VulkanEngine::MatrixKernels::composeTRSScalar(const TransformStreams& transforms, uint32_t first, uint32_t count, float* matrices) {
+    for (uint32_t i = first; i < first + count; i++) {
+        Columns<float> c = composeColumns<ScalarOps>(transforms, i);
+        float* m = matrices + size_t(i) * 16;
+        m[0] = c.c0x; m[1] = c.c0y; m[2] = c.c0z; m[3] = 0.0f;
+        m[4] = c.c1x; m[5] = c.c1y; m[6] = c.c1z; m[7] = 0.0f;
+        m[8] = c.c2x; m[9] = c.c2y; m[10] = c.c2z; m[11] = 0.0f;
+        m[12] = c.tx; m[13] = c.ty; m[14] = c.tz; m[15] = 1.0f;
+    }
+}
+
+
+void
+VulkanEngine::MatrixKernels::multiplyParentsScalar(float* matrices, const uint32_t* parents, uint32_t first, uint32_t count) {
+    for (uint32_t i = first; i < first + count; i++) {
+        const float* parent = matrices + size_t(parents[i]) * 16;
+        float* matrix = matrices + size_t(i) * 16;
+        float local[16];
+        memcpy(local, matrix, sizeof(local));
+        for (uint32_t column = 0; column < 4; column++) {
+            for (uint32_t row = 0; row < 4; row++) {
+                matrix[column * 4 + row] = parent[row] * local[column * 4]
+                                         + parent[4 + row] * local[column * 4 + 1]
+                                         + parent[8 + row] * local[column * 4 + 2]
+                                         + parent[12 + row] * local[column * 4 + 3];
+            }
+        }
+    }
+}
+
@@ -0,0 +1,50 @@
+#ifndef MATRIXKERNELS_H
+#define MATRIXKERNELS_H
+
+
+#include <cstdint>
+#include <cstddef>
+
+
+namespace VulkanEngine {
+
+    // Local transforms as structure of arrays, one stream per component.
+    struct TransformStreams
+    {
+        const float* positionX;
+        const float* positionY;
+        const float* positionZ;
+        const float* rotationX;
+        const float* rotationY;
+        const float* rotationZ;
+        const float* rotationW;
+        const float* scaleX;
+        const float* scaleY;
+        const float* scaleZ;
+    };
+
+// Batched 4x4 matrix math, 16 floats column major like glm::mat4. AVX2, SSE2 or NEON is picked at
+// compile time, the Scalar versions are always there for comparison.
+namespace MatrixKernels {
+
+    const char* getInstructionSet();
+
+    // matrices[i] = translate(position[i]) * rotate(rotation[i]) * scale(scale[i]) for i in [first, first + count).
+    void composeTRS(const TransformStreams& transforms, uint32_t first, uint32_t count, float* matrices);
+
+    // matrices[i] = matrices[parents[i]] * matrices[i] for i in [first, first + count). Parents
+    // must come before first, which breadth first order guarantees.
+    void multiplyParents(float* matrices, const uint32_t* parents, uint32_t first, uint32_t count);
+
+    // Copies matrices[indices[i]] to destination + i * stride, front to back and without reading
+    // the destination, so it is safe to point at write combined mapped memory.
+    void storeMatrices(const float* matrices, const uint32_t* indices, uint32_t count, void* destination, size_t stride);
+
+    void composeTRSScalar(const TransformStreams& transforms, uint32_t first, uint32_t count, float* matrices);
+    void multiplyParentsScalar(float* matrices, const uint32_t* parents, uint32_t first, uint32_t count);
+
+} // MatrixKernels
+
+} // VulkanEngine
+
+#endif //MATRIXKERNELS_H
@@ -0,0 +1,309 @@
+#include "MeshData.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+
+namespace {
+    struct ObjCorner
+    {
+        int position;
+        int texCoord;
+        int normal;
+
+        bool operator==(const ObjCorner& other) const {
+            return position == other.position && texCoord == other.texCoord && normal == other.normal;
+        }
+    };
+
+    struct ObjCornerHash
+    {
+        size_t operator()(const ObjCorner& corner) const {
+            return (size_t(uint32_t(corner.position)) * 73856093u) ^ (size_t(uint32_t(corner.texCoord)) * 19349663u) ^
+                   (size_t(uint32_t(corner.normal)) * 83492791u);
+        }
+    };
+
+    const char* skipSpaces(const char* cursor, const char* end) {
+        while (cursor < end && (*cursor == ' ' || *cursor == '\t')) {
+            cursor++;
+        }
+        return cursor;
+    }
+
+    // strtof would run past the line on a truncated file, the mapping is not null terminated
+    const char* parseFloats(const char* cursor, const char* end, float* values, int maxCount, int& count) {
+        count = 0;
+        char buffer[64];
+        while (count < maxCount) {
+            cursor = skipSpaces(cursor, end);
+            const char* start = cursor;
+            while (cursor < end && *cursor != ' ' && *cursor != '\t' && *cursor != '\r' && *cursor != '\n') {
+                cursor++;
+            }
+            size_t length = static_cast<size_t>(cursor - start);
+            if (length == 0 || length >= sizeof(buffer)) {
+                break;
+            }
+            std::memcpy(buffer, start, length);
+            buffer[length] = '\0';
+            values[count++] = std::strtof(buffer, nullptr);
+        }
+        return cursor;
+    }
+
+    // OBJ indices are 1 based, negative ones count back from the latest element, 0 means absent
+    int resolveIndex(long index, size_t count) {
+        if (index > 0) {
+            return static_cast<int>(index - 1);
+        }
+        if (index < 0) {
+            return static_cast<int>(static_cast<long>(count) + index);
+        }
+        return -1;
+    }
+
+    const char* parseCorner(const char* cursor, const char* end, ObjCorner& corner, size_t positionCount, size_t texCoordCount, size_t normalCount) {
+        long values[3] = {0, 0, 0};
+        for (int part = 0; part < 3 && cursor < end; part++) {
+            bool negative = *cursor == '-';
+            cursor += negative ? 1 : 0;
+            long value = 0;
+            while (cursor < end && *cursor >= '0' && *cursor <= '9') {
+                value = value * 10 + (*cursor - '0');
+                cursor++;
+            }
+            values[part] = negative ? -value : value;
+            if (cursor >= end || *cursor != '/') {
+                break;
+            }
+            cursor++;
+        }
+        corner.position = resolveIndex(values[0], positionCount);
+        corner.texCoord = resolveIndex(values[1], texCoordCount);
+        corner.normal = resolveIndex(values[2], normalCount);
+        return cursor;
+    }
+
+    bool startsWith(const char* cursor, const char* end, const char* keyword) {
+        size_t length = std::strlen(keyword);
+        if (static_cast<size_t>(end - cursor) < length || std::memcmp(cursor, keyword, length) != 0) {
+            return false;
+        }
+        return cursor + length == end || cursor[length] == ' ' || cursor[length] == '\t';
+    }
+
+    VulkanEngine::MeshBounds boundsOf(const VulkanEngine::MeshVertex* vertices, const uint32_t* indices, size_t indexCount) {
+        VulkanEngine::MeshBounds bounds{};
+        if (indexCount == 0) {
+            return bounds;
+        }
+        for (int c = 0; c < 3; c++) {
+            bounds.min[c] = vertices[indices[0]].position[c];
+            bounds.max[c] = vertices[indices[0]].position[c];
+        }
+        for (size_t i = 1; i < indexCount; i++) {
+            for (int c = 0; c < 3; c++) {
+                bounds.min[c] = std::min(bounds.min[c], vertices[indices[i]].position[c]);
+                bounds.max[c] = std::max(bounds.max[c], vertices[indices[i]].position[c]);
+            }
+        }
+
+        // around the box centre, not minimal but stable and cheap
+        float radiusSquared = 0.0f;
+        for (int c = 0; c < 3; c++) {
+            bounds.center[c] = (bounds.min[c] + bounds.max[c]) * 0.5f;
+        }
+        for (size_t i = 0; i < indexCount; i++) {
+            float distance = 0.0f;
+            for (int c = 0; c < 3; c++) {
+                float d = vertices[indices[i]].position[c] - bounds.center[c];
+                distance += d * d;
+            }
+            radiusSquared = std::max(radiusSquared, distance);
+        }
+        bounds.radius = std::sqrt(radiusSquared);
+        return bounds;
+    }
+}
+
+
+VulkanEngine::MeshData
+VulkanEngine::MeshData::loadObj(const std::string& path) {
+    MappedFile file(path);
+    const char* cursor = reinterpret_cast<const char*>(file.getData());
+    const char* fileEnd = cursor + file.getSize();
+
+    // position xyz followed by colour rgb, white unless the file has them
+    std::vector<float> positions;
+    std::vector<float> texCoords;
+    std::vector<float> normals;
+    // material 0 is for faces before the first usemtl
+    std::vector<std::string> materials(1);
+    uint32_t material = 0;
+
+    std::vector<MeshVertex> vertices;
+    std::vector<int> vertexPositions;
+    std::vector<bool> hasNormal;
+    std::unordered_map<ObjCorner, uint32_t, ObjCornerHash> cornerVertices;
+    // triangles per material, concatenated in material order once the file is read
+    std::vector<std::vector<uint32_t>> materialIndices(1);
+    std::vector<uint32_t> polygon;
+
+    size_t lineNumber = 0;
+    while (cursor < fileEnd) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(cursor, '\n', static_cast<size_t>(fileEnd - cursor)));
+        lineEnd = lineEnd != nullptr ? lineEnd : fileEnd;
+        const char* line = skipSpaces(cursor, lineEnd);
+        cursor = lineEnd + 1;
+        lineNumber++;
+
+        float values[6];
+        int count = 0;
+        if (startsWith(line, lineEnd, "v")) {
+            parseFloats(line + 1, lineEnd, values, 6, count);
+            if (count < 3) {
+                throw std::runtime_error("ERROR: " + path + ":" + std::to_string(lineNumber) + " has a malformed vertex");
+            }
+            positions.insert(positions.end(), values, values + 3);
+            if (count == 6) {
+                positions.insert(positions.end(), values + 3, values + 6);
+            } else {
+                positions.insert(positions.end(), {1.0f, 1.0f, 1.0f});
+            }
+        } else if (startsWith(line, lineEnd, "vt")) {
+            parseFloats(line + 2, lineEnd, values, 2, count);
+            texCoords.push_back(count > 0 ? values[0] : 0.0f);
+            // OBJ puts v = 0 at the bottom of the image, Vulkan at the top
+            texCoords.push_back(count > 1 ? 1.0f - values[1] : 1.0f);
+        } else if (startsWith(line, lineEnd, "vn")) {
+            parseFloats(line + 2, lineEnd, values, 3, count);
+            if (count < 3) {
+                throw std::runtime_error("ERROR: " + path + ":" + std::to_string(lineNumber) + " has a malformed normal");
+            }
+            normals.insert(normals.end(), values, values + 3);
+        } else if (startsWith(line, lineEnd, "usemtl")) {
+            std::string name(skipSpaces(line + 6, lineEnd), lineEnd);
+            while (!name.empty() && (name.back() == '\r' || name.back() == ' ' || name.back() == '\t')) {
+                name.pop_back();
+            }
+            auto found = std::find(materials.begin(), materials.end(), name);
+            material = static_cast<uint32_t>(found - materials.begin());
+            if (found == materials.end()) {
+                materials.push_back(name);
+                materialIndices.resize(materials.size());
+            }
+        } else if (startsWith(line, lineEnd, "f")) {
+            polygon.clear();
+            const char* token = line + 1;
+            for (;;) {
+                token = skipSpaces(token, lineEnd);
+                if (token >= lineEnd || *token == '\r') {
+                    break;
+                }
+                ObjCorner corner;
+                token = parseCorner(token, lineEnd, corner, positions.size() / 6, texCoords.size() / 2, normals.size() / 3);
+                if (corner.position < 0 || size_t(corner.position) >= positions.size() / 6 ||
+                    size_t(corner.texCoord + 1) > texCoords.size() / 2 || size_t(corner.normal + 1) > normals.size() / 3) {
+                    throw std::runtime_error("ERROR: " + path + ":" + std::to_string(lineNumber) + " references a missing element");
+                }
+
+                auto [found, inserted] = cornerVertices.try_emplace(corner, static_cast<uint32_t>(vertices.size()));
+                if (inserted) {
+                    MeshVertex vertex{};
+                    const float* position = &positions[size_t(corner.position) * 6];
+                    std::copy(position, position + 3, vertex.position);
+                    std::copy(position + 3, position + 6, vertex.color);
+                    if (corner.texCoord >= 0) {
+                        std::copy(&texCoords[size_t(corner.texCoord) * 2], &texCoords[size_t(corner.texCoord) * 2] + 2, vertex.texCoord);
+                    }
+                    if (corner.normal >= 0) {
+                        std::copy(&normals[size_t(corner.normal) * 3], &normals[size_t(corner.normal) * 3] + 3, vertex.normal);
+                    }
+                    vertices.push_back(vertex);
+                    vertexPositions.push_back(corner.position);
+                    hasNormal.push_back(corner.normal >= 0);
+                }
+                polygon.push_back(found->second);
+                // skip whatever trails the corner, e.g. a stray slash
+                while (token < lineEnd && *token != ' ' && *token != '\t' && *token != '\r') {
+                    token++;
+                }
+            }
+
+            if (polygon.size() < 3) {
+                throw std::runtime_error("ERROR: " + path + ":" + std::to_string(lineNumber) + " has a face with fewer than 3 corners");
+            }
+            std::vector<uint32_t>& target = materialIndices[material];
+            for (size_t i = 1; i + 1 < polygon.size(); i++) {
+                target.insert(target.end(), {polygon[0], polygon[i], polygon[i + 1]});
+            }
+        }
+    }
+
+    if (vertices.empty()) {
+        throw std::runtime_error("ERROR: " + path + " has no faces");
+    }
+
+    // area weighted face normals, summed per position so smooth surfaces stay smooth across uv seams
+    if (std::find(hasNormal.begin(), hasNormal.end(), false) != hasNormal.end()) {
+        std::vector<float> positionNormals(positions.size() / 6 * 3, 0.0f);
+        for (const auto& indices : materialIndices) {
+            for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+                const float* a = vertices[indices[i]].position;
+                const float* b = vertices[indices[i + 1]].position;
+                const float* c = vertices[indices[i + 2]].position;
+                float ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+                float ac[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+                float normal[3] = {ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0]};
+                for (size_t corner = 0; corner < 3; corner++) {
+                    float* sum = &positionNormals[size_t(vertexPositions[indices[i + corner]]) * 3];
+                    for (int k = 0; k < 3; k++) {
+                        sum[k] += normal[k];
+                    }
+                }
+            }
+        }
+        for (size_t v = 0; v < vertices.size(); v++) {
+            if (hasNormal[v]) {
+                continue;
+            }
+            const float* sum = &positionNormals[size_t(vertexPositions[v]) * 3];
+            float length = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+            for (int k = 0; k < 3; k++) {
+                vertices[v].normal[k] = length > 0.0f ? sum[k] / length : (k == 2 ? 1.0f : 0.0f);
+            }
+        }
+    }
+
+    MeshData mesh;
+    mesh.vertices.owned = std::move(vertices);
+    for (uint32_t m = 0; m < materialIndices.size(); m++) {
+        if (materialIndices[m].empty()) {
+            continue;
+        }
+        MeshSubmesh submesh{};
+        submesh.lod = 0;
+        submesh.firstIndex = static_cast<uint32_t>(mesh.indices.owned.size());
+        submesh.indexCount = static_cast<uint32_t>(materialIndices[m].size());
+        submesh.material = m;
+        mesh.submeshes.push_back(submesh);
+        mesh.indices.owned.insert(mesh.indices.owned.end(), materialIndices[m].begin(), materialIndices[m].end());
+    }
+    mesh.lods.push_back({0, static_cast<uint32_t>(mesh.indices.owned.size()), 0, 0, 0.0f});
+    mesh.computeBounds();
+    return mesh;
+}
+
+
+void
+VulkanEngine::MeshData::computeBounds() {
+    bounds = boundsOf(vertices.data(), indices.data(), indices.size());
+    for (auto& submesh : submeshes) {
+        submesh.bounds = boundsOf(vertices.data(), indices.data() + submesh.firstIndex, submesh.indexCount);
+    }
+}
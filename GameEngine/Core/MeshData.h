@@ -0,0 +1,125 @@
+#ifndef MESHDATA_H
+#define MESHDATA_H
+
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+
+
+namespace VulkanEngine {
+
+    // The layout of the vertex stream in mesh files and in the engine's vertex buffer.
+    struct MeshVertex
+    {
+        float position[3];
+        float normal[3];
+        float texCoord[2];
+        float color[3];
+    };
+    static_assert(sizeof(MeshVertex) == 44, "MeshVertex is part of the mesh file format");
+
+    // MeshVertex in 20 bytes, see MeshOptimizer::quantizeVertices.
+    struct QuantizedMeshVertex
+    {
+        uint16_t position[4];
+        int16_t normal[2];
+        uint16_t texCoord[2];
+        uint8_t color[4];
+    };
+    static_assert(sizeof(QuantizedMeshVertex) == 20, "QuantizedMeshVertex is read by the vertex shader");
+
+    // Axis aligned box and bounding sphere, in the mesh's object space.
+    struct MeshBounds
+    {
+        float min[3];
+        float max[3];
+        float center[3];
+        float radius;
+    };
+
+    // One level of detail, error is its object space distance from level 0.
+    struct MeshLod
+    {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        uint32_t firstMeshlet;
+        uint32_t meshletCount;
+        float error;
+    };
+
+    // A run of a level's indices sharing one material.
+    struct MeshSubmesh
+    {
+        uint32_t lod;
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        uint32_t material;
+        MeshBounds bounds;
+    };
+
+    // A small cluster of triangles, culled as a whole. Backfacing from a camera when
+    // dot(center - camera, coneAxis) >= coneCutoff * length(center - camera) + radius.
+    struct Meshlet
+    {
+        uint32_t vertexOffset;
+        uint32_t triangleOffset;
+        uint32_t vertexCount;
+        uint32_t triangleCount;
+        float center[3];
+        float radius;
+        float coneAxis[3];
+        float coneCutoff;
+    };
+
+    // Elements either owned or pointing into a MeshData's mapping.
+    template <typename T>
+    struct MeshStream
+    {
+        std::vector<T> owned;
+        const T* mapped = nullptr;
+        size_t mappedCount = 0;
+
+        const T* data() const { return mapped != nullptr ? mapped : owned.data(); }
+        size_t size() const { return mapped != nullptr ? mappedCount : owned.size(); }
+        size_t byteSize() const { return size() * sizeof(T); }
+        const T& operator[](size_t i) const { return data()[i]; }
+
+        // Copies mapped elements into owned ones, for code that modifies the stream.
+        std::vector<T>& own() {
+            if (mapped != nullptr) {
+                owned.assign(mapped, mapped + mappedCount);
+                mapped = nullptr;
+                mappedCount = 0;
+            }
+            return owned;
+        }
+    };
+
+// Triangle mesh as the engine draws it, with levels of detail and submeshes as index ranges.
+// Meshes read from mesh files leave their streams in the file mapping.
+struct MeshData {
+    MeshBounds bounds{};
+    MeshStream<MeshVertex> vertices;
+    MeshStream<uint32_t> indices;
+    std::vector<MeshLod> lods;
+    std::vector<MeshSubmesh> submeshes;
+    std::vector<Meshlet> meshlets;
+    MeshStream<uint32_t> meshletVertices;
+    MeshStream<uint8_t> meshletTriangles;
+    std::shared_ptr<const MappedFile> mapping;
+    // Set once MeshOptimizer::optimize has run, mesh files remember it.
+    bool optimized = false;
+
+    // Wavefront OBJ, with "v x y z r g b" vertex colours. Every usemtl starts a submesh.
+    static MeshData loadObj(const std::string& path);
+
+    // Bounds of the whole mesh and of every submesh, from the vertices they use.
+    void computeBounds();
+};
+
+} // VulkanEngine
+
+#endif //MESHDATA_H
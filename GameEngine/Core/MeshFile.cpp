@@ -0,0 +1,239 @@
+#include "MeshFile.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+
+namespace {
+    constexpr char MAGIC[8] = {'V', 'M', 'S', 'H', '\r', '\n', '\x1a', '\n'};
+    constexpr uint64_t STREAM_ALIGNMENT = 4096;
+    constexpr uint64_t TABLE_ALIGNMENT = 16;
+
+    enum class SectionType : uint32_t
+    {
+        Vertices = 1,
+        Indices = 2,
+        Lods = 3,
+        Submeshes = 4,
+        Meshlets = 5,
+        MeshletVertices = 6,
+        MeshletTriangles = 7
+    };
+    constexpr uint32_t SECTION_TYPE_COUNT = 8;
+
+    constexpr uint32_t FLAG_OPTIMIZED = 1;
+
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t sectionCount;
+        uint32_t flags;
+        uint32_t reserved;
+        VulkanEngine::MeshBounds bounds;
+    };
+    static_assert(sizeof(FileHeader) == 64, "the header layout is part of the file format");
+
+    struct FileSection
+    {
+        uint32_t type;
+        uint32_t elementSize;
+        uint64_t offset;
+        uint64_t count;
+    };
+    static_assert(sizeof(FileSection) == 24, "the section layout is part of the file format");
+    static_assert(sizeof(VulkanEngine::MeshLod) == 20, "MeshLod is part of the mesh file format");
+    static_assert(sizeof(VulkanEngine::MeshSubmesh) == 56, "MeshSubmesh is part of the mesh file format");
+    static_assert(sizeof(VulkanEngine::Meshlet) == 48, "Meshlet is part of the mesh file format");
+
+    struct PendingSection
+    {
+        SectionType type;
+        uint32_t elementSize;
+        uint64_t count;
+        const void* data;
+    };
+
+    uint64_t alignUp(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    uint64_t alignmentOf(SectionType type) {
+        return type == SectionType::Vertices || type == SectionType::Indices ? STREAM_ALIGNMENT : TABLE_ALIGNMENT;
+    }
+
+    template <typename T>
+    void readTable(const uint8_t* data, const FileSection& section, std::vector<T>& table) {
+        table.resize(section.count);
+        if (section.count == 0) {
+            return;
+        }
+        std::memcpy(table.data(), data + section.offset, sizeof(T) * section.count);
+    }
+
+    template <typename T>
+    void mapStream(const uint8_t* data, const FileSection& section, VulkanEngine::MeshStream<T>& stream) {
+        stream.mapped = reinterpret_cast<const T*>(data + section.offset);
+        stream.mappedCount = section.count;
+    }
+
+    bool inRange(uint64_t first, uint64_t count, uint64_t size) {
+        return first <= size && count <= size - first;
+    }
+}
+
+
+void
+VulkanEngine::MeshFile::write(const std::string& path, const MeshData& mesh) {
+    std::vector<PendingSection> sections = {
+        {SectionType::Vertices, sizeof(MeshVertex), mesh.vertices.size(), mesh.vertices.data()},
+        {SectionType::Indices, sizeof(uint32_t), mesh.indices.size(), mesh.indices.data()},
+        {SectionType::Lods, sizeof(MeshLod), mesh.lods.size(), mesh.lods.data()},
+        {SectionType::Submeshes, sizeof(MeshSubmesh), mesh.submeshes.size(), mesh.submeshes.data()}
+    };
+    if (!mesh.meshlets.empty()) {
+        sections.push_back({SectionType::Meshlets, sizeof(Meshlet), mesh.meshlets.size(), mesh.meshlets.data()});
+        sections.push_back({SectionType::MeshletVertices, sizeof(uint32_t), mesh.meshletVertices.size(), mesh.meshletVertices.data()});
+        sections.push_back({SectionType::MeshletTriangles, sizeof(uint8_t), mesh.meshletTriangles.size(), mesh.meshletTriangles.data()});
+    }
+
+    FileHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.sectionCount = static_cast<uint32_t>(sections.size());
+    header.flags = mesh.optimized ? FLAG_OPTIMIZED : 0;
+    header.bounds = mesh.bounds;
+
+    std::vector<FileSection> table;
+    uint64_t offset = sizeof(FileHeader) + sizeof(FileSection) * sections.size();
+    for (const auto& section : sections) {
+        offset = alignUp(offset, alignmentOf(section.type));
+        table.push_back({static_cast<uint32_t>(section.type), section.elementSize, offset, section.count});
+        offset += section.elementSize * section.count;
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("ERROR: failed to open " + path + " for writing");
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(table.data()), static_cast<std::streamsize>(sizeof(FileSection) * table.size()));
+
+    const std::vector<char> padding(STREAM_ALIGNMENT, 0);
+    for (size_t i = 0; i < sections.size(); i++) {
+        uint64_t position = static_cast<uint64_t>(file.tellp());
+        file.write(padding.data(), static_cast<std::streamsize>(table[i].offset - position));
+        file.write(static_cast<const char*>(sections[i].data), static_cast<std::streamsize>(sections[i].elementSize * sections[i].count));
+    }
+
+    if (!file) {
+        throw std::runtime_error("ERROR: failed to write " + path);
+    }
+}
+
+
+VulkanEngine::MeshData
+VulkanEngine::MeshFile::read(const std::string& path) {
+    auto mapping = std::make_shared<MappedFile>(path);
+    const uint8_t* data = mapping->getData();
+    const uint64_t size = mapping->getSize();
+
+    FileHeader header;
+    if (size < sizeof(header)) {
+        throw std::runtime_error("ERROR: " + path + " is too small for a mesh file");
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("ERROR: " + path + " is not a mesh file");
+    }
+    if (header.version != VERSION) {
+        throw std::runtime_error("ERROR: " + path + " has mesh file version " + std::to_string(header.version) +
+                                 ", expected " + std::to_string(VERSION));
+    }
+    if (!inRange(sizeof(FileHeader), sizeof(FileSection) * uint64_t(header.sectionCount), size)) {
+        throw std::runtime_error("ERROR: " + path + " is truncated");
+    }
+
+    const uint32_t elementSizes[SECTION_TYPE_COUNT] = {
+        0, sizeof(MeshVertex), sizeof(uint32_t), sizeof(MeshLod), sizeof(MeshSubmesh), sizeof(Meshlet), sizeof(uint32_t), sizeof(uint8_t)
+    };
+    FileSection sections[SECTION_TYPE_COUNT] = {};
+    bool present[SECTION_TYPE_COUNT] = {};
+    for (uint32_t i = 0; i < header.sectionCount; i++) {
+        FileSection section;
+        std::memcpy(&section, data + sizeof(FileHeader) + sizeof(FileSection) * i, sizeof(section));
+        if (section.type == 0 || section.type >= SECTION_TYPE_COUNT) {
+            continue;
+        }
+
+        SectionType type = static_cast<SectionType>(section.type);
+        bool valid = !present[section.type] && section.elementSize == elementSizes[section.type] &&
+                     section.offset % alignmentOf(type) == 0 && section.count <= size / section.elementSize &&
+                     inRange(section.offset, section.count * section.elementSize, size);
+        if (!valid) {
+            throw std::runtime_error("ERROR: " + path + " has a malformed section " + std::to_string(i));
+        }
+        sections[section.type] = section;
+        present[section.type] = true;
+    }
+
+    auto has = [&](SectionType type) { return present[static_cast<uint32_t>(type)]; };
+    auto get = [&](SectionType type) -> const FileSection& { return sections[static_cast<uint32_t>(type)]; };
+    if (!has(SectionType::Vertices) || !has(SectionType::Indices) || !has(SectionType::Lods) || !has(SectionType::Submeshes)) {
+        throw std::runtime_error("ERROR: " + path + " is missing a required section");
+    }
+
+    MeshData mesh;
+    mesh.bounds = header.bounds;
+    mesh.optimized = (header.flags & FLAG_OPTIMIZED) != 0;
+    mapStream(data, get(SectionType::Vertices), mesh.vertices);
+    mapStream(data, get(SectionType::Indices), mesh.indices);
+    readTable(data, get(SectionType::Lods), mesh.lods);
+    readTable(data, get(SectionType::Submeshes), mesh.submeshes);
+    if (has(SectionType::Meshlets) && has(SectionType::MeshletVertices) && has(SectionType::MeshletTriangles)) {
+        readTable(data, get(SectionType::Meshlets), mesh.meshlets);
+        mapStream(data, get(SectionType::MeshletVertices), mesh.meshletVertices);
+        mapStream(data, get(SectionType::MeshletTriangles), mesh.meshletTriangles);
+    }
+
+    // the ranges are what draws and culling index with, check them once here
+    bool valid = !mesh.lods.empty();
+    for (const auto& lod : mesh.lods) {
+        valid = valid && inRange(lod.firstIndex, lod.indexCount, mesh.indices.size()) && lod.indexCount % 3 == 0 &&
+                inRange(lod.firstMeshlet, lod.meshletCount, mesh.meshlets.size());
+    }
+    for (const auto& submesh : mesh.submeshes) {
+        valid = valid && submesh.lod < mesh.lods.size() && inRange(submesh.firstIndex, submesh.indexCount, mesh.indices.size());
+    }
+    for (const auto& meshlet : mesh.meshlets) {
+        valid = valid && inRange(meshlet.vertexOffset, meshlet.vertexCount, mesh.meshletVertices.size()) &&
+                inRange(meshlet.triangleOffset, uint64_t(meshlet.triangleCount) * 3, mesh.meshletTriangles.size());
+        for (uint32_t i = 0; valid && i < meshlet.triangleCount * 3; i++) {
+            valid = mesh.meshletTriangles[meshlet.triangleOffset + i] < meshlet.vertexCount;
+        }
+    }
+    // and so are the index values, the optimizer and the shaders read vertices through them
+    const uint32_t* indices = mesh.indices.data();
+    for (size_t i = 0; valid && i < mesh.indices.size(); i++) {
+        valid = indices[i] < mesh.vertices.size();
+    }
+    const uint32_t* meshletVertices = mesh.meshletVertices.data();
+    for (size_t i = 0; valid && i < mesh.meshletVertices.size(); i++) {
+        valid = meshletVertices[i] < mesh.vertices.size();
+    }
+    // the meshlet path draws a level's meshlets as consecutive index ranges, see MeshletBuilder.h
+    for (const auto& lod : mesh.lods) {
+        uint64_t triangles = 0;
+        for (uint32_t i = 0; valid && i < lod.meshletCount; i++) {
+            triangles += mesh.meshlets[lod.firstMeshlet + i].triangleCount;
+        }
+        valid = valid && (lod.meshletCount == 0 || triangles * 3 == lod.indexCount);
+    }
+    if (!valid) {
+        throw std::runtime_error("ERROR: " + path + " has ranges outside its streams");
+    }
+
+    mesh.mapping = std::move(mapping);
+    return mesh;
+}
@@ -0,0 +1,26 @@
+#ifndef MESHFILE_H
+#define MESHFILE_H
+
+
+#include <cstdint>
+#include <string>
+#include "MeshData.h"
+
+
+namespace VulkanEngine {
+
+// Cooked meshes written by the MeshCooker tool: a header, a section table and the sections, the
+// vertex and index streams page aligned. read() maps the file and checks every range and index.
+namespace MeshFile {
+
+    constexpr const char* EXTENSION = ".vmsh";
+    constexpr uint32_t VERSION = 1;
+
+    void write(const std::string& path, const MeshData& mesh);
+    MeshData read(const std::string& path);
+
+} // MeshFile
+
+} // VulkanEngine
+
+#endif //MESHFILE_H
@@ -0,0 +1,380 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+
+namespace {
+    constexpr uint32_t CACHE_SIZE = 32;
+    constexpr uint32_t NO_VERTEX = ~0u;
+    constexpr size_t NO_TRIANGLE = ~size_t(0);
+
+    // Forsyth's weights: the last triangle's vertices are about to be reused anyway, the rest
+    // of the cache decays, and vertices with few triangles left are finished off first.
+    float vertexScore(int32_t cachePosition, uint32_t remaining) {
+        if (remaining == 0) {
+            return -1.0f;
+        }
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+            score = cachePosition < 3 ? 0.75f
+                                      : std::pow(1.0f - float(cachePosition - 3) / float(CACHE_SIZE - 3), 1.5f);
+        }
+        return score + 2.0f / std::sqrt(float(remaining));
+    }
+
+    void cross(const float a[3], const float b[3], float result[3]) {
+        result[0] = a[1] * b[2] - a[2] * b[1];
+        result[1] = a[2] * b[0] - a[0] * b[2];
+        result[2] = a[0] * b[1] - a[1] * b[0];
+    }
+
+    struct Cluster
+    {
+        size_t firstTriangle;
+        size_t triangleCount;
+        float sortKey;
+    };
+
+    uint16_t toHalf(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        uint32_t sign = (bits >> 16) & 0x8000;
+        uint32_t magnitude = bits & 0x7fffffff;
+
+        // rebias the exponent and round the mantissa to nearest, then handle the edges:
+        // denormals flush to zero, overflow goes to infinity and NaN stays NaN
+        uint32_t half = (magnitude - (112u << 23) + (1u << 12)) >> 13;
+        half = magnitude < (113u << 23) ? 0 : half;
+        half = magnitude >= (143u << 23) ? 0x7c00 : half;
+        half = magnitude > (255u << 23) ? 0x7e00 : half;
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    int16_t toSnorm16(float value) {
+        return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+    }
+
+    uint8_t toUnorm8(float value) {
+        return static_cast<uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+    }
+
+    // The unit sphere projected onto an octahedron and the lower half folded over the upper,
+    // decoded in VBO.vert.
+    void encodeOctahedral(const float normal[3], int16_t encoded[2]) {
+        float length = std::abs(normal[0]) + std::abs(normal[1]) + std::abs(normal[2]);
+        if (length == 0.0f) {
+            encoded[0] = 0;
+            encoded[1] = 0;
+            return;
+        }
+        float x = normal[0] / length;
+        float y = normal[1] / length;
+        if (normal[2] < 0.0f) {
+            float foldedX = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            float foldedY = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+            x = foldedX;
+            y = foldedY;
+        }
+        encoded[0] = toSnorm16(x);
+        encoded[1] = toSnorm16(y);
+    }
+}
+
+
+VulkanEngine::MeshOptimizer::VertexCacheStats
+VulkanEngine::MeshOptimizer::analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize) {
+    std::vector<uint64_t> timestamps(vertexCount, 0);
+    uint64_t time = cacheSize + 1;
+    size_t misses = 0;
+    for (size_t i = 0; i < indexCount; i++) {
+        if (time - timestamps[indices[i]] > cacheSize) {
+            timestamps[indices[i]] = time++;
+            misses++;
+        }
+    }
+
+    size_t used = vertexCount - static_cast<size_t>(std::count(timestamps.begin(), timestamps.end(), 0));
+    VertexCacheStats stats{};
+    stats.acmr = indexCount >= 3 ? float(misses) / float(indexCount / 3) : 0.0f;
+    stats.atvr = used > 0 ? float(misses) / float(used) : 0.0f;
+    return stats;
+}
+
+
+void
+VulkanEngine::MeshOptimizer::optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount) {
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // triangles around each vertex, the first remaining[v] of them not emitted yet
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++) {
+        remaining[indices[i]]++;
+    }
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    std::partial_sum(remaining.begin(), remaining.end(), offsets.begin() + 1);
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < triangleCount * 3; i++) {
+        adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<int32_t> cachePosition(vertexCount, -1);
+    std::vector<float> scores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        scores[v] = vertexScore(-1, remaining[v]);
+    }
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    size_t best = 0;
+    for (size_t t = 0; t < triangleCount; t++) {
+        triangleScores[t] = scores[indices[t * 3]] + scores[indices[t * 3 + 1]] + scores[indices[t * 3 + 2]];
+        best = triangleScores[t] > triangleScores[best] ? t : best;
+    }
+
+    std::vector<uint32_t> output;
+    output.reserve(triangleCount * 3);
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> nextCache;
+    size_t cursor = 0;
+    while (output.size() < triangleCount * 3) {
+        if (best == NO_TRIANGLE) {
+            // nothing in the cache has triangles left, carry on in the original order
+            while (emitted[cursor]) {
+                cursor++;
+            }
+            best = cursor;
+        }
+
+        const uint32_t* triangle = indices + best * 3;
+        emitted[best] = true;
+        output.insert(output.end(), triangle, triangle + 3);
+
+        nextCache.clear();
+        for (int k = 0; k < 3; k++) {
+            if (std::find(nextCache.begin(), nextCache.end(), triangle[k]) == nextCache.end()) {
+                nextCache.push_back(triangle[k]);
+            }
+        }
+        for (uint32_t vertex : cache) {
+            if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2]) {
+                nextCache.push_back(vertex);
+            }
+        }
+
+        for (int k = 0; k < 3; k++) {
+            uint32_t* around = adjacency.data() + offsets[triangle[k]];
+            uint32_t& count = remaining[triangle[k]];
+            uint32_t* found = std::find(around, around + count, static_cast<uint32_t>(best));
+            std::swap(*found, around[count - 1]);
+            count--;
+        }
+
+        // vertices pushed out of the cache lose their bonus too, rescore everything that moved
+        for (size_t i = 0; i < nextCache.size(); i++) {
+            uint32_t vertex = nextCache[i];
+            cachePosition[vertex] = i < CACHE_SIZE ? static_cast<int32_t>(i) : -1;
+            scores[vertex] = vertexScore(cachePosition[vertex], remaining[vertex]);
+        }
+        best = NO_TRIANGLE;
+        float bestScore = -1.0f;
+        for (uint32_t vertex : nextCache) {
+            for (uint32_t i = 0; i < remaining[vertex]; i++) {
+                uint32_t t = adjacency[offsets[vertex] + i];
+                triangleScores[t] = scores[indices[t * 3]] + scores[indices[t * 3 + 1]] + scores[indices[t * 3 + 2]];
+                if (triangleScores[t] > bestScore) {
+                    bestScore = triangleScores[t];
+                    best = t;
+                }
+            }
+        }
+
+        nextCache.resize(std::min<size_t>(nextCache.size(), CACHE_SIZE));
+        std::swap(cache, nextCache);
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+
+void
+VulkanEngine::MeshOptimizer::optimizeOverdraw(uint32_t* indices, size_t indexCount, const MeshVertex* vertices, size_t vertexCount, float threshold) {
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2) {
+        return;
+    }
+
+    // the cache the clusters are measured against, as analyzeVertexCache
+    const uint32_t cacheSize = 16;
+    std::vector<uint64_t> timestamps(vertexCount, 0);
+    uint64_t time = cacheSize + 1;
+    auto missesOf = [&](size_t t) {
+        uint32_t misses = 0;
+        for (int k = 0; k < 3; k++) {
+            uint32_t vertex = indices[t * 3 + k];
+            if (time - timestamps[vertex] > cacheSize) {
+                timestamps[vertex] = time++;
+                misses++;
+            }
+        }
+        return misses;
+    };
+
+    std::vector<bool> flushes(triangleCount);
+    size_t totalMisses = 0;
+    for (size_t t = 0; t < triangleCount; t++) {
+        uint32_t misses = missesOf(t);
+        flushes[t] = misses == 3;
+        totalMisses += misses;
+    }
+    const float limit = threshold * float(totalMisses) / float(triangleCount);
+
+    // a cluster ends before a flush of the original order, or once its own ACMR from a cold
+    // cache is within the limit, so drawing the clusters in any order stays within it too
+    std::vector<Cluster> clusters;
+    size_t clusterMisses = 0;
+    for (size_t t = 0; t < triangleCount; t++) {
+        if (t == 0 || (flushes[t] && clusters.back().triangleCount > 0)) {
+            clusters.push_back({t, 0, 0.0f});
+            clusterMisses = 0;
+            time += cacheSize + 1;
+        }
+        clusterMisses += missesOf(t);
+        clusters.back().triangleCount++;
+        if (float(clusterMisses) <= limit * float(clusters.back().triangleCount) && t + 1 < triangleCount) {
+            clusters.push_back({t + 1, 0, 0.0f});
+            clusterMisses = 0;
+            time += cacheSize + 1;
+        }
+    }
+    if (clusters.back().triangleCount == 0) {
+        clusters.pop_back();
+    }
+
+    // clusters facing away from the middle of the mesh are on its outside and draw first
+    std::vector<float> centroids(clusters.size() * 3, 0.0f);
+    std::vector<float> normals(clusters.size() * 3, 0.0f);
+    std::vector<float> areas(clusters.size(), 0.0f);
+    float meshCentroid[3] = {0.0f, 0.0f, 0.0f};
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusters.size(); c++) {
+        for (size_t t = clusters[c].firstTriangle; t < clusters[c].firstTriangle + clusters[c].triangleCount; t++) {
+            const float* p0 = vertices[indices[t * 3]].position;
+            const float* p1 = vertices[indices[t * 3 + 1]].position;
+            const float* p2 = vertices[indices[t * 3 + 2]].position;
+            float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+            float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+            float normal[3];
+            cross(e1, e2, normal);
+            float area = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            for (int k = 0; k < 3; k++) {
+                float centre = (p0[k] + p1[k] + p2[k]) / 3.0f;
+                centroids[c * 3 + k] += centre * area;
+                normals[c * 3 + k] += normal[k];
+                meshCentroid[k] += centre * area;
+            }
+            areas[c] += area;
+            meshArea += area;
+        }
+    }
+    for (int k = 0; k < 3; k++) {
+        meshCentroid[k] = meshArea > 0.0f ? meshCentroid[k] / meshArea : 0.0f;
+    }
+    for (size_t c = 0; c < clusters.size(); c++) {
+        float* normal = &normals[c * 3];
+        float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        float key = 0.0f;
+        for (int k = 0; k < 3 && length > 0.0f && areas[c] > 0.0f; k++) {
+            key += (centroids[c * 3 + k] / areas[c] - meshCentroid[k]) * normal[k] / length;
+        }
+        clusters[c].sortKey = key;
+    }
+    std::stable_sort(clusters.begin(), clusters.end(),
+                     [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    std::vector<uint32_t> output;
+    output.reserve(triangleCount * 3);
+    for (const auto& cluster : clusters) {
+        output.insert(output.end(), indices + cluster.firstTriangle * 3,
+                      indices + (cluster.firstTriangle + cluster.triangleCount) * 3);
+    }
+    std::copy(output.begin(), output.end(), indices);
+}
+
+
+size_t
+VulkanEngine::MeshOptimizer::optimizeVertexFetch(uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t* remap) {
+    std::fill(remap, remap + vertexCount, NO_VERTEX);
+    uint32_t next = 0;
+    for (size_t i = 0; i < indexCount; i++) {
+        if (remap[indices[i]] == NO_VERTEX) {
+            remap[indices[i]] = next++;
+        }
+        indices[i] = remap[indices[i]];
+    }
+    return next;
+}
+
+
+void
+VulkanEngine::MeshOptimizer::optimize(MeshData& mesh) {
+    std::vector<uint32_t>& indices = mesh.indices.own();
+    std::vector<MeshVertex>& vertices = mesh.vertices.own();
+
+    std::vector<std::pair<uint32_t, uint32_t>> ranges;
+    for (const auto& submesh : mesh.submeshes) {
+        ranges.emplace_back(submesh.firstIndex, submesh.indexCount);
+    }
+    if (ranges.empty()) {
+        for (const auto& lod : mesh.lods) {
+            ranges.emplace_back(lod.firstIndex, lod.indexCount);
+        }
+    }
+    for (const auto& range : ranges) {
+        optimizeVertexCache(indices.data() + range.first, range.second, vertices.size());
+        optimizeOverdraw(indices.data() + range.first, range.second, vertices.data(), vertices.size());
+    }
+
+    std::vector<uint32_t> remap(vertices.size());
+    size_t vertexCount = optimizeVertexFetch(indices.data(), indices.size(), vertices.size(), remap.data());
+    std::vector<MeshVertex> reordered(vertexCount);
+    for (size_t v = 0; v < vertices.size(); v++) {
+        if (remap[v] != NO_VERTEX) {
+            reordered[remap[v]] = vertices[v];
+        }
+    }
+    vertices = std::move(reordered);
+
+    mesh.meshlets.clear();
+    mesh.meshletVertices = MeshStream<uint32_t>();
+    mesh.meshletTriangles = MeshStream<uint8_t>();
+    for (auto& lod : mesh.lods) {
+        lod.firstMeshlet = 0;
+        lod.meshletCount = 0;
+    }
+    mesh.optimized = true;
+}
+
+
+void
+VulkanEngine::MeshOptimizer::quantizeVertices(const MeshVertex* vertices, size_t count, QuantizedMeshVertex* destination) {
+    for (size_t i = 0; i < count; i++) {
+        const MeshVertex& vertex = vertices[i];
+        QuantizedMeshVertex& quantized = destination[i];
+        for (int c = 0; c < 3; c++) {
+            quantized.position[c] = toHalf(vertex.position[c]);
+            quantized.color[c] = toUnorm8(vertex.color[c]);
+        }
+        quantized.position[3] = toHalf(1.0f);
+        quantized.color[3] = 255;
+        encodeOctahedral(vertex.normal, quantized.normal);
+        quantized.texCoord[0] = toHalf(vertex.texCoord[0]);
+        quantized.texCoord[1] = toHalf(vertex.texCoord[1]);
+    }
+}
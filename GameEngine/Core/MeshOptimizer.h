@@ -0,0 +1,45 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include "MeshData.h"
+
+
+namespace VulkanEngine {
+
+// Reorders meshes for the GPU: vertex cache (Forsyth), then overdraw (Tipsify clusters), then
+// vertex fetch order. Plus quantization into QuantizedMeshVertex for --quantize-vertices.
+namespace MeshOptimizer {
+
+    struct VertexCacheStats
+    {
+        // transformed vertices per triangle, 0.5 at best for large regular meshes, 3 at worst
+        float acmr;
+        // transformed vertices per vertex, 1 is perfect
+        float atvr;
+    };
+
+    // Simulates a FIFO post-transform cache of cacheSize vertices.
+    VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = 16);
+
+    void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+    // Expects indices already optimized for the vertex cache.
+    void optimizeOverdraw(uint32_t* indices, size_t indexCount, const MeshVertex* vertices, size_t vertexCount, float threshold = 1.05f);
+
+    // Fills remap with the new index of every vertex, ~0u for unreferenced ones, and rewrites
+    // the indices. Returns the new vertex count.
+    size_t optimizeVertexFetch(uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t* remap);
+
+    // All three passes over every submesh. Drops the meshlets, build them afterwards.
+    void optimize(MeshData& mesh);
+
+    void quantizeVertices(const MeshVertex* vertices, size_t count, QuantizedMeshVertex* destination);
+
+} // MeshOptimizer
+
+} // VulkanEngine
+
+#endif //MESHOPTIMIZER_H
@@ -0,0 +1,154 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <vector>
+
+
+namespace {
+    constexpr uint32_t NO_SLOT = ~0u;
+
+    void computeMeshletBounds(VulkanEngine::Meshlet& meshlet, const VulkanEngine::MeshData& mesh,
+                              const std::vector<uint32_t>& meshletVertices, const std::vector<uint8_t>& meshletTriangles) {
+        auto position = [&](uint32_t local) {
+            return mesh.vertices[meshletVertices[meshlet.vertexOffset + local]].position;
+        };
+
+        // around the box centre, as the mesh bounds
+        float min[3];
+        float max[3];
+        for (int c = 0; c < 3; c++) {
+            min[c] = position(0)[c];
+            max[c] = position(0)[c];
+        }
+        for (uint32_t v = 1; v < meshlet.vertexCount; v++) {
+            for (int c = 0; c < 3; c++) {
+                min[c] = std::min(min[c], position(v)[c]);
+                max[c] = std::max(max[c], position(v)[c]);
+            }
+        }
+        float radiusSquared = 0.0f;
+        for (int c = 0; c < 3; c++) {
+            meshlet.center[c] = (min[c] + max[c]) * 0.5f;
+        }
+        for (uint32_t v = 0; v < meshlet.vertexCount; v++) {
+            float distance = 0.0f;
+            for (int c = 0; c < 3; c++) {
+                float d = position(v)[c] - meshlet.center[c];
+                distance += d * d;
+            }
+            radiusSquared = std::max(radiusSquared, distance);
+        }
+        meshlet.radius = std::sqrt(radiusSquared);
+
+        // the cone axis is the average face normal, its cutoff the sine of how far the
+        // normals spread: a view direction within 90 degrees minus the spread of the axis
+        // sees every triangle from behind
+        std::vector<float> normals;
+        float axis[3] = {0.0f, 0.0f, 0.0f};
+        for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+            const uint8_t* triangle = &meshletTriangles[meshlet.triangleOffset + t * 3];
+            const float* p0 = position(triangle[0]);
+            const float* p1 = position(triangle[1]);
+            const float* p2 = position(triangle[2]);
+            float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+            float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+            float normal[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+            float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            if (length == 0.0f) {
+                continue;
+            }
+            for (int c = 0; c < 3; c++) {
+                normals.push_back(normal[c] / length);
+                axis[c] += normal[c] / length;
+            }
+        }
+
+        float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        float minimumDot = 1.0f;
+        if (axisLength > 0.0f) {
+            for (int c = 0; c < 3; c++) {
+                axis[c] /= axisLength;
+            }
+            for (size_t n = 0; n < normals.size(); n += 3) {
+                minimumDot = std::min(minimumDot, normals[n] * axis[0] + normals[n + 1] * axis[1] + normals[n + 2] * axis[2]);
+            }
+        } else {
+            axis[2] = 1.0f;
+            minimumDot = -1.0f;
+        }
+        for (int c = 0; c < 3; c++) {
+            meshlet.coneAxis[c] = axis[c];
+        }
+        meshlet.coneCutoff = minimumDot <= 0.1f ? 1.0f : std::sqrt(1.0f - minimumDot * minimumDot);
+    }
+}
+
+
+void
+VulkanEngine::MeshletBuilder::build(MeshData& mesh) {
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> meshletVertices;
+    std::vector<uint8_t> meshletTriangles;
+    std::vector<uint32_t> slots(mesh.vertices.size(), NO_SLOT);
+
+    std::set<uint32_t> submeshStarts;
+    for (const auto& submesh : mesh.submeshes) {
+        submeshStarts.insert(submesh.firstIndex);
+    }
+
+    for (auto& lod : mesh.lods) {
+        lod.firstMeshlet = static_cast<uint32_t>(meshlets.size());
+
+        Meshlet current{};
+        auto finish = [&]() {
+            if (current.triangleCount == 0) {
+                return;
+            }
+            computeMeshletBounds(current, mesh, meshletVertices, meshletTriangles);
+            meshlets.push_back(current);
+            for (uint32_t v = 0; v < current.vertexCount; v++) {
+                slots[meshletVertices[current.vertexOffset + v]] = NO_SLOT;
+            }
+            meshletTriangles.resize((meshletTriangles.size() + 3) & ~size_t(3), 0);
+
+            current = Meshlet{};
+            current.vertexOffset = static_cast<uint32_t>(meshletVertices.size());
+            current.triangleOffset = static_cast<uint32_t>(meshletTriangles.size());
+        };
+        current.vertexOffset = static_cast<uint32_t>(meshletVertices.size());
+        current.triangleOffset = static_cast<uint32_t>(meshletTriangles.size());
+
+        for (uint32_t i = lod.firstIndex; i + 2 < lod.firstIndex + lod.indexCount; i += 3) {
+            const uint32_t* triangle = mesh.indices.data() + i;
+            uint32_t newVertices = 0;
+            for (int k = 0; k < 3; k++) {
+                bool repeated = (k > 0 && triangle[k] == triangle[0]) || (k > 1 && triangle[k] == triangle[1]);
+                newVertices += slots[triangle[k]] == NO_SLOT && !repeated ? 1 : 0;
+            }
+            if (submeshStarts.count(i) != 0 || current.vertexCount + newVertices > MAX_VERTICES ||
+                current.triangleCount == MAX_TRIANGLES) {
+                finish();
+            }
+
+            for (int k = 0; k < 3; k++) {
+                if (slots[triangle[k]] == NO_SLOT) {
+                    slots[triangle[k]] = current.vertexCount++;
+                    meshletVertices.push_back(triangle[k]);
+                }
+                meshletTriangles.push_back(static_cast<uint8_t>(slots[triangle[k]]));
+            }
+            current.triangleCount++;
+        }
+        finish();
+
+        lod.meshletCount = static_cast<uint32_t>(meshlets.size()) - lod.firstMeshlet;
+    }
+
+    mesh.meshlets = std::move(meshlets);
+    mesh.meshletVertices = MeshStream<uint32_t>();
+    mesh.meshletVertices.owned = std::move(meshletVertices);
+    mesh.meshletTriangles = MeshStream<uint8_t>();
+    mesh.meshletTriangles.owned = std::move(meshletTriangles);
+}
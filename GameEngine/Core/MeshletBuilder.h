@@ -0,0 +1,26 @@
+#ifndef MESHLETBUILDER_H
+#define MESHLETBUILDER_H
+
+
+#include <cstdint>
+#include "MeshData.h"
+
+
+namespace VulkanEngine {
+
+// Splits every level of a mesh into meshlets in index order, so the meshlets of a level cover its
+// index range in order and the compute path can draw them as index ranges.
+namespace MeshletBuilder {
+
+    // The mesh shader writes at most this many vertices and triangles per workgroup.
+    constexpr uint32_t MAX_VERTICES = 64;
+    constexpr uint32_t MAX_TRIANGLES = 124;
+
+    // Replaces any meshlets the mesh had and sets firstMeshlet and meshletCount of its levels.
+    void build(MeshData& mesh);
+
+} // MeshletBuilder
+
+} // VulkanEngine
+
+#endif //MESHLETBUILDER_H
@@ -0,0 +1,214 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+
+namespace {
+    struct EventRing
+    {
+        std::unique_ptr<VulkanEngine::ProfileEvent[]> events{new VulkanEngine::ProfileEvent[VulkanEngine::Profiler::EVENTS_PER_THREAD]};
+        // total events ever written, the ring holds the last EVENTS_PER_THREAD of them
+        std::atomic<uint64_t> written{0};
+        std::string name;
+        uint32_t threadId = 0;
+    };
+
+    struct FrameHistory
+    {
+        double milliseconds[VulkanEngine::Profiler::FRAME_HISTORY] = {};
+        uint64_t count = 0;
+
+        void push(double value) {
+            milliseconds[count % VulkanEngine::Profiler::FRAME_HISTORY] = value;
+            count++;
+        }
+    };
+
+    // rings are never freed, threads that have exited still show up in the trace
+    std::mutex gRingMutex;
+    std::vector<std::unique_ptr<EventRing>> gRings;
+    EventRing gGpuRing;
+
+    const std::chrono::steady_clock::time_point gEpoch = std::chrono::steady_clock::now();
+
+    thread_local EventRing* tRing = nullptr;
+
+    int64_t gFrameStart = 0;
+    uint64_t gFrameNumber = 0;
+    FrameHistory gCpuFrames;
+    FrameHistory gGpuFrames;
+
+    EventRing& threadRing() {
+        if (tRing == nullptr) {
+            std::lock_guard<std::mutex> lock(gRingMutex);
+            auto ring = std::make_unique<EventRing>();
+            ring->threadId = static_cast<uint32_t>(gRings.size()) + 1;
+            ring->name = "Thread " + std::to_string(ring->threadId);
+            tRing = ring.get();
+            gRings.push_back(std::move(ring));
+        }
+        return *tRing;
+    }
+
+    void push(EventRing& ring, const char* name, int64_t start, int64_t end) {
+        // only the owning thread writes, so a relaxed load of our own counter is enough
+        uint64_t index = ring.written.load(std::memory_order_relaxed);
+        ring.events[index % VulkanEngine::Profiler::EVENTS_PER_THREAD] = {name, start, end};
+        ring.written.store(index + 1, std::memory_order_release);
+    }
+
+    VulkanEngine::FrameStats computeStats(const FrameHistory& history) {
+        uint32_t count = static_cast<uint32_t>(std::min<uint64_t>(history.count, VulkanEngine::Profiler::FRAME_HISTORY));
+        return VulkanEngine::Profiler::summarize(history.milliseconds, count);
+    }
+
+    void writeJsonString(std::ofstream& file, const std::string& text) {
+        file << '"';
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                file << '\\' << c;
+            } else if (static_cast<unsigned char>(c) >= 0x20) {
+                file << c;
+            }
+        }
+        file << '"';
+    }
+
+    void writeRing(std::ofstream& file, const EventRing& ring, bool& first) {
+        file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring.threadId
+             << ",\"args\":{\"name\":";
+        writeJsonString(file, ring.name);
+        file << "}}";
+        first = false;
+
+        uint64_t written = ring.written.load(std::memory_order_acquire);
+        uint64_t begin = written > VulkanEngine::Profiler::EVENTS_PER_THREAD ? written - VulkanEngine::Profiler::EVENTS_PER_THREAD : 0;
+        for (uint64_t i = begin; i < written; i++) {
+            const VulkanEngine::ProfileEvent& event = ring.events[i % VulkanEngine::Profiler::EVENTS_PER_THREAD];
+            // chrome wants microseconds
+            file << ",\n{\"name\":";
+            writeJsonString(file, event.name);
+            file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring.threadId
+                 << ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+        }
+    }
+}
+
+
+int64_t
+VulkanEngine::Profiler::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - gEpoch).count();
+}
+
+
+void
+VulkanEngine::Profiler::setThreadName(const char* name) {
+    EventRing& ring = threadRing();
+    std::lock_guard<std::mutex> lock(gRingMutex);
+    ring.name = name;
+}
+
+
+void
+VulkanEngine::Profiler::recordEvent(const char* name, int64_t start, int64_t end) {
+    push(threadRing(), name, start, end);
+}
+
+
+void
+VulkanEngine::Profiler::beginFrame() {
+    gFrameStart = now();
+}
+
+
+void
+VulkanEngine::Profiler::endFrame() {
+    int64_t frameEnd = now();
+    recordEvent("Frame", gFrameStart, frameEnd);
+    gCpuFrames.push((frameEnd - gFrameStart) / 1e6);
+    gFrameNumber++;
+}
+
+
+uint64_t
+VulkanEngine::Profiler::getFrameNumber() {
+    return gFrameNumber;
+}
+
+
+void
+VulkanEngine::Profiler::recordGpuEvent(const char* name, int64_t start, int64_t end) {
+    push(gGpuRing, name, start, end);
+}
+
+
+void
+VulkanEngine::Profiler::recordGpuFrameTime(double milliseconds) {
+    gGpuFrames.push(milliseconds);
+}
+
+
+VulkanEngine::FrameStats
+VulkanEngine::Profiler::getFrameStats() {
+    return computeStats(gCpuFrames);
+}
+
+
+VulkanEngine::FrameStats
+VulkanEngine::Profiler::getGpuFrameStats() {
+    return computeStats(gGpuFrames);
+}
+
+
+VulkanEngine::FrameStats
+VulkanEngine::Profiler::summarize(const double* milliseconds, uint32_t count) {
+    FrameStats stats;
+    if (count == 0) {
+        return stats;
+    }
+
+    std::vector<double> sorted(milliseconds, milliseconds + count);
+    std::sort(sorted.begin(), sorted.end());
+
+    double sum = 0.0;
+    for (double value : sorted) {
+        sum += value;
+    }
+    stats.frameCount = count;
+    stats.averageMs = sum / count;
+    stats.p50Ms = sorted[(count - 1) / 2];
+    stats.p99Ms = sorted[(count - 1) * 99 / 100];
+    stats.maxMs = sorted.back();
+    return stats;
+}
+
+
+void
+VulkanEngine::Profiler::writeChromeTrace(const std::string& path) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("ERROR: could not open trace file " + path);
+    }
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    {
+        std::lock_guard<std::mutex> lock(gRingMutex);
+        for (const auto& ring : gRings) {
+            writeRing(file, *ring, first);
+        }
+    }
+    if (gGpuRing.written.load(std::memory_order_acquire) > 0) {
+        gGpuRing.threadId = 0;
+        gGpuRing.name = "GPU";
+        writeRing(file, gGpuRing, first);
+    }
+    file << "\n]}\n";
+}
@@ -0,0 +1,82 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+
+#include <cstdint>
+#include <string>
+
+
+namespace VulkanEngine {
+
+    // Times are nanoseconds since the profiler started.
+    struct ProfileEvent
+    {
+        const char* name;
+        int64_t start;
+        int64_t end;
+    };
+
+    struct FrameStats
+    {
+        uint32_t frameCount = 0;
+        double averageMs = 0.0;
+        double p50Ms = 0.0;
+        double p99Ms = 0.0;
+        double maxMs = 0.0;
+    };
+
+// Engine wide CPU profiler with a lock free event ring per thread. Event names must outlive it,
+// frame bookkeeping and the stats belong to the main thread.
+namespace Profiler {
+
+    constexpr uint32_t EVENTS_PER_THREAD = 1u << 16;
+    constexpr uint32_t FRAME_HISTORY = 1024;
+
+    int64_t now();
+
+    // Shows up as the thread's name in the trace.
+    void setThreadName(const char* name);
+
+    void recordEvent(const char* name, int64_t start, int64_t end);
+
+    void beginFrame();
+    void endFrame();
+    uint64_t getFrameNumber();
+
+    // GPU scopes and frame times read back by GpuProfiler, already converted to profiler time.
+    void recordGpuEvent(const char* name, int64_t start, int64_t end);
+    void recordGpuFrameTime(double milliseconds);
+
+    // Over the last FRAME_HISTORY frames.
+    FrameStats getFrameStats();
+    FrameStats getGpuFrameStats();
+
+    // Average, percentiles and maximum of any set of millisecond samples.
+    FrameStats summarize(const double* milliseconds, uint32_t count);
+
+    // Must not overlap scopes still being recorded, call it once the frame loop has stopped.
+    void writeChromeTrace(const std::string& path);
+
+} // Profiler
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name) : mName(name), mStart(Profiler::now()) {}
+    ~ProfileScope() { Profiler::recordEvent(mName, mStart, Profiler::now()); }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* mName;
+    int64_t mStart;
+};
+
+} // VulkanEngine
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+// Times the rest of the enclosing block.
+#define PROFILE_SCOPE(name) VulkanEngine::ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+
+#endif //PROFILER_H
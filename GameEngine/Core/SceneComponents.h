@@ -0,0 +1,41 @@
+#ifndef SCENECOMPONENTS_H
+#define SCENECOMPONENTS_H
+
+
+#include <cstdint>
+#include "../Vertex.h"
+
+
+namespace VulkanEngine {
+
+    // Node in the scene's TransformHierarchy that places the entity.
+    struct TransformNode
+    {
+        uint32_t node;
+    };
+
+    // Constant rotation about +Z, written to the transform node by the scene update every frame.
+    struct Spin
+    {
+        float phase;
+        float speed;
+    };
+
+    // Range of the shared index buffer and the streamed texture, UINT32_MAX for vertex colours.
+    struct MeshRef
+    {
+        uint32_t indexCount;
+        uint32_t firstIndex;
+        int32_t vertexOffset;
+        uint32_t texture;
+    };
+
+    // Object space bounding sphere, xyz is the centre and w the radius.
+    struct Bounds
+    {
+        glm::vec4 sphere;
+    };
+
+} // VulkanEngine
+
+#endif //SCENECOMPONENTS_H
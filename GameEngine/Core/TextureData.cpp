@@ -0,0 +1,172 @@
+#include "TextureData.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+
+namespace {
+    constexpr uint32_t LINEAR_TO_SRGB_STEPS = 4096;
+
+    struct SrgbTables
+    {
+        std::array<float, 256> toLinear;
+        std::array<uint8_t, LINEAR_TO_SRGB_STEPS> toSrgb;
+
+        SrgbTables() {
+            for (uint32_t i = 0; i < 256; i++) {
+                float c = i / 255.0f;
+                toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+            for (uint32_t i = 0; i < LINEAR_TO_SRGB_STEPS; i++) {
+                float l = i / float(LINEAR_TO_SRGB_STEPS - 1);
+                float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+                toSrgb[i] = static_cast<uint8_t>(std::lround(std::clamp(c, 0.0f, 1.0f) * 255.0f));
+            }
+        }
+    };
+
+    const SrgbTables& srgbTables() {
+        static const SrgbTables tables;
+        return tables;
+    }
+
+    // 2x2 box filter, odd edges reuse their last row or column
+    void downsample(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight, bool srgb) {
+        const SrgbTables& tables = srgbTables();
+        for (uint32_t y = 0; y < dstHeight; y++) {
+            uint32_t y0 = std::min(y * 2, srcHeight - 1);
+            uint32_t y1 = std::min(y * 2 + 1, srcHeight - 1);
+            for (uint32_t x = 0; x < dstWidth; x++) {
+                uint32_t x0 = std::min(x * 2, srcWidth - 1);
+                uint32_t x1 = std::min(x * 2 + 1, srcWidth - 1);
+                const uint8_t* p[4] = {
+                    src + (size_t(y0) * srcWidth + x0) * 4, src + (size_t(y0) * srcWidth + x1) * 4,
+                    src + (size_t(y1) * srcWidth + x0) * 4, src + (size_t(y1) * srcWidth + x1) * 4
+                };
+                uint8_t* out = dst + (size_t(y) * dstWidth + x) * 4;
+                for (uint32_t c = 0; c < 4; c++) {
+                    // alpha is always linear
+                    if (srgb && c < 3) {
+                        float sum = tables.toLinear[p[0][c]] + tables.toLinear[p[1][c]] + tables.toLinear[p[2][c]] + tables.toLinear[p[3][c]];
+                        out[c] = tables.toSrgb[static_cast<uint32_t>(sum * 0.25f * (LINEAR_TO_SRGB_STEPS - 1) + 0.5f)];
+                    } else {
+                        out[c] = static_cast<uint8_t>((p[0][c] + p[1][c] + p[2][c] + p[3][c] + 2) / 4);
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+uint32_t
+VulkanEngine::getBlockBytes(TextureFormat format) {
+    switch (format) {
+    case TextureFormat::Bc1:
+        return 8;
+    case TextureFormat::Bc3:
+    case TextureFormat::Bc5:
+    case TextureFormat::Bc7:
+        return 16;
+    default:
+        return 4;
+    }
+}
+
+
+uint32_t
+VulkanEngine::getBlockDim(TextureFormat format) {
+    return format == TextureFormat::Rgba8 ? 1 : 4;
+}
+
+
+const char*
+VulkanEngine::getFormatName(TextureFormat format) {
+    switch (format) {
+    case TextureFormat::Rgba8:
+        return "rgba8";
+    case TextureFormat::Bc1:
+        return "bc1";
+    case TextureFormat::Bc3:
+        return "bc3";
+    case TextureFormat::Bc5:
+        return "bc5";
+    case TextureFormat::Bc7:
+        return "bc7";
+    }
+    return "unknown";
+}
+
+
+size_t
+VulkanEngine::TextureData::getSize(uint32_t firstMip) const {
+    if (firstMip >= mips.size()) {
+        return 0;
+    }
+    return mips.back().offset + mips.back().size - mips[firstMip].offset;
+}
+
+
+VulkanEngine::TextureData
+VulkanEngine::TextureData::loadFromFile(const std::string& path, bool srgb) {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    stbi_uc* rgba = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+    if (rgba == nullptr) {
+        throw std::runtime_error("ERROR: failed to load image " + path + ": " + stbi_failure_reason());
+    }
+
+    TextureData texture = fromPixels(rgba, static_cast<uint32_t>(width), static_cast<uint32_t>(height), srgb);
+    stbi_image_free(rgba);
+    return texture;
+}
+
+
+VulkanEngine::TextureData
+VulkanEngine::TextureData::fromPixels(const uint8_t* rgba, uint32_t width, uint32_t height, bool srgb) {
+    TextureData texture;
+    texture.width = width;
+    texture.height = height;
+    texture.srgb = srgb;
+    size_t size = size_t(width) * height * 4;
+    texture.mips.push_back({width, height, 0, size});
+    texture.pixels.assign(rgba, rgba + size);
+    return texture;
+}
+
+
+void
+VulkanEngine::TextureData::generateMips() {
+    if (mips.empty()) {
+        return;
+    }
+    if (format != TextureFormat::Rgba8 || mapping) {
+        throw std::runtime_error("ERROR: mips can only be generated for decoded RGBA8 images");
+    }
+    mips.resize(1);
+
+    // size the whole chain first so the levels are written in place
+    size_t total = mips[0].size;
+    uint32_t levelWidth = width;
+    uint32_t levelHeight = height;
+    while (levelWidth > 1 || levelHeight > 1) {
+        levelWidth = std::max(1u, levelWidth / 2);
+        levelHeight = std::max(1u, levelHeight / 2);
+        mips.push_back({levelWidth, levelHeight, total, size_t(levelWidth) * levelHeight * 4});
+        total += mips.back().size;
+    }
+    pixels.resize(total);
+
+    for (size_t i = 1; i < mips.size(); i++) {
+        const TextureMip& src = mips[i - 1];
+        const TextureMip& dst = mips[i];
+        downsample(pixels.data() + src.offset, src.width, src.height, pixels.data() + dst.offset, dst.width, dst.height, srgb);
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef TEXTUREDATA_H
+#define TEXTUREDATA_H
+
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+
+
+namespace VulkanEngine {
+
+    // Values are stored in cooked texture files, only ever append.
+    enum class TextureFormat : uint32_t
+    {
+        Rgba8 = 0,
+        // RGB with 1 bit alpha, 8 bytes per 4x4 block
+        Bc1 = 1,
+        // RGBA, BC1 colour plus a BC4 alpha block
+        Bc3 = 2,
+        // two channels, normal maps
+        Bc5 = 3,
+        // RGBA at 8 bits per texel, the best quality of the four
+        Bc7 = 4
+    };
+
+    // Bytes per texel block and its width and height in texels, RGBA8 is one texel per block.
+    uint32_t getBlockBytes(TextureFormat format);
+    uint32_t getBlockDim(TextureFormat format);
+    const char* getFormatName(TextureFormat format);
+
+    // One level of a TextureData, offset and size are in bytes into its pixels.
+    struct TextureMip
+    {
+        uint32_t width;
+        uint32_t height;
+        size_t offset;
+        size_t size;
+    };
+
+// Image with its full mip chain packed back to back, finest level first. The bytes are either
+// decoded RGBA8 or a mapped cooked file, getPixels() hides which.
+struct TextureData {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    TextureFormat format = TextureFormat::Rgba8;
+    // colour data is filtered in linear space, anything else (normals, masks) as stored
+    bool srgb = true;
+    std::vector<TextureMip> mips;
+    std::vector<uint8_t> pixels;
+    // set instead of pixels when the levels live in a mapped file, mip offsets are then from its start
+    std::shared_ptr<const MappedFile> mapping;
+
+    const uint8_t* getPixels() const { return mapping ? mapping->getData() : pixels.data(); }
+    uint32_t getMipCount() const { return static_cast<uint32_t>(mips.size()); }
+    // Bytes of levels [firstMip, last].
+    size_t getSize(uint32_t firstMip = 0) const;
+
+    // Every format stb_image knows, converted to RGBA.
+    static TextureData loadFromFile(const std::string& path, bool srgb = true);
+    static TextureData fromPixels(const uint8_t* rgba, uint32_t width, uint32_t height, bool srgb = true);
+
+    // Box filters each level from the one above it, down to 1x1. RGBA8 only.
+    void generateMips();
+};
+
+} // VulkanEngine
+
+#endif //TEXTUREDATA_H
@@ -0,0 +1,165 @@
+#include "TextureFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+
+namespace {
+    // the line endings and EOF catch files mangled by text mode transfers, as in KTX
+    constexpr char MAGIC[8] = {'V', 'T', 'E', 'X', '\r', '\n', '\x1a', '\n'};
+    constexpr uint32_t FLAG_SRGB = 1;
+    constexpr uint32_t MAX_MIPS = 32;
+    constexpr uint64_t LEVEL_ALIGNMENT = 16;
+
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t format;
+        uint32_t flags;
+        uint32_t width;
+        uint32_t height;
+        uint32_t mipCount;
+    };
+    static_assert(sizeof(FileHeader) == 32, "the header layout is part of the file format");
+
+    struct FileLevel
+    {
+        uint64_t offset;
+        uint64_t size;
+        uint32_t width;
+        uint32_t height;
+    };
+    static_assert(sizeof(FileLevel) == 24, "the level layout is part of the file format");
+
+    uint64_t getLevelSize(VulkanEngine::TextureFormat format, uint32_t width, uint32_t height) {
+        uint32_t dim = VulkanEngine::getBlockDim(format);
+        return uint64_t((width + dim - 1) / dim) * ((height + dim - 1) / dim) * VulkanEngine::getBlockBytes(format);
+    }
+
+    FileHeader parseHeader(const uint8_t* data, size_t size, const std::string& path) {
+        FileHeader header;
+        if (size < sizeof(header)) {
+            throw std::runtime_error("ERROR: " + path + " is too small for a texture file");
+        }
+        std::memcpy(&header, data, sizeof(header));
+
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+            throw std::runtime_error("ERROR: " + path + " is not a texture file");
+        }
+        if (header.version != VulkanEngine::TextureFile::VERSION) {
+            throw std::runtime_error("ERROR: " + path + " has texture file version " + std::to_string(header.version) +
+                                     ", expected " + std::to_string(VulkanEngine::TextureFile::VERSION));
+        }
+        if (header.format > static_cast<uint32_t>(VulkanEngine::TextureFormat::Bc7)) {
+            throw std::runtime_error("ERROR: " + path + " has unknown texture format " + std::to_string(header.format));
+        }
+        if (header.width == 0 || header.height == 0 || header.mipCount == 0 || header.mipCount > MAX_MIPS) {
+            throw std::runtime_error("ERROR: " + path + " has a malformed texture header");
+        }
+        return header;
+    }
+}
+
+
+void
+VulkanEngine::TextureFile::write(const std::string& path, const TextureData& texture) {
+    if (texture.mips.empty() || texture.mips.size() > MAX_MIPS) {
+        throw std::runtime_error("ERROR: failed to write " + path + ", the texture has no or too many mips");
+    }
+
+    FileHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.format = static_cast<uint32_t>(texture.format);
+    header.flags = texture.srgb ? FLAG_SRGB : 0;
+    header.width = texture.width;
+    header.height = texture.height;
+    header.mipCount = texture.getMipCount();
+
+    std::vector<FileLevel> levels;
+    uint64_t offset = sizeof(FileHeader) + sizeof(FileLevel) * texture.mips.size();
+    for (const auto& mip : texture.mips) {
+        offset = (offset + LEVEL_ALIGNMENT - 1) & ~(LEVEL_ALIGNMENT - 1);
+        levels.push_back({offset, mip.size, mip.width, mip.height});
+        offset += mip.size;
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("ERROR: failed to open " + path + " for writing");
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(levels.data()), static_cast<std::streamsize>(sizeof(FileLevel) * levels.size()));
+
+    const char padding[LEVEL_ALIGNMENT] = {};
+    const uint8_t* pixels = texture.getPixels();
+    for (size_t i = 0; i < levels.size(); i++) {
+        uint64_t position = static_cast<uint64_t>(file.tellp());
+        file.write(padding, static_cast<std::streamsize>(levels[i].offset - position));
+        file.write(reinterpret_cast<const char*>(pixels + texture.mips[i].offset), static_cast<std::streamsize>(texture.mips[i].size));
+    }
+
+    if (!file) {
+        throw std::runtime_error("ERROR: failed to write " + path);
+    }
+}
+
+
+VulkanEngine::TextureData
+VulkanEngine::TextureFile::read(const std::string& path) {
+    auto mapping = std::make_shared<MappedFile>(path);
+    FileHeader header = parseHeader(mapping->getData(), mapping->getSize(), path);
+
+    uint64_t tableEnd = sizeof(FileHeader) + sizeof(FileLevel) * uint64_t(header.mipCount);
+    if (tableEnd > mapping->getSize()) {
+        throw std::runtime_error("ERROR: " + path + " is truncated");
+    }
+
+    TextureData texture;
+    texture.width = header.width;
+    texture.height = header.height;
+    texture.format = static_cast<TextureFormat>(header.format);
+    texture.srgb = (header.flags & FLAG_SRGB) != 0;
+
+    // the levels are uploaded straight from the mapping, so check every one against the file and its format
+    uint64_t previousEnd = tableEnd;
+    uint32_t expectedWidth = header.width;
+    uint32_t expectedHeight = header.height;
+    for (uint32_t i = 0; i < header.mipCount; i++) {
+        FileLevel level;
+        std::memcpy(&level, mapping->getData() + sizeof(FileHeader) + sizeof(FileLevel) * i, sizeof(level));
+
+        bool valid = level.width == expectedWidth && level.height == expectedHeight &&
+                     level.size == getLevelSize(texture.format, level.width, level.height) &&
+                     level.offset % LEVEL_ALIGNMENT == 0 && level.offset >= previousEnd &&
+                     level.offset + level.size <= mapping->getSize();
+        if (!valid) {
+            throw std::runtime_error("ERROR: " + path + " has a malformed level " + std::to_string(i));
+        }
+
+        texture.mips.push_back({level.width, level.height, static_cast<size_t>(level.offset), static_cast<size_t>(level.size)});
+        previousEnd = level.offset + level.size;
+        expectedWidth = std::max(1u, expectedWidth / 2);
+        expectedHeight = std::max(1u, expectedHeight / 2);
+    }
+
+    texture.mapping = std::move(mapping);
+    return texture;
+}
+
+
+VulkanEngine::TextureFileInfo
+VulkanEngine::TextureFile::readInfo(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("ERROR: failed to open " + path);
+    }
+
+    uint8_t bytes[sizeof(FileHeader)] = {};
+    file.read(reinterpret_cast<char*>(bytes), sizeof(bytes));
+    FileHeader header = parseHeader(bytes, static_cast<size_t>(file.gcount()), path);
+    return {static_cast<TextureFormat>(header.format), (header.flags & FLAG_SRGB) != 0, header.width, header.height, header.mipCount};
+}
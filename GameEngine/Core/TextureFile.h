@@ -0,0 +1,37 @@
+#ifndef TEXTUREFILE_H
+#define TEXTUREFILE_H
+
+
+#include <cstdint>
+#include <string>
+#include "TextureData.h"
+
+
+namespace VulkanEngine {
+
+    // What readInfo() returns, enough to pick a file without mapping its levels.
+    struct TextureFileInfo
+    {
+        TextureFormat format;
+        bool srgb;
+        uint32_t width;
+        uint32_t height;
+        uint32_t mipCount;
+    };
+
+// Cooked textures written by the TextureCooker tool: a header, a level table and the 16 byte
+// aligned levels. read() maps the file, the returned TextureData points into the mapping.
+namespace TextureFile {
+
+    constexpr const char* EXTENSION = ".vtex";
+    constexpr uint32_t VERSION = 1;
+
+    void write(const std::string& path, const TextureData& texture);
+    TextureData read(const std::string& path);
+    TextureFileInfo readInfo(const std::string& path);
+
+} // TextureFile
+
+} // VulkanEngine
+
+#endif //TEXTUREFILE_H
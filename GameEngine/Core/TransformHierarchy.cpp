@@ -0,0 +1,226 @@
+#include "TransformHierarchy.h"
+
+#include <algorithm>
+#include "MatrixKernels.h"
+#include "Profiler.h"
+
+
+namespace {
+    // nodes per job, large enough that scheduling stays well below the matrix work
+    constexpr uint32_t UPDATE_BATCH_SIZE = 1024;
+
+    // nodes translated from ids to dense indices at a time when storing
+    constexpr uint32_t STORE_BATCH_SIZE = 64;
+
+    template<typename T>
+    void permute(eastl::vector<T>& values, const eastl::vector<uint32_t>& newIndex, uint32_t liveCount) {
+        eastl::vector<T> sorted(liveCount);
+        for (uint32_t i = 0; i < newIndex.size(); i++) {
+            if (newIndex[i] != UINT32_MAX) {
+                sorted[newIndex[i]] = values[i];
+            }
+        }
+        values.swap(sorted);
+    }
+}
+
+
+VulkanEngine::TransformNodeId
+VulkanEngine::TransformHierarchy::createNode(TransformNodeId parent, const LocalTransform& local) {
+    uint32_t index = getNodeCount();
+
+    TransformNodeId id;
+    if (!mFreeIds.empty()) {
+        id = mFreeIds.back();
+        mFreeIds.pop_back();
+    } else {
+        id = static_cast<TransformNodeId>(mIndexOf.size());
+        mIndexOf.push_back(0);
+    }
+    mIndexOf[id] = index;
+
+    // appending keeps parents ahead of their children, the level order is restored on update
+    mParent.push_back(parent == INVALID_TRANSFORM_NODE ? UINT32_MAX : mIndexOf[parent]);
+    mIdOf.push_back(id);
+    mPositionX.push_back(0.0f);
+    mPositionY.push_back(0.0f);
+    mPositionZ.push_back(0.0f);
+    mRotationX.push_back(0.0f);
+    mRotationY.push_back(0.0f);
+    mRotationZ.push_back(0.0f);
+    mRotationW.push_back(1.0f);
+    mScaleX.push_back(1.0f);
+    mScaleY.push_back(1.0f);
+    mScaleZ.push_back(1.0f);
+    mWorld.push_back(glm::mat4(1.0f));
+    setLocal(id, local);
+
+    mOrderDirty = true;
+    return id;
+}
+
+
+void
+VulkanEngine::TransformHierarchy::destroyNode(TransformNodeId node) {
+    if (node < mIndexOf.size() && mIndexOf[node] != UINT32_MAX) {
+        mDestroyed.push_back(node);
+        mOrderDirty = true;
+    }
+}
+
+
+void
+VulkanEngine::TransformHierarchy::setLocal(TransformNodeId node, const LocalTransform& local) {
+    setPosition(node, local.position);
+    setRotation(node, local.rotation);
+    setScale(node, local.scale);
+}
+
+
+void
+VulkanEngine::TransformHierarchy::setPosition(TransformNodeId node, const glm::vec3& position) {
+    uint32_t index = mIndexOf[node];
+    mPositionX[index] = position.x;
+    mPositionY[index] = position.y;
+    mPositionZ[index] = position.z;
+}
+
+
+void
+VulkanEngine::TransformHierarchy::setRotation(TransformNodeId node, const glm::quat& rotation) {
+    uint32_t index = mIndexOf[node];
+    mRotationX[index] = rotation.x;
+    mRotationY[index] = rotation.y;
+    mRotationZ[index] = rotation.z;
+    mRotationW[index] = rotation.w;
+}
+
+
+void
+VulkanEngine::TransformHierarchy::setScale(TransformNodeId node, const glm::vec3& scale) {
+    uint32_t index = mIndexOf[node];
+    mScaleX[index] = scale.x;
+    mScaleY[index] = scale.y;
+    mScaleZ[index] = scale.z;
+}
+
+
+void
+VulkanEngine::TransformHierarchy::update(JobSystem& jobs) {
+    PROFILE_SCOPE("Transform update");
+
+    if (mOrderDirty) {
+        rebuildOrder();
+        mOrderDirty = false;
+    }
+
+    uint32_t count = getNodeCount();
+    if (count == 0) {
+        return;
+    }
+
+    TransformStreams streams{mPositionX.data(), mPositionY.data(), mPositionZ.data(),
+                             mRotationX.data(), mRotationY.data(), mRotationZ.data(), mRotationW.data(),
+                             mScaleX.data(), mScaleY.data(), mScaleZ.data()};
+    float* matrices = reinterpret_cast<float*>(mWorld.data());
+
+    // roots are done after this, every other level only has to apply its parents
+    jobs.parallelFor(0, count, UPDATE_BATCH_SIZE, [&](uint32_t first, uint32_t last) {
+        MatrixKernels::composeTRS(streams, first, last - first, matrices);
+    });
+    for (size_t level = 1; level + 1 < mLevels.size(); level++) {
+        jobs.parallelFor(mLevels[level], mLevels[level + 1], UPDATE_BATCH_SIZE, [&](uint32_t first, uint32_t last) {
+            MatrixKernels::multiplyParents(matrices, mParent.data(), first, last - first);
+        });
+    }
+}
+
+
+void
+VulkanEngine::TransformHierarchy::storeWorldMatrices(const TransformNodeId* nodes, uint32_t count, void* destination, size_t stride) const {
+    if (count == 0) {
+        return;
+    }
+    const float* matrices = reinterpret_cast<const float*>(mWorld.data());
+    uint8_t* bytes = static_cast<uint8_t*>(destination);
+
+    uint32_t indices[STORE_BATCH_SIZE];
+    for (uint32_t first = 0; first < count; first += STORE_BATCH_SIZE) {
+        uint32_t batch = std::min(STORE_BATCH_SIZE, count - first);
+        for (uint32_t i = 0; i < batch; i++) {
+            indices[i] = mIndexOf[nodes[first + i]];
+        }
+        MatrixKernels::storeMatrices(matrices, indices, batch, bytes + first * stride, stride);
+    }
+}
+
+
+void
+VulkanEngine::TransformHierarchy::rebuildOrder() {
+    uint32_t count = getNodeCount();
+
+    eastl::vector<uint8_t> dead(count, 0);
+    for (TransformNodeId id : mDestroyed) {
+        dead[mIndexOf[id]] = 1;
+    }
+    mDestroyed.clear();
+
+    // parents always precede their children here, so one pass settles depth and dead subtrees
+    eastl::vector<uint32_t> depth(count, 0);
+    uint32_t levelCount = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (mParent[i] != UINT32_MAX) {
+            dead[i] |= dead[mParent[i]];
+            depth[i] = depth[mParent[i]] + 1;
+        }
+        if (!dead[i]) {
+            levelCount = std::max(levelCount, depth[i] + 1);
+        }
+    }
+
+    // stable counting sort by depth
+    mLevels.assign(levelCount + 1, 0);
+    for (uint32_t i = 0; i < count; i++) {
+        if (!dead[i]) {
+            mLevels[depth[i] + 1]++;
+        }
+    }
+    for (uint32_t level = 1; level <= levelCount; level++) {
+        mLevels[level] += mLevels[level - 1];
+    }
+
+    eastl::vector<uint32_t> cursor(mLevels.begin(), mLevels.end());
+    eastl::vector<uint32_t> newIndex(count, UINT32_MAX);
+    for (uint32_t i = 0; i < count; i++) {
+        if (dead[i]) {
+            mIndexOf[mIdOf[i]] = UINT32_MAX;
+            mFreeIds.push_back(mIdOf[i]);
+        } else {
+            newIndex[i] = cursor[depth[i]]++;
+        }
+    }
+    uint32_t liveCount = mLevels[levelCount];
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (mParent[i] != UINT32_MAX) {
+            mParent[i] = newIndex[mParent[i]];
+        }
+    }
+    permute(mParent, newIndex, liveCount);
+    permute(mIdOf, newIndex, liveCount);
+    permute(mPositionX, newIndex, liveCount);
+    permute(mPositionY, newIndex, liveCount);
+    permute(mPositionZ, newIndex, liveCount);
+    permute(mRotationX, newIndex, liveCount);
+    permute(mRotationY, newIndex, liveCount);
+    permute(mRotationZ, newIndex, liveCount);
+    permute(mRotationW, newIndex, liveCount);
+    permute(mScaleX, newIndex, liveCount);
+    permute(mScaleY, newIndex, liveCount);
+    permute(mScaleZ, newIndex, liveCount);
+    mWorld.resize(liveCount);
+
+    for (uint32_t i = 0; i < liveCount; i++) {
+        mIndexOf[mIdOf[i]] = i;
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef TRANSFORMHIERARCHY_H
+#define TRANSFORMHIERARCHY_H
+
+
+#include <cstdint>
+#include <EASTL/vector.h>
+#include "../Vertex.h"
+#include <glm/gtc/quaternion.hpp>
+#include "JobSystem.h"
+
+
+namespace VulkanEngine {
+
+    using TransformNodeId = uint32_t;
+    constexpr TransformNodeId INVALID_TRANSFORM_NODE = UINT32_MAX;
+
+    struct LocalTransform
+    {
+        glm::vec3 position = glm::vec3(0.0f);
+        glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+        glm::vec3 scale = glm::vec3(1.0f);
+    };
+
+// Parent/child transforms stored breadth first as structure of arrays, updated a depth level at a
+// time. Creating and destroying nodes must not overlap update(), the setters may run in parallel.
+class TransformHierarchy {
+public:
+    TransformHierarchy() = default;
+
+    TransformHierarchy(const TransformHierarchy&) = delete;
+    TransformHierarchy& operator=(const TransformHierarchy&) = delete;
+
+    // The parent has to exist already, INVALID_TRANSFORM_NODE makes a root.
+    TransformNodeId createNode(TransformNodeId parent, const LocalTransform& local = LocalTransform());
+    // Destroys the node together with everything below it.
+    void destroyNode(TransformNodeId node);
+
+    void setLocal(TransformNodeId node, const LocalTransform& local);
+    void setPosition(TransformNodeId node, const glm::vec3& position);
+    void setRotation(TransformNodeId node, const glm::quat& rotation);
+    void setScale(TransformNodeId node, const glm::vec3& scale);
+
+    // Valid after update().
+    const glm::mat4& getWorld(TransformNodeId node) const { return mWorld[mIndexOf[node]]; }
+    uint32_t getNodeCount() const { return static_cast<uint32_t>(mParent.size()); }
+
+    void update(JobSystem& jobs);
+
+    // Writes the world matrix of nodes[i] to destination + i * stride.
+    void storeWorldMatrices(const TransformNodeId* nodes, uint32_t count, void* destination, size_t stride) const;
+
+private:
+    void rebuildOrder();
+
+    // indexed by dense position, in breadth first order once rebuilt
+    eastl::vector<float> mPositionX, mPositionY, mPositionZ;
+    eastl::vector<float> mRotationX, mRotationY, mRotationZ, mRotationW;
+    eastl::vector<float> mScaleX, mScaleY, mScaleZ;
+    eastl::vector<uint32_t> mParent;
+    eastl::vector<TransformNodeId> mIdOf;
+    eastl::vector<glm::mat4> mWorld;
+    // first dense index of every depth level, plus the end
+    eastl::vector<uint32_t> mLevels;
+
+    // indexed by node id
+    eastl::vector<uint32_t> mIndexOf;
+    eastl::vector<TransformNodeId> mFreeIds;
+    eastl::vector<TransformNodeId> mDestroyed;
+
+    bool mOrderDirty = false;
+};
+
+} // VulkanEngine
+
+#endif //TRANSFORMHIERARCHY_H
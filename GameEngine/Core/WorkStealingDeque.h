@@ -0,0 +1,98 @@
+#ifndef WORKSTEALINGDEQUE_H
+#define WORKSTEALINGDEQUE_H
+
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+
+namespace VulkanEngine {
+
+// Fixed-capacity Chase-Lev deque. The owning thread pushes and pops at the bottom,
+// any other thread may steal from the top. Memory orderings follow Le et al.,
+// "Correct and Efficient Work-Stealing for Weak Memory Models" (PPoPP 2013).
+template<typename T>
+class WorkStealingDeque {
+public:
+    explicit WorkStealingDeque(uint32_t capacity = 4096)
+        : mBuffer(roundUpPowerOfTwo(capacity)), mMask(static_cast<int64_t>(mBuffer.size()) - 1) {}
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    // Owner only. Returns false when full, the caller should run the item itself.
+    bool push(T* item) {
+        int64_t bottom = mBottom.load(std::memory_order_relaxed);
+        int64_t top = mTop.load(std::memory_order_acquire);
+        if (bottom - top > mMask) {
+            return false;
+        }
+        mBuffer[bottom & mMask].store(item, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        mBottom.store(bottom + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Owner only.
+    T* pop() {
+        int64_t bottom = mBottom.load(std::memory_order_relaxed) - 1;
+        mBottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = mTop.load(std::memory_order_relaxed);
+
+        if (top > bottom) {
+            mBottom.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        T* item = mBuffer[bottom & mMask].load(std::memory_order_relaxed);
+        if (top == bottom) {
+            // last item, race the thieves for it
+            if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                item = nullptr;
+            }
+            mBottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    // Any thread.
+    T* steal() {
+        int64_t top = mTop.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = mBottom.load(std::memory_order_acquire);
+
+        if (top >= bottom) {
+            return nullptr;
+        }
+
+        T* item = mBuffer[top & mMask].load(std::memory_order_relaxed);
+        if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return item;
+    }
+
+    bool empty() const {
+        return mTop.load(std::memory_order_acquire) >= mBottom.load(std::memory_order_acquire);
+    }
+
+private:
+    static size_t roundUpPowerOfTwo(uint32_t value) {
+        size_t result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    std::vector<std::atomic<T*>> mBuffer;
+    int64_t mMask;
+    alignas(64) std::atomic<int64_t> mTop{0};
+    alignas(64) std::atomic<int64_t> mBottom{0};
+};
+
+} // VulkanEngine
+
+#endif //WORKSTEALINGDEQUE_H
@@ -1,9 +1,27 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// set 1 is the bindless table, see VulkanCore/BindlessTable.h
+layout(set = 1, binding = 0) uniform texture2D textures[];
+layout(set = 1, binding = 1) uniform sampler samplers[];
+
+const uint INVALID_INDEX = 0xFFFFFFFFu;
 
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) flat in uint fragTextureIndex;
+layout(location = 3) in vec3 fragNormal;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    vec3 color = fragColor;
+    if (fragTextureIndex != INVALID_INDEX) {
+        // neighbouring draws of one subgroup may use different textures
+        color *= texture(sampler2D(textures[nonuniformEXT(fragTextureIndex)], samplers[0]), fragTexCoord).rgb;
+    }
+    // one fixed world space light with some ambient so faces turned away stay readable
+    const vec3 lightDirection = normalize(vec3(0.3, -0.4, 0.85));
+    color *= 0.3 + 0.7 * max(dot(normalize(fragNormal), lightDirection), 0.0);
+    outColor = vec4(color, 1.0);
 }
\ No newline at end of file
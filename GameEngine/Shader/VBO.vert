@@ -1,17 +1,57 @@
 #version 450
 
-layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
+layout(binding = 0) uniform FrameData {
     mat4 view;
     mat4 proj;
-} ubo;
+    vec4 frustumPlanes[6];
+} frame;
+
+struct ObjectData {
+    mat4 model;
+    vec4 boundingSphere;
+    uint indexCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint textureIndex;
+};
+
+layout(std430, binding = 1) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+};
 
-layout(location = 0) in vec2 inPosition;
+// Vertex or QuantizedVertex in Vertex.h. Missing components read as 0, so the quantized
+// normal arrives as (x, y, 0) and is decoded from the octahedron.
+layout(constant_id = 0) const bool OCTAHEDRAL_NORMALS = false;
+
+layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec3 inNormal;
+layout(location = 3) in vec2 inTexCoord;
+
+// the depth prepass runs this shader without the fragment stage, the main pass has to land on
+// exactly the depth it wrote
+invariant gl_Position;
 
 layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragTextureIndex;
+layout(location = 3) out vec3 fragNormal;
+
+vec3 decodeOctahedral(vec2 encoded) {
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-normal.z, 0.0);
+    normal.x += normal.x >= 0.0 ? -fold : fold;
+    normal.y += normal.y >= 0.0 ? -fold : fold;
+    return normalize(normal);
+}
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 0.0, 1.0);
+    mat4 model = objects[gl_InstanceIndex].model;
+    gl_Position = frame.proj * frame.view * model * vec4(inPosition, 1.0);
     fragColor = inColor;
+    fragTexCoord = inTexCoord;
+    fragTextureIndex = objects[gl_InstanceIndex].textureIndex;
+    // objects are only uniformly scaled, no inverse transpose needed
+    vec3 normal = OCTAHEDRAL_NORMALS ? decodeOctahedral(inNormal.xy) : inNormal;
+    fragNormal = mat3(model) * normal;
 }
\ No newline at end of file
@@ -0,0 +1,207 @@
+// DeletionQueueTest : drives submitFrame, collect and flush against fake timeline values and
+// checks what is destroyed, and in which order, as each value is reached.
+
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+#include "VulkanCore/DeletionQueue.h"
+#include "TestCheck.h"
+
+namespace
+{
+	template<typename T>
+	T fakeHandle(uintptr_t value)
+	{
+		return reinterpret_cast<T>(value);
+	}
+
+	using Destroyed = std::vector<std::pair<VkObjectType, uint64_t>>;
+
+	//completed values per timeline, and every destroy call in the order it was made
+	struct FakeDevice
+	{
+		std::map<VkSemaphore, uint64_t> completed;
+		Destroyed destroyed;
+
+		VulkanEngine::DeletionCallbacks callbacks()
+		{
+			VulkanEngine::DeletionCallbacks callbacks;
+			callbacks.getCompletedValue = [this](VkSemaphore timeline) { return completed[timeline]; };
+			callbacks.destroy = [this](VkObjectType type, uint64_t handle) { destroyed.emplace_back(type, handle); };
+			return callbacks;
+		}
+
+		//what was destroyed since the last call
+		Destroyed take()
+		{
+			Destroyed result;
+			result.swap(destroyed);
+			return result;
+		}
+	};
+
+	const VkSemaphore FRAME_TIMELINE = fakeHandle<VkSemaphore>(0x100);
+	const VkSemaphore TRANSFER_TIMELINE = fakeHandle<VkSemaphore>(0x200);
+
+	void testFramesReleaseInTimelineOrder()
+	{
+		FakeDevice device;
+		VulkanEngine::DeletionQueue queue(nullptr, device.callbacks());
+
+		//frame 1: a framebuffer before the view it uses, which has to stay the destroy order
+		queue.destroy(fakeHandle<VkFramebuffer>(1));
+		queue.destroy(fakeHandle<VkImageView>(2));
+		queue.submitFrame(FRAME_TIMELINE, 1);
+		//frame 2
+		queue.destroy(fakeHandle<VkBuffer>(3));
+		queue.destroy(fakeHandle<VkSwapchainKHR>(4));
+		queue.submitFrame(FRAME_TIMELINE, 2);
+		//recorded, not submitted yet
+		queue.destroy(fakeHandle<VkPipeline>(5));
+		CHECK(queue.getPendingCount() == 5);
+
+		device.completed[FRAME_TIMELINE] = 0;
+		queue.collect();
+		CHECK(device.take().empty());
+
+		device.completed[FRAME_TIMELINE] = 1;
+		queue.collect();
+		CHECK((device.take() == Destroyed{ { VK_OBJECT_TYPE_FRAMEBUFFER, 1 }, { VK_OBJECT_TYPE_IMAGE_VIEW, 2 } }));
+		CHECK(queue.getPendingCount() == 3);
+
+		//collecting again at the same value does nothing twice
+		queue.collect();
+		CHECK(device.take().empty());
+
+		//far past frame 2, the unsubmitted pipeline still waits for its own frame
+		device.completed[FRAME_TIMELINE] = 10;
+		queue.collect();
+		CHECK((device.take() == Destroyed{ { VK_OBJECT_TYPE_BUFFER, 3 }, { VK_OBJECT_TYPE_SWAPCHAIN_KHR, 4 } }));
+		CHECK(queue.getPendingCount() == 1);
+
+		queue.submitFrame(FRAME_TIMELINE, 11);
+		queue.collect();
+		CHECK(device.take().empty());
+		device.completed[FRAME_TIMELINE] = 11;
+		queue.collect();
+		CHECK((device.take() == Destroyed{ { VK_OBJECT_TYPE_PIPELINE, 5 } }));
+		CHECK(queue.getPendingCount() == 0);
+	}
+
+	void testTimelinesAreIndependent()
+	{
+		FakeDevice device;
+		VulkanEngine::DeletionQueue queue(nullptr, device.callbacks());
+
+		queue.destroy(fakeHandle<VkImage>(1));
+		queue.submitFrame(FRAME_TIMELINE, 5);
+		queue.destroy(fakeHandle<VkBuffer>(2));
+		queue.submitFrame(TRANSFER_TIMELINE, 3);
+
+		//the later frame is on a timeline that got there first
+		device.completed[TRANSFER_TIMELINE] = 3;
+		queue.collect();
+		CHECK((device.take() == Destroyed{ { VK_OBJECT_TYPE_BUFFER, 2 } }));
+
+		device.completed[FRAME_TIMELINE] = 5;
+		queue.collect();
+		CHECK((device.take() == Destroyed{ { VK_OBJECT_TYPE_IMAGE, 1 } }));
+	}
+
+	void testEmptyFramesAndNullHandles()
+	{
+		FakeDevice device;
+		VulkanEngine::DeletionQueue queue(nullptr, device.callbacks());
+
+		queue.destroy(VkBuffer(VK_NULL_HANDLE));
+		queue.destroy(VkImageView(VK_NULL_HANDLE));
+		queue.free(VulkanEngine::GpuAllocation{});
+		CHECK(queue.getPendingCount() == 0);
+
+		//a frame that retired nothing leaves no entry behind
+		queue.submitFrame(FRAME_TIMELINE, 1);
+		device.completed[FRAME_TIMELINE] = 1;
+		queue.collect();
+		CHECK(device.take().empty());
+	}
+
+	void testDeferAndFree()
+	{
+		//a memory type table of one, enough to hand out a real allocation
+		VkPhysicalDeviceMemoryProperties properties{};
+		properties.memoryHeapCount = 1;
+		properties.memoryHeaps[0].size = 64ull * 1024 * 1024;
+		properties.memoryTypeCount = 1;
+		properties.memoryTypes[0].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		std::vector<char> block;
+		VulkanEngine::GpuMemoryCallbacks memory;
+		memory.allocate = [&block](uint32_t, VkDeviceSize size, VkDeviceMemory* handle)
+		{
+			block.resize(static_cast<size_t>(size));
+			*handle = fakeHandle<VkDeviceMemory>(0x1000);
+			return VK_SUCCESS;
+		};
+		memory.free = [](VkDeviceMemory) {};
+		memory.map = [&block](VkDeviceMemory) { return static_cast<void*>(block.data()); };
+		VulkanEngine::GpuAllocator allocator(properties, memory, 1024 * 1024);
+
+		VkMemoryRequirements requirements{};
+		requirements.size = 4096;
+		requirements.alignment = 256;
+		requirements.memoryTypeBits = 1;
+		VulkanEngine::GpuAllocation allocation = allocator.allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		FakeDevice device;
+		VulkanEngine::DeletionQueue queue(&allocator, device.callbacks());
+		int deferredRuns = 0;
+		queue.destroy(fakeHandle<VkBuffer>(1), allocation);
+		queue.defer([&deferredRuns] { deferredRuns++; });
+		queue.submitFrame(FRAME_TIMELINE, 1);
+
+		queue.collect();
+		CHECK(allocator.getHeapStats(0).usedBytes > 0);
+		CHECK(deferredRuns == 0);
+		CHECK(device.take().empty());
+
+		device.completed[FRAME_TIMELINE] = 1;
+		queue.collect();
+		CHECK(allocator.getHeapStats(0).usedBytes == 0);
+		CHECK(deferredRuns == 1);
+		CHECK((device.take() == Destroyed{ { VK_OBJECT_TYPE_BUFFER, 1 } }));
+	}
+
+	void testFlush()
+	{
+		FakeDevice device;
+		{
+			VulkanEngine::DeletionQueue queue(nullptr, device.callbacks());
+			queue.destroy(fakeHandle<VkSampler>(1));
+			queue.submitFrame(FRAME_TIMELINE, 1);
+			queue.destroy(fakeHandle<VkSemaphore>(2));
+			queue.submitFrame(FRAME_TIMELINE, 2);
+			queue.destroy(fakeHandle<VkQueryPool>(3));
+
+			//submitted frames oldest first, then whatever is still being recorded, timelines unread
+			device.completed[FRAME_TIMELINE] = 0;
+			queue.flush();
+			CHECK((device.take() == Destroyed{ { VK_OBJECT_TYPE_SAMPLER, 1 }, { VK_OBJECT_TYPE_SEMAPHORE, 2 }, { VK_OBJECT_TYPE_QUERY_POOL, 3 } }));
+			CHECK(queue.getPendingCount() == 0);
+
+			queue.destroy(fakeHandle<VkCommandPool>(4));
+			queue.submitFrame(FRAME_TIMELINE, 3);
+		}
+		//the destructor flushes as well
+		CHECK((device.take() == Destroyed{ { VK_OBJECT_TYPE_COMMAND_POOL, 4 } }));
+	}
+}
+
+int main()
+{
+	testFramesReleaseInTimelineOrder();
+	testTimelinesAreIndependent();
+	testEmptyFramesAndNullHandles();
+	testDeferAndFree();
+	testFlush();
+	return testResult();
+}
@@ -0,0 +1,183 @@
+// EntityRegistryBench : a million entities over four archetypes, timing each, eachChunk,
+// parallelEachChunk and structural add/remove, with checks that every query saw the same rows.
+
+#include <chrono>
+#include <cstdint>
+#include <new>
+#include <vector>
+#include "Core/EntityRegistry.h"
+#include "Core/JobSystem.h"
+#include "TestCheck.h"
+
+//main.cpp provides these for the engine, EASTL's default allocator routes through them
+void* operator new[](size_t size, const char* pName, int flags, unsigned debugFlags, const char* file, int line)
+{
+	return ::operator new[](size);
+}
+
+void* operator new[](size_t size, size_t alignment, size_t alignmentOffset, const char* pName, int flags, unsigned debugFlags, const char* file, int line)
+{
+	return ::operator new[](size);
+}
+
+namespace
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	struct Position
+	{
+		float x, y, z;
+	};
+
+	struct Velocity
+	{
+		float x, y, z;
+	};
+
+	struct Health
+	{
+		uint32_t value;
+	};
+
+	struct Tag
+	{
+		uint32_t value;
+	};
+
+	constexpr uint32_t ENTITY_COUNT = 1000000;
+	constexpr uint32_t STRUCTURAL_COUNT = 100000;
+
+	void report(const char* what, Clock::time_point start, uint32_t rows)
+	{
+		double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		std::cout << what << ": " << ms << "ms, " << ms * 1e6 / rows << "ns per entity" << std::endl;
+	}
+}
+
+int main()
+{
+	VulkanEngine::JobSystem jobs;
+	VulkanEngine::EntityRegistry registry;
+	std::vector<VulkanEngine::Entity> entities;
+	entities.reserve(ENTITY_COUNT);
+
+	//a quarter each: moving, moving with health, static with health, moving and tagged
+	auto start = Clock::now();
+	for (uint32_t i = 0; i < ENTITY_COUNT; i++)
+	{
+		Position position{ float(i), 0.0f, 0.0f };
+		Velocity velocity{ 1.0f, 2.0f, 3.0f };
+		switch (i % 4)
+		{
+		case 0: entities.push_back(registry.create(position, velocity)); break;
+		case 1: entities.push_back(registry.create(position, velocity, Health{ 100 })); break;
+		case 2: entities.push_back(registry.create(position, Health{ 100 })); break;
+		default: entities.push_back(registry.create(position, velocity, Tag{ i })); break;
+		}
+	}
+	report("create", start, ENTITY_COUNT);
+	CHECK(registry.getEntityCount() == ENTITY_COUNT);
+
+	const uint32_t moving = ENTITY_COUNT / 4 * 3;
+	CHECK(registry.count<Position>() == ENTITY_COUNT);
+	CHECK((registry.count<Position, Velocity>() == moving));
+	CHECK(registry.count<Health>() == ENTITY_COUNT / 2);
+
+	start = Clock::now();
+	uint32_t visited = 0;
+	registry.each<Position, const Velocity>([&visited](Position& position, const Velocity& velocity)
+	{
+		position.x += velocity.x;
+		position.y += velocity.y;
+		position.z += velocity.z;
+		visited++;
+	});
+	report("each<Position, Velocity>", start, moving);
+	CHECK(visited == moving);
+
+	start = Clock::now();
+	visited = 0;
+	uint32_t expectedFirst = 0;
+	bool dense = true;
+	registry.eachChunk<Position, const Velocity>([&](uint32_t firstIndex, uint32_t count, Position* positions, const Velocity* velocities)
+	{
+		dense = dense && firstIndex == expectedFirst;
+		expectedFirst += count;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			positions[i].x += velocities[i].x;
+			positions[i].y += velocities[i].y;
+			positions[i].z += velocities[i].z;
+		}
+		visited += count;
+	});
+	report("eachChunk<Position, Velocity>", start, moving);
+	CHECK(visited == moving);
+	CHECK(dense);
+
+	//every row is written by exactly one job, the shared array is indexed by firstIndex
+	std::vector<uint32_t> touched(moving, 0);
+	start = Clock::now();
+	registry.parallelEachChunk<Position, const Velocity>(jobs, [&touched](uint32_t firstIndex, uint32_t count, Position* positions, const Velocity* velocities)
+	{
+		for (uint32_t i = 0; i < count; i++)
+		{
+			positions[i].x += velocities[i].x;
+			positions[i].y += velocities[i].y;
+			positions[i].z += velocities[i].z;
+			touched[firstIndex + i]++;
+		}
+	});
+	report("parallelEachChunk<Position, Velocity>", start, moving);
+	uint32_t wrong = 0;
+	for (uint32_t count : touched)
+	{
+		wrong += count == 1 ? 0 : 1;
+	}
+	CHECK(wrong == 0);
+
+	//three passes of (1, 2, 3) over every moving entity
+	uint32_t misplaced = 0;
+	for (uint32_t i = 0; i < ENTITY_COUNT; i++)
+	{
+		const Position* position = registry.get<Position>(entities[i]);
+		bool hasVelocity = i % 4 != 2;
+		float expected = hasVelocity ? 3.0f : 0.0f;
+		misplaced += position != nullptr && position->x == float(i) + expected && position->y == 2.0f * expected ? 0 : 1;
+	}
+	CHECK(misplaced == 0);
+
+	//add and remove move the rows between archetypes
+	start = Clock::now();
+	for (uint32_t i = 0; i < STRUCTURAL_COUNT; i++)
+	{
+		registry.add(entities[i * 4], Health{ i });
+	}
+	report("add<Health>", start, STRUCTURAL_COUNT);
+	CHECK(registry.count<Health>() == ENTITY_COUNT / 2 + STRUCTURAL_COUNT);
+	CHECK(registry.get<Health>(entities[4])->value == 1);
+	CHECK(registry.get<Position>(entities[4])->x == 4.0f + 3.0f);
+
+	start = Clock::now();
+	for (uint32_t i = 0; i < STRUCTURAL_COUNT; i++)
+	{
+		registry.remove<Health>(entities[i * 4]);
+	}
+	report("remove<Health>", start, STRUCTURAL_COUNT);
+	CHECK(registry.count<Health>() == ENTITY_COUNT / 2);
+	CHECK(!registry.has<Health>(entities[4]));
+	CHECK(registry.get<Position>(entities[4])->x == 4.0f + 3.0f);
+
+	start = Clock::now();
+	for (uint32_t i = 0; i < ENTITY_COUNT; i += 2)
+	{
+		registry.destroy(entities[i]);
+	}
+	report("destroy", start, ENTITY_COUNT / 2);
+	CHECK(registry.getEntityCount() == ENTITY_COUNT / 2);
+	CHECK(!registry.isAlive(entities[0]));
+	CHECK(registry.isAlive(entities[1]));
+	CHECK(registry.get<Position>(entities[1])->x == 1.0f + 3.0f);
+
+	return testResult();
+}
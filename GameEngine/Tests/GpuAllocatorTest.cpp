@@ -0,0 +1,235 @@
+// GpuAllocatorTest : the buddy allocator against a made up memory type table, with the driver
+// calls replaced by GpuMemoryCallbacks that hand out fake VkDeviceMemory handles.
+
+#include <cstdint>
+#include <map>
+#include <vector>
+#include "VulkanCore/GpuAllocator.h"
+#include "TestCheck.h"
+
+namespace
+{
+	constexpr VkDeviceSize BLOCK_SIZE = 1024 * 1024;
+
+	//what a driver would have handed out, by handle
+	struct FakeDriver
+	{
+		std::map<VkDeviceMemory, std::vector<char>> memory;
+		uintptr_t nextHandle = 1;
+
+		VulkanEngine::GpuMemoryCallbacks callbacks()
+		{
+			VulkanEngine::GpuMemoryCallbacks callbacks;
+			callbacks.allocate = [this](uint32_t, VkDeviceSize size, VkDeviceMemory* handle)
+			{
+				*handle = reinterpret_cast<VkDeviceMemory>(nextHandle++);
+				memory[*handle].resize(static_cast<size_t>(size));
+				return VK_SUCCESS;
+			};
+			callbacks.free = [this](VkDeviceMemory handle)
+			{
+				CHECK(memory.erase(handle) == 1);
+			};
+			callbacks.map = [this](VkDeviceMemory handle)
+			{
+				return static_cast<void*>(memory.at(handle).data());
+			};
+			return callbacks;
+		}
+	};
+
+	//type 0 device local on heap 0, type 1 host visible on heap 1
+	VkPhysicalDeviceMemoryProperties memoryTable()
+	{
+		VkPhysicalDeviceMemoryProperties properties{};
+		properties.memoryHeapCount = 2;
+		properties.memoryHeaps[0].size = 1024ull * 1024 * 1024;
+		properties.memoryHeaps[1].size = 256ull * 1024 * 1024;
+		properties.memoryTypeCount = 2;
+		properties.memoryTypes[0].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		properties.memoryTypes[0].heapIndex = 0;
+		properties.memoryTypes[1].propertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		properties.memoryTypes[1].heapIndex = 1;
+		return properties;
+	}
+
+	VkMemoryRequirements requirements(VkDeviceSize size, VkDeviceSize alignment = 1, uint32_t typeBits = 0x3)
+	{
+		VkMemoryRequirements result{};
+		result.size = size;
+		result.alignment = alignment;
+		result.memoryTypeBits = typeBits;
+		return result;
+	}
+
+	void testFindMemoryType()
+	{
+		VkPhysicalDeviceMemoryProperties properties = memoryTable();
+		CHECK(VulkanEngine::GpuAllocator::findMemoryType(properties, 0x3, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) == 0);
+		CHECK(VulkanEngine::GpuAllocator::findMemoryType(properties, 0x3, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 1);
+		CHECK_THROWS(VulkanEngine::GpuAllocator::findMemoryType(properties, 0x1, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT));
+	}
+
+	void testBuddySplitAndMerge()
+	{
+		FakeDriver driver;
+		VulkanEngine::GpuAllocator allocator(memoryTable(), driver.callbacks(), BLOCK_SIZE);
+
+		//1000 bytes take a 1024 byte node, aligned to its size
+		std::vector<VulkanEngine::GpuAllocation> allocations;
+		for (int i = 0; i < 3; i++)
+		{
+			allocations.push_back(allocator.allocate(requirements(1000), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+		}
+		CHECK(driver.memory.size() == 1);
+		CHECK(allocator.getDeviceAllocationCount() == 1);
+		for (size_t i = 0; i < allocations.size(); i++)
+		{
+			CHECK(allocations[i].isValid());
+			CHECK(allocations[i].memoryType == 0);
+			CHECK(allocations[i].size == 1000);
+			CHECK(allocations[i].offset % 1024 == 0);
+			CHECK(allocations[i].mapped == nullptr);
+			for (size_t j = 0; j < i; j++)
+			{
+				CHECK(allocations[i].memory == allocations[j].memory);
+				CHECK(allocations[i].offset != allocations[j].offset);
+			}
+		}
+
+		VulkanEngine::GpuHeapStats stats = allocator.getHeapStats(0);
+		CHECK(stats.blockCount == 1);
+		CHECK(stats.blockBytes == BLOCK_SIZE);
+		CHECK(stats.usedBytes == 3 * 1024);
+		CHECK(stats.allocationCount == 3);
+
+		//alignment rounds the node up as well
+		VulkanEngine::GpuAllocation aligned = allocator.allocate(requirements(256, 64 * 1024), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		CHECK(aligned.offset % (64 * 1024) == 0);
+		allocations.push_back(aligned);
+
+		//once everything is back the buddies have merged into the whole block again
+		for (auto& allocation : allocations)
+		{
+			allocator.free(allocation);
+			CHECK(!allocation.isValid());
+		}
+		CHECK(allocator.getHeapStats(0).usedBytes == 0);
+		CHECK(allocator.getDeviceAllocationCount() == 1);
+
+		VulkanEngine::GpuAllocation whole = allocator.allocate(requirements(BLOCK_SIZE), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		CHECK(whole.offset == 0);
+		CHECK(allocator.getDeviceAllocationCount() == 1);
+		allocator.free(whole);
+	}
+
+	void testDedicatedAndMapped()
+	{
+		FakeDriver driver;
+		VulkanEngine::GpuAllocator allocator(memoryTable(), driver.callbacks(), BLOCK_SIZE);
+
+		VulkanEngine::GpuAllocation big = allocator.allocate(requirements(3 * BLOCK_SIZE), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		CHECK(big.offset == 0);
+		CHECK(driver.memory.at(big.memory).size() == 3 * BLOCK_SIZE);
+		allocator.free(big);
+		CHECK(driver.memory.empty());
+
+		//host visible blocks are mapped once, allocations point into the mapping
+		VulkanEngine::GpuAllocation first = allocator.allocate(requirements(4096), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+		VulkanEngine::GpuAllocation second = allocator.allocate(requirements(4096), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+		CHECK(first.memoryType == 1);
+		CHECK(first.memory == second.memory);
+		char* base = driver.memory.at(first.memory).data();
+		CHECK(first.mapped == base + first.offset);
+		CHECK(second.mapped == base + second.offset);
+		CHECK(allocator.getHeapStats(1).usedBytes == 2 * 4096);
+		CHECK(allocator.getHeapStats(0).blockCount == 0);
+		allocator.free(first);
+		allocator.free(second);
+	}
+
+	void testBufferImageGranularity()
+	{
+		//a granularity above the smallest node keeps buffers and optimal images in separate blocks
+		{
+			FakeDriver driver;
+			VulkanEngine::GpuAllocator allocator(memoryTable(), driver.callbacks(), BLOCK_SIZE, 4096);
+			VulkanEngine::GpuAllocation buffer = allocator.allocate(requirements(256), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			VulkanEngine::GpuAllocation image = allocator.allocate(requirements(256), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				VulkanEngine::GpuResourceTiling::Optimal);
+			VulkanEngine::GpuAllocation otherImage = allocator.allocate(requirements(256), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				VulkanEngine::GpuResourceTiling::Optimal);
+			CHECK(buffer.memory != image.memory);
+			CHECK(image.memory == otherImage.memory);
+			CHECK(allocator.getDeviceAllocationCount() == 2);
+			allocator.free(buffer);
+			allocator.free(image);
+			allocator.free(otherImage);
+		}
+
+		//up to the smallest node neighbours never share a page, so they share blocks
+		{
+			FakeDriver driver;
+			VulkanEngine::GpuAllocator allocator(memoryTable(), driver.callbacks(), BLOCK_SIZE, VulkanEngine::GpuAllocator::MIN_ALLOCATION_SIZE);
+			VulkanEngine::GpuAllocation buffer = allocator.allocate(requirements(256), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			VulkanEngine::GpuAllocation image = allocator.allocate(requirements(256), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				VulkanEngine::GpuResourceTiling::Optimal);
+			CHECK(buffer.memory == image.memory);
+			CHECK(allocator.getDeviceAllocationCount() == 1);
+			allocator.free(buffer);
+			allocator.free(image);
+		}
+	}
+
+	void testDefragmentation()
+	{
+		FakeDriver driver;
+		VulkanEngine::GpuAllocator allocator(memoryTable(), driver.callbacks(), BLOCK_SIZE);
+
+		//two halves fill the first block, the third allocation opens a second one
+		VulkanEngine::GpuAllocation firstHalf = allocator.allocate(requirements(BLOCK_SIZE / 2), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VulkanEngine::GpuAllocation secondHalf = allocator.allocate(requirements(BLOCK_SIZE / 2), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VulkanEngine::GpuAllocation quarter = allocator.allocate(requirements(BLOCK_SIZE / 4), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		CHECK(quarter.memory != firstHalf.memory);
+		allocator.free(firstHalf);
+
+		//the emptier block is moved into the space the free half left
+		std::vector<VulkanEngine::GpuDefragMove> moves = allocator.beginDefragmentation(BLOCK_SIZE);
+		CHECK(moves.size() == 1);
+		if (moves.size() == 1)
+		{
+			CHECK(moves[0].src.memory == quarter.memory);
+			CHECK(moves[0].src.offset == quarter.offset);
+			CHECK(moves[0].dst.memory == secondHalf.memory);
+			quarter = moves[0].dst;
+		}
+		allocator.endDefragmentation(moves);
+		CHECK(moves.empty());
+		CHECK(allocator.getDeviceAllocationCount() == 1);
+		CHECK(driver.memory.size() == 1);
+
+		allocator.free(secondHalf);
+		allocator.free(quarter);
+		CHECK(allocator.getHeapStats(0).usedBytes == 0);
+	}
+
+	void testHeapStatsBounds()
+	{
+		FakeDriver driver;
+		VulkanEngine::GpuAllocator allocator(memoryTable(), driver.callbacks(), BLOCK_SIZE);
+		CHECK(allocator.getHeapCount() == 2);
+		CHECK_THROWS(allocator.getHeapStats(2));
+		CHECK_THROWS(allocator.getHeapStats(VK_MAX_MEMORY_HEAPS));
+	}
+}
+
+int main()
+{
+	testFindMemoryType();
+	testBuddySplitAndMerge();
+	testDedicatedAndMapped();
+	testBufferImageGranularity();
+	testDefragmentation();
+	testHeapStatsBounds();
+	return testResult();
+}
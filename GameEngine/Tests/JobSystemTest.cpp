@@ -0,0 +1,252 @@
+// JobSystemTest : stress tests for stealing, nesting and exception propagation through JobCounter,
+// then timings of empty jobs and of parallelFor from one thread up to every hardware thread.
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "Core/JobSystem.h"
+#include "TestCheck.h"
+
+namespace
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	double elapsedMs(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	//every index of the range is visited exactly once, whatever the grain
+	void testParallelForCoverage(VulkanEngine::JobSystem& jobs)
+	{
+		const uint32_t count = 100000;
+		for (uint32_t grain : { 1u, 7u, 64u, count, 2 * count })
+		{
+			std::vector<std::atomic<uint32_t>> visits(count);
+			jobs.parallelFor(0, count, grain, [&](uint32_t first, uint32_t last)
+			{
+				for (uint32_t i = first; i < last; i++)
+				{
+					visits[i].fetch_add(1, std::memory_order_relaxed);
+				}
+			});
+			uint32_t wrong = 0;
+			for (auto& visit : visits)
+			{
+				wrong += visit.load() == 1 ? 0 : 1;
+			}
+			CHECK(wrong == 0);
+		}
+
+		bool called = false;
+		jobs.parallelFor(5, 5, 1, [&](uint32_t, uint32_t) { called = true; });
+		CHECK(!called);
+	}
+
+	//a tree of jobs that spawn and wait on their own children, so the queues fill from every thread
+	//and the idle ones have to steal to make progress
+	void spawnTree(VulkanEngine::JobSystem& jobs, uint32_t depth, std::atomic<uint32_t>& visited)
+	{
+		visited.fetch_add(1, std::memory_order_relaxed);
+		if (depth == 0)
+		{
+			return;
+		}
+		VulkanEngine::JobCounter children;
+		for (int i = 0; i < 4; i++)
+		{
+			jobs.run([&jobs, depth, &visited] { spawnTree(jobs, depth - 1, visited); }, &children);
+		}
+		jobs.wait(children);
+	}
+
+	void testStealStress(VulkanEngine::JobSystem& jobs)
+	{
+		//1 + 4 + ... + 4^7 jobs
+		std::atomic<uint32_t> visited{ 0 };
+		spawnTree(jobs, 7, visited);
+		CHECK(visited.load() == (65536 - 1) / 3);
+
+		//everything pushed to the main thread's queue, the workers only get work by stealing
+		std::atomic<uint32_t> done{ 0 };
+		VulkanEngine::JobCounter counter;
+		const uint32_t jobCount = 20000;
+		for (uint32_t i = 0; i < jobCount; i++)
+		{
+			jobs.run([&] { done.fetch_add(1, std::memory_order_relaxed); }, &counter);
+		}
+		jobs.wait(counter);
+		CHECK(done.load() == jobCount);
+		CHECK(counter.isDone());
+
+		//jobs from a thread outside the system go through the submit queue
+		std::atomic<uint32_t> submitted{ 0 };
+		VulkanEngine::JobCounter external;
+		std::thread outsider([&]
+		{
+			for (int i = 0; i < 1000; i++)
+			{
+				jobs.run([&] { submitted.fetch_add(1, std::memory_order_relaxed); }, &external);
+			}
+		});
+		outsider.join();
+		jobs.wait(external);
+		CHECK(submitted.load() == 1000);
+	}
+
+	void testExceptionPropagation(VulkanEngine::JobSystem& jobs)
+	{
+		//the first failure is rethrown by wait, the other jobs still run to completion
+		std::atomic<uint32_t> finished{ 0 };
+		VulkanEngine::JobCounter counter;
+		for (int i = 0; i < 100; i++)
+		{
+			jobs.run([i, &finished]
+			{
+				finished.fetch_add(1, std::memory_order_relaxed);
+				if (i % 10 == 3)
+				{
+					throw std::runtime_error("job failed");
+				}
+			}, &counter);
+		}
+		CHECK_THROWS(jobs.wait(counter));
+		CHECK(finished.load() == 100);
+		CHECK(counter.isDone());
+
+		//the error was handed out, the counter is clean for the next batch
+		jobs.run([] {}, &counter);
+		jobs.wait(counter);
+		CHECK(counter.error == nullptr);
+
+		//from the chunk the caller runs itself and from the ones that went to other threads
+		CHECK_THROWS(jobs.parallelFor(0, 1000, 10, [](uint32_t first, uint32_t)
+		{
+			if (first == 0)
+			{
+				throw std::runtime_error("first chunk failed");
+			}
+		}));
+		CHECK_THROWS(jobs.parallelFor(0, 1000, 10, [](uint32_t first, uint32_t)
+		{
+			if (first == 990)
+			{
+				throw std::runtime_error("last chunk failed");
+			}
+		}));
+
+		//and through a nested wait up to the outer one
+		VulkanEngine::JobCounter outer;
+		jobs.run([&jobs]
+		{
+			VulkanEngine::JobCounter inner;
+			jobs.run([] { throw std::runtime_error("nested job failed"); }, &inner);
+			jobs.wait(inner);
+		}, &outer);
+		CHECK_THROWS(jobs.wait(outer));
+
+		//without a counter the worker survives and the main thread gets the error, once
+		VulkanEngine::JobCounter after;
+		//pushed last, so a thread running its own queue gets to it first
+		jobs.run([] {}, &after);
+		jobs.run([] { throw std::runtime_error("uncounted job failed"); });
+		jobs.wait(after);
+		while (true)
+		{
+			//unless a worker stole the other job first, then it is still queued or running
+			try
+			{
+				jobs.pumpMainThread();
+			}
+			catch (const std::runtime_error&)
+			{
+				break;
+			}
+			std::this_thread::yield();
+		}
+		jobs.pumpMainThread();
+		jobs.run([] {}, &after);
+		jobs.wait(after);
+		CHECK(after.error == nullptr);
+	}
+
+	void testMainThreadQueue(VulkanEngine::JobSystem& jobs)
+	{
+		std::thread::id mainThread = std::this_thread::get_id();
+		std::atomic<bool> ranOnMain{ false };
+		VulkanEngine::JobCounter counter;
+		jobs.run([&] { jobs.runOnMainThread([&] { ranOnMain = std::this_thread::get_id() == mainThread; }); }, &counter);
+		jobs.wait(counter);
+		jobs.pumpMainThread();
+		CHECK(ranOnMain.load());
+		CHECK(jobs.isMainThread());
+	}
+
+	//run + wait cost of a job that does nothing, and the speedup of a fixed parallelFor workload
+	void benchmark()
+	{
+		const uint32_t emptyJobs = 100000;
+		const uint32_t elements = 1 << 22;
+		std::vector<float> data(elements, 2.0f);
+		double singleThreadMs = 0.0;
+
+		uint32_t maxWorkers = VulkanEngine::JobSystem::defaultWorkerCount();
+		for (uint32_t workers = 0; workers <= maxWorkers; workers++)
+		{
+			VulkanEngine::JobSystem jobs(workers);
+
+			VulkanEngine::JobCounter counter;
+			auto start = Clock::now();
+			for (uint32_t i = 0; i < emptyJobs; i++)
+			{
+				jobs.run([] {}, &counter);
+			}
+			jobs.wait(counter);
+			double emptyMs = elapsedMs(start);
+
+			std::atomic<uint32_t> checksum{ 0 };
+			start = Clock::now();
+			jobs.parallelFor(0, elements, 4096, [&](uint32_t first, uint32_t last)
+			{
+				float sum = 0.0f;
+				for (uint32_t i = first; i < last; i++)
+				{
+					sum += std::sqrt(data[i]) * std::sin(data[i]);
+				}
+				checksum.fetch_add(sum > 0.0f ? 1 : 0, std::memory_order_relaxed);
+			});
+			double parallelMs = elapsedMs(start);
+			if (workers == 0)
+			{
+				singleThreadMs = parallelMs;
+			}
+
+			std::cout << jobs.getThreadCount() << " thread(s): empty job " << emptyMs * 1e6 / emptyJobs << "ns, parallelFor over "
+				<< elements << " elements " << parallelMs << "ms (" << singleThreadMs / parallelMs << "x)" << std::endl;
+		}
+	}
+}
+
+int main()
+{
+	{
+		VulkanEngine::JobSystem jobs;
+		testParallelForCoverage(jobs);
+		testStealStress(jobs);
+		testExceptionPropagation(jobs);
+		testMainThreadQueue(jobs);
+	}
+	//no workers at all, the main thread has to run everything from its own waits
+	{
+		VulkanEngine::JobSystem jobs(0);
+		testParallelForCoverage(jobs);
+		testStealStress(jobs);
+		testExceptionPropagation(jobs);
+	}
+	benchmark();
+	return testResult();
+}
@@ -0,0 +1,300 @@
+// MatrixKernelsTest : the transform kernels against glm, then timed against composing and
+// multiplying one glm::mat4 per object. Built twice, the second time with AVX2 enabled
+// (MatrixKernelsTestAVX2), which skips itself on CPUs without it.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "Core/MatrixKernels.h"
+#include "TestCheck.h"
+#if defined(__AVX2__) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	//CTest reads this as skipped, see SKIP_RETURN_CODE in CMakeLists.txt
+	constexpr int SKIP_RETURN_CODE = 77;
+	constexpr float EPSILON = 1e-4f;
+
+	bool cpuRunsThisBuild()
+	{
+#if defined(__AVX2__) && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+		{
+			return false;
+		}
+		__cpuid(info, 1);
+		bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+		__cpuidex(info, 7, 0);
+		return osSavesYmm && (info[1] & (1 << 5)) != 0;
+#elif defined(__AVX2__)
+		return __builtin_cpu_supports("avx2");
+#else
+		return true;
+#endif
+	}
+
+	//local transforms as the hierarchy keeps them, plus the same values as glm types
+	struct Transforms
+	{
+		std::vector<float> px, py, pz, rx, ry, rz, rw, sx, sy, sz;
+		std::vector<glm::vec3> positions;
+		std::vector<glm::quat> rotations;
+		std::vector<glm::vec3> scales;
+
+		explicit Transforms(uint32_t count)
+		{
+			std::mt19937 random(1234);
+			std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+			std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+			std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				glm::vec3 p(position(random), position(random), position(random));
+				glm::quat q = glm::normalize(glm::quat(unit(random), unit(random), unit(random), unit(random)));
+				glm::vec3 s(scale(random), scale(random), scale(random));
+				positions.push_back(p);
+				rotations.push_back(q);
+				scales.push_back(s);
+				px.push_back(p.x); py.push_back(p.y); pz.push_back(p.z);
+				rx.push_back(q.x); ry.push_back(q.y); rz.push_back(q.z); rw.push_back(q.w);
+				sx.push_back(s.x); sy.push_back(s.y); sz.push_back(s.z);
+			}
+		}
+
+		VulkanEngine::TransformStreams streams() const
+		{
+			return { px.data(), py.data(), pz.data(), rx.data(), ry.data(), rz.data(), rw.data(), sx.data(), sy.data(), sz.data() };
+		}
+
+		glm::mat4 compose(uint32_t i) const
+		{
+			return glm::translate(glm::mat4(1.0f), positions[i]) * glm::mat4_cast(rotations[i]) * glm::scale(glm::mat4(1.0f), scales[i]);
+		}
+	};
+
+	//breadth first: 16 roots, then every node's parent sits in the level before it
+	struct Hierarchy
+	{
+		std::vector<uint32_t> parents;
+		std::vector<uint32_t> levelStarts;
+
+		explicit Hierarchy(uint32_t count)
+		{
+			std::mt19937 random(5678);
+			uint32_t levelStart = 0;
+			uint32_t levelEnd = std::min(16u, count);
+			parents.assign(levelEnd, 0);
+			for (uint32_t i = 0; i < levelEnd; i++)
+			{
+				parents[i] = i;
+			}
+			while (levelEnd < count)
+			{
+				levelStarts.push_back(levelEnd);
+				uint32_t nextEnd = std::min(levelEnd + (levelEnd - levelStart) * 4, count);
+				std::uniform_int_distribution<uint32_t> parent(levelStart, levelEnd - 1);
+				for (uint32_t i = levelEnd; i < nextEnd; i++)
+				{
+					parents.push_back(parent(random));
+				}
+				levelStart = levelEnd;
+				levelEnd = nextEnd;
+			}
+			levelStarts.push_back(count);
+		}
+	};
+
+	//relative to the element size, translations reach a few hundred units after a few levels
+	uint32_t countMismatches(const float* matrices, const std::vector<glm::mat4>& expected)
+	{
+		uint32_t mismatches = 0;
+		for (size_t i = 0; i < expected.size(); i++)
+		{
+			for (int column = 0; column < 4; column++)
+			{
+				for (int row = 0; row < 4; row++)
+				{
+					float want = expected[i][column][row];
+					float got = matrices[i * 16 + column * 4 + row];
+					if (std::abs(got - want) > EPSILON * std::max(1.0f, std::abs(want)))
+					{
+						mismatches++;
+					}
+				}
+			}
+		}
+		return mismatches;
+	}
+
+	void composeReference(const Transforms& transforms, const Hierarchy& hierarchy, std::vector<glm::mat4>& local, std::vector<glm::mat4>& world)
+	{
+		for (uint32_t i = 0; i < local.size(); i++)
+		{
+			local[i] = transforms.compose(i);
+		}
+		for (uint32_t i = 0; i < world.size(); i++)
+		{
+			world[i] = hierarchy.parents[i] == i ? local[i] : world[hierarchy.parents[i]] * local[i];
+		}
+	}
+
+	void multiplyLevels(float* matrices, const Hierarchy& hierarchy, bool scalar)
+	{
+		for (size_t level = 0; level + 1 < hierarchy.levelStarts.size(); level++)
+		{
+			uint32_t first = hierarchy.levelStarts[level];
+			uint32_t count = hierarchy.levelStarts[level + 1] - first;
+			if (scalar)
+			{
+				VulkanEngine::MatrixKernels::multiplyParentsScalar(matrices, hierarchy.parents.data(), first, count);
+			}
+			else
+			{
+				VulkanEngine::MatrixKernels::multiplyParents(matrices, hierarchy.parents.data(), first, count);
+			}
+		}
+	}
+
+	void testAgainstGlm()
+	{
+		//not a multiple of any vector width, so the tail loops run as well
+		const uint32_t count = 1003;
+		Transforms transforms(count);
+		Hierarchy hierarchy(count);
+		std::vector<glm::mat4> local(count);
+		std::vector<glm::mat4> world(count);
+		composeReference(transforms, hierarchy, local, world);
+
+		for (bool scalar : { false, true })
+		{
+			std::vector<float> matrices(count * 16);
+			if (scalar)
+			{
+				VulkanEngine::MatrixKernels::composeTRSScalar(transforms.streams(), 0, count, matrices.data());
+			}
+			else
+			{
+				//in two uneven ranges, first is not always lane aligned
+				VulkanEngine::MatrixKernels::composeTRS(transforms.streams(), 0, 5, matrices.data());
+				VulkanEngine::MatrixKernels::composeTRS(transforms.streams(), 5, count - 5, matrices.data());
+			}
+			CHECK(countMismatches(matrices.data(), local) == 0);
+
+			multiplyLevels(matrices.data(), hierarchy, scalar);
+			CHECK(countMismatches(matrices.data(), world) == 0);
+		}
+	}
+
+	void testStoreMatrices()
+	{
+		struct Object
+		{
+			float model[16];
+			uint32_t extra[4];
+		};
+
+		const uint32_t count = 37;
+		std::vector<float> matrices(count * 16);
+		for (size_t i = 0; i < matrices.size(); i++)
+		{
+			matrices[i] = float(i);
+		}
+		std::vector<uint32_t> indices(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			indices[i] = (i * 7) % count;
+		}
+
+		//the rest of each object is left alone
+		std::vector<Object> objects(count);
+		for (auto& object : objects)
+		{
+			std::memset(object.extra, 0xab, sizeof(object.extra));
+		}
+		VulkanEngine::MatrixKernels::storeMatrices(matrices.data(), indices.data(), count, objects.data(), sizeof(Object));
+
+		uint32_t wrong = 0;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			wrong += std::memcmp(objects[i].model, &matrices[indices[i] * 16], sizeof(objects[i].model)) == 0 ? 0 : 1;
+			wrong += objects[i].extra[3] == 0xabababab ? 0 : 1;
+		}
+		CHECK(wrong == 0);
+	}
+
+	double elapsedMs(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	void benchmark()
+	{
+		const uint32_t count = 100000;
+		const int repeats = 20;
+		Transforms transforms(count);
+		Hierarchy hierarchy(count);
+
+		std::vector<glm::mat4> local(count);
+		std::vector<glm::mat4> world(count);
+		auto start = Clock::now();
+		for (int i = 0; i < repeats; i++)
+		{
+			composeReference(transforms, hierarchy, local, world);
+		}
+		double glmMs = elapsedMs(start) / repeats;
+
+		std::vector<float> matrices(count * 16);
+		start = Clock::now();
+		for (int i = 0; i < repeats; i++)
+		{
+			VulkanEngine::MatrixKernels::composeTRSScalar(transforms.streams(), 0, count, matrices.data());
+			multiplyLevels(matrices.data(), hierarchy, true);
+		}
+		double scalarMs = elapsedMs(start) / repeats;
+
+		start = Clock::now();
+		for (int i = 0; i < repeats; i++)
+		{
+			VulkanEngine::MatrixKernels::composeTRS(transforms.streams(), 0, count, matrices.data());
+			multiplyLevels(matrices.data(), hierarchy, false);
+		}
+		double kernelMs = elapsedMs(start) / repeats;
+		//keeps the timed loops from being optimised away
+		CHECK(countMismatches(matrices.data(), world) == 0);
+
+		std::cout << count << " transforms, compose and multiply: glm per object " << glmMs << "ms, scalar kernels " << scalarMs
+			<< "ms, " << VulkanEngine::MatrixKernels::getInstructionSet() << " kernels " << kernelMs << "ms ("
+			<< glmMs / kernelMs << "x)" << std::endl;
+	}
+}
+
+int main()
+{
+	if (!cpuRunsThisBuild())
+	{
+		std::cout << "skipped, the CPU lacks the instruction set this build targets" << std::endl;
+		return SKIP_RETURN_CODE;
+	}
+#if defined(__AVX2__)
+	CHECK(std::string(VulkanEngine::MatrixKernels::getInstructionSet()) == "AVX2");
+#endif
+
+	testAgainstGlm();
+	testStoreMatrices();
+	benchmark();
+	return testResult();
+}
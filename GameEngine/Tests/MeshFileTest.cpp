@@ -0,0 +1,97 @@
+// MeshFileTest : writes small meshes with MeshFile::write and reads them back, then checks that
+// read rejects files whose indices, meshlet vertices or meshlet triangles point outside the mesh.
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include "Core/MeshFile.h"
+#include "TestCheck.h"
+
+namespace
+{
+	//a quad of two triangles as one level, one submesh and one meshlet
+	VulkanEngine::MeshData makeQuad()
+	{
+		VulkanEngine::MeshData mesh;
+		const float corners[4][2] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f } };
+		for (const auto& corner : corners)
+		{
+			VulkanEngine::MeshVertex vertex{};
+			vertex.position[0] = corner[0];
+			vertex.position[1] = corner[1];
+			vertex.normal[2] = 1.0f;
+			mesh.vertices.owned.push_back(vertex);
+		}
+		mesh.indices.owned = { 0, 1, 2, 0, 2, 3 };
+		mesh.lods.push_back({ 0, 6, 0, 1, 0.0f });
+		mesh.submeshes.push_back({ 0, 0, 6, 0, {} });
+
+		VulkanEngine::Meshlet meshlet{};
+		meshlet.vertexCount = 4;
+		meshlet.triangleCount = 2;
+		meshlet.coneCutoff = 1.0f;
+		mesh.meshlets.push_back(meshlet);
+		mesh.meshletVertices.owned = { 0, 1, 2, 3 };
+		mesh.meshletTriangles.owned = { 0, 1, 2, 0, 2, 3, 0, 0 };
+		mesh.computeBounds();
+		return mesh;
+	}
+
+	std::string tempPath(const char* name)
+	{
+		return (std::filesystem::temp_directory_path() / (std::string(name) + VulkanEngine::MeshFile::EXTENSION)).string();
+	}
+
+	void testRoundTrip()
+	{
+		std::string path = tempPath("MeshFileTest_quad");
+		VulkanEngine::MeshFile::write(path, makeQuad());
+		{
+			VulkanEngine::MeshData mesh = VulkanEngine::MeshFile::read(path);
+			CHECK(mesh.vertices.size() == 4);
+			CHECK(mesh.indices.size() == 6);
+			CHECK(mesh.indices[5] == 3);
+			CHECK(mesh.lods.size() == 1 && mesh.submeshes.size() == 1 && mesh.meshlets.size() == 1);
+			CHECK(mesh.meshletTriangles.size() == 8);
+		}
+		std::filesystem::remove(path);
+	}
+
+	//every file here passes the section and range checks, only the values are wrong
+	void testRejectsOutOfRangeValues()
+	{
+		std::string path = tempPath("MeshFileTest_broken");
+
+		VulkanEngine::MeshData mesh = makeQuad();
+		mesh.indices.owned[4] = 4;
+		VulkanEngine::MeshFile::write(path, mesh);
+		CHECK_THROWS(VulkanEngine::MeshFile::read(path));
+
+		mesh = makeQuad();
+		mesh.meshletVertices.owned[3] = 100;
+		VulkanEngine::MeshFile::write(path, mesh);
+		CHECK_THROWS(VulkanEngine::MeshFile::read(path));
+
+		mesh = makeQuad();
+		mesh.meshletTriangles.owned[5] = 4;
+		VulkanEngine::MeshFile::write(path, mesh);
+		CHECK_THROWS(VulkanEngine::MeshFile::read(path));
+
+		//an empty level table is read without copying anything, then rejected
+		mesh = makeQuad();
+		mesh.lods.clear();
+		mesh.submeshes.clear();
+		mesh.meshlets.clear();
+		VulkanEngine::MeshFile::write(path, mesh);
+		CHECK_THROWS(VulkanEngine::MeshFile::read(path));
+
+		std::filesystem::remove(path);
+	}
+}
+
+int main()
+{
+	testRoundTrip();
+	testRejectsOutOfRangeValues();
+	return testResult();
+}
@@ -0,0 +1,519 @@
+// RenderGraphTest : compiles small graphs and checks which passes are culled, the barriers recorded
+// in front of each pass, transient aliasing and the async compute split. Barriers are captured by
+// a fake vkCmdPipelineBarrier2, transient images come from fake TransientImageCallbacks.
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "VulkanCore/RenderGraph.h"
+#include "TestCheck.h"
+
+namespace
+{
+	template<typename T>
+	T fakeHandle(uintptr_t value)
+	{
+		return reinterpret_cast<T>(value);
+	}
+
+	const VkCommandBuffer GRAPHICS_COMMANDS = fakeHandle<VkCommandBuffer>(0x10);
+	const VkCommandBuffer COMPUTE_COMMANDS = fakeHandle<VkCommandBuffer>(0x20);
+
+	//one barrier batch, tagged with the pass recorded after it ("" for the final batch)
+	struct RecordedBarriers
+	{
+		std::string beforePass;
+		VkCommandBuffer commandBuffer;
+		std::vector<VkMemoryBarrier2> memory;
+		std::vector<VkImageMemoryBarrier2> images;
+	};
+
+	//a plain function pointer cannot capture, the fake records into this
+	std::vector<RecordedBarriers>& recorded()
+	{
+		static std::vector<RecordedBarriers> batches;
+		return batches;
+	}
+
+	void VKAPI_CALL fakePipelineBarrier2(VkCommandBuffer commandBuffer, const VkDependencyInfo* dependency)
+	{
+		RecordedBarriers batch;
+		batch.commandBuffer = commandBuffer;
+		batch.memory.assign(dependency->pMemoryBarriers, dependency->pMemoryBarriers + dependency->memoryBarrierCount);
+		batch.images.assign(dependency->pImageMemoryBarriers, dependency->pImageMemoryBarriers + dependency->imageMemoryBarrierCount);
+		recorded().push_back(batch);
+	}
+
+	//passes log themselves, which tags the batch recorded just before them
+	struct PassLog
+	{
+		std::vector<std::pair<std::string, VkCommandBuffer>> runs;
+
+		std::function<void(VkCommandBuffer)> pass(const char* name)
+		{
+			return [this, name](VkCommandBuffer commandBuffer)
+			{
+				runs.emplace_back(name, commandBuffer);
+				if (!recorded().empty() && recorded().back().beforePass.empty())
+				{
+					recorded().back().beforePass = name;
+				}
+			};
+		}
+	};
+
+	//the barriers recorded right before a pass, empty when it had none
+	const RecordedBarriers* barriersBefore(const std::string& pass)
+	{
+		for (const auto& batch : recorded())
+		{
+			if (batch.beforePass == pass)
+			{
+				return &batch;
+			}
+		}
+		return nullptr;
+	}
+
+	//memory blocks from a fake driver, enough for the transient images
+	struct FakeMemory
+	{
+		std::vector<std::vector<char>> blocks;
+		uintptr_t nextHandle = 1;
+
+		VulkanEngine::GpuMemoryCallbacks callbacks()
+		{
+			VulkanEngine::GpuMemoryCallbacks callbacks;
+			callbacks.allocate = [this](uint32_t, VkDeviceSize size, VkDeviceMemory* memory)
+			{
+				blocks.emplace_back(static_cast<size_t>(size));
+				*memory = fakeHandle<VkDeviceMemory>(nextHandle++);
+				return VK_SUCCESS;
+			};
+			callbacks.free = [](VkDeviceMemory) {};
+			callbacks.map = [](VkDeviceMemory) { return static_cast<void*>(nullptr); };
+			return callbacks;
+		}
+
+		static VkPhysicalDeviceMemoryProperties memoryTable()
+		{
+			VkPhysicalDeviceMemoryProperties properties{};
+			properties.memoryHeapCount = 1;
+			properties.memoryHeaps[0].size = 1024ull * 1024 * 1024;
+			properties.memoryTypeCount = 1;
+			properties.memoryTypes[0].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+			return properties;
+		}
+	};
+
+	//transient images the graph created, by handle
+	struct FakeImages
+	{
+		struct Image
+		{
+			VkImageCreateInfo info;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize offset = 0;
+		};
+		std::map<VkImage, Image> images;
+		uintptr_t nextHandle = 0x1000;
+
+		VulkanEngine::TransientImageCallbacks callbacks()
+		{
+			VulkanEngine::TransientImageCallbacks callbacks;
+			callbacks.createImage = [this](const VkImageCreateInfo& info, VkImage* image)
+			{
+				*image = fakeHandle<VkImage>(nextHandle++);
+				images[*image].info = info;
+				return VK_SUCCESS;
+			};
+			callbacks.getMemoryRequirements = [this](VkImage image, VkMemoryRequirements* requirements)
+			{
+				const VkImageCreateInfo& info = images.at(image).info;
+				requirements->size = VkDeviceSize(info.extent.width) * info.extent.height * 4;
+				requirements->alignment = 4096;
+				requirements->memoryTypeBits = 1;
+			};
+			callbacks.bindMemory = [this](VkImage image, VkDeviceMemory memory, VkDeviceSize offset)
+			{
+				images.at(image).memory = memory;
+				images.at(image).offset = offset;
+				return VK_SUCCESS;
+			};
+			callbacks.createView = [this](const VkImageViewCreateInfo&, VkImageView* view)
+			{
+				*view = fakeHandle<VkImageView>(nextHandle++);
+				return VK_SUCCESS;
+			};
+			return callbacks;
+		}
+	};
+
+	//allocator, deletion queue and transient images, none of them talking to a device
+	struct Fixture
+	{
+		FakeMemory memory;
+		FakeImages images;
+		VulkanEngine::GpuAllocator allocator{ FakeMemory::memoryTable(), memory.callbacks() };
+		VulkanEngine::DeletionQueue deletionQueue{ &allocator, fakeDeletion() };
+		PassLog log;
+
+		static VulkanEngine::DeletionCallbacks fakeDeletion()
+		{
+			VulkanEngine::DeletionCallbacks callbacks;
+			callbacks.getCompletedValue = [](VkSemaphore) { return UINT64_MAX; };
+			callbacks.destroy = [](VkObjectType, uint64_t) {};
+			return callbacks;
+		}
+
+		VulkanEngine::RenderGraph makeGraph(std::optional<uint32_t> asyncComputeFamily = std::nullopt)
+		{
+			recorded().clear();
+			return VulkanEngine::RenderGraph(allocator, deletionQueue, images.callbacks(), asyncComputeFamily);
+		}
+	};
+
+	using Queue = VulkanEngine::RenderGraph::Queue;
+	using State = VulkanEngine::ResourceState;
+
+	const State COMPUTE_WRITE{ VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT };
+	const State VERTEX_READ{ VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT };
+	const State FRAGMENT_READ{ VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT };
+	const State INDIRECT_READ{ VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT };
+	const State COLOR_WRITE{ VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+	const State SAMPLED_READ{ VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT,
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	const State PRESENT{ 0, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR };
+
+	VkImage swapchainImage()
+	{
+		return fakeHandle<VkImage>(0x500);
+	}
+
+	//no passes at all, only the output transition is left to record
+	void testImportOnly()
+	{
+		Fixture fixture;
+		VulkanEngine::RenderGraph graph = fixture.makeGraph();
+		graph.setPipelineBarrier2(fakePipelineBarrier2);
+		auto color = graph.importImage("color", swapchainImage(), VK_IMAGE_ASPECT_COLOR_BIT,
+			{ VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+		graph.importBuffer("unused");
+		graph.setOutput(color, PRESENT);
+		graph.compile();
+		graph.execute(GRAPHICS_COMMANDS);
+
+		CHECK(!graph.hasAsyncWork());
+		CHECK(graph.getTransientMemorySize() == 0);
+		CHECK(fixture.images.images.empty());
+		CHECK(recorded().size() == 1);
+		if (recorded().size() == 1 && recorded()[0].images.size() == 1)
+		{
+			CHECK(recorded()[0].images[0].oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+			CHECK(recorded()[0].images[0].newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+		}
+	}
+
+	void testCulling()
+	{
+		Fixture fixture;
+		VulkanEngine::RenderGraph graph = fixture.makeGraph();
+		auto color = graph.importImage("color", swapchainImage(), VK_IMAGE_ASPECT_COLOR_BIT, {});
+		auto data = graph.importBuffer("data");
+		auto scratch = graph.importBuffer("scratch");
+		auto unusedTransient = graph.createImage("unusedTransient", { VK_FORMAT_R8G8B8A8_UNORM, { 64, 64 }, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT });
+
+		//nobody reads scratch or the transient
+		graph.addPass("unread", Queue::Graphics, fixture.log.pass("unread"))
+			.write(scratch, COMPUTE_WRITE)
+			.write(unusedTransient, COLOR_WRITE, true);
+		graph.addPass("produce", Queue::Graphics, fixture.log.pass("produce")).write(data, COMPUTE_WRITE);
+		//the draw discards color, whatever was drawn into it before is dead
+		graph.addPass("stale", Queue::Graphics, fixture.log.pass("stale")).write(color, COLOR_WRITE);
+		graph.addPass("draw", Queue::Graphics, fixture.log.pass("draw"))
+			.read(data, VERTEX_READ)
+			.write(color, COLOR_WRITE, true);
+		graph.addPass("readback", Queue::Graphics, fixture.log.pass("readback")).setSideEffects();
+		graph.setOutput(color, PRESENT);
+		graph.compile();
+
+		CHECK(graph.isPassCulled("unread"));
+		CHECK(!graph.isPassCulled("produce"));
+		CHECK(graph.isPassCulled("stale"));
+		CHECK(!graph.isPassCulled("draw"));
+		CHECK(!graph.isPassCulled("readback"));
+		CHECK(graph.isPassCulled("not a pass"));
+		//its only user was culled, so it was never created
+		CHECK(fixture.images.images.empty());
+		CHECK(graph.getImage(unusedTransient) == VK_NULL_HANDLE);
+
+		graph.setPipelineBarrier2(fakePipelineBarrier2);
+		graph.execute(GRAPHICS_COMMANDS);
+		CHECK(fixture.log.runs.size() == 3);
+		if (fixture.log.runs.size() == 3)
+		{
+			CHECK(fixture.log.runs[0].first == "produce");
+			CHECK(fixture.log.runs[1].first == "draw");
+			CHECK(fixture.log.runs[2].first == "readback");
+		}
+	}
+
+	void testBufferBarriers()
+	{
+		Fixture fixture;
+		VulkanEngine::RenderGraph graph = fixture.makeGraph();
+		graph.setPipelineBarrier2(fakePipelineBarrier2);
+		auto data = graph.importBuffer("data");
+
+		graph.addPass("write", Queue::Graphics, fixture.log.pass("write")).write(data, COMPUTE_WRITE);
+		graph.addPass("readVertex", Queue::Graphics, fixture.log.pass("readVertex")).read(data, VERTEX_READ).setSideEffects();
+		//the same stage and access again, the barrier before readVertex already covers it
+		graph.addPass("readVertexAgain", Queue::Graphics, fixture.log.pass("readVertexAgain")).read(data, VERTEX_READ).setSideEffects();
+		//a new stage still needs the write made visible to it
+		graph.addPass("readFragment", Queue::Graphics, fixture.log.pass("readFragment")).read(data, FRAGMENT_READ).setSideEffects();
+		//write after read: waits for both readers and the last write
+		graph.addPass("rewrite", Queue::Graphics, fixture.log.pass("rewrite")).write(data, COMPUTE_WRITE);
+		graph.setOutput(data);
+		graph.compile();
+		graph.execute(GRAPHICS_COMMANDS);
+
+		//the buffer starts with no pending write
+		CHECK(barriersBefore("write") == nullptr);
+
+		const RecordedBarriers* readVertex = barriersBefore("readVertex");
+		CHECK(readVertex != nullptr && readVertex->memory.size() == 1 && readVertex->images.empty());
+		if (readVertex != nullptr && readVertex->memory.size() == 1)
+		{
+			CHECK(readVertex->memory[0].srcStageMask == VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+			CHECK(readVertex->memory[0].srcAccessMask == VK_ACCESS_2_SHADER_WRITE_BIT);
+			CHECK(readVertex->memory[0].dstStageMask == VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT);
+			CHECK(readVertex->memory[0].dstAccessMask == VK_ACCESS_2_SHADER_READ_BIT);
+		}
+
+		CHECK(barriersBefore("readVertexAgain") == nullptr);
+
+		const RecordedBarriers* readFragment = barriersBefore("readFragment");
+		CHECK(readFragment != nullptr && readFragment->memory.size() == 1);
+		if (readFragment != nullptr && readFragment->memory.size() == 1)
+		{
+			CHECK(readFragment->memory[0].srcStageMask == VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+			CHECK(readFragment->memory[0].dstStageMask == VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT);
+		}
+
+		const RecordedBarriers* rewrite = barriersBefore("rewrite");
+		CHECK(rewrite != nullptr && rewrite->memory.size() == 1);
+		if (rewrite != nullptr && rewrite->memory.size() == 1)
+		{
+			CHECK(rewrite->memory[0].srcStageMask == (VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT |
+				VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT));
+			CHECK(rewrite->memory[0].srcAccessMask == VK_ACCESS_2_SHADER_WRITE_BIT);
+			CHECK(rewrite->memory[0].dstStageMask == VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+			CHECK(rewrite->memory[0].dstAccessMask == VK_ACCESS_2_SHADER_WRITE_BIT);
+		}
+	}
+
+	void testImageLayouts()
+	{
+		Fixture fixture;
+		VulkanEngine::RenderGraph graph = fixture.makeGraph();
+		graph.setPipelineBarrier2(fakePipelineBarrier2);
+		//presented last frame
+		auto color = graph.importImage("color", swapchainImage(), VK_IMAGE_ASPECT_COLOR_BIT,
+			{ VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR });
+
+		graph.addPass("draw", Queue::Graphics, fixture.log.pass("draw")).write(color, COLOR_WRITE, true);
+		graph.setOutput(color, PRESENT);
+		graph.compile();
+		graph.execute(GRAPHICS_COMMANDS);
+
+		const RecordedBarriers* draw = barriersBefore("draw");
+		CHECK(draw != nullptr && draw->memory.empty() && draw->images.size() == 1);
+		if (draw != nullptr && draw->images.size() == 1)
+		{
+			const VkImageMemoryBarrier2& barrier = draw->images[0];
+			CHECK(barrier.image == swapchainImage());
+			CHECK(barrier.oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+			CHECK(barrier.newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+			CHECK(barrier.srcStageMask == VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+			CHECK(barrier.srcAccessMask == 0);
+			CHECK(barrier.dstStageMask == VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+			CHECK(barrier.dstAccessMask == VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+		}
+
+		//the final batch hands the image to the presentation engine
+		CHECK(!recorded().empty() && recorded().back().beforePass.empty());
+		if (!recorded().empty() && recorded().back().images.size() == 1)
+		{
+			const VkImageMemoryBarrier2& barrier = recorded().back().images[0];
+			CHECK(barrier.oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+			CHECK(barrier.newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+			CHECK(barrier.srcStageMask == VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+			CHECK(barrier.srcAccessMask == VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+		}
+	}
+
+	void testTransientAliasing()
+	{
+		Fixture fixture;
+		VulkanEngine::RenderGraph graph = fixture.makeGraph();
+		graph.setPipelineBarrier2(fakePipelineBarrier2);
+		auto color = graph.importImage("color", swapchainImage(), VK_IMAGE_ASPECT_COLOR_BIT, {});
+		VulkanEngine::TransientImageDesc desc{ VK_FORMAT_R8G8B8A8_UNORM, { 256, 256 },
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT };
+		auto first = graph.createImage("first", desc);
+		auto second = graph.createImage("second", desc);
+
+		//first lives in passes 0-1 and second in 2-3, so they can share one allocation
+		graph.addPass("writeFirst", Queue::Graphics, fixture.log.pass("writeFirst")).write(first, COLOR_WRITE);
+		graph.addPass("readFirst", Queue::Graphics, fixture.log.pass("readFirst")).read(first, SAMPLED_READ).write(color, COLOR_WRITE);
+		graph.addPass("writeSecond", Queue::Graphics, fixture.log.pass("writeSecond")).write(second, COLOR_WRITE);
+		graph.addPass("readSecond", Queue::Graphics, fixture.log.pass("readSecond")).read(second, SAMPLED_READ).write(color, COLOR_WRITE);
+		graph.setOutput(color);
+		graph.compile();
+		graph.execute(GRAPHICS_COMMANDS);
+
+		CHECK(fixture.images.images.size() == 2);
+		VkImage firstImage = graph.getImage(first);
+		VkImage secondImage = graph.getImage(second);
+		CHECK(firstImage != VK_NULL_HANDLE && secondImage != VK_NULL_HANDLE && firstImage != secondImage);
+		if (fixture.images.images.count(firstImage) == 1 && fixture.images.images.count(secondImage) == 1)
+		{
+			CHECK(fixture.images.images[firstImage].memory == fixture.images.images[secondImage].memory);
+			CHECK(fixture.images.images[firstImage].offset == fixture.images.images[secondImage].offset);
+		}
+		CHECK(graph.getTransientRequestedSize() == 2 * 256 * 256 * 4);
+		CHECK(graph.getTransientMemorySize() == 256 * 256 * 4);
+
+		//first takes the memory over from second, which was last used by the frame before
+		const RecordedBarriers* writeFirst = barriersBefore("writeFirst");
+		CHECK(writeFirst != nullptr);
+		if (writeFirst != nullptr)
+		{
+			const VkImageMemoryBarrier2* barrier = nullptr;
+			for (const auto& image : writeFirst->images)
+			{
+				barrier = image.image == firstImage ? &image : barrier;
+			}
+			CHECK(barrier != nullptr);
+			if (barrier != nullptr)
+			{
+				CHECK(barrier->oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+				CHECK(barrier->srcStageMask == (VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT));
+				CHECK(barrier->srcAccessMask == VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+			}
+		}
+	}
+
+	void testSelfAliasedTransientWaitsForLastFrame()
+	{
+		Fixture fixture;
+		VulkanEngine::RenderGraph graph = fixture.makeGraph();
+		graph.setPipelineBarrier2(fakePipelineBarrier2);
+		auto color = graph.importImage("color", swapchainImage(), VK_IMAGE_ASPECT_COLOR_BIT, {});
+		auto temp = graph.createImage("temp", { VK_FORMAT_R16G16B16A16_SFLOAT, { 128, 128 },
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT });
+
+		graph.addPass("writeTemp", Queue::Graphics, fixture.log.pass("writeTemp")).write(temp, COLOR_WRITE);
+		graph.addPass("resolve", Queue::Graphics, fixture.log.pass("resolve")).read(temp, SAMPLED_READ).write(color, COLOR_WRITE);
+		graph.setOutput(color);
+		graph.compile();
+		graph.execute(GRAPHICS_COMMANDS);
+
+		//alone in its memory, so the frame before is the one to wait for: its write and its read
+		const RecordedBarriers* writeTemp = barriersBefore("writeTemp");
+		CHECK(writeTemp != nullptr && writeTemp->images.size() == 1);
+		if (writeTemp != nullptr && writeTemp->images.size() == 1)
+		{
+			const VkImageMemoryBarrier2& barrier = writeTemp->images[0];
+			CHECK(barrier.image == graph.getImage(temp));
+			CHECK(barrier.oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+			CHECK(barrier.newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+			CHECK(barrier.srcStageMask == (VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT));
+			CHECK(barrier.srcAccessMask == VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+		}
+
+		//and the read transitions it after the write
+		const RecordedBarriers* resolve = barriersBefore("resolve");
+		CHECK(resolve != nullptr);
+		if (resolve != nullptr)
+		{
+			bool found = false;
+			for (const auto& barrier : resolve->images)
+			{
+				if (barrier.image == graph.getImage(temp))
+				{
+					found = true;
+					CHECK(barrier.oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+					CHECK(barrier.newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+					CHECK(barrier.srcAccessMask == VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+					CHECK(barrier.dstStageMask == VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT);
+				}
+			}
+			CHECK(found);
+		}
+	}
+
+	void testAsyncCompute()
+	{
+		for (bool hasComputeQueue : { true, false })
+		{
+			Fixture fixture;
+			VulkanEngine::RenderGraph graph = fixture.makeGraph(hasComputeQueue ? std::optional<uint32_t>(1) : std::nullopt);
+			graph.setPipelineBarrier2(fakePipelineBarrier2);
+			auto color = graph.importImage("color", swapchainImage(), VK_IMAGE_ASPECT_COLOR_BIT, {});
+			auto draws = graph.importBuffer("draws");
+			auto counts = graph.importBuffer("counts");
+
+			graph.addPass("cull", Queue::AsyncCompute, fixture.log.pass("cull")).write(draws, COMPUTE_WRITE);
+			//images stay on the graphics queue
+			graph.addPass("clearColor", Queue::AsyncCompute, fixture.log.pass("clearColor")).write(color, COLOR_WRITE, true);
+			graph.addPass("draw", Queue::Graphics, fixture.log.pass("draw"))
+				.read(draws, INDIRECT_READ)
+				.write(counts, COMPUTE_WRITE)
+				.write(color, COLOR_WRITE);
+			//counts was touched by graphics already
+			graph.addPass("sumCounts", Queue::AsyncCompute, fixture.log.pass("sumCounts")).read(counts, VERTEX_READ).setSideEffects();
+			graph.setOutput(color);
+			graph.compile();
+
+			CHECK(graph.hasAsyncWork() == hasComputeQueue);
+			CHECK(graph.getAsyncWaitStages() == (hasComputeQueue ? VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT : 0));
+
+			if (hasComputeQueue)
+			{
+				CHECK_THROWS(graph.execute(GRAPHICS_COMMANDS));
+				fixture.log.runs.clear();
+				recorded().clear();
+			}
+			graph.execute(GRAPHICS_COMMANDS, hasComputeQueue ? COMPUTE_COMMANDS : VK_NULL_HANDLE);
+
+			std::map<std::string, VkCommandBuffer> ranOn(fixture.log.runs.begin(), fixture.log.runs.end());
+			CHECK(ranOn.size() == 4);
+			CHECK(ranOn["cull"] == (hasComputeQueue ? COMPUTE_COMMANDS : GRAPHICS_COMMANDS));
+			CHECK(ranOn["clearColor"] == GRAPHICS_COMMANDS);
+			CHECK(ranOn["draw"] == GRAPHICS_COMMANDS);
+			CHECK(ranOn["sumCounts"] == GRAPHICS_COMMANDS);
+
+			//the semaphore orders draw after cull, on one queue a barrier has to
+			const RecordedBarriers* draw = barriersBefore("draw");
+			bool waitsForCull = draw != nullptr && !draw->memory.empty() &&
+				(draw->memory[0].srcStageMask & VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT) != 0 &&
+				(draw->memory[0].dstStageMask & VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT) != 0;
+			CHECK(waitsForCull == !hasComputeQueue);
+		}
+	}
+}
+
+int main()
+{
+	testImportOnly();
+	testCulling();
+	testBufferBarriers();
+	testImageLayouts();
+	testTransientAliasing();
+	testSelfAliasedTransientWaitsForLastFrame();
+	testAsyncCompute();
+	return testResult();
+}
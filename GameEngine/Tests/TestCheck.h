@@ -0,0 +1,57 @@
+#ifndef TESTCHECK_H
+#define TESTCHECK_H
+
+
+#include <iostream>
+
+
+//failed checks are counted, not fatal, so one run reports all of them.
+//main returns testResult(), which CTest reads as pass or fail
+inline int& testFailureCount()
+{
+	static int failures = 0;
+	return failures;
+}
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" << #condition << ") failed" << std::endl; \
+			testFailureCount()++; \
+		} \
+	} while (false)
+
+//for code that has to throw std::exception, e.g. on a bad argument
+#define CHECK_THROWS(statement) \
+	do \
+	{ \
+		bool thrown = false; \
+		try \
+		{ \
+			statement; \
+		} \
+		catch (const std::exception&) \
+		{ \
+			thrown = true; \
+		} \
+		if (!thrown) \
+		{ \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": " << #statement << " did not throw" << std::endl; \
+			testFailureCount()++; \
+		} \
+	} while (false)
+
+inline int testResult()
+{
+	if (testFailureCount() > 0)
+	{
+		std::cerr << testFailureCount() << " check(s) failed" << std::endl;
+		return 1;
+	}
+	std::cout << "all checks passed" << std::endl;
+	return 0;
+}
+
+#endif //TESTCHECK_H
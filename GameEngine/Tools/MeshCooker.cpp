@@ -0,0 +1,148 @@
+// MeshCooker : offline tool turning OBJ models into the engine's cooked mesh files.
+//
+//   MeshCooker [--output DIR] [--no-optimize] [--benchmark] MODEL.obj...
+//
+//   --output DIR    where the files go, created if missing, default next to each model
+//   --no-optimize   keep the OBJ's order and build no meshlets, the engine does both at load time
+//   --benchmark     after cooking, time loading each model as OBJ and as a mesh file
+//
+// Each model is written as NAME.vmsh, the engine draws it with --mesh NAME.vmsh. Optimizing
+// reports the post-transform cache before and after, see Core/MeshOptimizer.h, and splits the
+// optimized order into meshlets for --meshlets, see Core/MeshletBuilder.h.
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Core/MeshData.h"
+#include "Core/MeshFile.h"
+#include "Core/MeshOptimizer.h"
+#include "Core/MeshletBuilder.h"
+
+namespace
+{
+	double millisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	//what the engine does with a loaded mesh before the GPU sees it: copy both streams into staging
+	double copyStreams(const VulkanEngine::MeshData& mesh, std::vector<uint8_t>& staging)
+	{
+		staging.resize(mesh.vertices.byteSize() + mesh.indices.byteSize());
+		auto start = std::chrono::steady_clock::now();
+		memcpy(staging.data(), mesh.vertices.data(), mesh.vertices.byteSize());
+		memcpy(staging.data() + mesh.vertices.byteSize(), mesh.indices.data(), mesh.indices.byteSize());
+		return millisecondsSince(start);
+	}
+
+	void benchmark(const std::string& model, const std::string& cooked)
+	{
+		auto start = std::chrono::steady_clock::now();
+		VulkanEngine::MeshData parsed = VulkanEngine::MeshData::loadObj(model);
+		double parseMs = millisecondsSince(start);
+
+		start = std::chrono::steady_clock::now();
+		VulkanEngine::MeshData mapped = VulkanEngine::MeshFile::read(cooked);
+		double readMs = millisecondsSince(start);
+
+		//the first copy out of the mapping pays for the page faults, that is part of loading
+		std::vector<uint8_t> staging;
+		double mappedCopyMs = copyStreams(mapped, staging);
+		double ownedCopyMs = copyStreams(parsed, staging);
+
+		double megabytes = staging.size() / (1024.0 * 1024.0);
+		std::cout << "  obj parse " << parseMs << "ms, mesh file read " << readMs << "ms" << std::endl;
+		std::cout << "  copy to staging: " << megabytes * 1000.0 / std::max(mappedCopyMs, 1e-6) << "MB/s from the mapping, "
+			<< megabytes * 1000.0 / std::max(ownedCopyMs, 1e-6) << "MB/s from memory" << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string outputDirectory;
+	bool runBenchmark = false;
+	bool optimize = true;
+	std::vector<std::string> inputs;
+
+	try
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			std::string option = argv[i];
+			if (option == "--output")
+			{
+				if (i + 1 >= argc)
+				{
+					throw std::runtime_error("ERROR: " + option + " expects a value");
+				}
+				outputDirectory = argv[++i];
+			}
+			else if (option == "--no-optimize")
+			{
+				optimize = false;
+			}
+			else if (option == "--benchmark")
+			{
+				runBenchmark = true;
+			}
+			else if (option.rfind("--", 0) == 0)
+			{
+				throw std::runtime_error("ERROR: unknown option " + option);
+			}
+			else
+			{
+				inputs.push_back(option);
+			}
+		}
+		if (inputs.empty())
+		{
+			throw std::runtime_error("ERROR: no models given");
+		}
+		if (!outputDirectory.empty())
+		{
+			std::filesystem::create_directories(outputDirectory);
+		}
+
+		for (const auto& input : inputs)
+		{
+			auto start = std::chrono::steady_clock::now();
+			VulkanEngine::MeshData mesh = VulkanEngine::MeshData::loadObj(input);
+
+			std::string cacheReport;
+			if (optimize)
+			{
+				auto before = VulkanEngine::MeshOptimizer::analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+				VulkanEngine::MeshOptimizer::optimize(mesh);
+				auto after = VulkanEngine::MeshOptimizer::analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+				cacheReport = ", ACMR " + std::to_string(before.acmr) + " -> " + std::to_string(after.acmr) +
+					", ATVR " + std::to_string(before.atvr) + " -> " + std::to_string(after.atvr);
+				//after optimizing, meshlets follow the index order
+				VulkanEngine::MeshletBuilder::build(mesh);
+				cacheReport += ", " + std::to_string(mesh.meshlets.size()) + " meshlets";
+			}
+
+			std::filesystem::path inputPath(input);
+			std::filesystem::path directory = outputDirectory.empty() ? inputPath.parent_path() : std::filesystem::path(outputDirectory);
+			std::filesystem::path output = directory / (inputPath.stem().string() + VulkanEngine::MeshFile::EXTENSION);
+			VulkanEngine::MeshFile::write(output.string(), mesh);
+
+			std::cout << output.string() << ": " << mesh.vertices.size() << " vertices, " << mesh.indices.size() / 3 << " triangles, "
+				<< mesh.submeshes.size() << " submeshes" << cacheReport << ", " << millisecondsSince(start) << "ms" << std::endl;
+			if (runBenchmark)
+			{
+				benchmark(input, output.string());
+			}
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
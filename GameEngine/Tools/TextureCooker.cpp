@@ -0,0 +1,127 @@
+// TextureCooker : offline tool turning source images into the engine's cooked texture files.
+//
+//   TextureCooker [--format LIST] [--linear] [--output DIR] IMAGE...
+//
+//   --format LIST   comma separated, any of rgba8, bc1, bc3, bc5, bc7, default bc7
+//   --linear        the images are not colour (normal maps, masks), bc5 needs it
+//   --output DIR    where the files go, default next to each image
+//
+// Each image is written once per format as NAME.FORMAT.vtex; the engine picks the best one
+// the device can sample and falls back to the image itself.
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Core/BlockCompression.h"
+#include "Core/JobSystem.h"
+#include "Core/TextureData.h"
+#include "Core/TextureFile.h"
+
+namespace
+{
+	VulkanEngine::TextureFormat parseFormat(const std::string& name)
+	{
+		const VulkanEngine::TextureFormat formats[] = {
+			VulkanEngine::TextureFormat::Rgba8, VulkanEngine::TextureFormat::Bc1, VulkanEngine::TextureFormat::Bc3,
+			VulkanEngine::TextureFormat::Bc5, VulkanEngine::TextureFormat::Bc7
+		};
+		for (VulkanEngine::TextureFormat format : formats)
+		{
+			if (name == VulkanEngine::getFormatName(format))
+			{
+				return format;
+			}
+		}
+		throw std::runtime_error("ERROR: unknown texture format '" + name + "'");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<VulkanEngine::TextureFormat> formats;
+	bool srgb = true;
+	std::string outputDirectory;
+	std::vector<std::string> inputs;
+
+	try
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			std::string option = argv[i];
+			if ((option == "--format" || option == "--output") && i + 1 >= argc)
+			{
+				throw std::runtime_error("ERROR: " + option + " expects a value");
+			}
+
+			if (option == "--format")
+			{
+				std::string list = argv[++i];
+				for (size_t start = 0; start <= list.size();)
+				{
+					size_t end = std::min(list.find(',', start), list.size());
+					formats.push_back(parseFormat(list.substr(start, end - start)));
+					start = end + 1;
+				}
+			}
+			else if (option == "--linear")
+			{
+				srgb = false;
+			}
+			else if (option == "--output")
+			{
+				outputDirectory = argv[++i];
+			}
+			else if (option.rfind("--", 0) == 0)
+			{
+				throw std::runtime_error("ERROR: unknown option " + option);
+			}
+			else
+			{
+				inputs.push_back(option);
+			}
+		}
+		if (inputs.empty())
+		{
+			throw std::runtime_error("ERROR: no images given");
+		}
+		if (formats.empty())
+		{
+			formats.push_back(VulkanEngine::TextureFormat::Bc7);
+		}
+
+		VulkanEngine::JobSystem jobs;
+		for (const auto& input : inputs)
+		{
+			auto start = std::chrono::steady_clock::now();
+			VulkanEngine::TextureData texture = VulkanEngine::TextureData::loadFromFile(input, srgb);
+			texture.generateMips();
+
+			std::filesystem::path inputPath(input);
+			std::filesystem::path directory = outputDirectory.empty() ? inputPath.parent_path() : std::filesystem::path(outputDirectory);
+			std::string name = inputPath.filename().string();
+			name = name.substr(0, name.find('.'));
+
+			for (VulkanEngine::TextureFormat format : formats)
+			{
+				VulkanEngine::TextureData cooked = VulkanEngine::BlockCompression::compress(texture, format, &jobs);
+				std::filesystem::path output = directory / (name + "." + VulkanEngine::getFormatName(format) + VulkanEngine::TextureFile::EXTENSION);
+				VulkanEngine::TextureFile::write(output.string(), cooked);
+
+				auto end = std::chrono::steady_clock::now();
+				std::cout << output.string() << ": " << texture.width << "x" << texture.height << ", " << cooked.getMipCount() << " mips, "
+					<< texture.getSize() << " -> " << cooked.getSize() << " bytes, "
+					<< std::chrono::duration<double, std::milli>(end - start).count() << "ms" << std::endl;
+				start = end;
+			}
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -5,13 +5,16 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <vulkan/vulkan.h>
 #include <array>
+#include "Core/MeshData.h"
 
+//the layout of VulkanEngine::MeshVertex, so vertex streams from mesh files upload as they are
 struct Vertex
 {
-	//glm::vec3 position3d;
-	glm::vec2 position2d;
+	float position[3];
+	float normal[3];
+	float texCoord[2];
+	float color[3];
 
-	glm::vec3 color;
 	static VkVertexInputBindingDescription getBindingDescription()
 	{
 		VkVertexInputBindingDescription bindingDescription{};
@@ -22,20 +25,84 @@ struct Vertex
 		return bindingDescription;
 	}
 
-	static std::array<VkVertexInputAttributeDescription,2> getAttributeDescriptions()
+	static std::array<VkVertexInputAttributeDescription,4> getAttributeDescriptions()
 	{
-		std::array<VkVertexInputAttributeDescription, 2> descriptions{};
+		std::array<VkVertexInputAttributeDescription, 4> descriptions{};
 
 		descriptions[0].binding = 0;
 		descriptions[0].location = 0;
-		descriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-		descriptions[0].offset = offsetof(Vertex, position2d);
+		descriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+		descriptions[0].offset = offsetof(Vertex, position);
 
 		descriptions[1].binding = 0;
 		descriptions[1].location = 1;
 		descriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
 		descriptions[1].offset = offsetof(Vertex,color);
+
+		descriptions[2].binding = 0;
+		descriptions[2].location = 2;
+		descriptions[2].format = VK_FORMAT_R32G32B32_SFLOAT;
+		descriptions[2].offset = offsetof(Vertex, normal);
+
+		descriptions[3].binding = 0;
+		descriptions[3].location = 3;
+		descriptions[3].format = VK_FORMAT_R32G32_SFLOAT;
+		descriptions[3].offset = offsetof(Vertex, texCoord);
 		return descriptions;
 	}
 
-};
\ No newline at end of file
+};
+static_assert(sizeof(Vertex) == sizeof(VulkanEngine::MeshVertex), "Vertex has to match the mesh file vertex stream");
+static_assert(offsetof(Vertex, normal) == offsetof(VulkanEngine::MeshVertex, normal), "Vertex has to match the mesh file vertex stream");
+static_assert(offsetof(Vertex, texCoord) == offsetof(VulkanEngine::MeshVertex, texCoord), "Vertex has to match the mesh file vertex stream");
+static_assert(offsetof(Vertex, color) == offsetof(VulkanEngine::MeshVertex, color), "Vertex has to match the mesh file vertex stream");
+
+//the layout of VulkanEngine::QuantizedMeshVertex, 20 bytes instead of 44. Same locations as Vertex,
+//the vertex shader decodes the octahedral normal when its OCTAHEDRAL_NORMALS constant is set
+struct QuantizedVertex
+{
+	uint16_t position[4];
+	int16_t normal[2];
+	uint16_t texCoord[2];
+	uint8_t color[4];
+
+	static VkVertexInputBindingDescription getBindingDescription()
+	{
+		VkVertexInputBindingDescription bindingDescription{};
+		bindingDescription.binding = 0;
+		bindingDescription.stride = sizeof(QuantizedVertex);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		return bindingDescription;
+	}
+
+	static std::array<VkVertexInputAttributeDescription, 4> getAttributeDescriptions()
+	{
+		std::array<VkVertexInputAttributeDescription, 4> descriptions{};
+
+		descriptions[0].binding = 0;
+		descriptions[0].location = 0;
+		descriptions[0].format = VK_FORMAT_R16G16B16A16_SFLOAT;
+		descriptions[0].offset = offsetof(QuantizedVertex, position);
+
+		descriptions[1].binding = 0;
+		descriptions[1].location = 1;
+		descriptions[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+		descriptions[1].offset = offsetof(QuantizedVertex, color);
+
+		descriptions[2].binding = 0;
+		descriptions[2].location = 2;
+		descriptions[2].format = VK_FORMAT_R16G16_SNORM;
+		descriptions[2].offset = offsetof(QuantizedVertex, normal);
+
+		descriptions[3].binding = 0;
+		descriptions[3].location = 3;
+		descriptions[3].format = VK_FORMAT_R16G16_SFLOAT;
+		descriptions[3].offset = offsetof(QuantizedVertex, texCoord);
+		return descriptions;
+	}
+};
+static_assert(sizeof(QuantizedVertex) == sizeof(VulkanEngine::QuantizedMeshVertex), "QuantizedVertex has to match MeshOptimizer::quantizeVertices");
+static_assert(offsetof(QuantizedVertex, normal) == offsetof(VulkanEngine::QuantizedMeshVertex, normal), "QuantizedVertex has to match MeshOptimizer::quantizeVertices");
+static_assert(offsetof(QuantizedVertex, texCoord) == offsetof(VulkanEngine::QuantizedMeshVertex, texCoord), "QuantizedVertex has to match MeshOptimizer::quantizeVertices");
+static_assert(offsetof(QuantizedVertex, color) == offsetof(VulkanEngine::QuantizedMeshVertex, color), "QuantizedVertex has to match MeshOptimizer::quantizeVertices");
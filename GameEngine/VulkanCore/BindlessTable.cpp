@@ -0,0 +1,262 @@
+#include "BindlessTable.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+
+namespace {
+    constexpr VkShaderStageFlags BINDLESS_STAGES = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+}
+
+
+VulkanEngine::BindlessTable::BindlessTable(VkPhysicalDevice physicalDevice, VkDevice device, DeletionQueue& deletionQueue,
+                                           BindlessCapacity capacity, VkShaderStageFlags additionalStages)
+    : mDevice(device), mDeletionQueue(deletionQueue) {
+    VkPhysicalDeviceVulkan12Properties properties12{};
+    properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &properties12;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+    // all three arrays are visible to the same stages, so the per stage limits apply as well
+    mImages.capacity = std::min({capacity.sampledImages, properties12.maxDescriptorSetUpdateAfterBindSampledImages,
+                                 properties12.maxPerStageDescriptorUpdateAfterBindSampledImages});
+    mSamplers.capacity = std::min({capacity.samplers, properties12.maxDescriptorSetUpdateAfterBindSamplers,
+                                   properties12.maxPerStageDescriptorUpdateAfterBindSamplers});
+    mBuffers.capacity = std::min({capacity.storageBuffers, properties12.maxDescriptorSetUpdateAfterBindStorageBuffers,
+                                  properties12.maxPerStageDescriptorUpdateAfterBindStorageBuffers});
+    uint32_t stageBudget = properties12.maxPerStageUpdateAfterBindResources;
+    if (mImages.capacity + mSamplers.capacity + mBuffers.capacity > stageBudget) {
+        // samplers are few, split what is left between images and buffers
+        mSamplers.capacity = std::min(mSamplers.capacity, stageBudget / 4);
+        mImages.capacity = std::min(mImages.capacity, (stageBudget - mSamplers.capacity) / 2);
+        mBuffers.capacity = std::min(mBuffers.capacity, stageBudget - mSamplers.capacity - mImages.capacity);
+    }
+
+    VkDescriptorSetLayoutBinding bindings[3]{};
+    bindings[0].binding = TEXTURE_BINDING;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    bindings[0].descriptorCount = mImages.capacity;
+    bindings[0].stageFlags = BINDLESS_STAGES | additionalStages;
+
+    bindings[1].binding = SAMPLER_BINDING;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+    bindings[1].descriptorCount = mSamplers.capacity;
+    bindings[1].stageFlags = BINDLESS_STAGES | additionalStages;
+
+    bindings[2].binding = BUFFER_BINDING;
+    bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[2].descriptorCount = mBuffers.capacity;
+    bindings[2].stageFlags = BINDLESS_STAGES | additionalStages;
+
+    // unused slots are never read, slots are written while other slots are in use by the gpu
+    VkDescriptorBindingFlags flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                     VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    VkDescriptorBindingFlags bindingFlags[3] = {flags, flags, flags};
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo{};
+    flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    flagsInfo.bindingCount = 3;
+    flagsInfo.pBindingFlags = bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = &flagsInfo;
+    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layoutInfo.bindingCount = 3;
+    layoutInfo.pBindings = bindings;
+
+    if (vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &mLayout) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create bindless descriptor set layout");
+    }
+
+    VkDescriptorPoolSize poolSizes[3]{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    poolSizes[0].descriptorCount = mImages.capacity;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_SAMPLER;
+    poolSizes[1].descriptorCount = mSamplers.capacity;
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[2].descriptorCount = mBuffers.capacity;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 3;
+    poolInfo.pPoolSizes = poolSizes;
+
+    if (vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &mPool) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create bindless descriptor pool");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = mPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &mLayout;
+
+    if (vkAllocateDescriptorSets(mDevice, &allocInfo, &mSet) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to allocate bindless descriptor set");
+    }
+}
+
+
+VulkanEngine::BindlessTable::~BindlessTable() {
+    // frees the set along with the pool
+    if (mPool != VK_NULL_HANDLE) {
+        vkDestroyDescriptorPool(mDevice, mPool, nullptr);
+    }
+    if (mLayout != VK_NULL_HANDLE) {
+        vkDestroyDescriptorSetLayout(mDevice, mLayout, nullptr);
+    }
+}
+
+
+bool
+VulkanEngine::BindlessTable::isSupported(const VkPhysicalDeviceVulkan12Features& features) {
+    return features.descriptorIndexing &&
+           features.runtimeDescriptorArray &&
+           features.descriptorBindingPartiallyBound &&
+           features.descriptorBindingUpdateUnusedWhilePending &&
+           features.descriptorBindingSampledImageUpdateAfterBind &&
+           features.descriptorBindingStorageBufferUpdateAfterBind &&
+           features.shaderSampledImageArrayNonUniformIndexing &&
+           features.shaderStorageBufferArrayNonUniformIndexing;
+}
+
+
+void
+VulkanEngine::BindlessTable::enableFeatures(VkPhysicalDeviceVulkan12Features& features) {
+    features.descriptorIndexing = VK_TRUE;
+    features.runtimeDescriptorArray = VK_TRUE;
+    features.descriptorBindingPartiallyBound = VK_TRUE;
+    features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    features.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+}
+
+
+void
+VulkanEngine::BindlessTable::bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t setIndex) const {
+    vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout, setIndex, 1, &mSet, 0, nullptr);
+}
+
+
+uint32_t
+VulkanEngine::BindlessTable::addImage(VkImageView imageView, VkImageLayout layout) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    uint32_t index = allocateSlot(mImages, "image");
+
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.imageView = imageView;
+    imageInfo.imageLayout = layout;
+    write(TEXTURE_BINDING, index, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, &imageInfo, nullptr);
+    return index;
+}
+
+
+uint32_t
+VulkanEngine::BindlessTable::addSampler(VkSampler sampler) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    uint32_t index = allocateSlot(mSamplers, "sampler");
+
+    VkDescriptorImageInfo samplerInfo{};
+    samplerInfo.sampler = sampler;
+    write(SAMPLER_BINDING, index, VK_DESCRIPTOR_TYPE_SAMPLER, &samplerInfo, nullptr);
+    return index;
+}
+
+
+uint32_t
+VulkanEngine::BindlessTable::addStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    uint32_t index = allocateSlot(mBuffers, "storage buffer");
+
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = buffer;
+    bufferInfo.offset = offset;
+    bufferInfo.range = range;
+    write(BUFFER_BINDING, index, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, nullptr, &bufferInfo);
+    return index;
+}
+
+
+void
+VulkanEngine::BindlessTable::removeImage(uint32_t index) {
+    removeSlot(mImages, index);
+}
+
+
+void
+VulkanEngine::BindlessTable::removeSampler(uint32_t index) {
+    removeSlot(mSamplers, index);
+}
+
+
+void
+VulkanEngine::BindlessTable::removeStorageBuffer(uint32_t index) {
+    removeSlot(mBuffers, index);
+}
+
+
+uint32_t
+VulkanEngine::BindlessTable::allocateSlot(SlotPool& pool, const char* kind) {
+    uint32_t index = pool.allocate();
+    if (index == INVALID_INDEX) {
+        throw std::runtime_error(std::string("ERROR: bindless table is out of ") + kind + " slots");
+    }
+    return index;
+}
+
+
+void
+VulkanEngine::BindlessTable::removeSlot(SlotPool& pool, uint32_t index) {
+    if (index == INVALID_INDEX) {
+        return;
+    }
+    // the queue runs this after the frames that could read the slot, the table has to outlive it
+    mDeletionQueue.defer([this, &pool, index]() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        pool.free(index);
+    });
+}
+
+
+void
+VulkanEngine::BindlessTable::write(uint32_t binding, uint32_t index, VkDescriptorType type, const VkDescriptorImageInfo* imageInfo, const VkDescriptorBufferInfo* bufferInfo) {
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = mSet;
+    descriptorWrite.dstBinding = binding;
+    descriptorWrite.dstArrayElement = index;
+    descriptorWrite.descriptorType = type;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = imageInfo;
+    descriptorWrite.pBufferInfo = bufferInfo;
+    vkUpdateDescriptorSets(mDevice, 1, &descriptorWrite, 0, nullptr);
+}
+
+
+uint32_t
+VulkanEngine::BindlessTable::SlotPool::allocate() {
+    // recycled slots first, keeps the live range of the arrays short
+    if (!freeList.empty()) {
+        uint32_t index = freeList.back();
+        freeList.pop_back();
+        return index;
+    }
+    if (next < capacity) {
+        return next++;
+    }
+    return INVALID_INDEX;
+}
+
+
+void
+VulkanEngine::BindlessTable::SlotPool::free(uint32_t index) {
+    freeList.push_back(index);
+}
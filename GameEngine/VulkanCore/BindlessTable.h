@@ -0,0 +1,91 @@
+#ifndef BINDLESSTABLE_H
+#define BINDLESSTABLE_H
+
+
+#include <vector>
+#include <mutex>
+#include "vulkan/vulkan.h"
+#include "DeletionQueue.h"
+
+
+namespace VulkanEngine {
+
+    // Slots are clamped to what the device allows for update-after-bind descriptors.
+    struct BindlessCapacity
+    {
+        uint32_t sampledImages = 16384;
+        uint32_t samplers = 64;
+        uint32_t storageBuffers = 16384;
+    };
+
+// One update-after-bind descriptor set with every texture (binding 0), sampler (1) and storage
+// buffer (2), indexed from shaders by the slots add*() returned.
+class BindlessTable {
+public:
+    static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+    static constexpr uint32_t TEXTURE_BINDING = 0;
+    static constexpr uint32_t SAMPLER_BINDING = 1;
+    static constexpr uint32_t BUFFER_BINDING = 2;
+
+    // Visible to vertex, fragment and compute shaders plus additionalStages.
+    BindlessTable(VkPhysicalDevice physicalDevice, VkDevice device, DeletionQueue& deletionQueue,
+                  BindlessCapacity capacity = {}, VkShaderStageFlags additionalStages = 0);
+    ~BindlessTable();
+
+    BindlessTable(const BindlessTable&) = delete;
+    BindlessTable& operator=(const BindlessTable&) = delete;
+
+    static bool isSupported(const VkPhysicalDeviceVulkan12Features& features);
+    // Sets the features the table relies on, on top of whatever is already enabled.
+    static void enableFeatures(VkPhysicalDeviceVulkan12Features& features);
+
+    VkDescriptorSetLayout getLayout() const { return mLayout; }
+    VkDescriptorSet getSet() const { return mSet; }
+    void bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t setIndex) const;
+
+    uint32_t addImage(VkImageView imageView, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    uint32_t addSampler(VkSampler sampler);
+    uint32_t addStorageBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+
+    // The descriptor stays valid until the frames recorded so far are done, the resource
+    // itself has to be retired through the same DeletionQueue.
+    void removeImage(uint32_t index);
+    void removeSampler(uint32_t index);
+    void removeStorageBuffer(uint32_t index);
+
+    uint32_t getImageCapacity() const { return mImages.capacity; }
+    uint32_t getSamplerCapacity() const { return mSamplers.capacity; }
+    uint32_t getStorageBufferCapacity() const { return mBuffers.capacity; }
+
+private:
+    // Free-list index allocator, indices below next have been handed out at least once.
+    struct SlotPool
+    {
+        uint32_t capacity = 0;
+        uint32_t next = 0;
+        std::vector<uint32_t> freeList;
+
+        uint32_t allocate();
+        void free(uint32_t index);
+    };
+
+    uint32_t allocateSlot(SlotPool& pool, const char* kind);
+    void removeSlot(SlotPool& pool, uint32_t index);
+    void write(uint32_t binding, uint32_t index, VkDescriptorType type, const VkDescriptorImageInfo* imageInfo, const VkDescriptorBufferInfo* bufferInfo);
+
+    VkDevice mDevice;
+    DeletionQueue& mDeletionQueue;
+    VkDescriptorSetLayout mLayout = VK_NULL_HANDLE;
+    VkDescriptorPool mPool = VK_NULL_HANDLE;
+    VkDescriptorSet mSet = VK_NULL_HANDLE;
+
+    // vkUpdateDescriptorSets needs the set externally synchronized, the slot pools share the lock
+    std::mutex mMutex;
+    SlotPool mImages;
+    SlotPool mSamplers;
+    SlotPool mBuffers;
+};
+
+} // VulkanEngine
+
+#endif //BINDLESSTABLE_H
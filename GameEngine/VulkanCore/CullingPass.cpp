@@ -0,0 +1,347 @@
+#include "CullingPass.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+
+VulkanEngine::CullingPass::CullingPass(VkDevice device, GpuAllocator& allocator, const BindlessTable& bindless,
+                                       VkPipelineCache pipelineCache, const std::vector<char>& shaderCode,
+                                       uint32_t frameCount, uint32_t maxDraws, uint32_t sliceCount,
+                                       bool drawIndirectCount, bool multiDrawIndirect)
+    : mDevice(device), mAllocator(allocator), mBindless(bindless), mMaxDraws(maxDraws), mSliceCount(sliceCount),
+      mDrawIndirectCount(drawIndirectCount), mMultiDrawIndirect(multiDrawIndirect) {
+    mFrames.resize(frameCount);
+    for (auto& frame : mFrames) {
+        mAllocator.createBuffer(sizeof(VkDrawIndexedIndirectCommand) * mMaxDraws * 2,
+                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.drawBuffer, frame.drawAllocation);
+        mAllocator.createBuffer(sizeof(uint32_t) * getCountSize(),
+                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.countBuffer, frame.countAllocation);
+        mAllocator.createBuffer(sizeof(uint32_t) * mMaxDraws, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.stateBuffer, frame.stateAllocation);
+        mAllocator.createBuffer(sizeof(uint32_t) * getCountSize(), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                frame.readbackBuffer, frame.readbackAllocation);
+        std::memset(frame.readbackAllocation.mapped, 0, sizeof(uint32_t) * getCountSize());
+    }
+
+    createDescriptors(frameCount);
+    createPipeline(pipelineCache, shaderCode);
+}
+
+
+VulkanEngine::CullingPass::~CullingPass() {
+    vkDestroyPipeline(mDevice, mPipeline, nullptr);
+    vkDestroyPipelineLayout(mDevice, mPipelineLayout, nullptr);
+    vkDestroyDescriptorPool(mDevice, mDescriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(mDevice, mDescriptorSetLayout, nullptr);
+
+    for (auto& frame : mFrames) {
+        mAllocator.destroyBuffer(frame.drawBuffer, frame.drawAllocation);
+        mAllocator.destroyBuffer(frame.countBuffer, frame.countAllocation);
+        mAllocator.destroyBuffer(frame.stateBuffer, frame.stateAllocation);
+        mAllocator.destroyBuffer(frame.readbackBuffer, frame.readbackAllocation);
+    }
+}
+
+
+void
+VulkanEngine::CullingPass::setInputBuffers(VkBuffer buffer, VkDeviceSize frameDataRange, VkDeviceSize objectDataRange) {
+    VkDescriptorBufferInfo frameInfo{};
+    frameInfo.buffer = buffer;
+    frameInfo.offset = 0;
+    frameInfo.range = frameDataRange;
+
+    VkDescriptorBufferInfo objectInfo{};
+    objectInfo.buffer = buffer;
+    objectInfo.offset = 0;
+    objectInfo.range = objectDataRange;
+
+    std::vector<VkWriteDescriptorSet> writes;
+    for (auto& frame : mFrames) {
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = frame.descriptorSet;
+        write.descriptorCount = 1;
+
+        write.dstBinding = 0;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        write.pBufferInfo = &frameInfo;
+        writes.push_back(write);
+
+        write.dstBinding = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        write.pBufferInfo = &objectInfo;
+        writes.push_back(write);
+    }
+    vkUpdateDescriptorSets(mDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+
+void
+VulkanEngine::CullingPass::record(VkCommandBuffer commandBuffer, uint32_t frameIndex,
+                                  uint32_t frameDataOffset, uint32_t objectDataOffset, uint32_t objectCount,
+                                  Phase phase, const DepthPyramid* pyramid) {
+    FrameResources& frame = mFrames[frameIndex];
+    if (phase == Phase::Early) {
+        frame.objectCount = objectCount < mMaxDraws ? objectCount : mMaxDraws;
+        frame.sliceSize = (frame.objectCount + mSliceCount - 1) / mSliceCount;
+        frame.lateRecorded = false;
+
+        vkCmdFillBuffer(commandBuffer, frame.countBuffer, 0, VK_WHOLE_SIZE, 0);
+
+        VkBufferMemoryBarrier clearBarrier{};
+        clearBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        clearBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        clearBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        clearBarrier.buffer = frame.countBuffer;
+        clearBarrier.offset = 0;
+        clearBarrier.size = VK_WHOLE_SIZE;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                             0, nullptr, 1, &clearBarrier, 0, nullptr);
+    } else {
+        frame.lateRecorded = true;
+    }
+
+    uint32_t dynamicOffsets[] = { frameDataOffset, objectDataOffset };
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipelineLayout, 0, 1,
+                            &frame.descriptorSet, 2, dynamicOffsets);
+    mBindless.bind(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipelineLayout, 1);
+
+    PushConstants constants{};
+    constants.objectCount = frame.objectCount;
+    constants.sliceSize = frame.sliceSize;
+    constants.sliceCount = mSliceCount;
+    constants.compact = mDrawIndirectCount ? 1 : 0;
+    constants.phase = static_cast<uint32_t>(phase);
+    constants.drawOffset = phase == Phase::Late ? mMaxDraws : 0;
+    // the early phase of the first frame after the pyramid was (re)created has nothing to test against
+    constants.occlusion = pyramid != nullptr && (phase == Phase::Late || pyramid->hasHistory()) ? 1 : 0;
+    if (pyramid != nullptr) {
+        constants.pyramidIndex = pyramid->getBindlessIndex();
+        constants.pyramidLevels = pyramid->getLevelCount();
+        constants.depthWidth = static_cast<float>(pyramid->getDepthExtent().width);
+        constants.depthHeight = static_cast<float>(pyramid->getDepthExtent().height);
+    }
+    vkCmdPushConstants(commandBuffer, mPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+
+    vkCmdDispatch(commandBuffer, (frame.objectCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+}
+
+
+void
+VulkanEngine::CullingPass::draw(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t slice, Phase phase) const {
+    const FrameResources& frame = mFrames[frameIndex];
+    const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    bool late = phase == Phase::Late;
+
+    uint32_t first = slice * frame.sliceSize;
+    if (first >= frame.objectCount || (late && !frame.lateRecorded)) {
+        return;
+    }
+    uint32_t maxDraws = std::min(frame.sliceSize, frame.objectCount - first);
+    VkDeviceSize offset = (VkDeviceSize(late ? mMaxDraws : 0) + first) * stride;
+    VkDeviceSize countOffset = ((late ? mSliceCount : 0) + slice) * sizeof(uint32_t);
+
+    if (mDrawIndirectCount) {
+        vkCmdDrawIndexedIndirectCount(commandBuffer, frame.drawBuffer, offset, frame.countBuffer, countOffset, maxDraws, stride);
+    } else if (mMultiDrawIndirect) {
+        vkCmdDrawIndexedIndirect(commandBuffer, frame.drawBuffer, offset, maxDraws, stride);
+    } else {
+        for (uint32_t i = 0; i < maxDraws; i++) {
+            vkCmdDrawIndexedIndirect(commandBuffer, frame.drawBuffer, offset + i * stride, 1, stride);
+        }
+    }
+}
+
+
+void
+VulkanEngine::CullingPass::recordReadback(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+    FrameResources& frame = mFrames[frameIndex];
+    frame.pending = true;
+
+    VkBufferCopy copyRegion{};
+    copyRegion.size = sizeof(uint32_t) * getCountSize();
+    vkCmdCopyBuffer(commandBuffer, frame.countBuffer, frame.readbackBuffer, 1, &copyRegion);
+
+    VkMemoryBarrier readbackBarrier{};
+    readbackBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    readbackBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    readbackBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                         1, &readbackBarrier, 0, nullptr, 0, nullptr);
+}
+
+
+uint32_t
+VulkanEngine::CullingPass::getVisibleCount(uint32_t frameIndex) const {
+    const uint32_t* counts = static_cast<const uint32_t*>(mFrames[frameIndex].readbackAllocation.mapped);
+    uint32_t visible = 0;
+    for (uint32_t i = 0; i < mSliceCount * 2; i++) {
+        visible += counts[i];
+    }
+    return visible;
+}
+
+
+uint32_t
+VulkanEngine::CullingPass::getFrustumVisibleCount(uint32_t frameIndex) const {
+    const uint32_t* counters = static_cast<const uint32_t*>(mFrames[frameIndex].readbackAllocation.mapped) + mSliceCount * 2;
+    return counters[COUNTER_TESTED] - counters[COUNTER_FRUSTUM_CULLED];
+}
+
+
+void
+VulkanEngine::CullingPass::collect(uint32_t frameIndex) {
+    FrameResources& frame = mFrames[frameIndex];
+    if (!frame.pending) {
+        return;
+    }
+    frame.pending = false;
+
+    const uint32_t* counts = static_cast<const uint32_t*>(frame.readbackAllocation.mapped);
+    for (uint32_t i = 0; i < mSliceCount; i++) {
+        mStats.drawnEarly += counts[i];
+        mStats.drawnLate += counts[mSliceCount + i];
+    }
+    const uint32_t* counters = counts + mSliceCount * 2;
+    mStats.tested += counters[COUNTER_TESTED];
+    mStats.frustumCulled += counters[COUNTER_FRUSTUM_CULLED];
+    mStats.occlusionRetested += counters[COUNTER_OCCLUSION_RETESTED];
+    mStats.occlusionCulled += counters[COUNTER_OCCLUSION_CULLED];
+    mStats.frames++;
+}
+
+
+void
+VulkanEngine::CullingPass::createDescriptors(uint32_t frameCount) {
+    VkDescriptorSetLayoutBinding bindings[5]{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    bindings[2].binding = 2;
+    bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[3].binding = 3;
+    bindings[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[4].binding = 4;
+    bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    for (auto& binding : bindings) {
+        binding.descriptorCount = 1;
+        binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 5;
+    layoutInfo.pBindings = bindings;
+
+    if (vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &mDescriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create culling descriptor set layout");
+    }
+
+    VkDescriptorPoolSize poolSizes[3]{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSizes[0].descriptorCount = frameCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    poolSizes[1].descriptorCount = frameCount;
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[2].descriptorCount = frameCount * 3;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 3;
+    poolInfo.pPoolSizes = poolSizes;
+    poolInfo.maxSets = frameCount;
+
+    if (vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &mDescriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create culling descriptor pool");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(frameCount, mDescriptorSetLayout);
+    std::vector<VkDescriptorSet> sets(frameCount);
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = mDescriptorPool;
+    allocInfo.descriptorSetCount = frameCount;
+    allocInfo.pSetLayouts = layouts.data();
+
+    if (vkAllocateDescriptorSets(mDevice, &allocInfo, sets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to allocate culling descriptor sets");
+    }
+
+    std::vector<VkDescriptorBufferInfo> bufferInfos(frameCount * 3);
+    std::vector<VkWriteDescriptorSet> writes;
+    for (uint32_t i = 0; i < frameCount; i++) {
+        mFrames[i].descriptorSet = sets[i];
+
+        bufferInfos[i * 3] = { mFrames[i].drawBuffer, 0, VK_WHOLE_SIZE };
+        bufferInfos[i * 3 + 1] = { mFrames[i].countBuffer, 0, VK_WHOLE_SIZE };
+        bufferInfos[i * 3 + 2] = { mFrames[i].stateBuffer, 0, VK_WHOLE_SIZE };
+
+        for (uint32_t binding = 2; binding < 5; binding++) {
+            VkWriteDescriptorSet write{};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = sets[i];
+            write.dstBinding = binding;
+            write.descriptorCount = 1;
+            write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            write.pBufferInfo = &bufferInfos[i * 3 + binding - 2];
+            writes.push_back(write);
+        }
+    }
+    vkUpdateDescriptorSets(mDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+
+void
+VulkanEngine::CullingPass::createPipeline(VkPipelineCache pipelineCache, const std::vector<char>& shaderCode) {
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    VkDescriptorSetLayout setLayouts[] = { mDescriptorSetLayout, mBindless.getLayout() };
+
+    VkPipelineLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount = 2;
+    layoutInfo.pSetLayouts = setLayouts;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(mDevice, &layoutInfo, nullptr, &mPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create culling pipeline layout");
+    }
+
+    VkShaderModuleCreateInfo moduleInfo{};
+    moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleInfo.codeSize = shaderCode.size();
+    moduleInfo.pCode = reinterpret_cast<const uint32_t*>(shaderCode.data());
+
+    VkShaderModule shaderModule;
+    if (vkCreateShaderModule(mDevice, &moduleInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create culling shader module");
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = mPipelineLayout;
+
+    VkResult result = vkCreateComputePipelines(mDevice, pipelineCache, 1, &pipelineInfo, nullptr, &mPipeline);
+    vkDestroyShaderModule(mDevice, shaderModule, nullptr);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create culling pipeline");
+    }
+}
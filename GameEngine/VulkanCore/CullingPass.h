@@ -0,0 +1,142 @@
+#ifndef CULLINGPASS_H
+#define CULLINGPASS_H
+
+
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "GpuAllocator.h"
+#include "BindlessTable.h"
+#include "DepthPyramid.h"
+
+
+namespace VulkanEngine {
+
+// GPU-driven draw submission: Shader/cull.comp culls every object and writes an indirect draw per
+// survivor, drawn with one indirect call per slice. With a DepthPyramid the early phase also tests
+// against last frame's pyramid, the late phase retests what it hid against this frame's.
+class CullingPass {
+public:
+    static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+    enum class Phase
+    {
+        Early,
+        Late
+    };
+
+    // Totals over every frame collect() has seen.
+    struct CullingStats
+    {
+        uint64_t frames = 0;
+        uint64_t tested = 0;
+        uint64_t frustumCulled = 0;
+        // frustum visible but hidden by the previous frame's pyramid, tested again late
+        uint64_t occlusionRetested = 0;
+        // still hidden by the current frame's pyramid, never drawn
+        uint64_t occlusionCulled = 0;
+        uint64_t drawnEarly = 0;
+        uint64_t drawnLate = 0;
+    };
+
+    // set 1 of the pipeline is the bindless table, for the depth pyramid.
+    CullingPass(VkDevice device, GpuAllocator& allocator, const BindlessTable& bindless, VkPipelineCache pipelineCache,
+                const std::vector<char>& shaderCode, uint32_t frameCount, uint32_t maxDraws,
+                uint32_t sliceCount, bool drawIndirectCount, bool multiDrawIndirect);
+    ~CullingPass();
+
+    CullingPass(const CullingPass&) = delete;
+    CullingPass& operator=(const CullingPass&) = delete;
+
+    // Frame and object data come from the frame ring; offsets are supplied per frame in record().
+    void setInputBuffers(VkBuffer buffer, VkDeviceSize frameDataRange, VkDeviceSize objectDataRange);
+
+    // Outside of a render pass, the early phase first. The caller puts the barriers in front of
+    // draw(), the late phase and the readback.
+    void record(VkCommandBuffer commandBuffer, uint32_t frameIndex,
+                uint32_t frameDataOffset, uint32_t objectDataOffset, uint32_t objectCount,
+                Phase phase = Phase::Early, const DepthPyramid* pyramid = nullptr);
+    // Safe to call for different slices from several threads.
+    void draw(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t slice, Phase phase = Phase::Early) const;
+    // After the last phase and a barrier to transfer reads.
+    void recordReadback(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+    uint32_t getSliceCount() const { return mSliceCount; }
+
+    // From the last time this frame slot was recorded, once its timeline value has been reached.
+    uint32_t getVisibleCount(uint32_t frameIndex) const;
+    uint32_t getFrustumVisibleCount(uint32_t frameIndex) const;
+
+    // Adds the frame's counters to the totals, call once its timeline value has been reached.
+    void collect(uint32_t frameIndex);
+    const CullingStats& getStats() const { return mStats; }
+
+private:
+    // CountBuffer in cull.comp: the slice counters of both phases, then these
+    enum Counter : uint32_t
+    {
+        COUNTER_TESTED,
+        COUNTER_FRUSTUM_CULLED,
+        COUNTER_OCCLUSION_RETESTED,
+        COUNTER_OCCLUSION_CULLED,
+        COUNTER_COUNT
+    };
+
+    struct PushConstants
+    {
+        uint32_t objectCount;
+        uint32_t sliceSize;
+        uint32_t sliceCount;
+        uint32_t compact;
+        uint32_t phase;
+        uint32_t drawOffset;
+        uint32_t occlusion;
+        uint32_t pyramidIndex;
+        uint32_t pyramidLevels;
+        float depthWidth;
+        float depthHeight;
+    };
+
+    struct FrameResources
+    {
+        // maxDraws per phase
+        VkBuffer drawBuffer = VK_NULL_HANDLE;
+        GpuAllocation drawAllocation;
+        VkBuffer countBuffer = VK_NULL_HANDLE;
+        GpuAllocation countAllocation;
+        // one flag per object, set by the early phase for the late one
+        VkBuffer stateBuffer = VK_NULL_HANDLE;
+        GpuAllocation stateAllocation;
+        VkBuffer readbackBuffer = VK_NULL_HANDLE;
+        GpuAllocation readbackAllocation;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        uint32_t objectCount = 0;
+        uint32_t sliceSize = 0;
+        bool lateRecorded = false;
+        bool pending = false;
+    };
+
+    uint32_t getCountSize() const { return mSliceCount * 2 + COUNTER_COUNT; }
+
+    void createDescriptors(uint32_t frameCount);
+    void createPipeline(VkPipelineCache pipelineCache, const std::vector<char>& shaderCode);
+
+    VkDevice mDevice;
+    GpuAllocator& mAllocator;
+    const BindlessTable& mBindless;
+    uint32_t mMaxDraws;
+    uint32_t mSliceCount;
+    bool mDrawIndirectCount;
+    bool mMultiDrawIndirect;
+
+    VkDescriptorSetLayout mDescriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool mDescriptorPool = VK_NULL_HANDLE;
+    VkPipelineLayout mPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline mPipeline = VK_NULL_HANDLE;
+
+    std::vector<FrameResources> mFrames;
+    CullingStats mStats;
+};
+
+} // VulkanEngine
+
+#endif //CULLINGPASS_H
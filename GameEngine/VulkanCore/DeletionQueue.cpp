@@ -0,0 +1,309 @@
+#include "DeletionQueue.h"
+
+#include <cstring>
+#include <stdexcept>
+
+
+namespace {
+    // non-dispatchable handles are pointers on 64 bit and uint64_t on 32 bit builds
+    template<typename T>
+    uint64_t toBits(T handle) {
+        static_assert(sizeof(T) <= sizeof(uint64_t), "handle does not fit");
+        uint64_t bits = 0;
+        std::memcpy(&bits, &handle, sizeof(T));
+        return bits;
+    }
+
+    template<typename T>
+    T fromBits(uint64_t bits) {
+        T handle;
+        std::memcpy(&handle, &bits, sizeof(T));
+        return handle;
+    }
+
+    void destroyHandle(VkDevice device, VkObjectType type, uint64_t handle) {
+        switch (type) {
+            case VK_OBJECT_TYPE_BUFFER:
+                vkDestroyBuffer(device, fromBits<VkBuffer>(handle), nullptr);
+                break;
+            case VK_OBJECT_TYPE_IMAGE:
+                vkDestroyImage(device, fromBits<VkImage>(handle), nullptr);
+                break;
+            case VK_OBJECT_TYPE_IMAGE_VIEW:
+                vkDestroyImageView(device, fromBits<VkImageView>(handle), nullptr);
+                break;
+            case VK_OBJECT_TYPE_SAMPLER:
+                vkDestroySampler(device, fromBits<VkSampler>(handle), nullptr);
+                break;
+            case VK_OBJECT_TYPE_FRAMEBUFFER:
+                vkDestroyFramebuffer(device, fromBits<VkFramebuffer>(handle), nullptr);
+                break;
+            case VK_OBJECT_TYPE_RENDER_PASS:
+                vkDestroyRenderPass(device, fromBits<VkRenderPass>(handle), nullptr);
+                break;
+            case VK_OBJECT_TYPE_PIPELINE:
+                vkDestroyPipeline(device, fromBits<VkPipeline>(handle), nullptr);
+                break;
+            case VK_OBJECT_TYPE_PIPELINE_LAYOUT:
+                vkDestroyPipelineLayout(device, fromBits<VkPipelineLayout>(handle), nullptr);
+                break;
+            case VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT:
+                vkDestroyDescriptorSetLayout(device, fromBits<VkDescriptorSetLayout>(handle), nullptr);
+                break;
+            case VK_OBJECT_TYPE_DESCRIPTOR_POOL:
+                vkDestroyDescriptorPool(device, fromBits<VkDescriptorPool>(handle), nullptr);
+                break;
+            case VK_OBJECT_TYPE_SHADER_MODULE:
+                vkDestroyShaderModule(device, fromBits<VkShaderModule>(handle), nullptr);
+                break;
+            case VK_OBJECT_TYPE_QUERY_POOL:
+                vkDestroyQueryPool(device, fromBits<VkQueryPool>(handle), nullptr);
+                break;
+            case VK_OBJECT_TYPE_COMMAND_POOL:
+                vkDestroyCommandPool(device, fromBits<VkCommandPool>(handle), nullptr);
+                break;
+            case VK_OBJECT_TYPE_SEMAPHORE:
+                vkDestroySemaphore(device, fromBits<VkSemaphore>(handle), nullptr);
+                break;
+            case VK_OBJECT_TYPE_SWAPCHAIN_KHR:
+                vkDestroySwapchainKHR(device, fromBits<VkSwapchainKHR>(handle), nullptr);
+                break;
+            default:
+                throw std::runtime_error("ERROR: deletion queue does not know how to destroy this object type");
+        }
+    }
+}
+
+
+VulkanEngine::DeletionQueue::DeletionQueue(VkDevice device, GpuAllocator* allocator)
+    : mAllocator(allocator) {
+    mCallbacks.getCompletedValue = [device](VkSemaphore timeline) {
+        uint64_t value = 0;
+        if (vkGetSemaphoreCounterValue(device, timeline, &value) != VK_SUCCESS) {
+            throw std::runtime_error("ERROR: failed to read timeline semaphore");
+        }
+        return value;
+    };
+    mCallbacks.destroy = [device](VkObjectType type, uint64_t handle) {
+        destroyHandle(device, type, handle);
+    };
+}
+
+
+VulkanEngine::DeletionQueue::DeletionQueue(GpuAllocator* allocator, DeletionCallbacks callbacks)
+    : mAllocator(allocator), mCallbacks(std::move(callbacks)) {
+}
+
+
+VulkanEngine::DeletionQueue::~DeletionQueue() {
+    // the owner drains the device before tearing down, anything left is safe to free
+    flush();
+}
+
+
+template<typename T>
+void
+VulkanEngine::DeletionQueue::enqueue(VkObjectType type, T handle, GpuAllocation allocation) {
+    if (handle == VK_NULL_HANDLE && !allocation.isValid()) {
+        return;
+    }
+
+    Deletion deletion;
+    deletion.type = handle == VK_NULL_HANDLE ? VK_OBJECT_TYPE_UNKNOWN : type;
+    deletion.handle = toBits(handle);
+    deletion.allocation = allocation;
+    push(std::move(deletion));
+}
+
+
+void
+VulkanEngine::DeletionQueue::destroy(VkBuffer buffer, GpuAllocation allocation) {
+    enqueue(VK_OBJECT_TYPE_BUFFER, buffer, allocation);
+}
+
+
+void
+VulkanEngine::DeletionQueue::destroy(VkImage image, GpuAllocation allocation) {
+    enqueue(VK_OBJECT_TYPE_IMAGE, image, allocation);
+}
+
+
+void
+VulkanEngine::DeletionQueue::destroy(VkImageView imageView) {
+    enqueue(VK_OBJECT_TYPE_IMAGE_VIEW, imageView);
+}
+
+
+void
+VulkanEngine::DeletionQueue::destroy(VkSampler sampler) {
+    enqueue(VK_OBJECT_TYPE_SAMPLER, sampler);
+}
+
+
+void
+VulkanEngine::DeletionQueue::destroy(VkFramebuffer framebuffer) {
+    enqueue(VK_OBJECT_TYPE_FRAMEBUFFER, framebuffer);
+}
+
+
+void
+VulkanEngine::DeletionQueue::destroy(VkRenderPass renderPass) {
+    enqueue(VK_OBJECT_TYPE_RENDER_PASS, renderPass);
+}
+
+
+void
+VulkanEngine::DeletionQueue::destroy(VkPipeline pipeline) {
+    enqueue(VK_OBJECT_TYPE_PIPELINE, pipeline);
+}
+
+
+void
+VulkanEngine::DeletionQueue::destroy(VkPipelineLayout pipelineLayout) {
+    enqueue(VK_OBJECT_TYPE_PIPELINE_LAYOUT, pipelineLayout);
+}
+
+
+void
+VulkanEngine::DeletionQueue::destroy(VkDescriptorSetLayout descriptorSetLayout) {
+    enqueue(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT, descriptorSetLayout);
+}
+
+
+void
+VulkanEngine::DeletionQueue::destroy(VkDescriptorPool descriptorPool) {
+    enqueue(VK_OBJECT_TYPE_DESCRIPTOR_POOL, descriptorPool);
+}
+
+
+void
+VulkanEngine::DeletionQueue::destroy(VkShaderModule shaderModule) {
+    enqueue(VK_OBJECT_TYPE_SHADER_MODULE, shaderModule);
+}
+
+
+void
+VulkanEngine::DeletionQueue::destroy(VkQueryPool queryPool) {
+    enqueue(VK_OBJECT_TYPE_QUERY_POOL, queryPool);
+}
+
+
+void
+VulkanEngine::DeletionQueue::destroy(VkCommandPool commandPool) {
+    enqueue(VK_OBJECT_TYPE_COMMAND_POOL, commandPool);
+}
+
+
+void
+VulkanEngine::DeletionQueue::destroy(VkSemaphore semaphore) {
+    enqueue(VK_OBJECT_TYPE_SEMAPHORE, semaphore);
+}
+
+
+void
+VulkanEngine::DeletionQueue::destroy(VkSwapchainKHR swapchain) {
+    enqueue(VK_OBJECT_TYPE_SWAPCHAIN_KHR, swapchain);
+}
+
+
+void
+VulkanEngine::DeletionQueue::free(GpuAllocation allocation) {
+    if (!allocation.isValid()) {
+        return;
+    }
+
+    Deletion deletion;
+    deletion.allocation = allocation;
+    push(std::move(deletion));
+}
+
+
+void
+VulkanEngine::DeletionQueue::defer(std::function<void()> function) {
+    Deletion deletion;
+    deletion.function = std::move(function);
+    push(std::move(deletion));
+}
+
+
+void
+VulkanEngine::DeletionQueue::push(Deletion deletion) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRecording.push_back(std::move(deletion));
+}
+
+
+void
+VulkanEngine::DeletionQueue::submitFrame(VkSemaphore timeline, uint64_t value) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mRecording.empty()) {
+        mFrames.push_back({timeline, value, std::move(mRecording)});
+        mRecording.clear();
+    }
+}
+
+
+void
+VulkanEngine::DeletionQueue::collect() {
+    std::vector<Deletion> completed;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (auto frame = mFrames.begin(); frame != mFrames.end();) {
+            if (mCallbacks.getCompletedValue(frame->timeline) >= frame->value) {
+                completed.insert(completed.end(), std::make_move_iterator(frame->deletions.begin()),
+                                 std::make_move_iterator(frame->deletions.end()));
+                frame = mFrames.erase(frame);
+            } else {
+                ++frame;
+            }
+        }
+    }
+    release(completed);
+}
+
+
+void
+VulkanEngine::DeletionQueue::flush() {
+    std::vector<Deletion> completed;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (auto& frame : mFrames) {
+            completed.insert(completed.end(), std::make_move_iterator(frame.deletions.begin()),
+                             std::make_move_iterator(frame.deletions.end()));
+        }
+        mFrames.clear();
+        completed.insert(completed.end(), std::make_move_iterator(mRecording.begin()),
+                         std::make_move_iterator(mRecording.end()));
+        mRecording.clear();
+    }
+    release(completed);
+}
+
+
+size_t
+VulkanEngine::DeletionQueue::getPendingCount() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    size_t count = mRecording.size();
+    for (const auto& frame : mFrames) {
+        count += frame.deletions.size();
+    }
+    return count;
+}
+
+
+void
+VulkanEngine::DeletionQueue::release(std::vector<Deletion>& deletions) {
+    // in enqueue order, so framebuffers queued before their views go first
+    for (auto& deletion : deletions) {
+        if (deletion.function) {
+            deletion.function();
+        }
+        if (deletion.type != VK_OBJECT_TYPE_UNKNOWN) {
+            mCallbacks.destroy(deletion.type, deletion.handle);
+        }
+        if (deletion.allocation.isValid() && mAllocator != nullptr) {
+            mAllocator->free(deletion.allocation);
+        }
+    }
+    deletions.clear();
+}
@@ -0,0 +1,93 @@
+#ifndef DELETIONQUEUE_H
+#define DELETIONQUEUE_H
+
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <functional>
+#include "vulkan/vulkan.h"
+#include "GpuAllocator.h"
+
+
+namespace VulkanEngine {
+
+    // Timeline query and handle destruction. The default constructor wires these to the device,
+    // tests can hand in fakes instead.
+    struct DeletionCallbacks
+    {
+        std::function<uint64_t(VkSemaphore timeline)> getCompletedValue;
+        std::function<void(VkObjectType type, uint64_t handle)> destroy;
+    };
+
+// Deferred destruction keyed to frame completion: whatever is enqueued is released once the
+// timeline value of the frame it was retired in has been reached. Enqueueing is thread safe.
+class DeletionQueue {
+public:
+    DeletionQueue(VkDevice device, GpuAllocator* allocator);
+    DeletionQueue(GpuAllocator* allocator, DeletionCallbacks callbacks);
+    ~DeletionQueue();
+
+    DeletionQueue(const DeletionQueue&) = delete;
+    DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+    void destroy(VkBuffer buffer, GpuAllocation allocation = {});
+    void destroy(VkImage image, GpuAllocation allocation = {});
+    void destroy(VkImageView imageView);
+    void destroy(VkSampler sampler);
+    void destroy(VkFramebuffer framebuffer);
+    void destroy(VkRenderPass renderPass);
+    void destroy(VkPipeline pipeline);
+    void destroy(VkPipelineLayout pipelineLayout);
+    void destroy(VkDescriptorSetLayout descriptorSetLayout);
+    void destroy(VkDescriptorPool descriptorPool);
+    void destroy(VkShaderModule shaderModule);
+    void destroy(VkQueryPool queryPool);
+    void destroy(VkCommandPool commandPool);
+    void destroy(VkSemaphore semaphore);
+    void destroy(VkSwapchainKHR swapchain);
+    void free(GpuAllocation allocation);
+    // Anything else, runs on the thread that calls collect().
+    void defer(std::function<void()> function);
+
+    // Everything enqueued since the last call is released once timeline reaches value.
+    void submitFrame(VkSemaphore timeline, uint64_t value);
+    void collect();
+    // Releases everything without looking at the timelines, only after the device is idle.
+    void flush();
+
+    size_t getPendingCount() const;
+
+private:
+    struct Deletion
+    {
+        VkObjectType type = VK_OBJECT_TYPE_UNKNOWN;
+        uint64_t handle = 0;
+        GpuAllocation allocation;
+        std::function<void()> function;
+    };
+
+    struct PendingFrame
+    {
+        VkSemaphore timeline;
+        uint64_t value;
+        std::vector<Deletion> deletions;
+    };
+
+    template<typename T>
+    void enqueue(VkObjectType type, T handle, GpuAllocation allocation = {});
+    void push(Deletion deletion);
+    void release(std::vector<Deletion>& deletions);
+
+    GpuAllocator* mAllocator;
+    DeletionCallbacks mCallbacks;
+
+    // guards mRecording and mFrames, the callbacks run outside of it
+    mutable std::mutex mMutex;
+    std::vector<Deletion> mRecording;
+    std::deque<PendingFrame> mFrames;
+};
+
+} // VulkanEngine
+
+#endif //DELETIONQUEUE_H
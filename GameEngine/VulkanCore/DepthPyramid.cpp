@@ -0,0 +1,284 @@
+#include "DepthPyramid.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace {
+    constexpr uint32_t WORKGROUP_SIZE = 8;
+    constexpr VkFormat PYRAMID_FORMAT = VK_FORMAT_R32_SFLOAT;
+}
+
+
+VulkanEngine::DepthPyramid::DepthPyramid(VkDevice device, GpuAllocator& allocator, DeletionQueue& deletionQueue,
+                                         BindlessTable& bindless, VkPipelineCache pipelineCache,
+                                         const std::vector<char>& shaderCode, VkExtent2D depthExtent)
+    : mDevice(device), mAllocator(allocator), mDeletionQueue(deletionQueue), mBindless(bindless), mDepthExtent(depthExtent) {
+    VkExtent2D extent = {std::max(depthExtent.width / 2, 1u), std::max(depthExtent.height / 2, 1u)};
+    while (true) {
+        Level level{};
+        level.extent = extent;
+        mLevels.push_back(level);
+        if (extent.width == 1 && extent.height == 1) {
+            break;
+        }
+        extent = {std::max(extent.width / 2, 1u), std::max(extent.height / 2, 1u)};
+    }
+
+    createImage();
+    createDescriptors();
+    createPipeline(pipelineCache, shaderCode);
+    mBindlessIndex = mBindless.addImage(mImageView, VK_IMAGE_LAYOUT_GENERAL);
+}
+
+
+VulkanEngine::DepthPyramid::~DepthPyramid() {
+    if (mBindlessIndex != BindlessTable::INVALID_INDEX) {
+        mBindless.removeImage(mBindlessIndex);
+    }
+    mDeletionQueue.destroy(mPipeline);
+    mDeletionQueue.destroy(mPipelineLayout);
+    mDeletionQueue.destroy(mDescriptorPool);
+    mDeletionQueue.destroy(mDescriptorSetLayout);
+    mDeletionQueue.destroy(mSampler);
+    for (auto& level : mLevels) {
+        mDeletionQueue.destroy(level.view);
+    }
+    mDeletionQueue.destroy(mImageView);
+    mDeletionQueue.destroy(mImage, mImageAllocation);
+}
+
+
+void
+VulkanEngine::DepthPyramid::setDepthView(VkImageView depthView) {
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.sampler = mSampler;
+    imageInfo.imageView = depthView;
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = mLevels[0].descriptorSet;
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(mDevice, 1, &write, 0, nullptr);
+}
+
+
+void
+VulkanEngine::DepthPyramid::record(VkCommandBuffer commandBuffer) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipeline);
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = mImage;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    for (uint32_t i = 0; i < mLevels.size(); i++) {
+        const Level& level = mLevels[i];
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipelineLayout, 0, 1,
+                                &level.descriptorSet, 0, nullptr);
+        vkCmdDispatch(commandBuffer, (level.extent.width + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE,
+                      (level.extent.height + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1);
+
+        // the next level reads this one; after the last, whoever reads the pyramid waits for it
+        if (i + 1 == mLevels.size()) {
+            break;
+        }
+        barrier.subresourceRange.baseMipLevel = i;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                             0, nullptr, 0, nullptr, 1, &barrier);
+    }
+    mHasHistory = true;
+}
+
+
+void
+VulkanEngine::DepthPyramid::createImage() {
+    uint32_t levelCount = static_cast<uint32_t>(mLevels.size());
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = PYRAMID_FORMAT;
+    imageInfo.extent = {mLevels[0].extent.width, mLevels[0].extent.height, 1};
+    imageInfo.mipLevels = levelCount;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(mDevice, &imageInfo, nullptr, &mImage) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create depth pyramid image");
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(mDevice, mImage, &requirements);
+    mImageAllocation = mAllocator.allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, GpuResourceTiling::Optimal);
+    vkBindImageMemory(mDevice, mImage, mImageAllocation.memory, mImageAllocation.offset);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = mImage;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = PYRAMID_FORMAT;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = levelCount;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(mDevice, &viewInfo, nullptr, &mImageView) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create depth pyramid image view");
+    }
+
+    viewInfo.subresourceRange.levelCount = 1;
+    for (uint32_t i = 0; i < levelCount; i++) {
+        viewInfo.subresourceRange.baseMipLevel = i;
+        if (vkCreateImageView(mDevice, &viewInfo, nullptr, &mLevels[i].view) != VK_SUCCESS) {
+            throw std::runtime_error("ERROR: failed to create depth pyramid level view");
+        }
+    }
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = 0.0f;
+
+    if (vkCreateSampler(mDevice, &samplerInfo, nullptr, &mSampler) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create depth pyramid sampler");
+    }
+}
+
+
+void
+VulkanEngine::DepthPyramid::createDescriptors() {
+    uint32_t levelCount = static_cast<uint32_t>(mLevels.size());
+
+    VkDescriptorSetLayoutBinding bindings[2]{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    for (auto& binding : bindings) {
+        binding.descriptorCount = 1;
+        binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = bindings;
+
+    if (vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &mDescriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create depth pyramid descriptor set layout");
+    }
+
+    VkDescriptorPoolSize poolSizes[2]{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = levelCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[1].descriptorCount = levelCount;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    poolInfo.maxSets = levelCount;
+
+    if (vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &mDescriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create depth pyramid descriptor pool");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(levelCount, mDescriptorSetLayout);
+    std::vector<VkDescriptorSet> sets(levelCount);
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = mDescriptorPool;
+    allocInfo.descriptorSetCount = levelCount;
+    allocInfo.pSetLayouts = layouts.data();
+
+    if (vkAllocateDescriptorSets(mDevice, &allocInfo, sets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to allocate depth pyramid descriptor sets");
+    }
+
+    // every level reads the one before it, level 0 the depth buffer setDepthView() hands in
+    std::vector<VkDescriptorImageInfo> imageInfos(levelCount * 2);
+    std::vector<VkWriteDescriptorSet> writes;
+    for (uint32_t i = 0; i < levelCount; i++) {
+        mLevels[i].descriptorSet = sets[i];
+
+        imageInfos[i * 2].sampler = mSampler;
+        imageInfos[i * 2].imageView = i == 0 ? VK_NULL_HANDLE : mLevels[i - 1].view;
+        imageInfos[i * 2].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        imageInfos[i * 2 + 1].imageView = mLevels[i].view;
+        imageInfos[i * 2 + 1].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        for (uint32_t binding = i == 0 ? 1 : 0; binding < 2; binding++) {
+            VkWriteDescriptorSet write{};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = sets[i];
+            write.dstBinding = binding;
+            write.descriptorCount = 1;
+            write.descriptorType = bindings[binding].descriptorType;
+            write.pImageInfo = &imageInfos[i * 2 + binding];
+            writes.push_back(write);
+        }
+    }
+    vkUpdateDescriptorSets(mDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+
+void
+VulkanEngine::DepthPyramid::createPipeline(VkPipelineCache pipelineCache, const std::vector<char>& shaderCode) {
+    VkPipelineLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &mDescriptorSetLayout;
+
+    if (vkCreatePipelineLayout(mDevice, &layoutInfo, nullptr, &mPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create depth pyramid pipeline layout");
+    }
+
+    VkShaderModuleCreateInfo moduleInfo{};
+    moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleInfo.codeSize = shaderCode.size();
+    moduleInfo.pCode = reinterpret_cast<const uint32_t*>(shaderCode.data());
+
+    VkShaderModule shaderModule;
+    if (vkCreateShaderModule(mDevice, &moduleInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create depth pyramid shader module");
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = mPipelineLayout;
+
+    VkResult result = vkCreateComputePipelines(mDevice, pipelineCache, 1, &pipelineInfo, nullptr, &mPipeline);
+    vkDestroyShaderModule(mDevice, shaderModule, nullptr);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create depth pyramid pipeline");
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef DEPTHPYRAMID_H
+#define DEPTHPYRAMID_H
+
+
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "GpuAllocator.h"
+#include "DeletionQueue.h"
+#include "BindlessTable.h"
+
+
+namespace VulkanEngine {
+
+// Hierarchical depth of the depth prepass for occlusion culling, each texel the farthest (reversed,
+// so smallest) depth it covers. Level 0 is half the depth buffer's size, rounded down.
+class DepthPyramid {
+public:
+    DepthPyramid(VkDevice device, GpuAllocator& allocator, DeletionQueue& deletionQueue, BindlessTable& bindless,
+                 VkPipelineCache pipelineCache, const std::vector<char>& shaderCode, VkExtent2D depthExtent);
+    ~DepthPyramid();
+
+    DepthPyramid(const DepthPyramid&) = delete;
+    DepthPyramid& operator=(const DepthPyramid&) = delete;
+
+    // The depth buffer level 0 is built from, before the first record().
+    void setDepthView(VkImageView depthView);
+
+    // Outside of a render pass, the depth image read only and the pyramid in GENERAL.
+    void record(VkCommandBuffer commandBuffer);
+
+    // False until the first record(), the pyramid holds nothing to test against before that.
+    bool hasHistory() const { return mHasHistory; }
+
+    VkImage getImage() const { return mImage; }
+    uint32_t getBindlessIndex() const { return mBindlessIndex; }
+    uint32_t getLevelCount() const { return static_cast<uint32_t>(mLevels.size()); }
+    VkExtent2D getDepthExtent() const { return mDepthExtent; }
+
+private:
+    struct Level
+    {
+        VkExtent2D extent;
+        VkImageView view = VK_NULL_HANDLE;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    };
+
+    void createImage();
+    void createDescriptors();
+    void createPipeline(VkPipelineCache pipelineCache, const std::vector<char>& shaderCode);
+
+    VkDevice mDevice;
+    GpuAllocator& mAllocator;
+    DeletionQueue& mDeletionQueue;
+    BindlessTable& mBindless;
+    VkExtent2D mDepthExtent;
+    bool mHasHistory = false;
+
+    VkImage mImage = VK_NULL_HANDLE;
+    GpuAllocation mImageAllocation;
+    VkImageView mImageView = VK_NULL_HANDLE;
+    uint32_t mBindlessIndex = BindlessTable::INVALID_INDEX;
+    VkSampler mSampler = VK_NULL_HANDLE;
+    std::vector<Level> mLevels;
+
+    VkDescriptorSetLayout mDescriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool mDescriptorPool = VK_NULL_HANDLE;
+    VkPipelineLayout mPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline mPipeline = VK_NULL_HANDLE;
+};
+
+} // VulkanEngine
+
+#endif //DEPTHPYRAMID_H
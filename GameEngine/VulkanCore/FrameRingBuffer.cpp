@@ -0,0 +1,62 @@
+#include "FrameRingBuffer.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+
+VulkanEngine::FrameRingBuffer::FrameRingBuffer(VkPhysicalDevice physicalDevice, VkDevice device, GpuAllocator& allocator,
+                                               uint32_t frameCount, VkDeviceSize frameSize)
+    : mAllocator(allocator), mFrameCount(frameCount) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    // every suballocation may end up behind a uniform or storage descriptor
+    mMinAlignment = std::max({VkDeviceSize(16),
+                              properties.limits.minUniformBufferOffsetAlignment,
+                              properties.limits.minStorageBufferOffsetAlignment});
+    mFrameSize = (frameSize + mMinAlignment - 1) & ~(mMinAlignment - 1);
+
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                               VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                               VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    mAllocator.createBuffer(mFrameSize * mFrameCount, usage,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                            mBuffer, mAllocation);
+
+    if (mAllocation.mapped == nullptr) {
+        throw std::runtime_error("ERROR: frame ring buffer is not host mapped");
+    }
+}
+
+
+VulkanEngine::FrameRingBuffer::~FrameRingBuffer() {
+    mAllocator.destroyBuffer(mBuffer, mAllocation);
+}
+
+
+void
+VulkanEngine::FrameRingBuffer::beginFrame(uint32_t frameIndex) {
+    mFrameIndex = frameIndex % mFrameCount;
+    mHead.store(0, std::memory_order_relaxed);
+}
+
+
+VulkanEngine::FrameAllocation
+VulkanEngine::FrameRingBuffer::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+    alignment = std::max(alignment, mMinAlignment);
+
+    VkDeviceSize head = mHead.load(std::memory_order_relaxed);
+    VkDeviceSize offset;
+    do {
+        offset = (head + alignment - 1) / alignment * alignment;
+        if (offset + size > mFrameSize) {
+            throw std::runtime_error("ERROR: frame ring buffer partition exhausted");
+        }
+    } while (!mHead.compare_exchange_weak(head, offset + size, std::memory_order_relaxed));
+
+    FrameAllocation allocation;
+    allocation.buffer = mBuffer;
+    allocation.offset = mFrameIndex * mFrameSize + offset;
+    allocation.mapped = static_cast<char*>(mAllocation.mapped) + allocation.offset;
+    return allocation;
+}
@@ -0,0 +1,56 @@
+#ifndef FRAMERINGBUFFER_H
+#define FRAMERINGBUFFER_H
+
+
+#include <atomic>
+#include "vulkan/vulkan.h"
+#include "GpuAllocator.h"
+
+
+namespace VulkanEngine {
+
+    struct FrameAllocation
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        void* mapped = nullptr;
+    };
+
+// One persistently mapped buffer with a bump allocated partition per frame in flight.
+class FrameRingBuffer {
+public:
+    static constexpr VkDeviceSize DEFAULT_FRAME_SIZE = 4ull * 1024 * 1024;
+
+    FrameRingBuffer(VkPhysicalDevice physicalDevice, VkDevice device, GpuAllocator& allocator,
+                    uint32_t frameCount, VkDeviceSize frameSize = DEFAULT_FRAME_SIZE);
+    ~FrameRingBuffer();
+
+    FrameRingBuffer(const FrameRingBuffer&) = delete;
+    FrameRingBuffer& operator=(const FrameRingBuffer&) = delete;
+
+    // The caller must have waited for the timeline value of the frame that last used this partition.
+    void beginFrame(uint32_t frameIndex);
+
+    // Safe to call from several threads while recording a frame.
+    FrameAllocation allocate(VkDeviceSize size, VkDeviceSize alignment = 0);
+
+    VkBuffer getBuffer() const { return mBuffer; }
+    VkDeviceSize getFrameSize() const { return mFrameSize; }
+    VkDeviceSize getFrameUsage() const { return mHead.load(std::memory_order_relaxed); }
+
+private:
+    VkBuffer mBuffer = VK_NULL_HANDLE;
+    GpuAllocation mAllocation;
+    GpuAllocator& mAllocator;
+
+    uint32_t mFrameCount;
+    VkDeviceSize mFrameSize;
+    VkDeviceSize mMinAlignment = 1;
+
+    uint32_t mFrameIndex = 0;
+    std::atomic<VkDeviceSize> mHead{0};
+};
+
+} // VulkanEngine
+
+#endif //FRAMERINGBUFFER_H
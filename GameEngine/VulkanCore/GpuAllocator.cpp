@@ -0,0 +1,474 @@
+#include "GpuAllocator.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+namespace {
+
+    VkDeviceSize nextPowerOfTwo(VkDeviceSize value) {
+        VkDeviceSize result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    uint32_t log2Floor(VkDeviceSize value) {
+        uint32_t result = 0;
+        while (value > 1) {
+            value >>= 1;
+            result++;
+        }
+        return result;
+    }
+
+    VkPhysicalDeviceMemoryProperties queryMemoryProperties(VkPhysicalDevice physicalDevice) {
+        VkPhysicalDeviceMemoryProperties memProperties;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+        return memProperties;
+    }
+
+    VkDeviceSize queryBufferImageGranularity(VkPhysicalDevice physicalDevice) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        return properties.limits.bufferImageGranularity;
+    }
+
+    VulkanEngine::GpuMemoryCallbacks deviceCallbacks(VkDevice device) {
+        VulkanEngine::GpuMemoryCallbacks callbacks;
+        callbacks.allocate = [device](uint32_t memoryType, VkDeviceSize size, VkDeviceMemory* memory) {
+            VkMemoryAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            allocInfo.allocationSize = size;
+            allocInfo.memoryTypeIndex = memoryType;
+            return vkAllocateMemory(device, &allocInfo, nullptr, memory);
+        };
+        callbacks.free = [device](VkDeviceMemory memory) {
+            vkFreeMemory(device, memory, nullptr);
+        };
+        callbacks.map = [device](VkDeviceMemory memory) {
+            void* data = nullptr;
+            if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS) {
+                throw std::runtime_error("ERROR: failed to map memory block");
+            }
+            return data;
+        };
+        return callbacks;
+    }
+
+} // namespace
+
+
+VulkanEngine::GpuAllocator::GpuAllocator(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize)
+    : GpuAllocator(queryMemoryProperties(physicalDevice), deviceCallbacks(device), blockSize, queryBufferImageGranularity(physicalDevice)) {
+    mDevice = device;
+}
+
+
+VulkanEngine::GpuAllocator::GpuAllocator(const VkPhysicalDeviceMemoryProperties& memoryProperties, GpuMemoryCallbacks callbacks, VkDeviceSize blockSize,
+                                         VkDeviceSize bufferImageGranularity)
+    : mMemoryProperties(memoryProperties), mCallbacks(std::move(callbacks)), mBlockSize(nextPowerOfTwo(std::max(blockSize, MIN_ALLOCATION_SIZE))),
+      mBufferImageGranularity(bufferImageGranularity) {
+    mBlocks.resize(mMemoryProperties.memoryTypeCount);
+}
+
+
+VulkanEngine::GpuAllocator::~GpuAllocator() {
+    for (uint32_t type = 0; type < mBlocks.size(); type++) {
+        for (uint32_t i = 0; i < mBlocks[type].size(); i++) {
+            if (mBlocks[type][i]) {
+                destroyBlock(type, i);
+            }
+        }
+    }
+}
+
+
+uint32_t
+VulkanEngine::GpuAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+    return findMemoryType(mMemoryProperties, typeFilter, properties);
+}
+
+
+uint32_t
+VulkanEngine::GpuAllocator::findMemoryType(const VkPhysicalDeviceMemoryProperties& memProperties, uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+    {
+        if (typeFilter & (1 << i) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+        {
+            return i;
+        }
+    }
+    throw std::runtime_error("ERROR: failed to find suitable memory type");
+}
+
+
+VulkanEngine::GpuAllocation
+VulkanEngine::GpuAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, GpuResourceTiling tiling) {
+    uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+    VkDeviceSize nodeSize = nextPowerOfTwo(std::max({requirements.size, requirements.alignment, MIN_ALLOCATION_SIZE}));
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    GpuAllocation allocation;
+    if (nodeSize > blockSizeForType(memoryType)) {
+        // too big to share a block, give it its own VkDeviceMemory
+        uint32_t blockIndex;
+        MemoryBlock* block = createBlock(memoryType, requirements.size, true, tiling, blockIndex);
+        allocation.memory = block->memory;
+        allocation.offset = 0;
+        allocation.memoryType = memoryType;
+        allocation.blockIndex = blockIndex;
+        allocation.mapped = block->mapped;
+    } else {
+        allocation = allocateFromType(memoryType, nodeSize, blockTiling(tiling), true, -1);
+    }
+    allocation.size = requirements.size;
+    return allocation;
+}
+
+
+void
+VulkanEngine::GpuAllocator::free(GpuAllocation& allocation) {
+    if (!allocation.isValid()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    auto& blocks = mBlocks[allocation.memoryType];
+    MemoryBlock& block = *blocks[allocation.blockIndex];
+    if (block.dedicated) {
+        destroyBlock(allocation.memoryType, allocation.blockIndex);
+    } else {
+        freeFromBlock(block, allocation.offset);
+
+        // keep a single empty block around per memory type so alloc/free churn doesn't hit the driver
+        if (block.usedBytes == 0 && !block.defragSource) {
+            for (uint32_t i = 0; i < blocks.size(); i++) {
+                if (i != allocation.blockIndex && blocks[i] && !blocks[i]->dedicated && blocks[i]->usedBytes == 0) {
+                    destroyBlock(allocation.memoryType, allocation.blockIndex);
+                    break;
+                }
+            }
+        }
+    }
+    allocation = GpuAllocation{};
+}
+
+
+void
+VulkanEngine::GpuAllocator::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, GpuAllocation& allocation) {
+    VkBufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.size = size;
+    bufferCreateInfo.usage = usage;
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(mDevice, &bufferCreateInfo, nullptr, &buffer) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: Could not create buffer");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(mDevice, buffer, &memRequirements);
+
+    allocation = allocate(memRequirements, properties);
+    vkBindBufferMemory(mDevice, buffer, allocation.memory, allocation.offset);
+}
+
+
+void
+VulkanEngine::GpuAllocator::destroyBuffer(VkBuffer& buffer, GpuAllocation& allocation) {
+    if (buffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(mDevice, buffer, nullptr);
+        buffer = VK_NULL_HANDLE;
+    }
+    free(allocation);
+}
+
+
+std::vector<VulkanEngine::GpuDefragMove>
+VulkanEngine::GpuAllocator::beginDefragmentation(VkDeviceSize maxBytesToMove) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    std::vector<GpuDefragMove> moves;
+    VkDeviceSize movedBytes = 0;
+
+    for (uint32_t type = 0; type < mBlocks.size(); type++) {
+        auto& blocks = mBlocks[type];
+
+        int source = -1;
+        uint32_t liveBlocks = 0;
+        for (uint32_t i = 0; i < blocks.size(); i++) {
+            if (!blocks[i] || blocks[i]->dedicated || blocks[i]->usedBytes == 0) {
+                continue;
+            }
+            liveBlocks++;
+            if (source < 0 || blocks[i]->usedBytes < blocks[source]->usedBytes) {
+                source = static_cast<int>(i);
+            }
+        }
+        if (liveBlocks < 2) {
+            continue;
+        }
+
+        MemoryBlock& block = *blocks[source];
+        block.defragSource = true;
+
+        for (const auto& [offset, level] : block.allocatedLevels) {
+            VkDeviceSize nodeSize = block.size >> level;
+            if (movedBytes + nodeSize > maxBytesToMove) {
+                break;
+            }
+
+            GpuAllocation dst = allocateFromType(type, nodeSize, block.tiling, false, source);
+            if (!dst.isValid()) {
+                continue;
+            }
+            dst.size = nodeSize;
+
+            GpuDefragMove move;
+            move.src.memory = block.memory;
+            move.src.offset = offset;
+            move.src.size = nodeSize;
+            move.src.memoryType = type;
+            move.src.blockIndex = static_cast<uint32_t>(source);
+            move.src.mapped = block.mapped ? static_cast<char*>(block.mapped) + offset : nullptr;
+            move.dst = dst;
+            moves.push_back(move);
+
+            movedBytes += nodeSize;
+        }
+    }
+
+    return moves;
+}
+
+
+void
+VulkanEngine::GpuAllocator::endDefragmentation(std::vector<GpuDefragMove>& moves) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    for (const auto& move : moves) {
+        freeFromBlock(*mBlocks[move.src.memoryType][move.src.blockIndex], move.src.offset);
+    }
+    moves.clear();
+
+    for (uint32_t type = 0; type < mBlocks.size(); type++) {
+        for (uint32_t i = 0; i < mBlocks[type].size(); i++) {
+            MemoryBlock* block = mBlocks[type][i].get();
+            if (block && block->defragSource) {
+                block->defragSource = false;
+                if (block->usedBytes == 0) {
+                    destroyBlock(type, i);
+                }
+            }
+        }
+    }
+}
+
+
+void
+VulkanEngine::GpuAllocator::releaseEmptyBlocks() {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    for (uint32_t type = 0; type < mBlocks.size(); type++) {
+        for (uint32_t i = 0; i < mBlocks[type].size(); i++) {
+            MemoryBlock* block = mBlocks[type][i].get();
+            if (block && !block->dedicated && !block->defragSource && block->usedBytes == 0) {
+                destroyBlock(type, i);
+            }
+        }
+    }
+}
+
+
+VulkanEngine::GpuHeapStats
+VulkanEngine::GpuAllocator::getHeapStats(uint32_t heapIndex) const {
+    if (heapIndex >= mMemoryProperties.memoryHeapCount) {
+        throw std::runtime_error("ERROR: memory heap index out of range");
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    GpuHeapStats stats;
+    stats.heapSize = mMemoryProperties.memoryHeaps[heapIndex].size;
+
+    for (uint32_t type = 0; type < mBlocks.size(); type++) {
+        if (mMemoryProperties.memoryTypes[type].heapIndex != heapIndex) {
+            continue;
+        }
+        for (const auto& block : mBlocks[type]) {
+            if (!block) {
+                continue;
+            }
+            stats.blockCount++;
+            stats.blockBytes += block->size;
+            stats.usedBytes += block->usedBytes;
+            stats.allocationCount += block->dedicated ? 1 : static_cast<uint32_t>(block->allocatedLevels.size());
+        }
+    }
+    return stats;
+}
+
+
+VulkanEngine::GpuAllocator::MemoryBlock*
+VulkanEngine::GpuAllocator::createBlock(uint32_t memoryType, VkDeviceSize size, bool dedicated, GpuResourceTiling tiling, uint32_t& blockIndex) {
+    auto block = std::make_unique<MemoryBlock>();
+    block->size = size;
+    block->dedicated = dedicated;
+    block->tiling = tiling;
+
+    if (mCallbacks.allocate(memoryType, size, &block->memory) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: Unable to allocate memory");
+    }
+    mDeviceAllocationCount++;
+
+    if (mMemoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        block->mapped = mCallbacks.map(block->memory);
+    }
+
+    if (dedicated) {
+        block->usedBytes = size;
+    } else {
+        block->freeLists.resize(levelCount(size));
+        block->freeLists[0].insert(0);
+    }
+
+    auto& blocks = mBlocks[memoryType];
+    auto slot = std::find(blocks.begin(), blocks.end(), nullptr);
+    if (slot == blocks.end()) {
+        slot = blocks.insert(blocks.end(), nullptr);
+    }
+    blockIndex = static_cast<uint32_t>(slot - blocks.begin());
+    *slot = std::move(block);
+    return slot->get();
+}
+
+
+void
+VulkanEngine::GpuAllocator::destroyBlock(uint32_t memoryType, uint32_t blockIndex) {
+    auto& block = mBlocks[memoryType][blockIndex];
+    mCallbacks.free(block->memory);
+    block.reset();
+    mDeviceAllocationCount--;
+}
+
+
+bool
+VulkanEngine::GpuAllocator::allocateFromBlock(MemoryBlock& block, VkDeviceSize nodeSize, VkDeviceSize& offset) {
+    uint32_t target = log2Floor(block.size / nodeSize);
+
+    int level = static_cast<int>(target);
+    while (level >= 0 && block.freeLists[level].empty()) {
+        level--;
+    }
+    if (level < 0) {
+        return false;
+    }
+
+    offset = *block.freeLists[level].begin();
+    block.freeLists[level].erase(block.freeLists[level].begin());
+
+    // split down to the requested size, parking the upper halves on the free lists
+    while (static_cast<uint32_t>(level) < target) {
+        level++;
+        block.freeLists[level].insert(offset + (block.size >> level));
+    }
+
+    block.allocatedLevels[offset] = target;
+    block.usedBytes += nodeSize;
+    return true;
+}
+
+
+void
+VulkanEngine::GpuAllocator::freeFromBlock(MemoryBlock& block, VkDeviceSize offset) {
+    auto it = block.allocatedLevels.find(offset);
+    if (it == block.allocatedLevels.end()) {
+        throw std::runtime_error("ERROR: freeing memory that was not allocated from this block");
+    }
+
+    uint32_t level = it->second;
+    block.allocatedLevels.erase(it);
+    block.usedBytes -= block.size >> level;
+
+    // merge with the buddy for as long as it is free
+    while (level > 0) {
+        VkDeviceSize buddy = offset ^ (block.size >> level);
+        auto buddyIt = block.freeLists[level].find(buddy);
+        if (buddyIt == block.freeLists[level].end()) {
+            break;
+        }
+        block.freeLists[level].erase(buddyIt);
+        offset = std::min(offset, buddy);
+        level--;
+    }
+    block.freeLists[level].insert(offset);
+}
+
+
+VulkanEngine::GpuAllocation
+VulkanEngine::GpuAllocator::allocateFromType(uint32_t memoryType, VkDeviceSize nodeSize, GpuResourceTiling tiling, bool allowNewBlock, int excludeBlock) {
+    auto& blocks = mBlocks[memoryType];
+
+    GpuAllocation allocation;
+    for (uint32_t i = 0; i < blocks.size(); i++) {
+        MemoryBlock* block = blocks[i].get();
+        if (!block || block->dedicated || block->defragSource || block->tiling != tiling || static_cast<int>(i) == excludeBlock) {
+            continue;
+        }
+
+        VkDeviceSize offset;
+        if (allocateFromBlock(*block, nodeSize, offset)) {
+            allocation.memory = block->memory;
+            allocation.offset = offset;
+            allocation.memoryType = memoryType;
+            allocation.blockIndex = i;
+            allocation.mapped = block->mapped ? static_cast<char*>(block->mapped) + offset : nullptr;
+            return allocation;
+        }
+    }
+
+    if (!allowNewBlock) {
+        return allocation;
+    }
+
+    uint32_t blockIndex;
+    MemoryBlock* block = createBlock(memoryType, blockSizeForType(memoryType), false, tiling, blockIndex);
+
+    VkDeviceSize offset;
+    allocateFromBlock(*block, nodeSize, offset);
+    allocation.memory = block->memory;
+    allocation.offset = offset;
+    allocation.memoryType = memoryType;
+    allocation.blockIndex = blockIndex;
+    allocation.mapped = block->mapped ? static_cast<char*>(block->mapped) + offset : nullptr;
+    return allocation;
+}
+
+
+VulkanEngine::GpuResourceTiling
+VulkanEngine::GpuAllocator::blockTiling(GpuResourceTiling tiling) const {
+    // nodes start on MIN_ALLOCATION_SIZE boundaries and are multiples of it, so up to that
+    // granularity neighbours never share a page and linear and optimal can share blocks
+    return mBufferImageGranularity > MIN_ALLOCATION_SIZE ? tiling : GpuResourceTiling::Linear;
+}
+
+
+VkDeviceSize
+VulkanEngine::GpuAllocator::blockSizeForType(uint32_t memoryType) const {
+    // small heaps (e.g. the 256MB host visible BAR) get proportionally smaller blocks
+    VkDeviceSize heapSize = mMemoryProperties.memoryHeaps[mMemoryProperties.memoryTypes[memoryType].heapIndex].size;
+    VkDeviceSize blockSize = mBlockSize;
+    while (blockSize > heapSize / 8 && blockSize > MIN_ALLOCATION_SIZE * 4096) {
+        blockSize >>= 1;
+    }
+    return blockSize;
+}
+
+
+uint32_t
+VulkanEngine::GpuAllocator::levelCount(VkDeviceSize blockSize) const {
+    return log2Floor(blockSize / MIN_ALLOCATION_SIZE) + 1;
+}
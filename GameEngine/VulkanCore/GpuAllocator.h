@@ -0,0 +1,135 @@
+#ifndef GPUALLOCATOR_H
+#define GPUALLOCATOR_H
+
+
+#include <vector>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <unordered_map>
+#include "vulkan/vulkan.h"
+
+
+namespace VulkanEngine {
+
+    struct GpuAllocation
+    {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        uint32_t memoryType = 0;
+        uint32_t blockIndex = 0;
+        void* mapped = nullptr;
+
+        bool isValid() const { return memory != VK_NULL_HANDLE; }
+    };
+
+    struct GpuHeapStats
+    {
+        VkDeviceSize heapSize = 0;
+        VkDeviceSize blockBytes = 0;
+        VkDeviceSize usedBytes = 0;
+        uint32_t blockCount = 0;
+        uint32_t allocationCount = 0;
+    };
+
+    // How the resource bound to an allocation lays out its memory: buffers and linear images are
+    // Linear, optimal tiling images Optimal. The two must not share a bufferImageGranularity page.
+    enum class GpuResourceTiling
+    {
+        Linear,
+        Optimal
+    };
+
+    // Driver entry points used by the allocator. The default constructor wires these
+    // to vkAllocateMemory/vkFreeMemory/vkMapMemory, tests can hand in fakes instead.
+    struct GpuMemoryCallbacks
+    {
+        std::function<VkResult(uint32_t memoryType, VkDeviceSize size, VkDeviceMemory* memory)> allocate;
+        std::function<void(VkDeviceMemory memory)> free;
+        std::function<void*(VkDeviceMemory memory)> map;
+    };
+
+    // A live allocation that should be copied to dst. The caller copies the data,
+    // rebinds its resource and then hands the moves back to endDefragmentation.
+    struct GpuDefragMove
+    {
+        GpuAllocation src;
+        GpuAllocation dst;
+    };
+
+class GpuAllocator {
+public:
+    static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+    static constexpr VkDeviceSize MIN_ALLOCATION_SIZE = 256;
+
+    GpuAllocator(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE);
+    GpuAllocator(const VkPhysicalDeviceMemoryProperties& memoryProperties, GpuMemoryCallbacks callbacks, VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE,
+                 VkDeviceSize bufferImageGranularity = 1);
+    ~GpuAllocator();
+
+    GpuAllocator(const GpuAllocator&) = delete;
+    GpuAllocator& operator=(const GpuAllocator&) = delete;
+
+    GpuAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+                           GpuResourceTiling tiling = GpuResourceTiling::Linear);
+    void free(GpuAllocation& allocation);
+
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, GpuAllocation& allocation);
+    void destroyBuffer(VkBuffer& buffer, GpuAllocation& allocation);
+
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+    static uint32_t findMemoryType(const VkPhysicalDeviceMemoryProperties& memProperties, uint32_t typeFilter, VkMemoryPropertyFlags properties);
+
+    // Defragmentation hooks: plan moves out of the emptiest block of each memory type,
+    // then release the sources once the GPU copies have completed.
+    std::vector<GpuDefragMove> beginDefragmentation(VkDeviceSize maxBytesToMove);
+    void endDefragmentation(std::vector<GpuDefragMove>& moves);
+    void releaseEmptyBlocks();
+
+    GpuHeapStats getHeapStats(uint32_t heapIndex) const;
+    uint32_t getHeapCount() const { return mMemoryProperties.memoryHeapCount; }
+    uint32_t getDeviceAllocationCount() const { return mDeviceAllocationCount; }
+    const VkPhysicalDeviceMemoryProperties& getMemoryProperties() const { return mMemoryProperties; }
+
+private:
+    // Buddy allocator over one VkDeviceMemory. Level 0 is the whole block,
+    // every level below halves the node size down to MIN_ALLOCATION_SIZE.
+    struct MemoryBlock
+    {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        VkDeviceSize usedBytes = 0;
+        void* mapped = nullptr;
+        bool dedicated = false;
+        bool defragSource = false;
+        // only allocations of this tiling go into the block, see blockTiling()
+        GpuResourceTiling tiling = GpuResourceTiling::Linear;
+        std::vector<std::set<VkDeviceSize>> freeLists;
+        std::unordered_map<VkDeviceSize, uint32_t> allocatedLevels;
+    };
+
+    MemoryBlock* createBlock(uint32_t memoryType, VkDeviceSize size, bool dedicated, GpuResourceTiling tiling, uint32_t& blockIndex);
+    void destroyBlock(uint32_t memoryType, uint32_t blockIndex);
+    bool allocateFromBlock(MemoryBlock& block, VkDeviceSize nodeSize, VkDeviceSize& offset);
+    void freeFromBlock(MemoryBlock& block, VkDeviceSize offset);
+    GpuAllocation allocateFromType(uint32_t memoryType, VkDeviceSize nodeSize, GpuResourceTiling tiling, bool allowNewBlock, int excludeBlock);
+    GpuResourceTiling blockTiling(GpuResourceTiling tiling) const;
+    VkDeviceSize blockSizeForType(uint32_t memoryType) const;
+    uint32_t levelCount(VkDeviceSize blockSize) const;
+
+    VkDevice mDevice = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties mMemoryProperties{};
+    GpuMemoryCallbacks mCallbacks;
+    VkDeviceSize mBlockSize;
+    VkDeviceSize mBufferImageGranularity;
+    uint32_t mDeviceAllocationCount = 0;
+
+    std::vector<std::vector<std::unique_ptr<MemoryBlock>>> mBlocks;
+    mutable std::mutex mMutex;
+};
+
+} // VulkanEngine
+
+#endif //GPUALLOCATOR_H
@@ -0,0 +1,149 @@
+#include "GpuProfiler.h"
+
+#include <stdexcept>
+#include "../Core/Profiler.h"
+
+
+namespace {
+    // query 0 is the frame start, query 1 the frame end, then a begin/end pair per scope
+    constexpr uint32_t FRAME_QUERIES = 2;
+}
+
+
+VulkanEngine::GpuProfiler::GpuProfiler(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily,
+                                       uint32_t frameCount, uint32_t maxScopes)
+    : mDevice(device), mQueriesPerFrame(FRAME_QUERIES + maxScopes * 2) {
+    mFrames.resize(frameCount);
+    mResults.resize(mQueriesPerFrame * 2);
+
+    VkPhysicalDeviceProperties deviceProp;
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProp);
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+
+    uint32_t validBits = queueFamily < familyCount ? families[queueFamily].timestampValidBits : 0;
+    if (validBits == 0 || deviceProp.limits.timestampPeriod == 0.0f) {
+        return;
+    }
+    mTimestampPeriod = deviceProp.limits.timestampPeriod;
+    mTimestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = mQueriesPerFrame * frameCount;
+
+    if (vkCreateQueryPool(mDevice, &poolInfo, nullptr, &mQueryPool) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create timestamp query pool");
+    }
+}
+
+
+VulkanEngine::GpuProfiler::~GpuProfiler() {
+    if (mQueryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(mDevice, mQueryPool, nullptr);
+    }
+}
+
+
+void
+VulkanEngine::GpuProfiler::collect(uint32_t frameIndex) {
+    FrameSlot& frame = mFrames[frameIndex];
+    if (!isSupported() || !frame.pending) {
+        return;
+    }
+    frame.pending = false;
+
+    // every query comes with its availability, a scope that was never closed just gets skipped
+    VkResult result = vkGetQueryPoolResults(mDevice, mQueryPool, frameIndex * mQueriesPerFrame, frame.queryCount,
+                                            frame.queryCount * 2 * sizeof(uint64_t), mResults.data(), 2 * sizeof(uint64_t),
+                                            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (result != VK_SUCCESS && result != VK_NOT_READY) {
+        return;
+    }
+
+    auto value = [this](uint32_t query) { return mResults[query * 2] & mTimestampMask; };
+    auto available = [this](uint32_t query) { return mResults[query * 2 + 1] != 0; };
+    if (!available(0) || !available(1)) {
+        return;
+    }
+
+    uint64_t frameStart = value(0);
+    auto toProfilerTime = [&](uint64_t timestamp) {
+        return frame.submitTime + static_cast<int64_t>(((timestamp - frameStart) & mTimestampMask) * mTimestampPeriod);
+    };
+
+    Profiler::recordGpuEvent("GPU frame", frame.submitTime, toProfilerTime(value(1)));
+    Profiler::recordGpuFrameTime(((value(1) - frameStart) & mTimestampMask) * mTimestampPeriod / 1e6);
+
+    for (uint32_t scope = 0; scope < frame.names.size(); scope++) {
+        uint32_t begin = FRAME_QUERIES + scope * 2;
+        if (begin + 1 < frame.queryCount && available(begin) && available(begin + 1)) {
+            Profiler::recordGpuEvent(frame.names[scope], toProfilerTime(value(begin)), toProfilerTime(value(begin + 1)));
+        }
+    }
+}
+
+
+void
+VulkanEngine::GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+    if (!isSupported()) {
+        return;
+    }
+
+    mCurrentFrame = frameIndex;
+    FrameSlot& frame = mFrames[frameIndex];
+    frame.names.clear();
+    frame.queryCount = FRAME_QUERIES;
+    frame.pending = false;
+
+    vkCmdResetQueryPool(commandBuffer, mQueryPool, frameIndex * mQueriesPerFrame, mQueriesPerFrame);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, mQueryPool, frameIndex * mQueriesPerFrame);
+}
+
+
+void
+VulkanEngine::GpuProfiler::endFrame(VkCommandBuffer commandBuffer) {
+    if (!isSupported()) {
+        return;
+    }
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mQueryPool, mCurrentFrame * mQueriesPerFrame + 1);
+    mFrames[mCurrentFrame].pending = true;
+}
+
+
+void
+VulkanEngine::GpuProfiler::markSubmitted() {
+    mFrames[mCurrentFrame].submitTime = Profiler::now();
+}
+
+
+uint32_t
+VulkanEngine::GpuProfiler::beginScope(VkCommandBuffer commandBuffer, const char* name) {
+    FrameSlot& frame = mFrames[mCurrentFrame];
+    if (!isSupported() || frame.queryCount + 2 > mQueriesPerFrame) {
+        return INVALID_SCOPE;
+    }
+
+    uint32_t scope = static_cast<uint32_t>(frame.names.size());
+    frame.names.push_back(name);
+    frame.queryCount += 2;
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, mQueryPool,
+                        mCurrentFrame * mQueriesPerFrame + FRAME_QUERIES + scope * 2);
+    return scope;
+}
+
+
+void
+VulkanEngine::GpuProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t scope) {
+    if (scope == INVALID_SCOPE) {
+        return;
+    }
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mQueryPool,
+                        mCurrentFrame * mQueriesPerFrame + FRAME_QUERIES + scope * 2 + 1);
+}
@@ -0,0 +1,60 @@
+#ifndef GPUPROFILER_H
+#define GPUPROFILER_H
+
+
+#include <vector>
+#include "vulkan/vulkan.h"
+
+
+namespace VulkanEngine {
+
+// GPU scopes through vkCmdWriteTimestamp, a query range per frame in flight handed to the Profiler
+// as its "GPU" track. A no-op on queues without timestamp support.
+class GpuProfiler {
+public:
+    GpuProfiler(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily, uint32_t frameCount, uint32_t maxScopes = 32);
+    ~GpuProfiler();
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    bool isSupported() const { return mQueryPool != VK_NULL_HANDLE; }
+
+    // Once the frame's timeline value is reached, before beginFrame().
+    void collect(uint32_t frameIndex);
+
+    // Outside a render pass, first thing in the frame's primary command buffer.
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+    void endFrame(VkCommandBuffer commandBuffer);
+    // Call right before the command buffer is submitted.
+    void markSubmitted();
+
+    // Scopes beyond maxScopes in a frame are dropped. Names must outlive the profiler.
+    uint32_t beginScope(VkCommandBuffer commandBuffer, const char* name);
+    void endScope(VkCommandBuffer commandBuffer, uint32_t scope);
+
+private:
+    static constexpr uint32_t INVALID_SCOPE = UINT32_MAX;
+
+    struct FrameSlot
+    {
+        std::vector<const char*> names;
+        uint32_t queryCount = 0;
+        int64_t submitTime = 0;
+        bool pending = false;
+    };
+
+    VkDevice mDevice;
+    VkQueryPool mQueryPool = VK_NULL_HANDLE;
+    uint32_t mQueriesPerFrame;
+    double mTimestampPeriod = 1.0;
+    uint64_t mTimestampMask = ~0ull;
+
+    std::vector<FrameSlot> mFrames;
+    std::vector<uint64_t> mResults;
+    uint32_t mCurrentFrame = 0;
+};
+
+} // VulkanEngine
+
+#endif //GPUPROFILER_H
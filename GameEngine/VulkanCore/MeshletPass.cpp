@@ -0,0 +1,440 @@
+#include "MeshletPass.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+
+namespace {
+    constexpr VkShaderStageFlags MESH_SHADER_STAGES = VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+}
+
+
+bool
+VulkanEngine::MeshletPass::supportsMeshShaders(VkPhysicalDevice physicalDevice) {
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+    bool found = std::any_of(extensions.begin(), extensions.end(), [](const VkExtensionProperties& extension) {
+        return std::strcmp(extension.extensionName, VK_EXT_MESH_SHADER_EXTENSION_NAME) == 0;
+    });
+    if (!found) {
+        return false;
+    }
+
+    VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures{};
+    meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+    VkPhysicalDeviceFeatures2 features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &meshShaderFeatures;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+    return meshShaderFeatures.taskShader && meshShaderFeatures.meshShader;
+}
+
+
+VkPushConstantRange
+VulkanEngine::MeshletPass::getPushConstantRange() {
+    VkPushConstantRange range{};
+    range.stageFlags = MESH_SHADER_STAGES;
+    range.offset = 0;
+    range.size = sizeof(MeshShaderConstants);
+    return range;
+}
+
+
+VulkanEngine::MeshletPass::MeshletPass(VkDevice device, GpuAllocator& allocator, TransferQueue& uploader, BindlessTable& bindless,
+                                       VkPipelineCache pipelineCache, Mode mode, const MeshData& mesh, uint32_t lod, VkBuffer vertexBuffer,
+                                       const std::vector<char>& cullShaderCode, uint32_t frameCount, uint32_t maxObjects, uint32_t sliceCount)
+    : mDevice(device), mAllocator(allocator), mBindless(bindless), mMode(mode), mSliceCount(sliceCount) {
+    uploadMeshlets(uploader, mesh, lod);
+
+    // compute mode compacts every slice into its own range of the draw buffer
+    uint64_t maxDraws = std::min<uint64_t>(uint64_t(maxObjects) * mMeshletCount, MAX_DRAWS);
+    mSliceCapacity = std::max<uint32_t>(static_cast<uint32_t>(maxDraws / mSliceCount), 1);
+
+    if (mMode == Mode::MeshShader) {
+        mDrawMeshTasks = reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(vkGetDeviceProcAddr(mDevice, "vkCmdDrawMeshTasksEXT"));
+        if (mDrawMeshTasks == nullptr) {
+            throw std::runtime_error("ERROR: vkCmdDrawMeshTasksEXT is not available");
+        }
+        mSlots.meshletBuffer = mBindless.addStorageBuffer(mMeshletBuffer);
+        mSlots.meshletVertexBuffer = mBindless.addStorageBuffer(mMeshletVertexBuffer);
+        mSlots.meshletTriangleBuffer = mBindless.addStorageBuffer(mMeshletTriangleBuffer);
+        mSlots.vertexBuffer = mBindless.addStorageBuffer(vertexBuffer);
+    }
+
+    mFrames.resize(frameCount);
+    for (auto& frame : mFrames) {
+        if (mMode == Mode::Compute) {
+            mAllocator.createBuffer(sizeof(VkDrawIndexedIndirectCommand) * mSliceCapacity * mSliceCount,
+                                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.drawBuffer, frame.drawAllocation);
+        }
+        mAllocator.createBuffer(sizeof(uint32_t) * mSliceCount,
+                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.countBuffer, frame.countAllocation);
+        mAllocator.createBuffer(sizeof(uint32_t) * mSliceCount, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                frame.readbackBuffer, frame.readbackAllocation);
+        std::memset(frame.readbackAllocation.mapped, 0, sizeof(uint32_t) * mSliceCount);
+        if (mMode == Mode::MeshShader) {
+            frame.countIndex = mBindless.addStorageBuffer(frame.countBuffer);
+        }
+    }
+
+    if (mMode == Mode::Compute) {
+        createDescriptors(frameCount);
+        createPipeline(pipelineCache, cullShaderCode);
+    }
+}
+
+
+VulkanEngine::MeshletPass::~MeshletPass() {
+    if (mMode == Mode::Compute) {
+        vkDestroyPipeline(mDevice, mPipeline, nullptr);
+        vkDestroyPipelineLayout(mDevice, mPipelineLayout, nullptr);
+        vkDestroyDescriptorPool(mDevice, mDescriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(mDevice, mDescriptorSetLayout, nullptr);
+    } else {
+        mBindless.removeStorageBuffer(mSlots.meshletBuffer);
+        mBindless.removeStorageBuffer(mSlots.meshletVertexBuffer);
+        mBindless.removeStorageBuffer(mSlots.meshletTriangleBuffer);
+        mBindless.removeStorageBuffer(mSlots.vertexBuffer);
+    }
+
+    for (auto& frame : mFrames) {
+        if (frame.countIndex != BindlessTable::INVALID_INDEX) {
+            mBindless.removeStorageBuffer(frame.countIndex);
+        }
+        if (frame.drawBuffer != VK_NULL_HANDLE) {
+            mAllocator.destroyBuffer(frame.drawBuffer, frame.drawAllocation);
+        }
+        mAllocator.destroyBuffer(frame.countBuffer, frame.countAllocation);
+        mAllocator.destroyBuffer(frame.readbackBuffer, frame.readbackAllocation);
+    }
+    mAllocator.destroyBuffer(mMeshletBuffer, mMeshletAllocation);
+    if (mMeshletVertexBuffer != VK_NULL_HANDLE) {
+        mAllocator.destroyBuffer(mMeshletVertexBuffer, mMeshletVertexAllocation);
+        mAllocator.destroyBuffer(mMeshletTriangleBuffer, mMeshletTriangleAllocation);
+    }
+}
+
+
+void
+VulkanEngine::MeshletPass::setInputBuffers(VkBuffer buffer, VkDeviceSize frameDataRange, VkDeviceSize objectDataRange) {
+    // the mesh shaders read set 0 of the caller's pipeline instead
+    if (mMode != Mode::Compute) {
+        return;
+    }
+
+    VkDescriptorBufferInfo frameInfo{};
+    frameInfo.buffer = buffer;
+    frameInfo.offset = 0;
+    frameInfo.range = frameDataRange;
+
+    VkDescriptorBufferInfo objectInfo{};
+    objectInfo.buffer = buffer;
+    objectInfo.offset = 0;
+    objectInfo.range = objectDataRange;
+
+    std::vector<VkWriteDescriptorSet> writes;
+    for (auto& frame : mFrames) {
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = frame.descriptorSet;
+        write.descriptorCount = 1;
+
+        write.dstBinding = 0;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        write.pBufferInfo = &frameInfo;
+        writes.push_back(write);
+
+        write.dstBinding = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        write.pBufferInfo = &objectInfo;
+        writes.push_back(write);
+    }
+    vkUpdateDescriptorSets(mDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+
+void
+VulkanEngine::MeshletPass::record(VkCommandBuffer commandBuffer, uint32_t frameIndex,
+                                  uint32_t frameDataOffset, uint32_t objectDataOffset, uint32_t objectCount) {
+    FrameResources& frame = mFrames[frameIndex];
+    frame.objectCount = objectCount;
+    frame.sliceObjects = (objectCount + mSliceCount - 1) / mSliceCount;
+
+    vkCmdFillBuffer(commandBuffer, frame.countBuffer, 0, sizeof(uint32_t) * mSliceCount, 0);
+
+    // the task shader culls while drawing, there is nothing to do ahead of the render pass
+    if (mMode != Mode::Compute || objectCount == 0 || mMeshletCount == 0) {
+        return;
+    }
+
+    VkBufferMemoryBarrier clearBarrier{};
+    clearBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    clearBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    clearBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    clearBarrier.buffer = frame.countBuffer;
+    clearBarrier.offset = 0;
+    clearBarrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                         0, nullptr, 1, &clearBarrier, 0, nullptr);
+
+    uint32_t dynamicOffsets[] = { frameDataOffset, objectDataOffset };
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipelineLayout, 0, 1,
+                            &frame.descriptorSet, 2, dynamicOffsets);
+
+    CullConstants constants{};
+    constants.objectCount = objectCount;
+    constants.meshletCount = mMeshletCount;
+    constants.sliceObjects = frame.sliceObjects;
+    constants.sliceCapacity = mSliceCapacity;
+    vkCmdPushConstants(commandBuffer, mPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+
+    // one row of meshlets per object
+    vkCmdDispatch(commandBuffer, (mMeshletCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, objectCount, 1);
+}
+
+
+void
+VulkanEngine::MeshletPass::draw(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t slice, VkPipelineLayout layout) const {
+    const FrameResources& frame = mFrames[frameIndex];
+    uint32_t first = slice * frame.sliceObjects;
+    if (first >= frame.objectCount || mMeshletCount == 0) {
+        return;
+    }
+
+    if (mMode == Mode::Compute) {
+        const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+        vkCmdDrawIndexedIndirectCount(commandBuffer, frame.drawBuffer, VkDeviceSize(slice) * mSliceCapacity * stride,
+                                      frame.countBuffer, slice * sizeof(uint32_t), mSliceCapacity, stride);
+        return;
+    }
+
+    MeshShaderConstants constants = mSlots;
+    constants.counterBuffer = frame.countIndex;
+    constants.meshletCount = mMeshletCount;
+    constants.firstObject = first;
+    constants.objectCount = std::min(frame.sliceObjects, frame.objectCount - first);
+    vkCmdPushConstants(commandBuffer, layout, MESH_SHADER_STAGES, 0, sizeof(constants), &constants);
+
+    // x walks the meshlets 32 at a time, y the slice's objects
+    mDrawMeshTasks(commandBuffer, (mMeshletCount + TASK_WORKGROUP_SIZE - 1) / TASK_WORKGROUP_SIZE, constants.objectCount, 1);
+}
+
+
+void
+VulkanEngine::MeshletPass::recordReadback(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+    FrameResources& frame = mFrames[frameIndex];
+
+    VkBufferCopy copyRegion{};
+    copyRegion.size = sizeof(uint32_t) * mSliceCount;
+    vkCmdCopyBuffer(commandBuffer, frame.countBuffer, frame.readbackBuffer, 1, &copyRegion);
+
+    VkMemoryBarrier readbackBarrier{};
+    readbackBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    readbackBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    readbackBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                         1, &readbackBarrier, 0, nullptr, 0, nullptr);
+}
+
+
+uint32_t
+VulkanEngine::MeshletPass::getVisibleCount(uint32_t frameIndex) const {
+    const uint32_t* counts = static_cast<const uint32_t*>(mFrames[frameIndex].readbackAllocation.mapped);
+    uint32_t visible = 0;
+    for (uint32_t i = 0; i < mSliceCount; i++) {
+        visible += counts[i];
+    }
+    return visible;
+}
+
+
+void
+VulkanEngine::MeshletPass::uploadMeshlets(TransferQueue& uploader, const MeshData& mesh, uint32_t lod) {
+    const MeshLod& level = mesh.lods.at(lod);
+    mMeshletCount = level.meshletCount;
+
+    // meshlets of a level are consecutive index ranges, see MeshletBuilder.h
+    std::vector<GpuMeshlet> meshlets(std::max<uint32_t>(mMeshletCount, 1), GpuMeshlet{});
+    uint32_t firstIndex = level.firstIndex;
+    for (uint32_t i = 0; i < mMeshletCount; i++) {
+        const Meshlet& meshlet = mesh.meshlets[level.firstMeshlet + i];
+        GpuMeshlet& gpu = meshlets[i];
+        std::memcpy(gpu.sphere, meshlet.center, sizeof(meshlet.center));
+        gpu.sphere[3] = meshlet.radius;
+        std::memcpy(gpu.cone, meshlet.coneAxis, sizeof(meshlet.coneAxis));
+        gpu.cone[3] = meshlet.coneCutoff;
+        gpu.vertexOffset = meshlet.vertexOffset;
+        gpu.triangleOffset = meshlet.triangleOffset;
+        gpu.vertexCount = meshlet.vertexCount;
+        gpu.triangleCount = meshlet.triangleCount;
+        gpu.firstIndex = firstIndex;
+        firstIndex += meshlet.triangleCount * 3;
+    }
+
+    const VkPipelineStageFlags readStage = mMode == Mode::Compute ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+                                                                  : VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT | VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT;
+    VkDeviceSize meshletSize = sizeof(GpuMeshlet) * meshlets.size();
+    mMeshletBuffer = createStorageBuffer(meshletSize, mMeshletAllocation);
+    uploader.uploadBuffer(mMeshletBuffer, 0, meshlets.data(), meshletSize, readStage, VK_ACCESS_SHADER_READ_BIT);
+
+    // only the mesh shader reads the meshlets' own vertex and triangle lists
+    if (mMode != Mode::MeshShader) {
+        return;
+    }
+    const std::vector<uint32_t> empty(1, 0);
+    auto upload = [&](const void* data, VkDeviceSize size, VkBuffer& buffer, GpuAllocation& allocation) {
+        if (size == 0) {
+            data = empty.data();
+            size = sizeof(uint32_t);
+        }
+        // the shader reads the triangle bytes as whole words
+        buffer = createStorageBuffer((size + 3) & ~VkDeviceSize(3), allocation);
+        uploader.uploadBuffer(buffer, 0, data, size, readStage, VK_ACCESS_SHADER_READ_BIT);
+    };
+    upload(mesh.meshletVertices.data(), mesh.meshletVertices.byteSize(), mMeshletVertexBuffer, mMeshletVertexAllocation);
+    upload(mesh.meshletTriangles.data(), mesh.meshletTriangles.byteSize(), mMeshletTriangleBuffer, mMeshletTriangleAllocation);
+}
+
+
+VkBuffer
+VulkanEngine::MeshletPass::createStorageBuffer(VkDeviceSize size, GpuAllocation& allocation) {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    mAllocator.createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, allocation);
+    return buffer;
+}
+
+
+void
+VulkanEngine::MeshletPass::createDescriptors(uint32_t frameCount) {
+    VkDescriptorSetLayoutBinding bindings[5]{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    for (uint32_t binding = 2; binding < 5; binding++) {
+        bindings[binding].binding = binding;
+        bindings[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    }
+    for (auto& binding : bindings) {
+        binding.descriptorCount = 1;
+        binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 5;
+    layoutInfo.pBindings = bindings;
+
+    if (vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &mDescriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create meshlet culling descriptor set layout");
+    }
+
+    VkDescriptorPoolSize poolSizes[3]{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSizes[0].descriptorCount = frameCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    poolSizes[1].descriptorCount = frameCount;
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[2].descriptorCount = frameCount * 3;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 3;
+    poolInfo.pPoolSizes = poolSizes;
+    poolInfo.maxSets = frameCount;
+
+    if (vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &mDescriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create meshlet culling descriptor pool");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(frameCount, mDescriptorSetLayout);
+    std::vector<VkDescriptorSet> sets(frameCount);
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = mDescriptorPool;
+    allocInfo.descriptorSetCount = frameCount;
+    allocInfo.pSetLayouts = layouts.data();
+
+    if (vkAllocateDescriptorSets(mDevice, &allocInfo, sets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to allocate meshlet culling descriptor sets");
+    }
+
+    std::vector<VkDescriptorBufferInfo> bufferInfos(frameCount * 3);
+    std::vector<VkWriteDescriptorSet> writes;
+    for (uint32_t i = 0; i < frameCount; i++) {
+        mFrames[i].descriptorSet = sets[i];
+
+        bufferInfos[i * 3] = { mMeshletBuffer, 0, VK_WHOLE_SIZE };
+        bufferInfos[i * 3 + 1] = { mFrames[i].drawBuffer, 0, VK_WHOLE_SIZE };
+        bufferInfos[i * 3 + 2] = { mFrames[i].countBuffer, 0, VK_WHOLE_SIZE };
+
+        for (uint32_t binding = 2; binding < 5; binding++) {
+            VkWriteDescriptorSet write{};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = sets[i];
+            write.dstBinding = binding;
+            write.descriptorCount = 1;
+            write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            write.pBufferInfo = &bufferInfos[i * 3 + binding - 2];
+            writes.push_back(write);
+        }
+    }
+    vkUpdateDescriptorSets(mDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+
+void
+VulkanEngine::MeshletPass::createPipeline(VkPipelineCache pipelineCache, const std::vector<char>& shaderCode) {
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(CullConstants);
+
+    VkPipelineLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &mDescriptorSetLayout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(mDevice, &layoutInfo, nullptr, &mPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create meshlet culling pipeline layout");
+    }
+
+    VkShaderModuleCreateInfo moduleInfo{};
+    moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleInfo.codeSize = shaderCode.size();
+    moduleInfo.pCode = reinterpret_cast<const uint32_t*>(shaderCode.data());
+
+    VkShaderModule shaderModule;
+    if (vkCreateShaderModule(mDevice, &moduleInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create meshlet culling shader module");
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = mPipelineLayout;
+
+    VkResult result = vkCreateComputePipelines(mDevice, pipelineCache, 1, &pipelineInfo, nullptr, &mPipeline);
+    vkDestroyShaderModule(mDevice, shaderModule, nullptr);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create meshlet culling pipeline");
+    }
+}
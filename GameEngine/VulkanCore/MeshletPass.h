@@ -0,0 +1,145 @@
+#ifndef MESHLETPASS_H
+#define MESHLETPASS_H
+
+
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "GpuAllocator.h"
+#include "TransferQueue.h"
+#include "BindlessTable.h"
+#include "../Core/MeshData.h"
+
+
+namespace VulkanEngine {
+
+// The meshlet counterpart of CullingPass, culling every meshlet against the frustum and its normal
+// cone. MeshShader mode culls in a task shader, Compute mode writes indirect draws and needs
+// drawIndirectCount.
+class MeshletPass {
+public:
+    enum class Mode
+    {
+        MeshShader,
+        Compute
+    };
+
+    static constexpr uint32_t WORKGROUP_SIZE = 64;
+    static constexpr uint32_t TASK_WORKGROUP_SIZE = 32;
+    // Compute mode keeps at most this many meshlet draws per frame.
+    static constexpr uint32_t MAX_DRAWS = 1u << 20;
+
+    // Push constants of the task and mesh shaders.
+    struct MeshShaderConstants
+    {
+        uint32_t meshletBuffer;
+        uint32_t meshletVertexBuffer;
+        uint32_t meshletTriangleBuffer;
+        uint32_t vertexBuffer;
+        uint32_t counterBuffer;
+        uint32_t meshletCount;
+        uint32_t firstObject;
+        uint32_t objectCount;
+    };
+
+    // The extension and its task and mesh shader features.
+    static bool supportsMeshShaders(VkPhysicalDevice physicalDevice);
+    static VkPushConstantRange getPushConstantRange();
+
+    // vertexBuffer needs STORAGE_BUFFER usage in MeshShader mode.
+    MeshletPass(VkDevice device, GpuAllocator& allocator, TransferQueue& uploader, BindlessTable& bindless,
+                VkPipelineCache pipelineCache, Mode mode, const MeshData& mesh, uint32_t lod, VkBuffer vertexBuffer,
+                const std::vector<char>& cullShaderCode, uint32_t frameCount, uint32_t maxObjects, uint32_t sliceCount);
+    ~MeshletPass();
+
+    MeshletPass(const MeshletPass&) = delete;
+    MeshletPass& operator=(const MeshletPass&) = delete;
+
+    // Frame and object data come from the frame ring, as for CullingPass::setInputBuffers.
+    void setInputBuffers(VkBuffer buffer, VkDeviceSize frameDataRange, VkDeviceSize objectDataRange);
+
+    // Outside of a render pass, the caller puts the barrier between this and draw().
+    void record(VkCommandBuffer commandBuffer, uint32_t frameIndex,
+                uint32_t frameDataOffset, uint32_t objectDataOffset, uint32_t objectCount);
+    // Safe to call for different slices from several threads.
+    void draw(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t slice, VkPipelineLayout layout) const;
+    // After the render pass and a barrier to transfer reads.
+    void recordReadback(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+    Mode getMode() const { return mMode; }
+    uint32_t getMeshletCount() const { return mMeshletCount; }
+
+    // Once the frame's timeline value has been reached.
+    uint32_t getVisibleCount(uint32_t frameIndex) const;
+
+private:
+    // std430 layout of MeshletData in the shaders
+    struct GpuMeshlet
+    {
+        float sphere[4];
+        float cone[4];
+        uint32_t vertexOffset;
+        uint32_t triangleOffset;
+        uint32_t vertexCount;
+        uint32_t triangleCount;
+        uint32_t firstIndex;
+        uint32_t padding[3];
+    };
+
+    struct CullConstants
+    {
+        uint32_t objectCount;
+        uint32_t meshletCount;
+        uint32_t sliceObjects;
+        uint32_t sliceCapacity;
+    };
+
+    struct FrameResources
+    {
+        VkBuffer drawBuffer = VK_NULL_HANDLE;
+        GpuAllocation drawAllocation;
+        // one counter per slice, visible meshlets
+        VkBuffer countBuffer = VK_NULL_HANDLE;
+        GpuAllocation countAllocation;
+        uint32_t countIndex = BindlessTable::INVALID_INDEX;
+        VkBuffer readbackBuffer = VK_NULL_HANDLE;
+        GpuAllocation readbackAllocation;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        uint32_t objectCount = 0;
+        uint32_t sliceObjects = 0;
+    };
+
+    void uploadMeshlets(TransferQueue& uploader, const MeshData& mesh, uint32_t lod);
+    VkBuffer createStorageBuffer(VkDeviceSize size, GpuAllocation& allocation);
+    void createDescriptors(uint32_t frameCount);
+    void createPipeline(VkPipelineCache pipelineCache, const std::vector<char>& shaderCode);
+
+    VkDevice mDevice;
+    GpuAllocator& mAllocator;
+    BindlessTable& mBindless;
+    Mode mMode;
+    uint32_t mSliceCount;
+    uint32_t mSliceCapacity;
+    uint32_t mMeshletCount = 0;
+
+    VkBuffer mMeshletBuffer = VK_NULL_HANDLE;
+    GpuAllocation mMeshletAllocation;
+    VkBuffer mMeshletVertexBuffer = VK_NULL_HANDLE;
+    GpuAllocation mMeshletVertexAllocation;
+    VkBuffer mMeshletTriangleBuffer = VK_NULL_HANDLE;
+    GpuAllocation mMeshletTriangleAllocation;
+    // bindless slots of the buffers above and of the vertex buffer, MeshShader mode only
+    MeshShaderConstants mSlots{};
+
+    PFN_vkCmdDrawMeshTasksEXT mDrawMeshTasks = nullptr;
+
+    VkDescriptorSetLayout mDescriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool mDescriptorPool = VK_NULL_HANDLE;
+    VkPipelineLayout mPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline mPipeline = VK_NULL_HANDLE;
+
+    std::vector<FrameResources> mFrames;
+};
+
+} // VulkanEngine
+
+#endif //MESHLETPASS_H
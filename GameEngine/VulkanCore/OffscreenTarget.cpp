@@ -0,0 +1,138 @@
+#include "OffscreenTarget.h"
+
+#include <stdexcept>
+
+
+namespace {
+    constexpr VkDeviceSize READBACK_SLOT_ALIGNMENT = 256;
+}
+
+
+VulkanEngine::OffscreenTarget::OffscreenTarget(VkDevice device, GpuAllocator& allocator, VkFormat format,
+                                               VkExtent2D extent, uint32_t frameCount)
+    : mDevice(device), mAllocator(allocator), mFormat(format), mExtent(extent) {
+    // every format the engine renders to has 4 byte texels
+    mFrameSize = VkDeviceSize(extent.width) * extent.height * 4;
+    mSlotSize = (mFrameSize + READBACK_SLOT_ALIGNMENT - 1) / READBACK_SLOT_ALIGNMENT * READBACK_SLOT_ALIGNMENT;
+
+    mImages.resize(frameCount);
+    mImageAllocations.resize(frameCount);
+    mImageViews.resize(frameCount);
+
+    for (uint32_t i = 0; i < frameCount; i++) {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = format;
+        imageInfo.extent = {extent.width, extent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        if (vkCreateImage(mDevice, &imageInfo, nullptr, &mImages[i]) != VK_SUCCESS) {
+            throw std::runtime_error("ERROR: failed to create offscreen image");
+        }
+
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(mDevice, mImages[i], &requirements);
+        mImageAllocations[i] = mAllocator.allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, GpuResourceTiling::Optimal);
+        vkBindImageMemory(mDevice, mImages[i], mImageAllocations[i].memory, mImageAllocations[i].offset);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = mImages[i];
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(mDevice, &viewInfo, nullptr, &mImageViews[i]) != VK_SUCCESS) {
+            throw std::runtime_error("ERROR: failed to create offscreen image view");
+        }
+    }
+
+    // cached memory makes the CPU reads fast, coherent memory is the fallback
+    VkDeviceSize readbackSize = mSlotSize * frameCount;
+    try {
+        mAllocator.createBuffer(readbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                                mReadbackBuffer, mReadbackAllocation);
+    } catch (const std::runtime_error&) {
+        mAllocator.createBuffer(readbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                mReadbackBuffer, mReadbackAllocation);
+    }
+    VkMemoryPropertyFlags readbackFlags = mAllocator.getMemoryProperties().memoryTypes[mReadbackAllocation.memoryType].propertyFlags;
+    mReadbackCoherent = (readbackFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+}
+
+
+VulkanEngine::OffscreenTarget::~OffscreenTarget() {
+    mAllocator.destroyBuffer(mReadbackBuffer, mReadbackAllocation);
+
+    for (uint32_t i = 0; i < mImages.size(); i++) {
+        vkDestroyImageView(mDevice, mImageViews[i], nullptr);
+        vkDestroyImage(mDevice, mImages[i], nullptr);
+        mAllocator.free(mImageAllocations[i]);
+    }
+}
+
+
+void
+VulkanEngine::OffscreenTarget::recordReadback(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+    // the render pass already moved the image to TRANSFER_SRC, this only orders the copy after it
+    VkImageMemoryBarrier renderBarrier{};
+    renderBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    renderBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    renderBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    renderBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    renderBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    renderBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    renderBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    renderBarrier.image = mImages[frameIndex];
+    renderBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &renderBarrier);
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = mSlotSize * frameIndex;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {mExtent.width, mExtent.height, 1};
+    vkCmdCopyImageToBuffer(commandBuffer, mImages[frameIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mReadbackBuffer, 1, &region);
+
+    VkBufferMemoryBarrier hostBarrier{};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.buffer = mReadbackBuffer;
+    hostBarrier.offset = region.bufferOffset;
+    hostBarrier.size = mFrameSize;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                         0, nullptr, 1, &hostBarrier, 0, nullptr);
+}
+
+
+const uint8_t*
+VulkanEngine::OffscreenTarget::getPixels(uint32_t frameIndex) const {
+    if (!mReadbackCoherent) {
+        VkMappedMemoryRange range{};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = mReadbackAllocation.memory;
+        range.offset = mReadbackAllocation.offset;
+        range.size = VK_WHOLE_SIZE;
+        vkInvalidateMappedMemoryRanges(mDevice, 1, &range);
+    }
+    return static_cast<const uint8_t*>(mReadbackAllocation.mapped) + mSlotSize * frameIndex;
+}
@@ -0,0 +1,53 @@
+#ifndef OFFSCREENTARGET_H
+#define OFFSCREENTARGET_H
+
+
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "GpuAllocator.h"
+
+
+namespace VulkanEngine {
+
+// Stand-in for the swapchain when there is no display: a colour image and a mapped readback slot
+// per frame in flight. The render pass must leave the image in TRANSFER_SRC_OPTIMAL.
+class OffscreenTarget {
+public:
+    OffscreenTarget(VkDevice device, GpuAllocator& allocator, VkFormat format, VkExtent2D extent, uint32_t frameCount);
+    ~OffscreenTarget();
+
+    OffscreenTarget(const OffscreenTarget&) = delete;
+    OffscreenTarget& operator=(const OffscreenTarget&) = delete;
+
+    VkFormat getFormat() const { return mFormat; }
+    VkExtent2D getExtent() const { return mExtent; }
+    const std::vector<VkImage>& getImages() const { return mImages; }
+    const std::vector<VkImageView>& getImageViews() const { return mImageViews; }
+
+    // Copies the frame's image into its readback slot. Record after the render pass.
+    void recordReadback(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+    // Tightly packed rows of 4 byte texels. Only valid once the frame's timeline value has been reached.
+    const uint8_t* getPixels(uint32_t frameIndex) const;
+    VkDeviceSize getFrameSize() const { return mFrameSize; }
+
+private:
+    VkDevice mDevice;
+    GpuAllocator& mAllocator;
+    VkFormat mFormat;
+    VkExtent2D mExtent;
+    VkDeviceSize mFrameSize;
+
+    std::vector<VkImage> mImages;
+    std::vector<GpuAllocation> mImageAllocations;
+    std::vector<VkImageView> mImageViews;
+
+    VkBuffer mReadbackBuffer = VK_NULL_HANDLE;
+    GpuAllocation mReadbackAllocation;
+    VkDeviceSize mSlotSize;
+    bool mReadbackCoherent;
+};
+
+} // VulkanEngine
+
+#endif //OFFSCREENTARGET_H
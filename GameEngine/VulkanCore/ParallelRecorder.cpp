@@ -0,0 +1,99 @@
+#include "ParallelRecorder.h"
+
+#include <stdexcept>
+#include "../Core/Profiler.h"
+
+
+VulkanEngine::ParallelRecorder::ParallelRecorder(VkDevice device, JobSystem& jobs, uint32_t queueFamily,
+                                                 uint32_t frameCount, uint32_t sliceCount)
+    : mDevice(device), mJobs(jobs) {
+    mSlices.resize(sliceCount > 0 ? sliceCount : 1);
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = queueFamily;
+
+    for (auto& slice : mSlices) {
+        slice.pools.resize(frameCount);
+        slice.commandBuffers.resize(frameCount);
+
+        for (uint32_t frame = 0; frame < frameCount; frame++) {
+            if (vkCreateCommandPool(mDevice, &poolInfo, nullptr, &slice.pools[frame]) != VK_SUCCESS) {
+                throw std::runtime_error("ERROR: failed to create worker command pool");
+            }
+
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = slice.pools[frame];
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocInfo.commandBufferCount = 1;
+
+            if (vkAllocateCommandBuffers(mDevice, &allocInfo, &slice.commandBuffers[frame]) != VK_SUCCESS) {
+                throw std::runtime_error("ERROR: failed to allocate secondary command buffer");
+            }
+        }
+    }
+}
+
+
+VulkanEngine::ParallelRecorder::~ParallelRecorder() {
+    for (auto& slice : mSlices) {
+        for (auto pool : slice.pools) {
+            vkDestroyCommandPool(mDevice, pool, nullptr);
+        }
+    }
+}
+
+
+const std::vector<VkCommandBuffer>&
+VulkanEngine::ParallelRecorder::record(uint32_t frameIndex, const VkCommandBufferInheritanceInfo& inheritance,
+                                       const RecordFunction& function) {
+    // slice 0 is recorded by the calling thread while the others run as jobs
+    JobCounter counter;
+    for (uint32_t i = 1; i < mSlices.size(); i++) {
+        mJobs.run([this, i, frameIndex, &inheritance, &function] {
+            recordSlice(i, frameIndex, inheritance, function);
+        }, &counter);
+    }
+    // the jobs reference the arguments, so they have to finish even if slice 0 fails
+    try {
+        recordSlice(0, frameIndex, inheritance, function);
+    } catch (...) {
+        mJobs.wait(counter);
+        throw;
+    }
+    mJobs.wait(counter);
+
+    mRecorded.clear();
+    for (auto& slice : mSlices) {
+        mRecorded.push_back(slice.commandBuffers[frameIndex]);
+    }
+    return mRecorded;
+}
+
+
+void
+VulkanEngine::ParallelRecorder::recordSlice(uint32_t slice, uint32_t frameIndex, const VkCommandBufferInheritanceInfo& inheritance,
+                                            const RecordFunction& function) {
+    PROFILE_SCOPE("Record slice");
+
+    vkResetCommandPool(mDevice, mSlices[slice].pools[frameIndex], 0);
+
+    VkCommandBuffer commandBuffer = mSlices[slice].commandBuffers[frameIndex];
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritance;
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to begin secondary command buffer");
+    }
+
+    function(commandBuffer, slice);
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to record secondary command buffer");
+    }
+}
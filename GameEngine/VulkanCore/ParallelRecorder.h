@@ -0,0 +1,49 @@
+#ifndef PARALLELRECORDER_H
+#define PARALLELRECORDER_H
+
+
+#include <vector>
+#include <functional>
+#include "vulkan/vulkan.h"
+#include "../Core/JobSystem.h"
+
+
+namespace VulkanEngine {
+
+// Records secondary command buffers as jobs, one per slice. Every slice owns a command pool per
+// frame in flight, so no pool is shared between threads.
+class ParallelRecorder {
+public:
+    using RecordFunction = std::function<void(VkCommandBuffer commandBuffer, uint32_t slice)>;
+
+    ParallelRecorder(VkDevice device, JobSystem& jobs, uint32_t queueFamily, uint32_t frameCount, uint32_t sliceCount);
+    ~ParallelRecorder();
+
+    ParallelRecorder(const ParallelRecorder&) = delete;
+    ParallelRecorder& operator=(const ParallelRecorder&) = delete;
+
+    uint32_t getSliceCount() const { return static_cast<uint32_t>(mSlices.size()); }
+
+    // Returns the buffers in slice order. The frame's previous submission must have completed.
+    const std::vector<VkCommandBuffer>& record(uint32_t frameIndex, const VkCommandBufferInheritanceInfo& inheritance,
+                                               const RecordFunction& function);
+
+private:
+    struct Slice
+    {
+        std::vector<VkCommandPool> pools;
+        std::vector<VkCommandBuffer> commandBuffers;
+    };
+
+    void recordSlice(uint32_t slice, uint32_t frameIndex, const VkCommandBufferInheritanceInfo& inheritance,
+                     const RecordFunction& function);
+
+    VkDevice mDevice;
+    JobSystem& mJobs;
+    std::vector<Slice> mSlices;
+    std::vector<VkCommandBuffer> mRecorded;
+};
+
+} // VulkanEngine
+
+#endif //PARALLELRECORDER_H
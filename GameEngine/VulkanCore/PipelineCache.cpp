@@ -0,0 +1,144 @@
+#include "PipelineCache.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <filesystem>
+
+
+VulkanEngine::PipelineCache::PipelineCache(VkPhysicalDevice physicalDevice, VkDevice device, std::string path)
+    : mDevice(device), mPath(std::move(path)) {
+    vkGetPhysicalDeviceProperties(physicalDevice, &mDeviceProperties);
+
+    std::vector<char> data = readCacheFile();
+    mLoadedFromDisk = !data.empty() && isCompatible(data);
+
+    VkPipelineCacheCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    if (mLoadedFromDisk) {
+        createInfo.initialDataSize = data.size();
+        createInfo.pInitialData = data.data();
+    }
+
+    if (vkCreatePipelineCache(mDevice, &createInfo, nullptr, &mCache) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create pipeline cache");
+    }
+}
+
+
+VulkanEngine::PipelineCache::~PipelineCache() {
+    for (auto workerCache : mWorkerCaches) {
+        vkDestroyPipelineCache(mDevice, workerCache, nullptr);
+    }
+    if (mCache != VK_NULL_HANDLE) {
+        vkDestroyPipelineCache(mDevice, mCache, nullptr);
+    }
+}
+
+
+VkPipelineCache
+VulkanEngine::PipelineCache::createWorkerCache() {
+    VkPipelineCacheCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+    VkPipelineCache workerCache;
+    if (vkCreatePipelineCache(mDevice, &createInfo, nullptr, &workerCache) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create worker pipeline cache");
+    }
+
+    std::lock_guard<std::mutex> lock(mWorkerMutex);
+    mWorkerCaches.push_back(workerCache);
+    return workerCache;
+}
+
+
+void
+VulkanEngine::PipelineCache::mergeWorkerCaches() {
+    // worker caches must no longer be in use by any thread at this point
+    std::lock_guard<std::mutex> lock(mWorkerMutex);
+    if (mWorkerCaches.empty()) {
+        return;
+    }
+
+    if (vkMergePipelineCaches(mDevice, mCache, static_cast<uint32_t>(mWorkerCaches.size()), mWorkerCaches.data()) != VK_SUCCESS) {
+        std::cerr << "pipeline cache: failed to merge worker caches" << std::endl;
+    }
+
+    for (auto workerCache : mWorkerCaches) {
+        vkDestroyPipelineCache(mDevice, workerCache, nullptr);
+    }
+    mWorkerCaches.clear();
+}
+
+
+void
+VulkanEngine::PipelineCache::save() {
+    mergeWorkerCaches();
+
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(mDevice, mCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+        return;
+    }
+
+    std::vector<char> data(dataSize);
+    if (vkGetPipelineCacheData(mDevice, mCache, &dataSize, data.data()) != VK_SUCCESS) {
+        std::cerr << "pipeline cache: failed to read cache data" << std::endl;
+        return;
+    }
+
+    // write next to the real file and swap it in, so a crash mid-write never leaves a torn cache behind
+    std::string tempPath = mPath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), static_cast<std::streamsize>(dataSize));
+        if (!file.good()) {
+            std::cerr << "pipeline cache: failed to write " << tempPath << std::endl;
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, mPath, error);
+    if (error) {
+        std::cerr << "pipeline cache: failed to replace " << mPath << ": " << error.message() << std::endl;
+        std::filesystem::remove(tempPath, error);
+    }
+}
+
+
+std::vector<char>
+VulkanEngine::PipelineCache::readCacheFile() const {
+    std::ifstream file(mPath, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        return {};
+    }
+
+    size_t fileSize = static_cast<size_t>(file.tellg());
+    std::vector<char> data(fileSize);
+    file.seekg(0);
+    file.read(data.data(), static_cast<std::streamsize>(fileSize));
+    if (!file.good()) {
+        return {};
+    }
+    return data;
+}
+
+
+bool
+VulkanEngine::PipelineCache::isCompatible(const std::vector<char>& data) const {
+    if (data.size() < sizeof(VkPipelineCacheHeaderVersionOne)) {
+        return false;
+    }
+
+    VkPipelineCacheHeaderVersionOne header;
+    std::memcpy(&header, data.data(), sizeof(header));
+
+    // a blob from another GPU or driver is ignored rather than trusted
+    return header.headerSize >= sizeof(VkPipelineCacheHeaderVersionOne) &&
+           header.headerSize <= data.size() &&
+           header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == mDeviceProperties.vendorID &&
+           header.deviceID == mDeviceProperties.deviceID &&
+           std::memcmp(header.pipelineCacheUUID, mDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
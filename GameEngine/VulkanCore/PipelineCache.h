@@ -0,0 +1,47 @@
+#ifndef PIPELINECACHE_H
+#define PIPELINECACHE_H
+
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include "vulkan/vulkan.h"
+
+
+namespace VulkanEngine {
+
+// Wraps a VkPipelineCache that is warm-started from disk and written back on save().
+// Worker threads get their own caches so they never contend on the main one;
+// those are merged into the main cache before it is serialized.
+class PipelineCache {
+public:
+    PipelineCache(VkPhysicalDevice physicalDevice, VkDevice device, std::string path);
+    ~PipelineCache();
+
+    PipelineCache(const PipelineCache&) = delete;
+    PipelineCache& operator=(const PipelineCache&) = delete;
+
+    VkPipelineCache getHandle() const { return mCache; }
+    bool isWarm() const { return mLoadedFromDisk; }
+
+    VkPipelineCache createWorkerCache();
+    void mergeWorkerCaches();
+    void save();
+
+private:
+    std::vector<char> readCacheFile() const;
+    bool isCompatible(const std::vector<char>& data) const;
+
+    VkDevice mDevice;
+    VkPhysicalDeviceProperties mDeviceProperties;
+    std::string mPath;
+    VkPipelineCache mCache = VK_NULL_HANDLE;
+    bool mLoadedFromDisk = false;
+
+    std::vector<VkPipelineCache> mWorkerCaches;
+    std::mutex mWorkerMutex;
+};
+
+} // VulkanEngine
+
+#endif //PIPELINECACHE_H
@@ -0,0 +1,626 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+
+namespace {
+    // access bits that make a barrier's source scope, reads need no availability
+    constexpr VkAccessFlags2 WRITE_ACCESS = VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+                                            VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT |
+                                            VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+    // The graph only uses bits that exist in both, and those have the same values.
+    VkPipelineStageFlags toLegacyStages(VkPipelineStageFlags2 stages) {
+        return static_cast<VkPipelineStageFlags>(stages);
+    }
+
+    VkAccessFlags toLegacyAccess(VkAccessFlags2 access) {
+        return static_cast<VkAccessFlags>(access);
+    }
+
+    bool overlaps(uint32_t firstA, uint32_t lastA, uint32_t firstB, uint32_t lastB) {
+        return firstA <= lastB && firstB <= lastA;
+    }
+}
+
+
+VulkanEngine::RenderGraph::PassBuilder&
+VulkanEngine::RenderGraph::PassBuilder::read(Resource resource, const ResourceState& state) {
+    mGraph.addAccess(mPass, resource, state, false, false);
+    return *this;
+}
+
+
+VulkanEngine::RenderGraph::PassBuilder&
+VulkanEngine::RenderGraph::PassBuilder::write(Resource resource, const ResourceState& state, bool discard) {
+    mGraph.addAccess(mPass, resource, state, true, discard);
+    return *this;
+}
+
+
+VulkanEngine::RenderGraph::PassBuilder&
+VulkanEngine::RenderGraph::PassBuilder::setSideEffects() {
+    mGraph.mPasses[mPass].sideEffects = true;
+    return *this;
+}
+
+
+VulkanEngine::RenderGraph::RenderGraph(VkDevice device, GpuAllocator& allocator, DeletionQueue& deletionQueue,
+                                       std::optional<uint32_t> asyncComputeFamily)
+    : mAllocator(allocator), mDeletionQueue(deletionQueue), mAsyncComputeFamily(asyncComputeFamily) {
+    mCallbacks.createImage = [device](const VkImageCreateInfo& info, VkImage* image) {
+        return vkCreateImage(device, &info, nullptr, image);
+    };
+    mCallbacks.getMemoryRequirements = [device](VkImage image, VkMemoryRequirements* requirements) {
+        vkGetImageMemoryRequirements(device, image, requirements);
+    };
+    mCallbacks.bindMemory = [device](VkImage image, VkDeviceMemory memory, VkDeviceSize offset) {
+        return vkBindImageMemory(device, image, memory, offset);
+    };
+    mCallbacks.createView = [device](const VkImageViewCreateInfo& info, VkImageView* view) {
+        return vkCreateImageView(device, &info, nullptr, view);
+    };
+}
+
+
+VulkanEngine::RenderGraph::RenderGraph(GpuAllocator& allocator, DeletionQueue& deletionQueue, TransientImageCallbacks callbacks,
+                                       std::optional<uint32_t> asyncComputeFamily)
+    : mCallbacks(std::move(callbacks)), mAllocator(allocator), mDeletionQueue(deletionQueue), mAsyncComputeFamily(asyncComputeFamily) {
+}
+
+
+VulkanEngine::RenderGraph::~RenderGraph() {
+    destroyTransients();
+}
+
+
+VulkanEngine::RenderGraph::Resource
+VulkanEngine::RenderGraph::importImage(const char* name, VkImage image, VkImageAspectFlags aspect, const ResourceState& initial) {
+    ResourceEntry entry{};
+    entry.name = name;
+    entry.image = true;
+    entry.handle = image;
+    entry.aspect = aspect;
+    entry.initial = initial;
+    mResources.push_back(entry);
+    return static_cast<Resource>(mResources.size() - 1);
+}
+
+
+VulkanEngine::RenderGraph::Resource
+VulkanEngine::RenderGraph::importBuffer(const char* name, const ResourceState& initial) {
+    ResourceEntry entry{};
+    entry.name = name;
+    entry.initial = initial;
+    mResources.push_back(entry);
+    return static_cast<Resource>(mResources.size() - 1);
+}
+
+
+VulkanEngine::RenderGraph::Resource
+VulkanEngine::RenderGraph::createImage(const char* name, const TransientImageDesc& desc) {
+    ResourceEntry entry{};
+    entry.name = name;
+    entry.image = true;
+    entry.transient = true;
+    entry.aspect = desc.aspect;
+    entry.desc = desc;
+    mResources.push_back(entry);
+    return static_cast<Resource>(mResources.size() - 1);
+}
+
+
+void
+VulkanEngine::RenderGraph::setOutput(Resource resource, const std::optional<ResourceState>& finalState) {
+    ResourceEntry& entry = mResources.at(resource);
+    if (entry.transient) {
+        throw std::runtime_error(std::string("ERROR: transient image ") + entry.name + " cannot be a render graph output");
+    }
+    entry.output = true;
+    entry.finalState = finalState;
+}
+
+
+VulkanEngine::RenderGraph::PassBuilder
+VulkanEngine::RenderGraph::addPass(const char* name, Queue queue, std::function<void(VkCommandBuffer)> execute) {
+    if (mCompiled) {
+        throw std::runtime_error("ERROR: render graph is already compiled");
+    }
+    PassEntry pass{};
+    pass.name = name;
+    pass.queue = queue;
+    pass.execute = std::move(execute);
+    mPasses.push_back(std::move(pass));
+    return PassBuilder(*this, static_cast<uint32_t>(mPasses.size() - 1));
+}
+
+
+void
+VulkanEngine::RenderGraph::addAccess(uint32_t pass, Resource resource, const ResourceState& state, bool write, bool discard) {
+    const ResourceEntry& entry = mResources.at(resource);
+    PassEntry& passEntry = mPasses[pass];
+
+    // one access per resource and pass, a pass that reads and writes something does both in one state
+    for (auto& access : passEntry.accesses) {
+        if (access.resource != resource) {
+            continue;
+        }
+        if (entry.image && access.state.layout != state.layout) {
+            throw std::runtime_error(std::string("ERROR: render graph pass ") + passEntry.name + " uses " + entry.name +
+                                     " in two layouts");
+        }
+        access.state.stages |= state.stages;
+        access.state.access |= state.access;
+        access.discard = access.discard && write && discard;
+        access.write = access.write || write;
+        return;
+    }
+    passEntry.accesses.push_back({resource, state, write, write && discard});
+}
+
+
+void
+VulkanEngine::RenderGraph::compile() {
+    if (mCompiled) {
+        throw std::runtime_error("ERROR: render graph is already compiled");
+    }
+    cullPasses();
+    assignQueues();
+    placeTransients();
+    computeBarriers();
+    mCompiled = true;
+}
+
+
+void
+VulkanEngine::RenderGraph::cullPasses() {
+    std::vector<bool> needed(mResources.size());
+    for (size_t i = 0; i < mResources.size(); i++) {
+        needed[i] = mResources[i].output;
+    }
+
+    // backwards: a pass is needed when something after it, or the frame's outputs, reads what it writes
+    for (size_t i = mPasses.size(); i-- > 0;) {
+        PassEntry& pass = mPasses[i];
+        pass.kept = pass.sideEffects;
+        for (const auto& access : pass.accesses) {
+            pass.kept = pass.kept || (access.write && needed[access.resource]);
+        }
+        if (!pass.kept) {
+            continue;
+        }
+
+        // what it overwrites completely nobody before it has to produce, what it reads or keeps does
+        for (const auto& access : pass.accesses) {
+            if (access.discard) {
+                needed[access.resource] = false;
+            }
+        }
+        for (const auto& access : pass.accesses) {
+            if (!access.discard) {
+                needed[access.resource] = true;
+            }
+        }
+    }
+}
+
+
+void
+VulkanEngine::RenderGraph::assignQueues() {
+    std::vector<bool> touchedByGraphics(mResources.size());
+    std::vector<bool> touchedByAsync(mResources.size());
+
+    for (auto& pass : mPasses) {
+        if (!pass.kept) {
+            continue;
+        }
+
+        // images would need layout transitions and ownership transfers on both queues
+        pass.async = mAsyncComputeFamily.has_value() && pass.queue == Queue::AsyncCompute;
+        for (const auto& access : pass.accesses) {
+            pass.async = pass.async && !mResources[access.resource].image && !touchedByGraphics[access.resource];
+        }
+
+        for (const auto& access : pass.accesses) {
+            if (pass.async) {
+                touchedByAsync[access.resource] = true;
+                continue;
+            }
+            // the first graphics use of what the compute queue touched waits on its semaphore
+            if (touchedByAsync[access.resource] && !touchedByGraphics[access.resource]) {
+                mAsyncWaitStages |= access.state.stages;
+            }
+            touchedByGraphics[access.resource] = true;
+        }
+        mAsyncPassCount += pass.async ? 1 : 0;
+    }
+}
+
+
+void
+VulkanEngine::RenderGraph::placeTransients() {
+    for (uint32_t i = 0; i < mPasses.size(); i++) {
+        if (!mPasses[i].kept) {
+            continue;
+        }
+        for (const auto& access : mPasses[i].accesses) {
+            ResourceEntry& entry = mResources[access.resource];
+            entry.firstPass = std::min(entry.firstPass, i);
+            entry.lastPass = std::max(entry.lastPass, i);
+            entry.usedStages |= access.state.stages;
+            entry.writtenAccess |= access.state.access & WRITE_ACCESS;
+        }
+    }
+
+    // Every group of transients with disjoint lifetimes shares one allocation. Biggest first, so
+    // the small ones fill the space the big ones leave.
+    struct Bucket
+    {
+        VkMemoryRequirements requirements;
+        std::vector<Resource> occupants;
+    };
+    std::vector<Bucket> buckets;
+
+    std::vector<std::pair<Resource, VkMemoryRequirements>> transients;
+    for (Resource i = 0; i < mResources.size(); i++) {
+        ResourceEntry& entry = mResources[i];
+        if (!entry.transient || entry.firstPass == UINT32_MAX) {
+            continue;
+        }
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = entry.desc.format;
+        imageInfo.extent = {entry.desc.extent.width, entry.desc.extent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = entry.desc.usage;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        if (mCallbacks.createImage(imageInfo, &entry.handle) != VK_SUCCESS) {
+            throw std::runtime_error(std::string("ERROR: failed to create transient image ") + entry.name);
+        }
+
+        VkMemoryRequirements requirements;
+        mCallbacks.getMemoryRequirements(entry.handle, &requirements);
+        transients.emplace_back(i, requirements);
+        mTransientRequestedSize += requirements.size;
+    }
+
+    std::stable_sort(transients.begin(), transients.end(), [](const auto& a, const auto& b) {
+        return a.second.size > b.second.size;
+    });
+
+    for (const auto& [resource, requirements] : transients) {
+        const ResourceEntry& entry = mResources[resource];
+        Bucket* target = nullptr;
+        for (auto& bucket : buckets) {
+            if ((bucket.requirements.memoryTypeBits & requirements.memoryTypeBits) == 0) {
+                continue;
+            }
+            bool disjoint = std::none_of(bucket.occupants.begin(), bucket.occupants.end(), [&](Resource other) {
+                return overlaps(entry.firstPass, entry.lastPass, mResources[other].firstPass, mResources[other].lastPass);
+            });
+            if (disjoint) {
+                target = &bucket;
+                break;
+            }
+        }
+        if (target == nullptr) {
+            buckets.push_back({requirements, {}});
+            target = &buckets.back();
+        }
+        target->requirements.size = std::max(target->requirements.size, requirements.size);
+        target->requirements.alignment = std::max(target->requirements.alignment, requirements.alignment);
+        target->requirements.memoryTypeBits &= requirements.memoryTypeBits;
+        target->occupants.push_back(resource);
+    }
+
+    for (auto& bucket : buckets) {
+        GpuAllocation allocation = mAllocator.allocate(bucket.requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, GpuResourceTiling::Optimal);
+        mTransientMemory.push_back(allocation);
+        mTransientMemorySize += bucket.requirements.size;
+
+        // in the order they run; the first one follows the last one of the frame before
+        std::sort(bucket.occupants.begin(), bucket.occupants.end(), [this](Resource a, Resource b) {
+            return mResources[a].firstPass < mResources[b].firstPass;
+        });
+        for (size_t i = 0; i < bucket.occupants.size(); i++) {
+            ResourceEntry& entry = mResources[bucket.occupants[i]];
+            entry.aliasedAfter = bucket.occupants[(i + bucket.occupants.size() - 1) % bucket.occupants.size()];
+            if (mCallbacks.bindMemory(entry.handle, allocation.memory, allocation.offset) != VK_SUCCESS) {
+                throw std::runtime_error(std::string("ERROR: failed to bind transient image ") + entry.name);
+            }
+
+            VkImageViewCreateInfo viewInfo{};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = entry.handle;
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = entry.desc.format;
+            viewInfo.subresourceRange.aspectMask = entry.aspect;
+            viewInfo.subresourceRange.baseMipLevel = 0;
+            viewInfo.subresourceRange.levelCount = 1;
+            viewInfo.subresourceRange.baseArrayLayer = 0;
+            viewInfo.subresourceRange.layerCount = 1;
+
+            if (mCallbacks.createView(viewInfo, &entry.view) != VK_SUCCESS) {
+                throw std::runtime_error(std::string("ERROR: failed to create transient image view ") + entry.name);
+            }
+        }
+    }
+}
+
+
+void
+VulkanEngine::RenderGraph::computeBarriers() {
+    std::vector<Tracking> tracking(mResources.size());
+    for (size_t i = 0; i < mResources.size(); i++) {
+        const ResourceEntry& entry = mResources[i];
+        Tracking& state = tracking[i];
+        if (entry.transient) {
+            // the memory was last used by whatever it aliases, possibly itself a frame ago
+            if (entry.aliasedAfter != INVALID_RESOURCE) {
+                state.writeStages = mResources[entry.aliasedAfter].usedStages;
+                state.writeAccess = mResources[entry.aliasedAfter].writtenAccess;
+            }
+        }
+        else {
+            state.writeStages = entry.initial.stages;
+            state.writeAccess = entry.initial.access & WRITE_ACCESS;
+            state.layout = entry.initial.layout;
+        }
+    }
+
+    for (uint32_t i = 0; i < mPasses.size(); i++) {
+        PassEntry& pass = mPasses[i];
+        if (!pass.kept) {
+            continue;
+        }
+        for (const auto& access : pass.accesses) {
+            const ResourceEntry& entry = mResources[access.resource];
+            Tracking& state = tracking[access.resource];
+
+            bool firstUse = entry.transient && entry.firstPass == i;
+            if (firstUse && !access.write) {
+                throw std::runtime_error(std::string("ERROR: render graph pass ") + pass.name + " reads transient image " +
+                                         entry.name + " before anything writes it");
+            }
+            // the semaphore the graphics queue waits on already orders it after the compute work
+            if (state.async && !pass.async) {
+                state = Tracking{};
+            }
+            state.async = pass.async;
+
+            addBarrier(pass.barriers, access.resource, state, access.state, access.write, access.discard || firstUse);
+        }
+    }
+
+    for (Resource i = 0; i < mResources.size(); i++) {
+        const ResourceEntry& entry = mResources[i];
+        if (entry.image && entry.finalState.has_value()) {
+            addBarrier(mFinalBarriers, i, tracking[i], entry.finalState.value(), false, false);
+        }
+    }
+}
+
+
+void
+VulkanEngine::RenderGraph::addBarrier(BarrierBatch& batch, Resource resource, Tracking& tracking,
+                                      const ResourceState& state, bool write, bool discard) {
+    const ResourceEntry& entry = mResources[resource];
+    bool transition = entry.image && (discard || tracking.layout != state.layout);
+
+    // writes and transitions wait for everything before them, reads only for the last write,
+    // and not at all when an earlier barrier already made it visible to them
+    VkPipelineStageFlags2 srcStages = tracking.writeStages;
+    bool needed;
+    if (transition || write) {
+        srcStages |= tracking.readStages;
+        needed = transition || srcStages != 0;
+    }
+    else {
+        bool visible = (state.stages & ~tracking.visibleStages) == 0 && (state.access & ~tracking.visibleAccess) == 0;
+        needed = srcStages != 0 && !visible;
+    }
+
+    if (transition) {
+        ImageBarrier image{};
+        image.resource = resource;
+        image.barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        image.barrier.srcStageMask = srcStages;
+        image.barrier.srcAccessMask = tracking.writeAccess;
+        image.barrier.dstStageMask = state.stages;
+        image.barrier.dstAccessMask = state.access;
+        image.barrier.oldLayout = discard ? VK_IMAGE_LAYOUT_UNDEFINED : tracking.layout;
+        image.barrier.newLayout = state.layout;
+        image.barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        image.barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        image.barrier.subresourceRange.aspectMask = entry.aspect;
+        image.barrier.subresourceRange.baseMipLevel = 0;
+        image.barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        image.barrier.subresourceRange.baseArrayLayer = 0;
+        image.barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+        batch.images.push_back(image);
+    }
+    else if (needed) {
+        // no layout to change, one global barrier per pass carries all of them
+        batch.memory.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+        batch.memory.srcStageMask |= srcStages;
+        batch.memory.srcAccessMask |= tracking.writeAccess;
+        batch.memory.dstStageMask |= state.stages;
+        batch.memory.dstAccessMask |= state.access;
+    }
+
+    if (write) {
+        tracking.writeStages = state.stages;
+        tracking.writeAccess = state.access & WRITE_ACCESS;
+        tracking.visibleStages = 0;
+        tracking.visibleAccess = 0;
+        tracking.readStages = 0;
+    }
+    else if (transition) {
+        // the transition is a write of its own, visible to the reader it was made for
+        tracking.writeStages = state.stages;
+        tracking.writeAccess = 0;
+        tracking.visibleStages = state.stages;
+        tracking.visibleAccess = state.access;
+        tracking.readStages = state.stages;
+    }
+    else {
+        if (needed) {
+            tracking.visibleStages |= state.stages;
+            tracking.visibleAccess |= state.access;
+        }
+        tracking.readStages |= state.stages;
+    }
+    if (transition) {
+        tracking.layout = state.layout;
+    }
+}
+
+
+void
+VulkanEngine::RenderGraph::setImportedImage(Resource resource, VkImage image) {
+    ResourceEntry& entry = mResources.at(resource);
+    if (!entry.image || entry.transient) {
+        throw std::runtime_error(std::string("ERROR: ") + entry.name + " is not an imported image");
+    }
+    entry.handle = image;
+}
+
+
+void
+VulkanEngine::RenderGraph::execute(VkCommandBuffer graphics, VkCommandBuffer compute, GpuProfiler* profiler) {
+    if (!mCompiled) {
+        throw std::runtime_error("ERROR: render graph executed before it was compiled");
+    }
+    if (mAsyncPassCount > 0 && compute == VK_NULL_HANDLE) {
+        throw std::runtime_error("ERROR: render graph has async compute passes but no compute command buffer");
+    }
+
+    for (const auto& pass : mPasses) {
+        if (!pass.kept) {
+            continue;
+        }
+        VkCommandBuffer commandBuffer = pass.async ? compute : graphics;
+        recordBarriers(commandBuffer, pass.barriers);
+
+        // the profiler's queries belong to the graphics queue
+        bool profiled = profiler != nullptr && !pass.async;
+        uint32_t scope = profiled ? profiler->beginScope(commandBuffer, pass.name) : 0;
+        pass.execute(commandBuffer);
+        if (profiled) {
+            profiler->endScope(commandBuffer, scope);
+        }
+    }
+    recordBarriers(graphics, mFinalBarriers);
+}
+
+
+void
+VulkanEngine::RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch& batch) const {
+    if (batch.empty()) {
+        return;
+    }
+    bool hasMemoryBarrier = batch.memory.srcStageMask != 0 || batch.memory.dstStageMask != 0;
+
+    if (mPipelineBarrier2 != nullptr) {
+        std::vector<VkImageMemoryBarrier2> images;
+        images.reserve(batch.images.size());
+        for (const auto& image : batch.images) {
+            images.push_back(image.barrier);
+            images.back().image = mResources[image.resource].handle;
+        }
+
+        VkDependencyInfo dependency{};
+        dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        dependency.memoryBarrierCount = hasMemoryBarrier ? 1 : 0;
+        dependency.pMemoryBarriers = &batch.memory;
+        dependency.imageMemoryBarrierCount = static_cast<uint32_t>(images.size());
+        dependency.pImageMemoryBarriers = images.data();
+        mPipelineBarrier2(commandBuffer, &dependency);
+        return;
+    }
+
+    // one stage pair for the whole batch, the union of what the barriers ask for
+    VkPipelineStageFlags srcStages = toLegacyStages(batch.memory.srcStageMask);
+    VkPipelineStageFlags dstStages = toLegacyStages(batch.memory.dstStageMask);
+
+    VkMemoryBarrier memory{};
+    memory.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memory.srcAccessMask = toLegacyAccess(batch.memory.srcAccessMask);
+    memory.dstAccessMask = toLegacyAccess(batch.memory.dstAccessMask);
+
+    std::vector<VkImageMemoryBarrier> images;
+    images.reserve(batch.images.size());
+    for (const auto& image : batch.images) {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = toLegacyAccess(image.barrier.srcAccessMask);
+        barrier.dstAccessMask = toLegacyAccess(image.barrier.dstAccessMask);
+        barrier.oldLayout = image.barrier.oldLayout;
+        barrier.newLayout = image.barrier.newLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = mResources[image.resource].handle;
+        barrier.subresourceRange = image.barrier.subresourceRange;
+        images.push_back(barrier);
+
+        srcStages |= toLegacyStages(image.barrier.srcStageMask);
+        dstStages |= toLegacyStages(image.barrier.dstStageMask);
+    }
+
+    vkCmdPipelineBarrier(commandBuffer, srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         dstStages != 0 ? dstStages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                         hasMemoryBarrier ? 1 : 0, &memory, 0, nullptr,
+                         static_cast<uint32_t>(images.size()), images.data());
+}
+
+
+VkImage
+VulkanEngine::RenderGraph::getImage(Resource resource) const {
+    return mResources.at(resource).handle;
+}
+
+
+VkImageView
+VulkanEngine::RenderGraph::getImageView(Resource resource) const {
+    return mResources.at(resource).view;
+}
+
+
+bool
+VulkanEngine::RenderGraph::isPassCulled(const char* name) const {
+    for (const auto& pass : mPasses) {
+        if (std::strcmp(pass.name, name) == 0) {
+            return !pass.kept;
+        }
+    }
+    return true;
+}
+
+
+void
+VulkanEngine::RenderGraph::destroyTransients() {
+    for (auto& entry : mResources) {
+        if (!entry.transient) {
+            continue;
+        }
+        mDeletionQueue.destroy(entry.view);
+        mDeletionQueue.destroy(entry.handle);
+        entry.view = VK_NULL_HANDLE;
+        entry.handle = VK_NULL_HANDLE;
+    }
+    for (auto& allocation : mTransientMemory) {
+        mDeletionQueue.free(allocation);
+    }
+    mTransientMemory.clear();
+}
@@ -0,0 +1,223 @@
+#ifndef RENDERGRAPH_H
+#define RENDERGRAPH_H
+
+
+#include <vector>
+#include <optional>
+#include <functional>
+#include "vulkan/vulkan.h"
+#include "GpuAllocator.h"
+#include "DeletionQueue.h"
+#include "GpuProfiler.h"
+
+
+namespace VulkanEngine {
+
+    // How a pass uses a resource, or the state it is in, in synchronization2 terms. Only stage
+    // and access bits that also exist in the original flags may be used, barriers fall back to
+    // vkCmdPipelineBarrier without synchronization2. layout is ignored for buffers.
+    struct ResourceState
+    {
+        VkPipelineStageFlags2 stages = 0;
+        VkAccessFlags2 access = 0;
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    };
+
+    // An image the graph creates itself, placed in memory it shares with other transients.
+    struct TransientImageDesc
+    {
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkExtent2D extent = {0, 0};
+        VkImageUsageFlags usage = 0;
+        VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+    };
+
+    // Device calls behind the transient images, tests can hand in fakes instead.
+    struct TransientImageCallbacks
+    {
+        std::function<VkResult(const VkImageCreateInfo& info, VkImage* image)> createImage;
+        std::function<void(VkImage image, VkMemoryRequirements* requirements)> getMemoryRequirements;
+        std::function<VkResult(VkImage image, VkDeviceMemory memory, VkDeviceSize offset)> bindMemory;
+        std::function<VkResult(const VkImageViewCreateInfo& info, VkImageView* view)> createView;
+    };
+
+// The frame as a list of passes and the resources they read and write. compile() culls unused
+// passes, works out the barriers in front of each pass, aliases transient images with disjoint
+// lifetimes and keeps buffer-only AsyncCompute passes on the compute queue. Buffers stand for
+// global memory barriers. Build it once, execute it every frame.
+class RenderGraph {
+public:
+    using Resource = uint32_t;
+    static constexpr Resource INVALID_RESOURCE = UINT32_MAX;
+
+    enum class Queue
+    {
+        Graphics,
+        AsyncCompute
+    };
+
+    // Declares the accesses of the pass addPass() returned.
+    class PassBuilder {
+    public:
+        PassBuilder& read(Resource resource, const ResourceState& state);
+        // With discard the previous contents are not needed; images start out undefined.
+        PassBuilder& write(Resource resource, const ResourceState& state, bool discard = false);
+        // Never culled, for passes with effects the graph cannot see, like a host readback.
+        PassBuilder& setSideEffects();
+
+    private:
+        friend class RenderGraph;
+        PassBuilder(RenderGraph& graph, uint32_t pass) : mGraph(graph), mPass(pass) {}
+
+        RenderGraph& mGraph;
+        uint32_t mPass;
+    };
+
+    // asyncComputeFamily is a compute queue family other than graphicsFamily, without one every
+    // pass runs on the graphics queue.
+    RenderGraph(VkDevice device, GpuAllocator& allocator, DeletionQueue& deletionQueue,
+                std::optional<uint32_t> asyncComputeFamily = std::nullopt);
+    RenderGraph(GpuAllocator& allocator, DeletionQueue& deletionQueue, TransientImageCallbacks callbacks,
+                std::optional<uint32_t> asyncComputeFamily = std::nullopt);
+    ~RenderGraph();
+
+    RenderGraph(const RenderGraph&) = delete;
+    RenderGraph& operator=(const RenderGraph&) = delete;
+
+    // Barriers through vkCmdPipelineBarrier2, null for vkCmdPipelineBarrier. Needs the
+    // synchronization2 feature enabled on the device.
+    void setPipelineBarrier2(PFN_vkCmdPipelineBarrier2KHR pipelineBarrier2) { mPipelineBarrier2 = pipelineBarrier2; }
+
+    // initial is the state the image is in whenever the graph starts: stages and access of the
+    // last write to it and its layout. Names must outlive the graph.
+    Resource importImage(const char* name, VkImage image, VkImageAspectFlags aspect, const ResourceState& initial);
+    Resource importBuffer(const char* name, const ResourceState& initial = {});
+    Resource createImage(const char* name, const TransientImageDesc& desc);
+    // Keeps the passes writing the resource; with a final state images are left in it.
+    void setOutput(Resource resource, const std::optional<ResourceState>& finalState = std::nullopt);
+
+    // The function records the pass into the command buffer of the queue it runs on. The name
+    // also names its GPU profiler scope and must outlive the graph.
+    PassBuilder addPass(const char* name, Queue queue, std::function<void(VkCommandBuffer)> execute);
+
+    void compile();
+
+    // Between frames, the barriers are not recorded yet.
+    void setImportedImage(Resource resource, VkImage image);
+
+    // compute takes the async passes, submit it first and have graphics wait at getAsyncWaitStages().
+    void execute(VkCommandBuffer graphics, VkCommandBuffer compute = VK_NULL_HANDLE, GpuProfiler* profiler = nullptr);
+
+    // After compile().
+    VkImage getImage(Resource resource) const;
+    VkImageView getImageView(Resource resource) const;
+    bool isPassCulled(const char* name) const;
+    bool hasAsyncWork() const { return mAsyncPassCount > 0; }
+    VkPipelineStageFlags2 getAsyncWaitStages() const { return mAsyncWaitStages; }
+    // Bytes of memory backing the transient images, and what they would take unaliased.
+    VkDeviceSize getTransientMemorySize() const { return mTransientMemorySize; }
+    VkDeviceSize getTransientRequestedSize() const { return mTransientRequestedSize; }
+
+private:
+    struct ResourceEntry
+    {
+        const char* name = nullptr;
+        bool image = false;
+        bool transient = false;
+        VkImage handle = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkImageAspectFlags aspect = 0;
+        TransientImageDesc desc;
+        ResourceState initial;
+        bool output = false;
+        std::optional<ResourceState> finalState;
+
+        // filled by compile(), first and last kept pass touching it
+        uint32_t firstPass = UINT32_MAX;
+        uint32_t lastPass = 0;
+        VkPipelineStageFlags2 usedStages = 0;
+        VkAccessFlags2 writtenAccess = 0;
+        // the transient that used its memory before it, itself when alone
+        Resource aliasedAfter = INVALID_RESOURCE;
+    };
+
+    struct Access
+    {
+        Resource resource;
+        ResourceState state;
+        bool write;
+        bool discard;
+    };
+
+    struct ImageBarrier
+    {
+        Resource resource;
+        VkImageMemoryBarrier2 barrier;
+    };
+
+    struct BarrierBatch
+    {
+        VkMemoryBarrier2 memory{};
+        std::vector<ImageBarrier> images;
+        bool empty() const { return memory.srcStageMask == 0 && memory.dstStageMask == 0 && images.empty(); }
+    };
+
+    struct PassEntry
+    {
+        const char* name;
+        Queue queue;
+        std::function<void(VkCommandBuffer)> execute;
+        std::vector<Access> accesses;
+        bool sideEffects = false;
+
+        // filled by compile()
+        bool kept = false;
+        bool async = false;
+        BarrierBatch barriers;
+    };
+
+    // per resource while barriers are worked out
+    struct Tracking
+    {
+        // last write, or layout transition, and what it has been made visible to since
+        VkPipelineStageFlags2 writeStages = 0;
+        VkAccessFlags2 writeAccess = 0;
+        VkPipelineStageFlags2 visibleStages = 0;
+        VkAccessFlags2 visibleAccess = 0;
+        // stages that read since the write, a later write waits for them
+        VkPipelineStageFlags2 readStages = 0;
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        bool async = false;
+    };
+
+    void addAccess(uint32_t pass, Resource resource, const ResourceState& state, bool write, bool discard);
+    void cullPasses();
+    void assignQueues();
+    void placeTransients();
+    void computeBarriers();
+    void addBarrier(BarrierBatch& batch, Resource resource, Tracking& tracking, const ResourceState& state, bool write, bool discard);
+    void recordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch& batch) const;
+    void destroyTransients();
+
+    TransientImageCallbacks mCallbacks;
+    GpuAllocator& mAllocator;
+    DeletionQueue& mDeletionQueue;
+    std::optional<uint32_t> mAsyncComputeFamily;
+    PFN_vkCmdPipelineBarrier2KHR mPipelineBarrier2 = nullptr;
+
+    std::vector<ResourceEntry> mResources;
+    std::vector<PassEntry> mPasses;
+    BarrierBatch mFinalBarriers;
+    bool mCompiled = false;
+
+    VkPipelineStageFlags2 mAsyncWaitStages = 0;
+    uint32_t mAsyncPassCount = 0;
+
+    std::vector<GpuAllocation> mTransientMemory;
+    VkDeviceSize mTransientMemorySize = 0;
+    VkDeviceSize mTransientRequestedSize = 0;
+};
+
+} // VulkanEngine
+
+#endif //RENDERGRAPH_H
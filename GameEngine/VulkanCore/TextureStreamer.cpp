@@ -0,0 +1,381 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include "../Core/Profiler.h"
+#include "../Core/TextureFile.h"
+
+
+VulkanEngine::TextureStreamer::TextureStreamer(VkDevice device, GpuAllocator& allocator, TransferQueue& uploader, BindlessTable& bindless,
+                                               DeletionQueue& deletionQueue, JobSystem& jobs, const TextureFormatSupport& formats,
+                                               VkDeviceSize budget)
+    : mDevice(device), mAllocator(allocator), mUploader(uploader), mBindless(bindless),
+      mDeletionQueue(deletionQueue), mJobs(jobs), mFormats(formats), mBudget(budget) {
+    // what every slot shows until its texture has arrived, white leaves the vertex colours as they are
+    const uint8_t white[4] = {255, 255, 255, 255};
+    TextureData placeholder = TextureData::fromPixels(white, 1, 1, false);
+    mPlaceholder = createImage(placeholder, 0);
+    mLastTicket = upload(mPlaceholder, placeholder);
+}
+
+
+VulkanEngine::TextureStreamer::~TextureStreamer() {
+    // decode jobs still write to mDecoded
+    mJobs.wait(mDecodeJobs);
+    // an upload recorded but not yet submitted would copy into an image destroyed below
+    mUploader.wait(mLastTicket);
+
+    for (auto& texture : mTextures) {
+        retire(texture.pending);
+        retire(texture.current);
+        mBindless.removeImage(texture.bindlessIndex);
+    }
+    retire(mPlaceholder);
+}
+
+
+VulkanEngine::TextureHandle
+VulkanEngine::TextureStreamer::load(const std::string& path, bool srgb) {
+    TextureHandle handle = static_cast<TextureHandle>(mTextures.size());
+    Texture& texture = mTextures.emplace_back();
+    texture.path = path;
+    texture.srgb = srgb;
+    texture.bindlessIndex = mBindless.addImage(mPlaceholder.view);
+    mDecodingCount++;
+
+    mJobs.run([this, handle, path, srgb]() {
+        PROFILE_SCOPE("Decode texture");
+        DecodedTexture decoded{handle, {}, false, 0, 0};
+        try {
+            int64_t start = Profiler::now();
+            bool cooked = path.size() >= std::strlen(TextureFile::EXTENSION) &&
+                          path.compare(path.size() - std::strlen(TextureFile::EXTENSION), std::string::npos, TextureFile::EXTENSION) == 0;
+            // cooked files come with their mips, only the level table is read here
+            decoded.data = cooked ? TextureFile::read(path) : TextureData::loadFromFile(path, srgb);
+            if (!mFormats.supports(decoded.data.format, decoded.data.srgb)) {
+                throw std::runtime_error("ERROR: the device cannot sample " + std::string(getFormatName(decoded.data.format)) + ", " + path);
+            }
+            int64_t decodedTime = Profiler::now();
+            if (!cooked) {
+                decoded.data.generateMips();
+            }
+            decoded.decodeNs = decodedTime - start;
+            decoded.mipNs = Profiler::now() - decodedTime;
+        } catch (const std::exception& e) {
+            // the slot keeps the placeholder
+            std::cerr << e.what() << std::endl;
+            decoded.failed = true;
+        }
+
+        std::lock_guard<std::mutex> lock(mDecodedMutex);
+        mDecoded.push_back(std::move(decoded));
+    }, &mDecodeJobs);
+
+    return handle;
+}
+
+
+void
+VulkanEngine::TextureStreamer::reportUsage(TextureHandle handle, float screenPixels) {
+    Texture& texture = mTextures[handle];
+    // one more so that a report of zero pixels still marks the texture used
+    uint32_t pixels = static_cast<uint32_t>(std::min(screenPixels, 65536.0f)) + 1;
+    uint32_t previous = texture.usagePixels.load(std::memory_order_relaxed);
+    while (previous < pixels && !texture.usagePixels.compare_exchange_weak(previous, pixels, std::memory_order_relaxed)) {
+    }
+}
+
+
+void
+VulkanEngine::TextureStreamer::update(uint64_t frameNumber) {
+    PROFILE_SCOPE("TextureStreamer::update");
+
+    receiveDecoded();
+    completeUploads();
+    takeUsage(frameNumber);
+    startUploads(chooseResidency());
+
+    int64_t now = Profiler::now();
+    if (mUploadingCount > 0 && mUploadBusySince == 0) {
+        mUploadBusySince = now;
+    } else if (mUploadingCount == 0 && mUploadBusySince != 0) {
+        mUploadNs += now - mUploadBusySince;
+        mUploadBusySince = 0;
+    }
+}
+
+
+bool
+VulkanEngine::TextureStreamer::isIdle() const {
+    if (mDecodingCount > 0 || mUploadingCount > 0) {
+        return false;
+    }
+    for (const auto& texture : mTextures) {
+        if (texture.decoded && texture.targetMip != residentMip(texture)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+VulkanEngine::TextureStreamingStats
+VulkanEngine::TextureStreamer::getStats() const {
+    TextureStreamingStats stats;
+    stats.textureCount = static_cast<uint32_t>(mTextures.size());
+    stats.decodingCount = mDecodingCount;
+    stats.uploadingCount = mUploadingCount;
+    stats.residentBytes = mResidentBytes;
+    stats.budgetBytes = mBudget;
+    stats.decodedBytes = mDecodedBytes;
+    stats.decodeSeconds = mDecodeNs / 1e9;
+    stats.mipSeconds = mMipNs / 1e9;
+    stats.uploadedBytes = mUploadedBytes;
+    int64_t uploadNs = mUploadNs + (mUploadBusySince != 0 ? Profiler::now() - mUploadBusySince : 0);
+    stats.uploadSeconds = uploadNs / 1e9;
+    stats.evictions = mEvictions;
+    return stats;
+}
+
+
+void
+VulkanEngine::TextureStreamer::receiveDecoded() {
+    std::vector<DecodedTexture> decoded;
+    {
+        std::lock_guard<std::mutex> lock(mDecodedMutex);
+        decoded.swap(mDecoded);
+    }
+
+    for (auto& result : decoded) {
+        Texture& texture = mTextures[result.texture];
+        mDecodingCount--;
+        if (result.failed) {
+            texture.failed = true;
+            continue;
+        }
+
+        texture.data = std::move(result.data);
+        texture.decoded = true;
+        mDecodedBytes += texture.data.mips[0].size;
+        mDecodeNs += result.decodeNs;
+        mMipNs += result.mipNs;
+
+        // the finest level that is still small enough to always stay resident
+        uint32_t mipCount = texture.data.getMipCount();
+        texture.tailMip = mipCount - 1;
+        for (uint32_t mip = 0; mip < mipCount; mip++) {
+            const TextureMip& level = texture.data.mips[mip];
+            if (std::max(level.width, level.height) <= TAIL_SIZE) {
+                texture.tailMip = mip;
+                break;
+            }
+        }
+        // nothing reported it yet, only the tail until something does
+        texture.wantedMip = texture.tailMip;
+        texture.targetMip = texture.tailMip;
+    }
+}
+
+
+void
+VulkanEngine::TextureStreamer::completeUploads() {
+    for (auto& texture : mTextures) {
+        if (texture.pending.image == VK_NULL_HANDLE || !mUploader.isComplete(texture.pendingTicket)) {
+            continue;
+        }
+
+        if (texture.current.image != VK_NULL_HANDLE) {
+            mResidentBytes -= texture.data.getSize(texture.current.firstMip);
+        }
+        mResidentBytes += texture.data.getSize(texture.pending.firstMip);
+
+        // frames already recorded keep sampling the old slot and image, the queue frees both after them
+        mBindless.removeImage(texture.bindlessIndex);
+        texture.bindlessIndex = mBindless.addImage(texture.pending.view);
+        retire(texture.current);
+        texture.current = texture.pending;
+        texture.pending = {};
+        mUploadingCount--;
+    }
+}
+
+
+void
+VulkanEngine::TextureStreamer::takeUsage(uint64_t frameNumber) {
+    for (auto& texture : mTextures) {
+        uint32_t pixels = texture.usagePixels.exchange(0, std::memory_order_relaxed);
+        if (pixels == 0 || !texture.decoded) {
+            continue;
+        }
+        texture.lastUsedFrame = frameNumber;
+        texture.lastUsagePixels = pixels;
+
+        // one texel per pixel: every halving of the on-screen size drops a level
+        uint32_t size = std::max(texture.data.width, texture.data.height);
+        uint32_t mip = 0;
+        while (mip < texture.tailMip && (size >> (mip + 1)) >= pixels) {
+            mip++;
+        }
+        texture.wantedMip = mip;
+    }
+}
+
+
+std::vector<VulkanEngine::TextureStreamer::Texture*>
+VulkanEngine::TextureStreamer::chooseResidency() {
+    std::vector<Texture*> priority;
+    VkDeviceSize committed = 0;
+    for (auto& texture : mTextures) {
+        if (texture.decoded) {
+            // tails are never evicted, they come out of the budget first
+            committed += texture.data.getSize(texture.tailMip);
+            priority.push_back(&texture);
+        }
+    }
+
+    // most recently used first, the largest on screen among equals
+    std::sort(priority.begin(), priority.end(), [](const Texture* a, const Texture* b) {
+        if (a->lastUsedFrame != b->lastUsedFrame) {
+            return a->lastUsedFrame > b->lastUsedFrame;
+        }
+        return a->lastUsagePixels > b->lastUsagePixels;
+    });
+
+    for (Texture* texture : priority) {
+        VkDeviceSize tailSize = texture->data.getSize(texture->tailMip);
+        uint32_t target = texture->tailMip;
+        for (uint32_t mip = texture->wantedMip; mip < texture->tailMip; mip++) {
+            if (committed + texture->data.getSize(mip) - tailSize <= mBudget) {
+                target = mip;
+                break;
+            }
+        }
+        committed += texture->data.getSize(target) - tailSize;
+        texture->targetMip = target;
+    }
+    return priority;
+}
+
+
+void
+VulkanEngine::TextureStreamer::startUploads(const std::vector<Texture*>& priority) {
+    VkDeviceSize started = 0;
+    auto start = [&](Texture& texture) {
+        texture.pending = createImage(texture.data, texture.targetMip);
+        texture.pendingTicket = upload(texture.pending, texture.data);
+        mLastTicket = std::max(mLastTicket, texture.pendingTicket);
+        VkDeviceSize size = texture.data.getSize(texture.targetMip);
+        mUploadedBytes += size;
+        started += size;
+        mUploadingCount++;
+    };
+
+    // evictions first, they are what brings the budget back down. They rebuild the image too, so
+    // they share the per frame limit, least recently used first; the rest follow in later frames
+    for (auto it = priority.rbegin(); it != priority.rend() && started < UPLOAD_BYTES_PER_FRAME; ++it) {
+        Texture* texture = *it;
+        if (texture->pending.image == VK_NULL_HANDLE && texture->current.image != VK_NULL_HANDLE &&
+            texture->targetMip > texture->current.firstMip) {
+            start(*texture);
+            mEvictions++;
+        }
+    }
+
+    for (Texture* texture : priority) {
+        if (started >= UPLOAD_BYTES_PER_FRAME) {
+            break;
+        }
+        if (texture->pending.image == VK_NULL_HANDLE && texture->targetMip < residentMip(*texture)) {
+            start(*texture);
+        }
+    }
+}
+
+
+VulkanEngine::TextureStreamer::TextureImage
+VulkanEngine::TextureStreamer::createImage(const TextureData& data, uint32_t firstMip) {
+    TextureImage result;
+    result.firstMip = firstMip;
+    VkFormat format = toVkFormat(data.format, data.srgb);
+    const TextureMip& top = data.mips[firstMip];
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = format;
+    imageInfo.extent = {top.width, top.height, 1};
+    imageInfo.mipLevels = data.getMipCount() - firstMip;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(mDevice, &imageInfo, nullptr, &result.image) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create texture image");
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(mDevice, result.image, &requirements);
+    result.allocation = mAllocator.allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, GpuResourceTiling::Optimal);
+    vkBindImageMemory(mDevice, result.image, result.allocation.memory, result.allocation.offset);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = result.image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = imageInfo.mipLevels;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(mDevice, &viewInfo, nullptr, &result.view) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create texture image view");
+    }
+    return result;
+}
+
+
+uint64_t
+VulkanEngine::TextureStreamer::upload(const TextureImage& image, const TextureData& data) {
+    const TextureMip& top = data.mips[image.firstMip];
+    std::vector<VkBufferImageCopy> regions;
+    for (uint32_t mip = image.firstMip; mip < data.getMipCount(); mip++) {
+        const TextureMip& level = data.mips[mip];
+        VkBufferImageCopy region{};
+        region.bufferOffset = level.offset - top.offset;
+        region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip - image.firstMip, 0, 1};
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = {level.width, level.height, 1};
+        regions.push_back(region);
+    }
+
+    // for cooked files this reads the mapping, the pages go from the page cache straight into staging
+    return mUploader.uploadImage(image.image, data.getPixels() + top.offset, regions.data(), static_cast<uint32_t>(regions.size()),
+                                 getBlockBytes(data.format), getBlockDim(data.format),
+                                 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+}
+
+
+void
+VulkanEngine::TextureStreamer::retire(TextureImage& image) {
+    if (image.image == VK_NULL_HANDLE) {
+        return;
+    }
+    mDeletionQueue.destroy(image.view);
+    mDeletionQueue.destroy(image.image, image.allocation);
+    image = {};
+}
+
+
+uint32_t
+VulkanEngine::TextureStreamer::residentMip(const Texture& texture) const {
+    // one past the last level when nothing is resident yet
+    return texture.current.image != VK_NULL_HANDLE ? texture.current.firstMip : texture.data.getMipCount();
+}
@@ -0,0 +1,163 @@
+#ifndef TEXTURESTREAMER_H
+#define TEXTURESTREAMER_H
+
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "GpuAllocator.h"
+#include "TransferQueue.h"
+#include "BindlessTable.h"
+#include "DeletionQueue.h"
+#include "VulkanDevice.h"
+#include "../Core/JobSystem.h"
+#include "../Core/TextureData.h"
+
+
+namespace VulkanEngine {
+
+    using TextureHandle = uint32_t;
+
+    struct TextureStreamingStats
+    {
+        uint32_t textureCount = 0;
+        uint32_t decodingCount = 0;
+        uint32_t uploadingCount = 0;
+        VkDeviceSize residentBytes = 0;
+        VkDeviceSize budgetBytes = 0;
+        // level 0 bytes out of stb_image or a cooked file, times summed over the worker threads
+        uint64_t decodedBytes = 0;
+        double decodeSeconds = 0.0;
+        double mipSeconds = 0.0;
+        // wall time with at least one upload in flight, seen at frame granularity
+        uint64_t uploadedBytes = 0;
+        double uploadSeconds = 0.0;
+        uint32_t evictions = 0;
+    };
+
+// Streams textures into the bindless table, decoding on jobs and keeping the finest mips that fit
+// the budget resident, in LRU order. A residency change moves the texture to a new slot.
+// reportUsage() may run on jobs, the rest belongs to the main thread.
+class TextureStreamer {
+public:
+    static constexpr TextureHandle INVALID_TEXTURE = UINT32_MAX;
+    static constexpr uint32_t TAIL_SIZE = 64;
+    // Evictions and uploads started per update(), at least one; keeps them inside the staging ring so they never block.
+    static constexpr VkDeviceSize UPLOAD_BYTES_PER_FRAME = 16ull * 1024 * 1024;
+
+    TextureStreamer(VkDevice device, GpuAllocator& allocator, TransferQueue& uploader, BindlessTable& bindless,
+                    DeletionQueue& deletionQueue, JobSystem& jobs, const TextureFormatSupport& formats, VkDeviceSize budget);
+    ~TextureStreamer();
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    // srgb for colour data, cooked files bring their own. Shows a placeholder until mips arrive.
+    TextureHandle load(const std::string& path, bool srgb = true);
+    // Changes whenever the residency does, look it up every frame when writing the draw data.
+    uint32_t getBindlessIndex(TextureHandle texture) const { return mTextures[texture].bindlessIndex; }
+    // At least the tail mips are on the GPU.
+    bool isResident(TextureHandle texture) const { return mTextures[texture].current.image != VK_NULL_HANDLE; }
+
+    // Largest on-screen extent in pixels of anything drawn with the texture this frame.
+    void reportUsage(TextureHandle texture, float screenPixels);
+
+    // Call once per frame before the TransferQueue is flushed.
+    void update(uint64_t frameNumber);
+
+    void setBudget(VkDeviceSize budget) { mBudget = budget; }
+    // Nothing decoding and no residency change in flight.
+    bool isIdle() const;
+    TextureStreamingStats getStats() const;
+
+private:
+    struct TextureImage
+    {
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        GpuAllocation allocation;
+        // first level of the TextureData it holds
+        uint32_t firstMip = 0;
+    };
+
+    struct Texture
+    {
+        std::string path;
+        bool srgb = true;
+        uint32_t bindlessIndex = BindlessTable::INVALID_INDEX;
+
+        TextureData data;
+        bool decoded = false;
+        bool failed = false;
+        uint32_t tailMip = 0;
+
+        // written by reportUsage, taken by update
+        std::atomic<uint32_t> usagePixels{0};
+        uint32_t lastUsagePixels = 0;
+        uint64_t lastUsedFrame = 0;
+        uint32_t wantedMip = 0;
+        // what the budget allows, chosen by update()
+        uint32_t targetMip = 0;
+
+        TextureImage current;
+        TextureImage pending;
+        uint64_t pendingTicket = 0;
+    };
+
+    struct DecodedTexture
+    {
+        TextureHandle texture;
+        TextureData data;
+        bool failed;
+        int64_t decodeNs;
+        int64_t mipNs;
+    };
+
+    void receiveDecoded();
+    void completeUploads();
+    void takeUsage(uint64_t frameNumber);
+    std::vector<Texture*> chooseResidency();
+    void startUploads(const std::vector<Texture*>& priority);
+
+    TextureImage createImage(const TextureData& data, uint32_t firstMip);
+    uint64_t upload(const TextureImage& image, const TextureData& data);
+    void retire(TextureImage& image);
+    uint32_t residentMip(const Texture& texture) const;
+
+    VkDevice mDevice;
+    GpuAllocator& mAllocator;
+    TransferQueue& mUploader;
+    BindlessTable& mBindless;
+    DeletionQueue& mDeletionQueue;
+    JobSystem& mJobs;
+    TextureFormatSupport mFormats;
+    VkDeviceSize mBudget;
+
+    // deque, textures never move once loaded
+    std::deque<Texture> mTextures;
+    TextureImage mPlaceholder;
+    uint64_t mLastTicket = 0;
+
+    JobCounter mDecodeJobs;
+    std::mutex mDecodedMutex;
+    std::vector<DecodedTexture> mDecoded;
+
+    uint32_t mDecodingCount = 0;
+    uint32_t mUploadingCount = 0;
+    VkDeviceSize mResidentBytes = 0;
+
+    uint64_t mDecodedBytes = 0;
+    int64_t mDecodeNs = 0;
+    int64_t mMipNs = 0;
+    uint64_t mUploadedBytes = 0;
+    int64_t mUploadNs = 0;
+    int64_t mUploadBusySince = 0;
+    uint32_t mEvictions = 0;
+};
+
+} // VulkanEngine
+
+#endif //TEXTURESTREAMER_H
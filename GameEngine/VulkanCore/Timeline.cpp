@@ -0,0 +1,82 @@
+#include "Timeline.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+
+VulkanEngine::Timeline::Timeline(VkDevice device, uint64_t initialValue)
+    : mDevice(device), mLastValue(initialValue), mCompletedValue(initialValue) {
+    VkSemaphoreTypeCreateInfo typeInfo{};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = initialValue;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+
+    if (vkCreateSemaphore(mDevice, &semaphoreInfo, nullptr, &mSemaphore) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create timeline semaphore");
+    }
+}
+
+
+VulkanEngine::Timeline::~Timeline() {
+    vkDestroySemaphore(mDevice, mSemaphore, nullptr);
+}
+
+
+bool
+VulkanEngine::Timeline::isSupported(const VkPhysicalDeviceVulkan12Features& features) {
+    return features.timelineSemaphore;
+}
+
+
+void
+VulkanEngine::Timeline::enableFeatures(VkPhysicalDeviceVulkan12Features& features) {
+    features.timelineSemaphore = VK_TRUE;
+}
+
+
+uint64_t
+VulkanEngine::Timeline::getCompletedValue() {
+    if (mCompletedValue < mLastValue) {
+        uint64_t value = 0;
+        if (vkGetSemaphoreCounterValue(mDevice, mSemaphore, &value) != VK_SUCCESS) {
+            throw std::runtime_error("ERROR: failed to read timeline semaphore");
+        }
+        mCompletedValue = value;
+    }
+    return mCompletedValue;
+}
+
+
+bool
+VulkanEngine::Timeline::isComplete(uint64_t value) {
+    return value <= mCompletedValue || value <= getCompletedValue();
+}
+
+
+bool
+VulkanEngine::Timeline::wait(uint64_t value, uint64_t timeout) {
+    if (isComplete(value)) {
+        return true;
+    }
+
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &mSemaphore;
+    waitInfo.pValues = &value;
+
+    VkResult result = vkWaitSemaphores(mDevice, &waitInfo, timeout);
+    if (result == VK_TIMEOUT) {
+        return false;
+    }
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to wait for timeline semaphore");
+    }
+    // at least the value waited for, the next query fills in the rest
+    mCompletedValue = std::max(mCompletedValue, value);
+    return true;
+}
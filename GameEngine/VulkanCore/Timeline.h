@@ -0,0 +1,47 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+
+#include <cstdint>
+#include "vulkan/vulkan.h"
+
+
+namespace VulkanEngine {
+
+// A timeline semaphore and the values handed out on it, one per submission that signals it. Not
+// thread safe, the owner of the submitting queue drives it.
+class Timeline {
+public:
+    explicit Timeline(VkDevice device, uint64_t initialValue = 0);
+    ~Timeline();
+
+    Timeline(const Timeline&) = delete;
+    Timeline& operator=(const Timeline&) = delete;
+
+    static bool isSupported(const VkPhysicalDeviceVulkan12Features& features);
+    // Sets the feature the timeline relies on, on top of whatever is already enabled.
+    static void enableFeatures(VkPhysicalDeviceVulkan12Features& features);
+
+    VkSemaphore getHandle() const { return mSemaphore; }
+
+    // The value for the next submission to signal.
+    uint64_t advance() { return ++mLastValue; }
+    // The last value handed out, the one waiting on everything submitted so far.
+    uint64_t getLastValue() const { return mLastValue; }
+
+    // What the GPU has reached, only asks the device while values are outstanding.
+    uint64_t getCompletedValue();
+    bool isComplete(uint64_t value);
+    // False when the timeout in nanoseconds ran out first.
+    bool wait(uint64_t value, uint64_t timeout = UINT64_MAX);
+
+private:
+    VkDevice mDevice;
+    VkSemaphore mSemaphore = VK_NULL_HANDLE;
+    uint64_t mLastValue;
+    uint64_t mCompletedValue;
+};
+
+} // VulkanEngine
+
+#endif //TIMELINE_H
@@ -0,0 +1,437 @@
+#include "TransferQueue.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+
+VulkanEngine::TransferQueue::TransferQueue(VkDevice device, GpuAllocator& allocator,
+                                           VkQueue transferQueue, uint32_t transferFamily,
+                                           VkQueue graphicsQueue, uint32_t graphicsFamily,
+                                           VkDeviceSize stagingSize)
+    : mDevice(device), mAllocator(allocator),
+      mTransferQueue(transferQueue), mGraphicsQueue(graphicsQueue),
+      mTransferFamily(transferFamily), mGraphicsFamily(graphicsFamily),
+      mStagingSize(stagingSize) {
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = mTransferFamily;
+
+    if (vkCreateCommandPool(mDevice, &poolInfo, nullptr, &mTransferPool) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create transfer command pool");
+    }
+
+    if (hasDedicatedQueue()) {
+        poolInfo.queueFamilyIndex = mGraphicsFamily;
+        if (vkCreateCommandPool(mDevice, &poolInfo, nullptr, &mAcquirePool) != VK_SUCCESS) {
+            throw std::runtime_error("ERROR: failed to create ownership acquire command pool");
+        }
+    }
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+
+    mTimeline = std::make_unique<Timeline>(mDevice);
+    if (hasDedicatedQueue()) {
+        mCopyTimeline = std::make_unique<Timeline>(mDevice);
+    }
+
+    for (auto& batch : mBatches) {
+        allocInfo.commandPool = mTransferPool;
+        if (vkAllocateCommandBuffers(mDevice, &allocInfo, &batch.transferCommands) != VK_SUCCESS) {
+            throw std::runtime_error("ERROR: failed to allocate transfer command buffer");
+        }
+
+        if (hasDedicatedQueue()) {
+            allocInfo.commandPool = mAcquirePool;
+            if (vkAllocateCommandBuffers(mDevice, &allocInfo, &batch.acquireCommands) != VK_SUCCESS) {
+                throw std::runtime_error("ERROR: failed to allocate ownership acquire command buffer");
+            }
+        }
+    }
+
+    mAllocator.createBuffer(mStagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                            mStagingBuffer, mStagingAllocation);
+}
+
+
+VulkanEngine::TransferQueue::~TransferQueue() {
+    if (mBatches[mCurrentBatch].recording) {
+        flush();
+    }
+    while (mBatches[mOldestBatch].pending) {
+        waitForBatch(mBatches[mOldestBatch]);
+    }
+
+    mAllocator.destroyBuffer(mStagingBuffer, mStagingAllocation);
+
+    vkDestroyCommandPool(mDevice, mTransferPool, nullptr);
+    if (mAcquirePool != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(mDevice, mAcquirePool, nullptr);
+    }
+}
+
+
+uint64_t
+VulkanEngine::TransferQueue::uploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size,
+                                          VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    // half the ring at a time, so a large upload never waits on itself
+    const VkDeviceSize chunkSize = mStagingSize / 2;
+    Batch* batch = nullptr;
+    for (VkDeviceSize done = 0; done < size; done += chunkSize) {
+        VkDeviceSize chunk = std::min(chunkSize, size - done);
+
+        // reserve staging first, making room may have to flush the batch that is being recorded
+        VkDeviceSize stagingOffset = allocateStaging(chunk);
+        std::memcpy(static_cast<char*>(mStagingAllocation.mapped) + stagingOffset, static_cast<const char*>(data) + done, static_cast<size_t>(chunk));
+
+        batch = &beginBatch();
+
+        VkBufferCopy copyRegion{};
+        copyRegion.srcOffset = stagingOffset;
+        copyRegion.dstOffset = dstOffset + done;
+        copyRegion.size = chunk;
+        vkCmdCopyBuffer(batch->transferCommands, mStagingBuffer, dst, 1, &copyRegion);
+
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.buffer = dst;
+        barrier.offset = dstOffset + done;
+        barrier.size = chunk;
+
+        if (hasDedicatedQueue()) {
+            barrier.srcQueueFamilyIndex = mTransferFamily;
+            barrier.dstQueueFamilyIndex = mGraphicsFamily;
+
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            batch->releaseBarriers.push_back(barrier);
+
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = dstAccess;
+            batch->acquireBarriers.push_back(barrier);
+        } else {
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = dstAccess;
+            batch->releaseBarriers.push_back(barrier);
+        }
+        batch->dstStages |= dstStage;
+    }
+
+    if (batch == nullptr) {
+        return mNextSerial - 1;
+    }
+    return batch->serial;
+}
+
+
+uint64_t
+VulkanEngine::TransferQueue::uploadImage(VkImage dst, const void* data, const VkBufferImageCopy* regions, uint32_t regionCount,
+                                         uint32_t blockBytes, uint32_t blockDim, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    VkImageSubresourceRange range{};
+    range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    range.baseMipLevel = regions[0].imageSubresource.mipLevel;
+    range.levelCount = 0;
+    range.baseArrayLayer = 0;
+    range.layerCount = 1;
+    for (uint32_t i = 0; i < regionCount; i++) {
+        range.baseMipLevel = std::min(range.baseMipLevel, regions[i].imageSubresource.mipLevel);
+    }
+    for (uint32_t i = 0; i < regionCount; i++) {
+        range.levelCount = std::max(range.levelCount, regions[i].imageSubresource.mipLevel + 1 - range.baseMipLevel);
+    }
+
+    bool transitioned = false;
+    Batch* batch = nullptr;
+    for (uint32_t i = 0; i < regionCount; i++) {
+        const VkBufferImageCopy& region = regions[i];
+        VkDeviceSize rowBytes = VkDeviceSize((region.imageExtent.width + blockDim - 1) / blockDim) * blockBytes;
+        uint32_t blockRows = (region.imageExtent.height + blockDim - 1) / blockDim;
+        uint32_t bandRows = static_cast<uint32_t>(std::max<VkDeviceSize>(1, (mStagingSize / 2) / rowBytes));
+
+        for (uint32_t firstRow = 0; firstRow < blockRows; firstRow += bandRows) {
+            uint32_t rows = std::min(bandRows, blockRows - firstRow);
+            VkDeviceSize size = rowBytes * rows;
+
+            // like uploadBuffer, staging before the batch since making room may flush it
+            VkDeviceSize stagingOffset = allocateStaging(size);
+            std::memcpy(static_cast<char*>(mStagingAllocation.mapped) + stagingOffset,
+                        static_cast<const char*>(data) + region.bufferOffset + rowBytes * firstRow, static_cast<size_t>(size));
+
+            batch = &beginBatch();
+            if (!transitioned) {
+                // the contents are replaced, nothing to preserve from the old layout
+                VkImageMemoryBarrier toTransfer{};
+                toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                toTransfer.srcAccessMask = 0;
+                toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                toTransfer.image = dst;
+                toTransfer.subresourceRange = range;
+                vkCmdPipelineBarrier(batch->transferCommands, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                                     0, nullptr, 0, nullptr, 1, &toTransfer);
+                transitioned = true;
+            }
+
+            VkBufferImageCopy band = region;
+            band.bufferOffset = stagingOffset;
+            band.bufferRowLength = 0;
+            band.bufferImageHeight = 0;
+            band.imageOffset.y = region.imageOffset.y + static_cast<int32_t>(firstRow * blockDim);
+            band.imageExtent.height = std::min(rows * blockDim, region.imageExtent.height - firstRow * blockDim);
+            vkCmdCopyBufferToImage(batch->transferCommands, mStagingBuffer, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &band);
+        }
+    }
+
+    if (batch == nullptr) {
+        return mNextSerial - 1;
+    }
+
+    // released from the batch holding the last copy, its barrier orders every earlier submit too
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.image = dst;
+    barrier.subresourceRange = range;
+
+    if (hasDedicatedQueue()) {
+        barrier.srcQueueFamilyIndex = mTransferFamily;
+        barrier.dstQueueFamilyIndex = mGraphicsFamily;
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        batch->imageReleaseBarriers.push_back(barrier);
+
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = dstAccess;
+        batch->imageAcquireBarriers.push_back(barrier);
+    } else {
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = dstAccess;
+        batch->imageReleaseBarriers.push_back(barrier);
+    }
+    batch->dstStages |= dstStage;
+
+    return batch->serial;
+}
+
+
+uint64_t
+VulkanEngine::TransferQueue::flush() {
+    Batch& batch = mBatches[mCurrentBatch];
+    if (!batch.recording) {
+        return mNextSerial - 1;
+    }
+
+    VkPipelineStageFlags releaseDstStage = hasDedicatedQueue() ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : batch.dstStages;
+    vkCmdPipelineBarrier(batch.transferCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, releaseDstStage, 0,
+                         0, nullptr,
+                         static_cast<uint32_t>(batch.releaseBarriers.size()), batch.releaseBarriers.data(),
+                         static_cast<uint32_t>(batch.imageReleaseBarriers.size()), batch.imageReleaseBarriers.data());
+
+    if (vkEndCommandBuffer(batch.transferCommands) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to record transfer command buffer");
+    }
+
+    // batches go out in serial order, so the serial is the next value on both timelines
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &batch.serial;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch.transferCommands;
+    submitInfo.signalSemaphoreCount = 1;
+
+    VkSemaphore completion = mTimeline->getHandle();
+    if (hasDedicatedQueue()) {
+        VkSemaphore copies = mCopyTimeline->getHandle();
+        submitInfo.pSignalSemaphores = &copies;
+        mCopyTimeline->advance();
+        if (vkQueueSubmit(mTransferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("ERROR: failed to submit to transfer queue");
+        }
+
+        // the graphics family takes ownership before anything there can read the data
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(batch.acquireCommands, &beginInfo);
+        vkCmdPipelineBarrier(batch.acquireCommands, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, batch.dstStages, 0,
+                             0, nullptr,
+                             static_cast<uint32_t>(batch.acquireBarriers.size()), batch.acquireBarriers.data(),
+                             static_cast<uint32_t>(batch.imageAcquireBarriers.size()), batch.imageAcquireBarriers.data());
+        if (vkEndCommandBuffer(batch.acquireCommands) != VK_SUCCESS) {
+            throw std::runtime_error("ERROR: failed to record ownership acquire command buffer");
+        }
+
+        VkTimelineSemaphoreSubmitInfo acquireTimelineInfo{};
+        acquireTimelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        acquireTimelineInfo.waitSemaphoreValueCount = 1;
+        acquireTimelineInfo.pWaitSemaphoreValues = &batch.serial;
+        acquireTimelineInfo.signalSemaphoreValueCount = 1;
+        acquireTimelineInfo.pSignalSemaphoreValues = &batch.serial;
+
+        VkSubmitInfo acquireInfo{};
+        acquireInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        acquireInfo.pNext = &acquireTimelineInfo;
+        acquireInfo.waitSemaphoreCount = 1;
+        acquireInfo.pWaitSemaphores = &copies;
+        acquireInfo.pWaitDstStageMask = &batch.dstStages;
+        acquireInfo.commandBufferCount = 1;
+        acquireInfo.pCommandBuffers = &batch.acquireCommands;
+        acquireInfo.signalSemaphoreCount = 1;
+        acquireInfo.pSignalSemaphores = &completion;
+        if (vkQueueSubmit(mGraphicsQueue, 1, &acquireInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("ERROR: failed to submit ownership acquire");
+        }
+    } else {
+        submitInfo.pSignalSemaphores = &completion;
+        if (vkQueueSubmit(mTransferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("ERROR: failed to submit to transfer queue");
+        }
+    }
+    mTimeline->advance();
+
+    batch.recording = false;
+    batch.pending = true;
+    batch.stagingEnd = mStagingHead;
+    mCurrentBatch = (mCurrentBatch + 1) % BATCH_COUNT;
+
+    return batch.serial;
+}
+
+
+void
+VulkanEngine::TransferQueue::collect() {
+    while (mBatches[mOldestBatch].pending && mTimeline->isComplete(mBatches[mOldestBatch].serial)) {
+        retire(mBatches[mOldestBatch]);
+    }
+}
+
+
+bool
+VulkanEngine::TransferQueue::isComplete(uint64_t ticket) {
+    collect();
+    return ticket <= mCompletedSerial;
+}
+
+
+void
+VulkanEngine::TransferQueue::wait(uint64_t ticket) {
+    Batch& current = mBatches[mCurrentBatch];
+    if (current.recording && current.serial <= ticket) {
+        flush();
+    }
+    while (mCompletedSerial < ticket && mBatches[mOldestBatch].pending) {
+        waitForBatch(mBatches[mOldestBatch]);
+    }
+}
+
+
+VulkanEngine::TransferQueue::Batch&
+VulkanEngine::TransferQueue::beginBatch() {
+    Batch& batch = mBatches[mCurrentBatch];
+    if (batch.recording) {
+        return batch;
+    }
+
+    // only blocks when every batch in the ring is still in flight
+    if (batch.pending) {
+        waitForBatch(batch);
+    }
+
+    vkResetCommandBuffer(batch.transferCommands, 0);
+    if (batch.acquireCommands != VK_NULL_HANDLE) {
+        vkResetCommandBuffer(batch.acquireCommands, 0);
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(batch.transferCommands, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to begin transfer command buffer");
+    }
+
+    batch.serial = mNextSerial++;
+    batch.recording = true;
+    batch.dstStages = 0;
+    return batch;
+}
+
+
+VkDeviceSize
+VulkanEngine::TransferQueue::allocateStaging(VkDeviceSize size) {
+    size = (size + 15) & ~VkDeviceSize(15);
+    if (size > mStagingSize) {
+        throw std::runtime_error("ERROR: upload is larger than the staging ring");
+    }
+
+    // head and tail are running byte counts, the ring offset is the count modulo the ring size
+    for (;;) {
+        uint64_t start = mStagingHead;
+        VkDeviceSize offset = start % mStagingSize;
+        if (offset + size > mStagingSize) {
+            start += mStagingSize - offset;
+        }
+
+        if (start + size - mStagingTail <= mStagingSize) {
+            mStagingHead = start + size;
+            return start % mStagingSize;
+        }
+
+        collect();
+        if (start + size - mStagingTail <= mStagingSize) {
+            continue;
+        }
+
+        if (mBatches[mCurrentBatch].recording) {
+            flush();
+        }
+        if (!mBatches[mOldestBatch].pending) {
+            // nothing left in flight, the ring is empty
+            mStagingTail = mStagingHead;
+            continue;
+        }
+        waitForBatch(mBatches[mOldestBatch]);
+    }
+}
+
+
+void
+VulkanEngine::TransferQueue::retire(Batch& batch) {
+    batch.pending = false;
+    batch.releaseBarriers.clear();
+    batch.acquireBarriers.clear();
+    batch.imageReleaseBarriers.clear();
+    batch.imageAcquireBarriers.clear();
+
+    mStagingTail = batch.stagingEnd;
+    mCompletedSerial = batch.serial;
+    mOldestBatch = (mOldestBatch + 1) % BATCH_COUNT;
+}
+
+
+void
+VulkanEngine::TransferQueue::waitForBatch(Batch& batch) {
+    // batches complete in submission order, so retire everything up to and including this one
+    mTimeline->wait(batch.serial);
+    while (batch.pending) {
+        retire(mBatches[mOldestBatch]);
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef TRANSFERQUEUE_H
+#define TRANSFERQUEUE_H
+
+
+#include <array>
+#include <vector>
+#include <memory>
+#include "vulkan/vulkan.h"
+#include "GpuAllocator.h"
+#include "Timeline.h"
+
+
+namespace VulkanEngine {
+
+// Asynchronous uploader: data goes into a mapped staging ring, the copies are batched and submitted
+// on flush(), on the dedicated transfer family when there is one. Tickets are timeline values.
+class TransferQueue {
+public:
+    static constexpr VkDeviceSize DEFAULT_STAGING_SIZE = 32ull * 1024 * 1024;
+
+    TransferQueue(VkDevice device, GpuAllocator& allocator,
+                  VkQueue transferQueue, uint32_t transferFamily,
+                  VkQueue graphicsQueue, uint32_t graphicsFamily,
+                  VkDeviceSize stagingSize = DEFAULT_STAGING_SIZE);
+    ~TransferQueue();
+
+    TransferQueue(const TransferQueue&) = delete;
+    TransferQueue& operator=(const TransferQueue&) = delete;
+
+    // Returns the ticket of the batch the last copy was recorded into.
+    uint64_t uploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size,
+                          VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+    // One region per mip level, bufferOffset relative to data. blockBytes and blockDim are the
+    // format's texel blocks: 4 and 1 for RGBA8, 8 or 16 and 4 for BC.
+    uint64_t uploadImage(VkImage dst, const void* data, const VkBufferImageCopy* regions, uint32_t regionCount,
+                         uint32_t blockBytes, uint32_t blockDim, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+
+    // Submits to the graphics queue, call it from the thread that owns that queue.
+    uint64_t flush();
+    void collect();
+    bool isComplete(uint64_t ticket);
+    void wait(uint64_t ticket);
+
+    bool hasDedicatedQueue() const { return mTransferFamily != mGraphicsFamily; }
+
+private:
+    static constexpr uint32_t BATCH_COUNT = 4;
+
+    struct Batch
+    {
+        VkCommandBuffer transferCommands = VK_NULL_HANDLE;
+        VkCommandBuffer acquireCommands = VK_NULL_HANDLE;
+        // also the value it signals on both timelines
+        uint64_t serial = 0;
+        uint64_t stagingEnd = 0;
+        bool recording = false;
+        bool pending = false;
+        VkPipelineStageFlags dstStages = 0;
+        std::vector<VkBufferMemoryBarrier> releaseBarriers;
+        std::vector<VkBufferMemoryBarrier> acquireBarriers;
+        std::vector<VkImageMemoryBarrier> imageReleaseBarriers;
+        std::vector<VkImageMemoryBarrier> imageAcquireBarriers;
+    };
+
+    Batch& beginBatch();
+    VkDeviceSize allocateStaging(VkDeviceSize size);
+    void retire(Batch& batch);
+    void waitForBatch(Batch& batch);
+
+    VkDevice mDevice;
+    GpuAllocator& mAllocator;
+    VkQueue mTransferQueue;
+    VkQueue mGraphicsQueue;
+    uint32_t mTransferFamily;
+    uint32_t mGraphicsFamily;
+
+    VkCommandPool mTransferPool = VK_NULL_HANDLE;
+    VkCommandPool mAcquirePool = VK_NULL_HANDLE;
+
+    VkBuffer mStagingBuffer = VK_NULL_HANDLE;
+    GpuAllocation mStagingAllocation;
+    VkDeviceSize mStagingSize;
+    uint64_t mStagingHead = 0;
+    uint64_t mStagingTail = 0;
+
+    std::unique_ptr<Timeline> mTimeline;
+    // dedicated queue only, reached when the copies are done
+    std::unique_ptr<Timeline> mCopyTimeline;
+
+    std::array<Batch, BATCH_COUNT> mBatches;
+    uint32_t mCurrentBatch = 0;
+    uint32_t mOldestBatch = 0;
+    uint64_t mNextSerial = 1;
+    uint64_t mCompletedSerial = 0;
+};
+
+} // VulkanEngine
+
+#endif //TRANSFERQUEUE_H
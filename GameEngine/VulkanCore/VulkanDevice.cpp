@@ -1,4 +1,5 @@
 #include "VulkanDevice.h"
+#include "Timeline.h"
 
 #include <cstring>
 #include <set>
@@ -12,7 +13,10 @@ VulkanEngine::VulkanDevice::VulkanDevice(VkInstance instance, VkSurfaceKHR surfa
     mEnableValidationLayers = false;
 #endif
     pickPhysicalDevice();
+    mTextureFormats = queryTextureFormats(mPhysicalDevice);
     createLogicalDevice();
+    mAllocator = std::make_unique<GpuAllocator>(mPhysicalDevice, mDevice);
+    mDeletionQueue = std::make_unique<DeletionQueue>(mDevice, mAllocator.get());
     createCommandPool();
 }
 
@@ -23,6 +27,10 @@ VulkanEngine::VulkanDevice::~VulkanDevice() {
         vkDestroyCommandPool(mDevice, mCommandPool, nullptr);
     }
 
+    // still needs the allocator for the sub-allocations it holds
+    mDeletionQueue.reset();
+    mAllocator.reset();
+
     if (mDevice != VK_NULL_HANDLE) {
         vkDestroyDevice(mDevice, nullptr);
     }
@@ -33,20 +41,121 @@ VulkanEngine::VulkanDevice::~VulkanDevice() {
 }
 
 
-uint32_t
-VulkanEngine::VulkanDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
-{
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(mPhysicalDevice,&memProperties);
+bool
+VulkanEngine::TextureFormatSupport::supports(TextureFormat format, bool srgbData) const {
+    uint32_t index = static_cast<uint32_t>(format);
+    if (index >= 5) {
+        return false;
+    }
+    return srgbData ? srgb[index] : unorm[index];
+}
 
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
-    {
-        if(typeFilter & (1 << i)&&(memProperties.memoryTypes[i].propertyFlags & properties) == properties)
-        {
-            return i;
+
+VkFormat
+VulkanEngine::toVkFormat(TextureFormat format, bool srgb) {
+    switch (format) {
+    case TextureFormat::Rgba8:
+        return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+    case TextureFormat::Bc1:
+        return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    case TextureFormat::Bc3:
+        return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+    case TextureFormat::Bc5:
+        return srgb ? VK_FORMAT_UNDEFINED : VK_FORMAT_BC5_UNORM_BLOCK;
+    case TextureFormat::Bc7:
+        return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+
+VulkanEngine::TextureFormatSupport
+VulkanEngine::VulkanDevice::queryTextureFormats(VkPhysicalDevice physicalDevice) {
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+
+    TextureFormatSupport support;
+    support.textureCompressionBC = features.textureCompressionBC == VK_TRUE;
+
+    const TextureFormat formats[] = {TextureFormat::Rgba8, TextureFormat::Bc1, TextureFormat::Bc3, TextureFormat::Bc5, TextureFormat::Bc7};
+    for (TextureFormat format : formats) {
+        uint32_t index = static_cast<uint32_t>(format);
+        if (format != TextureFormat::Rgba8 && !support.textureCompressionBC) {
+            continue;
         }
+        for (bool srgb : {false, true}) {
+            VkFormat vkFormat = toVkFormat(format, srgb);
+            if (vkFormat == VK_FORMAT_UNDEFINED) {
+                continue;
+            }
+            VkFormatProperties properties;
+            vkGetPhysicalDeviceFormatProperties(physicalDevice, vkFormat, &properties);
+            bool sampled = (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) != 0 &&
+                           (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_TRANSFER_DST_BIT) != 0;
+            (srgb ? support.srgb : support.unorm)[index] = sampled;
+        }
+    }
+    return support;
+}
+
+
+VkFormat
+VulkanEngine::VulkanDevice::findDepthFormat(VkPhysicalDevice physicalDevice, VkFormatFeatureFlags features) {
+    const VkFormat candidates[] = {VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D16_UNORM};
+    features |= VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    for (VkFormat format : candidates) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+        if ((properties.optimalTilingFeatures & features) == features) {
+            return format;
+        }
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+
+VulkanEngine::RenderingFeatures
+VulkanEngine::VulkanDevice::queryRenderingFeatures(VkPhysicalDevice physicalDevice) {
+    RenderingFeatures features;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    if (properties.apiVersion < VK_API_VERSION_1_2) {
+        return features;
     }
-    throw std::runtime_error("ERROR: failed to find suitable memory type");
+
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+
+    bool dynamicRenderingExtension = false;
+    bool synchronization2Extension = false;
+    for (const auto& extension : extensions) {
+        dynamicRenderingExtension |= strcmp(extension.extensionName, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) == 0;
+        synchronization2Extension |= strcmp(extension.extensionName, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME) == 0;
+    }
+
+    VkPhysicalDeviceDynamicRenderingFeatures dynamicRendering{};
+    dynamicRendering.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+    VkPhysicalDeviceSynchronization2Features synchronization2{};
+    synchronization2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
+    dynamicRendering.pNext = &synchronization2;
+
+    VkPhysicalDeviceFeatures2 features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &dynamicRendering;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+    features.dynamicRendering = dynamicRenderingExtension && dynamicRendering.dynamicRendering == VK_TRUE;
+    features.synchronization2 = synchronization2Extension && synchronization2.synchronization2 == VK_TRUE;
+    return features;
+}
+
+uint32_t
+VulkanEngine::VulkanDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+{
+    return mAllocator->findMemoryType(typeFilter, properties);
 }
 
 
@@ -107,6 +216,7 @@ VulkanEngine::VulkanDevice::createLogicalDevice()
     }
 
     VkPhysicalDeviceFeatures DeviceFeatures{};
+    DeviceFeatures.textureCompressionBC = mTextureFormats.textureCompressionBC ? VK_TRUE : VK_FALSE;
 
     VkDeviceCreateInfo createInfo{};
 
@@ -116,6 +226,12 @@ VulkanEngine::VulkanDevice::createLogicalDevice()
 
     createInfo.pEnabledFeatures = &DeviceFeatures;
 
+    // the renderer paces its frames on a timeline semaphore
+    VkPhysicalDeviceVulkan12Features features12{};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    Timeline::enableFeatures(features12);
+    createInfo.pNext = &features12;
+
     createInfo.enabledExtensionCount = static_cast<uint32_t>(mDeviceExtensions.size());
     createInfo.ppEnabledExtensionNames = mDeviceExtensions.data();
 
@@ -144,6 +260,8 @@ VulkanEngine::VulkanDevice::createLogicalDevice()
     }
     if (indices.transfereFamily.has_value()) {
         vkGetDeviceQueue(mDevice, indices.transfereFamily.value(), 0, &mTransferQueue);
+    } else {
+        mTransferQueue = mGraphicsQueue;
     }
 
 }
@@ -210,21 +328,35 @@ VulkanEngine::VulkanDevice::findQueueFamilyIndices(VkPhysicalDevice device)
     int i = 0;
     for (const auto& queueFamily : queueFam)
     {
-        if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+        if (!indices.isComplete())
         {
-            indices.graphicsFamily = i;
-        }
+            if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+            {
+                indices.graphicsFamily = i;
+            }
 
-        VkBool32 presentSupport = false;
+            VkBool32 presentSupport = false;
 
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, mSurface, &presentSupport);
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, mSurface, &presentSupport);
 
-        if (presentSupport)
+            if (presentSupport)
+            {
+                indices.presentFamily = i;
+            }
+        }
+
+        // dedicated transfer family, preferably a DMA-only one
+        if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT))
         {
-            indices.presentFamily = i;
+            if (!indices.isTransfereFamily() || !(queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT))
+            {
+                indices.transfereFamily = i;
+            }
         }
-        if (indices.isComplete()) {
-            break;
+
+        if ((queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && !indices.isComputeFamily())
+        {
+            indices.computeFamily = i;
         }
         i++;
     }
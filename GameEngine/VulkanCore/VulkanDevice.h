@@ -5,7 +5,11 @@
 #include <iostream>
 #include <vector>
 #include <optional>
+#include <memory>
 #include "vulkan/vulkan.h"
+#include "GpuAllocator.h"
+#include "DeletionQueue.h"
+#include "../Core/TextureData.h"
 
 
 namespace VulkanEngine {
@@ -34,6 +38,29 @@ namespace VulkanEngine {
 
     };
 
+    // What the device can sample with optimal tiling, per TextureFormat in its UNORM and sRGB
+    // variant. BC5 has no sRGB variant.
+    struct TextureFormatSupport
+    {
+        bool textureCompressionBC = false;
+        bool unorm[5] = {};
+        bool srgb[5] = {};
+
+        bool supports(TextureFormat format, bool srgbData) const;
+    };
+
+    // VK_FORMAT_UNDEFINED when the format has no such variant.
+    VkFormat toVkFormat(TextureFormat format, bool srgb);
+
+    // VK_KHR_dynamic_rendering and VK_KHR_synchronization2, both core in 1.3. Only set when the
+    // extension is there and its feature is supported; enable them through the extensions, the
+    // instance only asks for 1.2.
+    struct RenderingFeatures
+    {
+        bool dynamicRendering = false;
+        bool synchronization2 = false;
+    };
+
 class VulkanDevice {
 public:
     VulkanDevice(VkInstance instance, VkSurfaceKHR surface);
@@ -43,8 +70,23 @@ public:
     VkDevice getLogicalDevice() const { return mDevice; }
     VkQueue getGraphicsQueue() const { return mGraphicsQueue; }
     VkQueue getPresentQueue() const { return mPresentQueue; }
+    VkQueue getTransferQueue() const { return mTransferQueue; }
+    VkQueue getComputeQueue() const { return mComputeQueue; }
     QueueFamilyIndices getQueueFamilyIndices() const { return mQueueFamilyIndices; }
     VkCommandPool getCommandPool() const { return mCommandPool; }
+    GpuAllocator& getAllocator() const { return *mAllocator; }
+    // Retire resources here instead of destroying them while a frame may still use them.
+    DeletionQueue& getDeletionQueue() const { return *mDeletionQueue; }
+
+    // Cooked textures in formats this says no to fall back to their source image.
+    const TextureFormatSupport& getTextureFormats() const { return mTextureFormats; }
+    // BC formats only count when textureCompressionBC gets enabled, as createLogicalDevice does.
+    static TextureFormatSupport queryTextureFormats(VkPhysicalDevice physicalDevice);
+    // First of D32, X8_D24 and D16 whose optimal tiling has DEPTH_STENCIL_ATTACHMENT plus
+    // features, VK_FORMAT_UNDEFINED if none does.
+    static VkFormat findDepthFormat(VkPhysicalDevice physicalDevice, VkFormatFeatureFlags features = 0);
+    // Both need a 1.2 device, dynamic rendering builds on its depth stencil resolve.
+    static RenderingFeatures queryRenderingFeatures(VkPhysicalDevice physicalDevice);
 
     uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
     SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device) const;
@@ -68,6 +110,9 @@ private:
     VkQueue mTransferQueue = VK_NULL_HANDLE;
     VkCommandPool mCommandPool = VK_NULL_HANDLE;
     QueueFamilyIndices mQueueFamilyIndices;
+    TextureFormatSupport mTextureFormats;
+    std::unique_ptr<GpuAllocator> mAllocator;
+    std::unique_ptr<DeletionQueue> mDeletionQueue;
 
     const std::vector<const char*> mDeviceExtensions = {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME
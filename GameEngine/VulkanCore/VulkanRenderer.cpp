@@ -17,14 +17,16 @@ VulkanEngine::VulkanRenderer::VulkanRenderer(VulkanDevice& device, VkSurfaceKHR
 
 VulkanEngine::VulkanRenderer::~VulkanRenderer() {
     vkDeviceWaitIdle(device.getLogicalDevice());
+    // the queue still refers to the frame timeline destroyed below
+    device.getDeletionQueue().flush();
 
     cleanupSwapChain();
 
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         vkDestroySemaphore(device.getLogicalDevice(), renderFinishedSemaphores[i], nullptr);
         vkDestroySemaphore(device.getLogicalDevice(), imageAvailableSemaphores[i], nullptr);
-        vkDestroyFence(device.getLogicalDevice(), inFlightFences[i], nullptr);
     }
+    frameTimeline.reset();
 
     vkDestroyRenderPass(device.getLogicalDevice(), renderPass, nullptr);
 }
@@ -272,22 +274,20 @@ void
 VulkanEngine::VulkanRenderer::createSyncObjects() {
     imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
     renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
 
     VkSemaphoreCreateInfo semaphoreInfo{};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         if (vkCreateSemaphore(device.getLogicalDevice(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-            vkCreateSemaphore(device.getLogicalDevice(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-            vkCreateFence(device.getLogicalDevice(), &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+            vkCreateSemaphore(device.getLogicalDevice(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create synchronization objects for a frame!");
         }
     }
+
+    // acquire and present only take binary semaphores, frame completion goes on the timeline
+    frameTimeline = std::make_unique<Timeline>(device.getLogicalDevice());
+    frameTimelineValues.assign(MAX_FRAMES_IN_FLIGHT, 0);
 }
 
 
@@ -349,15 +349,27 @@ VulkanEngine::VulkanRenderer::endFrame() {
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
 
-    VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-    submitInfo.signalSemaphoreCount = 1;
+    uint64_t timelineValue = frameTimeline->advance();
+    VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame], frameTimeline->getHandle()};
+    submitInfo.signalSemaphoreCount = 2;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
-    vkResetFences(device.getLogicalDevice(), 1, &inFlightFences[currentFrame]);
-
-    if (vkQueueSubmit(device.getGraphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
+    // the binary semaphore ignores its value
+    uint64_t waitValues[] = {0};
+    uint64_t signalValues[] = {0, timelineValue};
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = 1;
+    timelineInfo.pWaitSemaphoreValues = waitValues;
+    timelineInfo.signalSemaphoreValueCount = 2;
+    timelineInfo.pSignalSemaphoreValues = signalValues;
+    submitInfo.pNext = &timelineInfo;
+
+    if (vkQueueSubmit(device.getGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
         throw std::runtime_error("Failed to submit draw command buffer!");
     }
+    frameTimelineValues[currentFrame] = timelineValue;
+    device.getDeletionQueue().submitFrame(frameTimeline->getHandle(), timelineValue);
 
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -381,7 +393,8 @@ VulkanEngine::VulkanRenderer::endFrame() {
     isFrameStarted = false;
     currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 
-    vkWaitForFences(device.getLogicalDevice(), 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+    frameTimeline->wait(frameTimelineValues[currentFrame]);
+    device.getDeletionQueue().collect();
 }
 
 
@@ -3,6 +3,7 @@
 #define VULKANRENDERER_H
 
 #include "VulkanDevice.h"
+#include "Timeline.h"
 #include <vulkan/vulkan.h>
 #include <vector>
 #include <memory>
@@ -61,7 +62,9 @@ private:
     static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
     std::vector<VkSemaphore> imageAvailableSemaphores;
     std::vector<VkSemaphore> renderFinishedSemaphores;
-    std::vector<VkFence> inFlightFences;
+    // value each frame slot signalled last, the slot is reused once the timeline reaches it
+    std::unique_ptr<Timeline> frameTimeline;
+    std::vector<uint64_t> frameTimelineValues;
 
     uint32_t currentFrame = 0;
     uint32_t currentImageIndex = 0;
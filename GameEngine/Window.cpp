@@ -3,77 +3,163 @@
 #include <cstdint>
 #include <fstream>
 #include <cstring>
+#include <cstdio>
 #include <filesystem>
 #include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include "Core/FrameDump.h"
+#include "Core/TextureFile.h"
+#include "Core/MeshFile.h"
+#include "Core/MeshOptimizer.h"
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 
+#ifndef SHADER_PATH
+#define SHADER_PATH "Shader/"
+#endif
 
-void WindowApp::run()
+
+WindowApp::WindowApp(const VulkanEngine::AppSettings& settings)
+	: mSettings(settings), mFramesInFlight(settings.framesInFlight), mPacer(settings.fpsLimit)
+{
+	if (mSettings.headless)
+	{
+		deviceExtensions.clear();
+	}
+}
+
+int WindowApp::run()
 {
 	initWindow();
 	initVulkan();
-	WindowLoop();
+	//the pipelines were timed while initVulkan built them, nothing left to render
+	if (mSettings.benchmarkPipelines)
+	{
+		vkDeviceWaitIdle(mDevice);
+	}
+	else
+	{
+		WindowLoop();
+	}
 	CleanUp();
+
+	if (mSettings.verifyCulling)
+	{
+		if (mCullingMismatches > 0)
+		{
+			std::cerr << "Culling: " << mCullingMismatches << " of " << mFrameNumber << " frames disagree with the cpu reference" << std::endl;
+			return 1;
+		}
+		std::cout << "Culling: " << mFrameNumber << " frames agree with the cpu reference" << std::endl;
+	}
+	return 0;
 }
 
 void WindowApp::initWindow()
 {
+	if (mSettings.headless)
+	{
+		return;
+	}
+
 	glfwInit();
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-	mWindow = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan Engine", nullptr, nullptr);
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+	mWindow = glfwCreateWindow(static_cast<int>(mSettings.width), static_cast<int>(mSettings.height), "Vulkan Engine", nullptr, nullptr);
+	glfwSetWindowUserPointer(mWindow, this);
+	glfwSetFramebufferSizeCallback(mWindow, framebufferResizeCallback);
+}
+
+void WindowApp::framebufferResizeCallback(GLFWwindow* window, int width, int height)
+{
+	auto app = reinterpret_cast<WindowApp*>(glfwGetWindowUserPointer(window));
+	app->mFramebufferResized = true;
 }
 void WindowApp::initVulkan()
 {
+	createJobSystem();
 	CreateInstance();
 	setupDebugMessenger();
-	createSurface();	
+	if (!mSettings.headless)
+	{
+		createSurface();
+	}
 	PhysicalDevice();
 	createLogicalDevice();
-	createSwapChain();
-	createImageVeiw();
+	createAllocator();
+	createPipelineCache();
+	if (mSettings.headless)
+	{
+		createOffscreenTarget();
+	}
+	else
+	{
+		createSwapChain();
+		createImageVeiw();
+	}
 	createRenderPass();
 	createDescriptorSetLayout();
+	createBindlessTable();
 	createGraphicsPipeline();
+	createRenderGraph();
 	createFramebuffers();
 	createCommandPool();
-	createVertexBuffer();
-	createIndexBuffer();
-	createUniformBuffers();
+	createTransferQueue();
+	createTextureStreamer();
+	loadMesh();
+	createFrameRingBuffer();
+	createScene();
 	createDescriptorPool();
 	createDescriptorSets();
+	createParallelRecorder();
+	createCullingPass();
+	createMeshletPass();
+	createGpuProfiler();
 	createCommandBuffers();
 	createSyncObj();
 }
 
 void WindowApp::CleanUp()
 {
+	//retires its images and slots into the queue, so before it
+	mTextures.reset();
+	mMeshlets.reset();
+	destroyRenderGraph();
+	//the device is idle, whatever is still queued goes now
+	mDeletionQueue.reset();
+	//after the queue, removed slots are handed back to the table when it flushes
+	mBindless.reset();
+	vkDestroySampler(mDevice, mDefaultSampler, nullptr);
+	releaseRetiredSwapchains(true);
 	cleanUpSwapChain();
 	
-	for (auto i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-	{
-		vkDestroyBuffer(mDevice, mUniformBuffers[i], nullptr);
-		vkFreeMemory(mDevice, mUniformBuffersMemory[i], nullptr);
-	}
+	mCulling.reset();
+	mRecorder.reset();
+	mGpuProfiler.reset();
+	mFrameRing.reset();
 	
 	vkDestroyDescriptorPool(mDevice, mDescriptorPool, nullptr);
 	vkDestroyDescriptorSetLayout(mDevice, mDescriptorSetLayout, nullptr);
 
-	for (auto i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	for (uint32_t i = 0; i < mFramesInFlight; i++)
 	{
 		vkDestroySemaphore(mDevice, renderFinishedSemaphores[i], nullptr);
 		vkDestroySemaphore(mDevice, imageAvalibleSemaphores[i], nullptr);
-		vkDestroyFence(mDevice, inFlightFences[i], nullptr);
 	}
+	mFrameTimeline.reset();
 
-	vkDestroyBuffer(mDevice, mIndexBuffer, nullptr);
-	vkFreeMemory(mDevice, mIndexBufferMemory, nullptr);
-	
-	vkDestroyBuffer(mDevice, mVertexBuffer, nullptr);
-	vkDestroyCommandPool(mDevice, mCommandPool, nullptr);
+	mAllocator->destroyBuffer(mIndexBuffer, mIndexBufferAllocation);
+	mAllocator->destroyBuffer(mVertexBuffer, mVertexBufferAllocation);
+
+	for (auto commandPool : mCommandPools)
+	{
+		vkDestroyCommandPool(mDevice, commandPool, nullptr);
+	}
 
-	vkDestroyBuffer(mDevice,mVertexBuffer,nullptr);
-	vkFreeMemory(mDevice,mVertexBufferMemory,nullptr);
 	for (auto frameBuffer : swapChainFrambuffers)
 	{
 		vkDestroyFramebuffer(mDevice, frameBuffer, nullptr);
@@ -81,6 +167,12 @@ void WindowApp::CleanUp()
 
 	vkDestroyPipelineLayout(mDevice, mPipelinelayout, nullptr);
 	vkDestroyPipeline(mDevice, mPipeline, nullptr);
+	//null without mesh shaders, which is fine to destroy
+	vkDestroyPipelineLayout(mDevice, mMeshletPipelineLayout, nullptr);
+	vkDestroyPipeline(mDevice, mMeshletPipeline, nullptr);
+	//null without occlusion culling, as above
+	vkDestroyPipeline(mDevice, mDepthPipeline, nullptr);
+	vkDestroyRenderPass(mDevice, mDepthPrepassRenderpass, nullptr);
 	vkDestroyRenderPass(mDevice, mRenderpass,nullptr);
 
 
@@ -88,6 +180,10 @@ void WindowApp::CleanUp()
 	{
 		vkDestroyImageView(mDevice, imageView, nullptr);
 	}
+	mUploader.reset();
+	mPipelineCache->save();
+	mPipelineCache.reset();
+	mAllocator.reset();
 	vkDestroyDevice(mDevice, nullptr);
 	
 	if (enableValidationLayers)
@@ -95,43 +191,264 @@ void WindowApp::CleanUp()
 		DestroyDebugUtilsMessengerEXT(mInstance, mDebugMessenger, nullptr);
 	}
 
-	vkDestroySurfaceKHR(mInstance, mSurface, nullptr);
+	if (!mSettings.headless)
+	{
+		vkDestroySurfaceKHR(mInstance, mSurface, nullptr);
+	}
 	vkDestroyInstance(mInstance, nullptr);
-	glfwDestroyWindow(mWindow);
-	glfwTerminate();
+	if (!mSettings.headless)
+	{
+		glfwDestroyWindow(mWindow);
+		glfwTerminate();
+	}
+
+	mJobs.reset();
 }
 
 void WindowApp::WindowLoop()
 {
-	while (!glfwWindowShouldClose(mWindow))
+	auto loopStart = std::chrono::high_resolution_clock::now();
+
+	while (mSettings.frameCount == 0 || mFrameNumber < mSettings.frameCount)
 	{
-		//system("cls");
+		//presents that complete while the limiter spins are timestamped as they land
+		mPacer.waitForNextFrame([this]() { pollPresentCompletion(); });
+
+		VulkanEngine::Profiler::beginFrame();
+
+		//latency is counted from the moment input is sampled for this frame
+		mPacer.markInput(mFrameNumber);
+		if (!mSettings.headless)
+		{
+			if (glfwWindowShouldClose(mWindow))
+			{
+				break;
+			}
+			glfwPollEvents();
 
-		glfwPollEvents();
-		//auto frameStart = std::chrono::high_resolution_clock::now();
+			//a minimized window has no surface area to render to, sleep until something changes
+			int width = 0, height = 0;
+			glfwGetFramebufferSize(mWindow, &width, &height);
+			if (width == 0 || height == 0)
+			{
+				glfwWaitEvents();
+				VulkanEngine::Profiler::endFrame();
+				continue;
+			}
+		}
+		//glfw and other main thread only work queued by jobs
+		mJobs->pumpMainThread();
 		drawFrame();
-		//auto frameEnd = std::chrono::high_resolution_clock::now();
 
-	//		std::chrono::duration<double, std::milli> elapsed = frameEnd - frameStart;
-	//	double fps = 1000.0 / elapsed.count();
-	//	double deltaTime = elapsed.count();
-		
-		//std::cout << "Frame time: " << elapsed.count() << "ms" << std::endl;
-		//std::cout << "FPS: " << fps << std::endl;
-		
+		VulkanEngine::Profiler::endFrame();
+
+		//a rolling summary in the title, about once a second at 60fps
+		if (!mSettings.headless && mFrameNumber % 60 == 0)
+		{
+			VulkanEngine::FrameStats cpu = VulkanEngine::Profiler::getFrameStats();
+			VulkanEngine::FrameStats gpu = VulkanEngine::Profiler::getGpuFrameStats();
+			VulkanEngine::FrameStats latency = mPacer.getLatencyStats();
+			char title[200];
+			snprintf(title, sizeof(title), "Vulkan Engine - frame p50 %.2fms p99 %.2fms | gpu p50 %.2fms p99 %.2fms | latency p50 %.2fms p99 %.2fms",
+				cpu.p50Ms, cpu.p99Ms, gpu.p50Ms, gpu.p99Ms, latency.p50Ms, latency.p99Ms);
+			glfwSetWindowTitle(mWindow, title);
+		}
 	}
 	vkDeviceWaitIdle(mDevice);
+	pollPresentCompletion();
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - loopStart;
+
+	//frames still sitting in their readback slots and timestamp ranges
+	for (uint32_t i = 0; i < mReadbackFrame.size(); i++)
+	{
+		processReadback(i);
+	}
+	for (uint32_t i = 0; i < mFramesInFlight; i++)
+	{
+		mGpuProfiler->collect(i);
+		if (!mMeshlets)
+		{
+			mCulling->collect(i);
+			verifyCulling(i);
+		}
+	}
+
+	if (mSettings.benchmark && mFrameNumber > 0)
+	{
+		std::cout << "Benchmark: " << mFrameNumber << " frames at " << mSwapchainExtent.width << "x" << mSwapchainExtent.height
+			<< " in " << elapsed.count() << "ms, " << elapsed.count() / mFrameNumber << "ms/frame, "
+			<< 1000.0 * mFrameNumber / elapsed.count() << " fps" << std::endl;
+		printFrameStats();
+	}
+
+	if (!mSettings.tracePath.empty())
+	{
+		VulkanEngine::Profiler::writeChromeTrace(mSettings.tracePath);
+		std::cout << "Trace written to " << mSettings.tracePath << std::endl;
+	}
+}
+
+void WindowApp::printFrameStats()
+{
+	VulkanEngine::FrameStats cpu = VulkanEngine::Profiler::getFrameStats();
+	VulkanEngine::FrameStats gpu = VulkanEngine::Profiler::getGpuFrameStats();
+
+	std::cout << "Frame time over the last " << cpu.frameCount << " frames: avg " << cpu.averageMs << "ms, p50 " << cpu.p50Ms
+		<< "ms, p99 " << cpu.p99Ms << "ms, max " << cpu.maxMs << "ms" << std::endl;
+	if (gpu.frameCount > 0)
+	{
+		std::cout << "GPU time over the last " << gpu.frameCount << " frames: avg " << gpu.averageMs << "ms, p50 " << gpu.p50Ms
+			<< "ms, p99 " << gpu.p99Ms << "ms, max " << gpu.maxMs << "ms" << std::endl;
+	}
+	std::cout << "Passes: " << (mDynamicRendering ? "dynamic rendering, synchronization2 barriers and submits"
+		: "render pass objects and framebuffers, original barriers and submits") << std::endl;
+
+	uint64_t meshBytes = mVertexBufferSize + mMesh.indices.byteSize();
+	std::cout << "Mesh: " << mMesh.vertices.size() << " vertices, " << mMesh.lods[0].indexCount / 3 << " triangles from "
+		<< (mSettings.meshPath.empty() ? std::string("the built in quad") : mSettings.meshPath) << ", loaded in " << mMeshLoadMs << "ms ("
+		<< meshBytes / (1024.0 * 1024.0) / std::max(mMeshLoadMs / 1000.0, 1e-9) << "MB/s into staging)" << std::endl;
+	std::cout << "  " << mVertexBufferSize / std::max<size_t>(mMesh.vertices.size(), 1) << " bytes per vertex" << (mSettings.quantizeVertices ? " (quantized)" : "")
+		<< ", ACMR " << mMeshCacheStats.acmr << ", ATVR " << mMeshCacheStats.atvr << std::endl;
+	if (mMeshlets)
+	{
+		//the last frame recorded into slot 0, everything is idle by the time the stats print
+		uint32_t drawn = mMeshlets->getVisibleCount(0);
+		uint64_t total = uint64_t(mMeshlets->getMeshletCount()) * mObjectCount;
+		std::cout << "Meshlets: " << mMeshlets->getMeshletCount() << " per object, "
+			<< (mMeshlets->getMode() == VulkanEngine::MeshletPass::Mode::MeshShader ? "mesh shaders" : "compute culling")
+			<< ", " << drawn << " of " << total << " drawn (" << 100.0 * drawn / std::max<uint64_t>(total, 1) << "%)" << std::endl;
+	}
+
+	const VulkanEngine::CullingPass::CullingStats& culling = mCulling->getStats();
+	if (culling.frames > 0)
+	{
+		double frames = static_cast<double>(culling.frames);
+		std::cout << "Culling per frame over " << culling.frames << " frames: " << culling.tested / frames << " tested, "
+			<< culling.frustumCulled / frames << " outside the frustum, " << culling.occlusionCulled / frames << " occluded ("
+			<< culling.occlusionRetested / frames << " retested late), " << culling.drawnEarly / frames << " drawn early, "
+			<< culling.drawnLate / frames << " late" << (mOcclusionCulling ? "" : ", occlusion culling off") << std::endl;
+	}
+
+	VulkanEngine::TextureStreamingStats textures = mTextures->getStats();
+	if (textures.textureCount > 0)
+	{
+		const double mb = 1024.0 * 1024.0;
+		std::cout << "Textures: " << textures.textureCount << " streamed, decode " << textures.decodedBytes / mb / std::max(textures.decodeSeconds, 1e-9)
+			<< "MB/s, mips " << textures.mipSeconds * 1000.0 << "ms, upload " << textures.uploadedBytes / mb / std::max(textures.uploadSeconds, 1e-9)
+			<< "MB/s, resident " << textures.residentBytes / mb << "MB of " << textures.budgetBytes / mb << "MB, "
+			<< textures.evictions << " evictions" << (mTextures->isIdle() ? "" : ", still streaming") << std::endl;
+	}
+
+	VulkanEngine::FrameStats latency = mPacer.getLatencyStats();
+	if (latency.frameCount > 0)
+	{
+		std::cout << (mPresentWait ? "Input to present" : "Input to gpu completion") << " over the last " << latency.frameCount
+			<< " frames: avg " << latency.averageMs << "ms, p50 " << latency.p50Ms << "ms, p99 " << latency.p99Ms
+			<< "ms, max " << latency.maxMs << "ms (" << mFramesInFlight << " frames in flight)" << std::endl;
+	}
+}
+
+void WindowApp::pollPresentCompletion()
+{
+	if (mPresentWait)
+	{
+		//a present the swapchain cannot report on is dropped, the ones behind it may still complete
+		while (!pollPresents(mSwapChain, mPendingPresents))
+		{
+			mPendingPresents.pop_front();
+		}
+		return;
+	}
+
+	for (uint32_t i = 0; i < mTimelineFrame.size(); i++)
+	{
+		if (mTimelineFrame[i].has_value() && mFrameTimeline->isComplete(mFrameTimelineValue[i]))
+		{
+			mPacer.markPresented(mTimelineFrame[i].value());
+			mTimelineFrame[i].reset();
+		}
+	}
+}
+bool WindowApp::pollPresents(VkSwapchainKHR swapchain, std::deque<uint64_t>& pendingPresents)
+{
+	//presents complete in order, a zero timeout only asks. False when the front one failed
+	while (!pendingPresents.empty())
+	{
+		VkResult result = mWaitForPresent(mDevice, swapchain, pendingPresents.front() + 1, 0);
+		if (result == VK_TIMEOUT)
+		{
+			return true;
+		}
+		if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+		{
+			return false;
+		}
+		mPacer.markPresented(pendingPresents.front());
+		pendingPresents.pop_front();
+	}
+	return true;
 }
+
 void WindowApp::drawFrame()
 {
-	vkWaitForFences(mDevice, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
-	vkResetFences(mDevice, 1, &inFlightFences[currentFrame]);
+	PROFILE_SCOPE("drawFrame");
+
+	//residency changes are recorded as uploads, so before the flush
+	mTextures->update(mFrameNumber);
+	//uploads recorded since the last frame go out before this frame's submit
+	mUploader->flush();
+	mUploader->collect();
+
+	{
+		PROFILE_SCOPE("Wait for frame timeline");
+		mFrameTimeline->wait(mFrameTimelineValue[currentFrame]);
+	}
+	//before the slot's value is replaced, the timeline fallback reads it
+	pollPresentCompletion();
+	releaseRetiredSwapchains(false);
+	mDeletionQueue->collect();
+
+	//the timestamps this slot wrote last time around are ready now, and so are the culling counters
+	mGpuProfiler->collect(currentFrame);
+	if (!mMeshlets)
+	{
+		mCulling->collect(currentFrame);
+	}
+
+	//the gpu is done with this frame's partition
+	mFrameRing->beginFrame(currentFrame);
+
+	if (!mMeshlets)
+	{
+		verifyCulling(currentFrame);
+	}
+
+	if (mSettings.headless)
+	{
+		//the previous frame in this slot has finished, so its readback is complete
+		processReadback(currentFrame);
+
+		//every frame in flight owns its offscreen image, there is nothing to acquire or present
+		updateFrameData(currentFrame);
+		vkResetCommandPool(mDevice, mCommandPools[currentFrame], 0);
+		recordCommandBuffer(commandBuffers[currentFrame], currentFrame);
+
+		uint64_t timelineValue = submitFrame(VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+		mTimelineFrame[currentFrame] = mFrameNumber;
+		mDeletionQueue->submitFrame(mFrameTimeline->getHandle(), timelineValue);
+
+		mFrameNumber++;
+		currentFrame = (currentFrame + 1) % mFramesInFlight;
+		return;
+	}
 
 	uint32_t imageIndex;
 	VkResult swapchainResult = vkAcquireNextImageKHR(mDevice, mSwapChain, UINT64_MAX, imageAvalibleSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
 
 	if (swapchainResult == VK_ERROR_OUT_OF_DATE_KHR)
 	{
+		//nothing was submitted, the slot's timeline value still stands and it is simply retried next frame
 		recreateSwapChain();
 		return;
 	}
@@ -140,33 +457,21 @@ void WindowApp::drawFrame()
 		throw std::runtime_error("ERROR: FAILED TO AQUIRE SWAPCHAIN IMAGE");
 	}
 
-	updateUniformBuffer(currentFrame);
+	updateFrameData(currentFrame);
 
-	vkResetCommandBuffer(commandBuffers[currentFrame], 0);
+	//the whole pool is recycled instead of resetting buffers one by one
+	vkResetCommandPool(mDevice, mCommandPools[currentFrame], 0);
 	recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
 
-	VkSubmitInfo submitInfo{};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-	VkSemaphore waitSemaphores[] = { imageAvalibleSemaphores[currentFrame]};
-	VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = waitSemaphores;
-	submitInfo.pWaitDstStageMask = waitStages;
-
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
-
+	//the graph's first transition of the image waits at color output, see createRenderGraph
 	VkSemaphore signalSemaphore[] = {renderFinishedSemaphores[currentFrame]};
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = signalSemaphore;
-
-	if (vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
+	uint64_t timelineValue = submitFrame(imageAvalibleSemaphores[currentFrame], VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, signalSemaphore[0]);
+	mDeletionQueue->submitFrame(mFrameTimeline->getHandle(), timelineValue);
+	if (!mPresentWait)
 	{
-		throw std::runtime_error("ERROR: failed to submit to queue");
+		mTimelineFrame[currentFrame] = mFrameNumber;
 	}
 
-
 	VkPresentInfoKHR presentInfo{};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
@@ -179,10 +484,41 @@ void WindowApp::drawFrame()
 
 	presentInfo.pImageIndices = &imageIndex;
 
-	vkQueuePresentKHR(mPresentQueue,&presentInfo);
+	//present ids start at 1, frame n is presented as n + 1
+	uint64_t presentId = mFrameNumber + 1;
+	VkPresentIdKHR presentIdInfo{};
+	presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+	presentIdInfo.swapchainCount = 1;
+	presentIdInfo.pPresentIds = &presentId;
+	if (mPresentWait)
+	{
+		presentInfo.pNext = &presentIdInfo;
+		mPendingPresents.push_back(mFrameNumber);
+	}
+
+	VkResult presentResult;
+	{
+		PROFILE_SCOPE("Present");
+		presentResult = vkQueuePresentKHR(mPresentQueue,&presentInfo);
+	}
+	//an out of date swapchain did not take the image, there is nothing to wait for
+	if (mPresentWait && presentResult == VK_ERROR_OUT_OF_DATE_KHR)
+	{
+		mPendingPresents.pop_back();
+	}
+
+	mFrameNumber++;
+	currentFrame = (currentFrame + 1) % mFramesInFlight;
 
-	currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
-	//std::cout << currentFrame << std::endl;
+	if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR || mFramebufferResized)
+	{
+		mFramebufferResized = false;
+		recreateSwapChain();
+	}
+	else if (presentResult != VK_SUCCESS)
+	{
+		throw std::runtime_error("ERROR: failed to present swapchain image");
+	}
 }
 
 
@@ -199,7 +535,7 @@ void WindowApp::CreateInstance()
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	appInfo.pEngineName = "MikaelEngine";
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	appInfo.apiVersion = VK_API_VERSION_1_2;
 
 	VkInstanceCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -242,12 +578,15 @@ void WindowApp::PhysicalDevice()
 	}
 	std::vector<VkPhysicalDevice> physDev(numberOfGPU);
 	vkEnumeratePhysicalDevices(mInstance, &numberOfGPU, physDev.data());
+	uint32_t bestScore = 0;
 	for (const auto& device : physDev) 
 	{
-		if (isDeviceSuitable(device)) 
+		//software rasterizers like lavapipe and SwiftShader are still picked when nothing else is there
+		uint32_t score = isDeviceSuitable(device) ? rateDevice(device) : 0;
+		if (score > bestScore) 
 		{
 			mPhysicalDevice = device;
-			break;
+			bestScore = score;
 		}
 	}
 	
@@ -264,38 +603,56 @@ bool WindowApp::isDeviceSuitable(VkPhysicalDevice Device)
 	vkGetPhysicalDeviceProperties(Device, &deviceProp);
 	QueueFamilyIndices indices = findQueueFamily(Device);
 	bool extensionSupport = checkExtensionSupport(Device);
-	bool swapChainSupported = false;
-	if (extensionSupport) 
+	bool swapChainSupported = mSettings.headless;
+	if (extensionSupport && !mSettings.headless) 
 	{
 		VulkanEngine::SwapChainSupportDetails swapChainDet = querySwapChainSupport(Device);
 		swapChainSupported = !swapChainDet.formats.empty() && !swapChainDet.presentMode.empty();
 	}
 
-	return deviceProp.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU && Devicefeat.geometryShader && indices.isComplete() && extensionSupport&&swapChainSupported;
+	//shaders index their textures and buffers through the bindless table, which needs descriptor indexing.
+	//Frames and uploads are tracked on timeline semaphores
+	bool bindlessSupported = false;
+	bool timelineSupported = false;
+	if (deviceProp.apiVersion >= VK_API_VERSION_1_2)
+	{
+		VkPhysicalDeviceVulkan12Features features12{};
+		features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &features12;
+		vkGetPhysicalDeviceFeatures2(Device, &features2);
+		bindlessSupported = VulkanEngine::BindlessTable::isSupported(features12);
+		timelineSupported = VulkanEngine::Timeline::isSupported(features12);
+	}
+
+	return indices.isComplete() && extensionSupport&&swapChainSupported && bindlessSupported && timelineSupported;
 
 }
 
-int rateDevice(VkPhysicalDevice device)
+uint32_t WindowApp::rateDevice(VkPhysicalDevice device)
 {
-	unsigned int result = 0;
 	VkPhysicalDeviceProperties deviceProp{};
-	VkPhysicalDeviceFeatures deviceFeatures{};
 	vkGetPhysicalDeviceProperties(device, &deviceProp);
-	vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
 
-	if (deviceProp.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
-	{
-		result +=1000;
-	}else
-	{
-		result +=10;
-	}
-	result += deviceProp.limits.maxImageDimension2D;
-	if(deviceFeatures.geometryShader)
+	//discrete before integrated before virtual before cpu, then the largest texture limit
+	uint32_t result = 0;
+	switch (deviceProp.deviceType)
 	{
-		return 0;
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+		result = 4;
+		break;
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+		result = 3;
+		break;
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+		result = 2;
+		break;
+	default:
+		result = 1;
+		break;
 	}
-	return result;
+	return result * 100000 + std::min(deviceProp.limits.maxImageDimension2D, 99999u);
 }
 
 QueueFamilyIndices WindowApp::findQueueFamily(VkPhysicalDevice device)
@@ -308,21 +665,43 @@ QueueFamilyIndices WindowApp::findQueueFamily(VkPhysicalDevice device)
 	int i = 0;
 	for (const auto& queueFamily : queueFam) 
 	{
-		if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+		if (!indices.isComplete())
 		{
-			indices.graphicsFamily = i;
+			if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+			{
+				indices.graphicsFamily = i;
+			}
+
+			VkBool32 presentSupport = false;
+			
+			if (mSettings.headless)
+			{
+				//nothing is presented, the graphics queue stands in so the rest of the setup is unchanged
+				presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+			}
+			else
+			{
+				vkGetPhysicalDeviceSurfaceSupportKHR(device, i, mSurface, &presentSupport);
+			}
+			
+			if (presentSupport)
+			{
+				indices.presentFamily = i;
+			}
 		}
 
-		VkBool32 presentSupport = false;
-		
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, mSurface, &presentSupport);
-		
-		if (presentSupport)
+		//dedicated transfer family, ideally one that is DMA only
+		if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT))
 		{
-			indices.presentFamily = i;
+			if (!indices.isTransfereFamily() || !(queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT))
+			{
+				indices.transfereFamily = i;
+			}
 		}
-		if (indices.isComplete()) {
-			break;
+
+		if ((queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && !indices.isComputeFamily())
+		{
+			indices.computeFamily = i;
 		}
 		i++;
 	}
@@ -374,11 +753,14 @@ bool WindowApp::checkForValidationLayerSupport()
 
 std::vector<const char*> WindowApp::getRequiredextensions()
 {
-	uint32_t extentioncount = 0;
-	const char** glfwExtension;
-	glfwExtension = glfwGetRequiredInstanceExtensions(&extentioncount);
-
-	std::vector<const char*> extensions(glfwExtension, glfwExtension + extentioncount);
+	std::vector<const char*> extensions;
+	if (!mSettings.headless)
+	{
+		uint32_t extentioncount = 0;
+		const char** glfwExtension;
+		glfwExtension = glfwGetRequiredInstanceExtensions(&extentioncount);
+		extensions.assign(glfwExtension, glfwExtension + extentioncount);
+	}
 
 	if(enableValidationLayers)
 	{
@@ -443,6 +825,10 @@ void WindowApp::createLogicalDevice()
 
 	std::vector<VkDeviceQueueCreateInfo> queueCreateinfos;
 	std::set<uint32_t> uniqueQueueFamily = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+	if (indices.isTransfereFamily())
+	{
+		uniqueQueueFamily.insert(indices.transfereFamily.value());
+	}
 
 	float queuePriority = 1.f;
 	for (uint32_t queueFamily : uniqueQueueFamily)
@@ -455,9 +841,151 @@ void WindowApp::createLogicalDevice()
 		queueCreateinfos.push_back(queueCreateInfo);
 	}
 
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(mPhysicalDevice, &supportedFeatures);
+	mMultiDrawIndirect = supportedFeatures.multiDrawIndirect;
+
 	VkPhysicalDeviceFeatures DeviceFeatures{};
-	
+	DeviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+	//cooked textures pick their format from this, BC needs its feature enabled to be sampled
+	mTextureFormats = VulkanEngine::VulkanDevice::queryTextureFormats(mPhysicalDevice);
+	DeviceFeatures.textureCompressionBC = mTextureFormats.textureCompressionBC ? VK_TRUE : VK_FALSE;
+
+	//drawIndirectCount is core in 1.2, older devices fall back to non-compacted indirect draws
+	VkPhysicalDeviceProperties deviceProp;
+	vkGetPhysicalDeviceProperties(mPhysicalDevice, &deviceProp);
+
+	VkPhysicalDeviceVulkan12Features supported12{};
+	supported12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	VkPhysicalDeviceVulkan12Features enabled12{};
+	enabled12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+	//present wait lets the latency measurement run all the way to the present, it is optional
+	std::vector<const char*> enabledExtensions = deviceExtensions;
+	VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+	presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+	VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+	presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+	bool presentWaitExtensions = false;
+
+	//passes begin on image views and the graph's barriers go out as they are, see --legacy-render-passes
+	VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeatures{};
+	dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+	dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+	VkPhysicalDeviceSynchronization2Features synchronization2Features{};
+	synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
+	synchronization2Features.synchronization2 = VK_TRUE;
+
+	if (!mSettings.headless)
+	{
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(mPhysicalDevice, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> extensionProp(extensionCount);
+		vkEnumerateDeviceExtensionProperties(mPhysicalDevice, nullptr, &extensionCount, extensionProp.data());
+
+		std::set<std::string> presentExtensions = { VK_KHR_PRESENT_ID_EXTENSION_NAME, VK_KHR_PRESENT_WAIT_EXTENSION_NAME };
+		for (auto& extension : extensionProp)
+		{
+			presentExtensions.erase(extension.extensionName);
+		}
+		presentWaitExtensions = presentExtensions.empty();
+	}
+
+	if (deviceProp.apiVersion >= VK_API_VERSION_1_2)
+	{
+		if (presentWaitExtensions)
+		{
+			supported12.pNext = &presentIdFeatures;
+			presentIdFeatures.pNext = &presentWaitFeatures;
+		}
+
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &supported12;
+		vkGetPhysicalDeviceFeatures2(mPhysicalDevice, &features2);
+
+		mDrawIndirectCount = supported12.drawIndirectCount;
+		enabled12.drawIndirectCount = supported12.drawIndirectCount;
+		//checked in isDeviceSuitable
+		VulkanEngine::BindlessTable::enableFeatures(enabled12);
+		VulkanEngine::Timeline::enableFeatures(enabled12);
+
+		mPresentWait = presentWaitExtensions && presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+		//the same structs are reused for enabling, with nothing but the two features set
+		presentIdFeatures.pNext = &presentWaitFeatures;
+		presentWaitFeatures.pNext = nullptr;
+		if (mPresentWait)
+		{
+			enabled12.pNext = &presentIdFeatures;
+			enabledExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+			enabledExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+		}
+
+		//one backend or the other, the render passes are only dropped when the barriers can keep up
+		VulkanEngine::RenderingFeatures rendering = VulkanEngine::VulkanDevice::queryRenderingFeatures(mPhysicalDevice);
+		mDynamicRendering = mSettings.dynamicRendering && rendering.dynamicRendering && rendering.synchronization2;
+		if (mDynamicRendering)
+		{
+			dynamicRenderingFeatures.pNext = &synchronization2Features;
+			synchronization2Features.pNext = enabled12.pNext;
+			enabled12.pNext = &dynamicRenderingFeatures;
+			enabledExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+			enabledExtensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+		}
+	}
+
+	//the mesh shaders are SPIR-V 1.4, so they need 1.2 as well
+	bool meshShaders = deviceProp.apiVersion >= VK_API_VERSION_1_2 && VulkanEngine::MeshletPass::supportsMeshShaders(mPhysicalDevice);
+	switch (mSettings.meshletMode)
+	{
+	case VulkanEngine::MeshletMode::Off:
+		break;
+	case VulkanEngine::MeshletMode::Auto:
+		if (meshShaders)
+		{
+			mMeshletMode = VulkanEngine::MeshletPass::Mode::MeshShader;
+		}
+		else if (mDrawIndirectCount)
+		{
+			mMeshletMode = VulkanEngine::MeshletPass::Mode::Compute;
+		}
+		else
+		{
+			std::cerr << "meshlets need mesh shaders or drawIndirectCount, drawing whole objects" << std::endl;
+		}
+		break;
+	case VulkanEngine::MeshletMode::MeshShader:
+		if (!meshShaders)
+		{
+			throw std::runtime_error("ERROR: --meshlets mesh needs VK_EXT_mesh_shader with task shaders");
+		}
+		mMeshletMode = VulkanEngine::MeshletPass::Mode::MeshShader;
+		break;
+	case VulkanEngine::MeshletMode::Compute:
+		if (!mDrawIndirectCount)
+		{
+			throw std::runtime_error("ERROR: --meshlets compute needs drawIndirectCount");
+		}
+		mMeshletMode = VulkanEngine::MeshletPass::Mode::Compute;
+		break;
+	}
+
+	VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures{};
+	meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+	if (mMeshletMode == VulkanEngine::MeshletPass::Mode::MeshShader)
+	{
+		meshShaderFeatures.taskShader = VK_TRUE;
+		meshShaderFeatures.meshShader = VK_TRUE;
+		meshShaderFeatures.pNext = enabled12.pNext;
+		enabled12.pNext = &meshShaderFeatures;
+		enabledExtensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+	}
+
 	VkDeviceCreateInfo createInfo{};
+	if (deviceProp.apiVersion >= VK_API_VERSION_1_2)
+	{
+		createInfo.pNext = &enabled12;
+	}
 	
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateinfos.size());
@@ -465,8 +993,8 @@ void WindowApp::createLogicalDevice()
 
 	createInfo.pEnabledFeatures = &DeviceFeatures;
 
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+	createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 	
 	if (enableValidationLayers) 
 	{
@@ -484,9 +1012,75 @@ void WindowApp::createLogicalDevice()
 		throw std::runtime_error("ERROR: failed to create logical device");
 	}
 
+	if (mPresentWait)
+	{
+		mWaitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(mDevice, "vkWaitForPresentKHR"));
+		mPresentWait = mWaitForPresent != nullptr;
+	}
+
+	//the extension entry points, the instance only asks for 1.2 so the core ones are not there
+	if (mDynamicRendering)
+	{
+		mCmdBeginRendering = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(vkGetDeviceProcAddr(mDevice, "vkCmdBeginRenderingKHR"));
+		mCmdEndRendering = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(vkGetDeviceProcAddr(mDevice, "vkCmdEndRenderingKHR"));
+		mCmdPipelineBarrier2 = reinterpret_cast<PFN_vkCmdPipelineBarrier2KHR>(vkGetDeviceProcAddr(mDevice, "vkCmdPipelineBarrier2KHR"));
+		mQueueSubmit2 = reinterpret_cast<PFN_vkQueueSubmit2KHR>(vkGetDeviceProcAddr(mDevice, "vkQueueSubmit2KHR"));
+		if (!mCmdBeginRendering || !mCmdEndRendering || !mCmdPipelineBarrier2 || !mQueueSubmit2)
+		{
+			throw std::runtime_error("ERROR: failed to load the dynamic rendering and synchronization2 functions");
+		}
+	}
+
 
 	vkGetDeviceQueue(mDevice, indices.graphicsFamily.value(), 0, &mGraphicsQueue);
 	vkGetDeviceQueue(mDevice, indices.presentFamily.value(), 0, &mPresentQueue);
+
+	if (indices.isTransfereFamily())
+	{
+		vkGetDeviceQueue(mDevice, indices.transfereFamily.value(), 0, &mTransferQueue);
+	}
+	else
+	{
+		mTransferQueue = mGraphicsQueue;
+	}
+}
+
+void WindowApp::createJobSystem()
+{
+	mJobs = std::make_unique<VulkanEngine::JobSystem>();
+}
+
+void WindowApp::createAllocator()
+{
+	mAllocator = std::make_unique<VulkanEngine::GpuAllocator>(mPhysicalDevice, mDevice);
+	mDeletionQueue = std::make_unique<VulkanEngine::DeletionQueue>(mDevice, mAllocator.get());
+}
+
+void WindowApp::createPipelineCache()
+{
+	mPipelineCache = std::make_unique<VulkanEngine::PipelineCache>(mPhysicalDevice, mDevice, "pipeline_cache.bin");
+}
+
+void WindowApp::createBindlessTable()
+{
+	mBindless = std::make_unique<VulkanEngine::BindlessTable>(mPhysicalDevice, mDevice, *mDeletionQueue, VulkanEngine::BindlessCapacity{}, getMeshletStages());
+
+	//slot 0, what the shaders sample textures with until materials pick their own
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+	if (vkCreateSampler(mDevice, &samplerInfo, nullptr, &mDefaultSampler) != VK_SUCCESS)
+	{
+		throw std::runtime_error("ERROR: failed to create default sampler");
+	}
+	mBindless->addSampler(mDefaultSampler);
 }
 
 void WindowApp::createSurface()
@@ -550,14 +1144,34 @@ VkSurfaceFormatKHR WindowApp::chooseSwapSurfaceFormat(const std::vector<VkSurfac
 
 VkPresentModeKHR WindowApp::choosePresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes)
 {
+	VkPresentModeKHR wanted = VK_PRESENT_MODE_MAILBOX_KHR;
+	switch (mSettings.presentMode)
+	{
+	case VulkanEngine::PresentMode::Fifo:
+		return VK_PRESENT_MODE_FIFO_KHR;
+	case VulkanEngine::PresentMode::FifoRelaxed:
+		wanted = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+		break;
+	case VulkanEngine::PresentMode::Immediate:
+		wanted = VK_PRESENT_MODE_IMMEDIATE_KHR;
+		break;
+	default:
+		break;
+	}
+
 	for (const auto& presentModes : availablePresentModes)
 	{
-		if(presentModes == VK_PRESENT_MODE_MAILBOX_KHR)
+		if(presentModes == wanted)
 		{
 			return presentModes;
 		}
 	}
 
+	//fifo is the one mode every surface has
+	if (mSettings.presentMode != VulkanEngine::PresentMode::Auto)
+	{
+		std::cerr << "requested present mode is not supported, falling back to fifo" << std::endl;
+	}
 	return VK_PRESENT_MODE_FIFO_KHR;
 }
 
@@ -584,7 +1198,7 @@ VkExtent2D WindowApp::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilit
 }
 
 void
-WindowApp::createSwapChain()
+WindowApp::createSwapChain(VkSwapchainKHR oldSwapchain)
 {
 	VulkanEngine::SwapChainSupportDetails swapchainSup = querySwapChainSupport(mPhysicalDevice);
 
@@ -627,7 +1241,8 @@ WindowApp::createSwapChain()
 	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	createInfo.presentMode = presentMode;
 	createInfo.clipped = VK_TRUE;
-	createInfo.oldSwapchain = VK_NULL_HANDLE;
+	//handing over the old swapchain lets the driver recycle its memory and keep presenting meanwhile
+	createInfo.oldSwapchain = oldSwapchain;
 
 	if (vkCreateSwapchainKHR(mDevice, &createInfo, nullptr, &mSwapChain) != VK_SUCCESS) 
 	{
@@ -644,26 +1259,124 @@ WindowApp::createSwapChain()
 
 void WindowApp::recreateSwapChain()
 {
-	vkDeviceWaitIdle(mDevice);
-	cleanUpSwapChain();
+	PROFILE_SCOPE("recreateSwapChain");
 
-	createSwapChain();
-	createImageVeiw();
-	createFramebuffers();
+	//minimized, keep the current swapchain and try again once the window is back
+	int width = 0, height = 0;
+	glfwGetFramebufferSize(mWindow, &width, &height);
+	if (width == 0 || height == 0)
+	{
+		mFramebufferResized = true;
+		return;
+	}
 
-}
+	//no device drain: the old swapchain's objects go to the deletion queue and are destroyed
+	//once the frames still using them have finished
+	for (auto framebuffer : swapChainFrambuffers)
+	{
+		mDeletionQueue->destroy(framebuffer);
+	}
+	for (auto imageView : swapChainImageViews)
+	{
+		mDeletionQueue->destroy(imageView);
+	}
+	swapChainImageViews.clear();
+	swapChainFrambuffers.clear();
+	destroyRenderGraph();
+
+	//the surface format comes from the same surface, so the render pass and pipeline stay compatible.
+	//its presents are still tracked against the old swapchain, which lives until they have gone out
+	RetiredSwapchain retired{ mSwapChain, std::move(mPendingPresents), mFrameNumber };
+	mPendingPresents.clear();
+	createSwapChain(retired.swapchain);
+	mRetiredSwapchains.push_back(std::move(retired));
+
+	createImageVeiw();
+	createRenderGraph();
+	createFramebuffers();
+}
+
+void WindowApp::releaseRetiredSwapchains(bool waitedIdle)
+{
+	//frames complete in submission order and the slot being reused held frame mFrameNumber - mFramesInFlight.
+	//without present wait one more ring of frames is added so presents queued behind the last frame have gone out too
+	uint64_t completedFrames = mFrameNumber >= mFramesInFlight ? mFrameNumber - mFramesInFlight + 1 : 0;
+
+	auto retired = mRetiredSwapchains.begin();
+	while (retired != mRetiredSwapchains.end())
+	{
+		bool released = waitedIdle;
+		if (!released && mPresentWait && !retired->presentWaitFailed)
+		{
+			retired->presentWaitFailed = !pollPresents(retired->swapchain, retired->pendingPresents);
+			released = !retired->presentWaitFailed && retired->pendingPresents.empty();
+		}
+		if (!released && (!mPresentWait || retired->presentWaitFailed))
+		{
+			released = completedFrames >= retired->lastFrame + mFramesInFlight;
+		}
+		if (!released)
+		{
+			++retired;
+			continue;
+		}
+
+		vkDestroySwapchainKHR(mDevice, retired->swapchain, nullptr);
+		retired = mRetiredSwapchains.erase(retired);
+	}
+}
 
 void WindowApp::cleanUpSwapChain()
 {
-	for (auto i = 0; i < swapChainImageViews.size(); i++)
+	for (auto i = 0; i < swapChainFrambuffers.size(); i++)
 	{
 		vkDestroyFramebuffer(mDevice,swapChainFrambuffers[i],nullptr);
 	}
+	swapChainFrambuffers.clear();
+
+	if (mSettings.headless)
+	{
+		//the images and views belong to the offscreen target
+		swapChainImage.clear();
+		swapChainImageViews.clear();
+		mOffscreen.reset();
+		return;
+	}
+
 	for(auto i = 0; i < swapChainImageViews.size();i++)
 	{
 		vkDestroyImageView(mDevice, swapChainImageViews[i], nullptr);
 	}
+	swapChainImageViews.clear();
 	vkDestroySwapchainKHR(mDevice,mSwapChain,nullptr);
+
+	//presents of the old swapchain can no longer be waited on
+	mPendingPresents.clear();
+}
+
+void WindowApp::createOffscreenTarget()
+{
+	//RGBA so the read back bytes can be written out as they are
+	mSwapChainImageFormat = VK_FORMAT_R8G8B8A8_SRGB;
+	mSwapchainExtent = { mSettings.width, mSettings.height };
+
+	mOffscreen = std::make_unique<VulkanEngine::OffscreenTarget>(mDevice, *mAllocator, mSwapChainImageFormat, mSwapchainExtent, mFramesInFlight);
+	swapChainImage = mOffscreen->getImages();
+	swapChainImageViews = mOffscreen->getImageViews();
+	mReadbackFrame.resize(mFramesInFlight);
+}
+
+//only call once the frame's timeline value has been reached
+void WindowApp::processReadback(uint32_t frameIndex)
+{
+	if (!mReadbackFrame[frameIndex].has_value())
+	{
+		return;
+	}
+
+	VulkanEngine::FrameDump::write(mSettings.dumpDirectory, mSettings.dumpFormat, mReadbackFrame[frameIndex].value(),
+		mOffscreen->getPixels(frameIndex), mSwapchainExtent.width, mSwapchainExtent.height);
+	mReadbackFrame[frameIndex].reset();
 }
 
 void WindowApp::createImageVeiw()
@@ -695,13 +1408,173 @@ void WindowApp::createImageVeiw()
 	}
 }
 
+void WindowApp::createRenderGraph()
+{
+	using VulkanEngine::ResourceState;
+	using Queue = VulkanEngine::RenderGraph::Queue;
+	using Resource = VulkanEngine::RenderGraph::Resource;
+
+	//built once and executed every frame, the passes read the frame being recorded from the members
+	mRenderGraph = std::make_unique<VulkanEngine::RenderGraph>(mDevice, *mAllocator, *mDeletionQueue);
+	VulkanEngine::RenderGraph& graph = *mRenderGraph;
+	//null on the legacy path, the graph falls back to vkCmdPipelineBarrier
+	graph.setPipelineBarrier2(mCmdPipelineBarrier2);
+
+	//the acquire semaphore is waited on at color output, the first transition chains onto it
+	mGraphColorTarget = graph.importImage("Color target", VK_NULL_HANDLE, VK_IMAGE_ASPECT_COLOR_BIT,
+		{ VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED });
+	//offscreen images are copied out after the graph instead of presented
+	graph.setOutput(mGraphColorTarget, mSettings.headless
+		? ResourceState{ VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL }
+		: ResourceState{ VK_PIPELINE_STAGE_2_NONE, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR });
+
+	//one depth buffer for every frame in flight, the graph's barriers keep them apart
+	VulkanEngine::TransientImageDesc depthDesc{};
+	depthDesc.format = mDepthFormat;
+	depthDesc.extent = mSwapchainExtent;
+	depthDesc.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | (mOcclusionCulling ? VK_IMAGE_USAGE_SAMPLED_BIT : 0);
+	depthDesc.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+	mGraphDepth = graph.createImage("Depth", depthDesc);
+
+	const ResourceState depthWrite = { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+		VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+	const ResourceState indirectRead = { VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT };
+	const ResourceState transferRead = { VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT };
+	//the counters are cleared first, then the compute shader writes the draws
+	const ResourceState cullWrite = { VK_PIPELINE_STAGE_2_TRANSFER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+		VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT };
+
+	//one handle for all of a frame's culling buffers, they are always used together. Frame slots
+	//are only reused after their timeline value, so nothing carries over between frames
+	Resource draws = graph.importBuffer(mMeshletMode.has_value() ? "Meshlet draws" : "Culled draws");
+	bool meshShaders = mMeshletMode == VulkanEngine::MeshletPass::Mode::MeshShader;
+
+	if (mMeshletMode.has_value())
+	{
+		//in MeshShader mode this only clears the counters, the task shader culls during the pass
+		graph.addPass("Cull", Queue::Graphics, [this](VkCommandBuffer buffer)
+		{
+			mMeshlets->record(buffer, currentFrame, mFrameDataOffset, mObjectDataOffset, mObjectCount);
+		}).write(draws, meshShaders ? ResourceState{ VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT } : cullWrite, true);
+	}
+	else
+	{
+		Resource pyramid = VulkanEngine::RenderGraph::INVALID_RESOURCE;
+		if (mOcclusionCulling)
+		{
+			//a fresh pyramid has no history, the first frame after a resize only frustum culls early
+			auto pyramidShader = readShaderFile(SHADER_PATH "depth_pyramid.spv");
+			mDepthPyramid = std::make_unique<VulkanEngine::DepthPyramid>(mDevice, *mAllocator, *mDeletionQueue, *mBindless,
+				mPipelineCache->getHandle(), pyramidShader, mSwapchainExtent);
+			//the frame before built it, and the next frame reads what this one builds
+			pyramid = graph.importImage("Depth pyramid", mDepthPyramid->getImage(), VK_IMAGE_ASPECT_COLOR_BIT,
+				{ VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL });
+			graph.setOutput(pyramid);
+		}
+		const ResourceState pyramidRead = { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL };
+
+		//frustum, and occlusion against the pyramid the previous frame built
+		auto cull = graph.addPass("Cull", Queue::Graphics, [this](VkCommandBuffer buffer)
+		{
+			mCulling->record(buffer, currentFrame, mFrameDataOffset, mObjectDataOffset, mObjectCount,
+				VulkanEngine::CullingPass::Phase::Early, mDepthPyramid.get());
+		});
+		cull.write(draws, cullWrite, true);
+
+		if (mOcclusionCulling)
+		{
+			cull.read(pyramid, pyramidRead);
+
+			graph.addPass("Depth prepass", Queue::Graphics, [this](VkCommandBuffer buffer) { recordDepthPrepass(buffer); })
+				.read(draws, indirectRead)
+				.write(mGraphDepth, depthWrite, true);
+
+			graph.addPass("Depth pyramid", Queue::Graphics, [this](VkCommandBuffer buffer) { mDepthPyramid->record(buffer); })
+				.read(mGraphDepth, { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL })
+				.write(pyramid, { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL }, true);
+
+			//what last frame's depth hid, against this frame's
+			graph.addPass("Late cull", Queue::Graphics, [this](VkCommandBuffer buffer)
+			{
+				mCulling->record(buffer, currentFrame, mFrameDataOffset, mObjectDataOffset, mObjectCount,
+					VulkanEngine::CullingPass::Phase::Late, mDepthPyramid.get());
+			})
+				.read(pyramid, pyramidRead)
+				.write(draws, { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT });
+		}
+
+		graph.addPass("Cull readback", Queue::Graphics, [this](VkCommandBuffer buffer) { mCulling->recordReadback(buffer, currentFrame); })
+			.read(draws, transferRead)
+			.setSideEffects();
+	}
+
+	//with occlusion culling the prepass has already written the early objects' depth
+	auto mainPass = graph.addPass("Main pass", Queue::Graphics, [this](VkCommandBuffer buffer) { recordMainPass(buffer); });
+	mainPass.write(mGraphColorTarget, { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL }, true);
+	mainPass.write(mGraphDepth, depthWrite, !mOcclusionCulling);
+	if (meshShaders)
+	{
+		//the task shaders count what they launch
+		mainPass.write(draws, { VK_PIPELINE_STAGE_2_TASK_SHADER_BIT_EXT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT });
+	}
+	else
+	{
+		mainPass.read(draws, indirectRead);
+	}
+
+	if (mMeshletMode.has_value())
+	{
+		//the task shaders only finish counting once the pass is done
+		graph.addPass("Meshlet readback", Queue::Graphics, [this](VkCommandBuffer buffer) { mMeshlets->recordReadback(buffer, currentFrame); })
+			.read(draws, transferRead)
+			.setSideEffects();
+	}
+
+	graph.compile();
+
+	if (!mDepthPyramid)
+	{
+		return;
+	}
+	VkImageView depthView = graph.getImageView(mGraphDepth);
+	mDepthPyramid->setDepthView(depthView);
+	if (mDynamicRendering)
+	{
+		return;
+	}
+
+	VkFramebufferCreateInfo framebufferInfo{};
+	framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebufferInfo.renderPass = mDepthPrepassRenderpass;
+	framebufferInfo.attachmentCount = 1;
+	framebufferInfo.pAttachments = &depthView;
+	framebufferInfo.width = mSwapchainExtent.width;
+	framebufferInfo.height = mSwapchainExtent.height;
+	framebufferInfo.layers = 1;
+
+	if (vkCreateFramebuffer(mDevice, &framebufferInfo, nullptr, &mDepthPrepassFramebuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("ERROR: failed to make depth prepass framebuffer");
+	}
+}
+
+void WindowApp::destroyRenderGraph()
+{
+	//retired rather than destroyed, frames in flight may still use them
+	mDepthPyramid.reset();
+	mDeletionQueue->destroy(mDepthPrepassFramebuffer);
+	mDepthPrepassFramebuffer = VK_NULL_HANDLE;
+	mRenderGraph.reset();
+}
+
 void WindowApp::createGraphicsPipeline()
 {
-	auto bindingDescription = Vertex::getBindingDescription();
-	auto attributeDescription = Vertex::getAttributeDescriptions();
+	auto bindingDescription = mSettings.quantizeVertices ? QuantizedVertex::getBindingDescription() : Vertex::getBindingDescription();
+	auto attributeDescription = mSettings.quantizeVertices ? QuantizedVertex::getAttributeDescriptions() : Vertex::getAttributeDescriptions();
 
-	auto vertexShad = readShaderFile("Shader/vert.spv");
-	auto fragmentShad = readShaderFile("Shader/frag.spv");
+	auto vertexShad = readShaderFile(SHADER_PATH "vert.spv");
+	auto fragmentShad = readShaderFile(SHADER_PATH "frag.spv");
 
 	VkShaderModule vertShaderMod = createShaderModule(vertexShad);
 	VkShaderModule fragShaderMod = createShaderModule(fragmentShad);
@@ -712,6 +1585,16 @@ void WindowApp::createGraphicsPipeline()
 	VertCreateInfo.module = vertShaderMod;
 	VertCreateInfo.pName = "main";
 
+	//OCTAHEDRAL_NORMALS in VBO.vert
+	VkBool32 octahedralNormals = mSettings.quantizeVertices ? VK_TRUE : VK_FALSE;
+	VkSpecializationMapEntry specializationEntry{ 0, 0, sizeof(VkBool32) };
+	VkSpecializationInfo specialization{};
+	specialization.mapEntryCount = 1;
+	specialization.pMapEntries = &specializationEntry;
+	specialization.dataSize = sizeof(VkBool32);
+	specialization.pData = &octahedralNormals;
+	VertCreateInfo.pSpecializationInfo = &specialization;
+
 	VkPipelineShaderStageCreateInfo FragCreateInfo{};
 	FragCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	FragCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -778,6 +1661,15 @@ void WindowApp::createGraphicsPipeline()
 	colorBlending.blendConstants[2] = 0.0f;
 	colorBlending.blendConstants[3] = 0.0f;
 
+	//reversed depth, nearer is greater. Equal passes so the main pass can redraw what the prepass wrote
+	VkPipelineDepthStencilStateCreateInfo depthStencil{};
+	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencil.depthTestEnable = VK_TRUE;
+	depthStencil.depthWriteEnable = VK_TRUE;
+	depthStencil.depthCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL;
+	depthStencil.depthBoundsTestEnable = VK_FALSE;
+	depthStencil.stencilTestEnable = VK_FALSE;
+
 	std::vector<VkDynamicState> dynamicStates = {
 	VK_DYNAMIC_STATE_VIEWPORT,
 	VK_DYNAMIC_STATE_SCISSOR
@@ -790,16 +1682,26 @@ void WindowApp::createGraphicsPipeline()
 
 	VkPipelineLayoutCreateInfo pipelineLayCreateInfo{};
 	pipelineLayCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayCreateInfo.setLayoutCount = 1;
-	pipelineLayCreateInfo.pSetLayouts =	&mDescriptorSetLayout;
+	//set 0 is the per-frame data, set 1 the bindless table
+	VkDescriptorSetLayout setLayouts[] = { mDescriptorSetLayout, mBindless->getLayout() };
+	pipelineLayCreateInfo.setLayoutCount = 2;
+	pipelineLayCreateInfo.pSetLayouts =	setLayouts;
 
 
 	if (vkCreatePipelineLayout(mDevice,&pipelineLayCreateInfo,nullptr,&mPipelinelayout) != VK_SUCCESS)
 	{
 		throw std::runtime_error("ERROR: Failed to create PipelineLayout");
 	}
+	//with dynamic rendering the pipeline is built against the attachment formats instead of a render pass
+	VkPipelineRenderingCreateInfo renderingInfo{};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+	renderingInfo.colorAttachmentCount = 1;
+	renderingInfo.pColorAttachmentFormats = &mSwapChainImageFormat;
+	renderingInfo.depthAttachmentFormat = mDepthFormat;
+
 	VkGraphicsPipelineCreateInfo pipelineInfo{};
 	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.pNext = mDynamicRendering ? &renderingInfo : nullptr;
 	pipelineInfo.stageCount = 2;
 	pipelineInfo.pStages = shaderStages;
 	pipelineInfo.pVertexInputState = &vertexcreateInfo;
@@ -807,7 +1709,7 @@ void WindowApp::createGraphicsPipeline()
 	pipelineInfo.pViewportState = &viewCreateinfo;
 	pipelineInfo.pRasterizationState = &raztCreateinfo;
 	pipelineInfo.pMultisampleState = &multiCreateinfo;
-	pipelineInfo.pDepthStencilState = nullptr;
+	pipelineInfo.pDepthStencilState = &depthStencil;
 	pipelineInfo.pColorBlendState = &colorBlending;
 	pipelineInfo.pDynamicState = &DynamicCreateInfo;
 	pipelineInfo.layout = mPipelinelayout;
@@ -816,9 +1718,112 @@ void WindowApp::createGraphicsPipeline()
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineInfo.basePipelineIndex = -1;
 
-	if (vkCreateGraphicsPipelines(mDevice,VK_NULL_HANDLE,1,&pipelineInfo,nullptr,&mPipeline)!=VK_SUCCESS)
+	//--benchmark-pipelines builds every pipeline twice, first into an empty cache and thrown away,
+	//then for real with the cache loaded from disk
+	VkPipelineCache emptyCache = VK_NULL_HANDLE;
+	if (mSettings.benchmarkPipelines)
+	{
+		VkPipelineCacheCreateInfo cacheInfo{};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		if (vkCreatePipelineCache(mDevice, &cacheInfo, nullptr, &emptyCache) != VK_SUCCESS)
+		{
+			throw std::runtime_error("ERROR: Failed to create empty pipeline cache");
+		}
+	}
+	std::chrono::duration<double, std::milli> emptyCacheTime{ 0.0 };
+	std::chrono::duration<double, std::milli> loadedCacheTime{ 0.0 };
+	auto createPipeline = [&](const VkGraphicsPipelineCreateInfo& info, VkPipeline* pipeline, const char* error)
+	{
+		if (emptyCache != VK_NULL_HANDLE)
+		{
+			VkPipeline scratch;
+			auto emptyStart = std::chrono::high_resolution_clock::now();
+			if (vkCreateGraphicsPipelines(mDevice, emptyCache, 1, &info, nullptr, &scratch) != VK_SUCCESS)
+			{
+				throw std::runtime_error(error);
+			}
+			emptyCacheTime += std::chrono::high_resolution_clock::now() - emptyStart;
+			vkDestroyPipeline(mDevice, scratch, nullptr);
+		}
+		auto start = std::chrono::high_resolution_clock::now();
+		if (vkCreateGraphicsPipelines(mDevice, mPipelineCache->getHandle(), 1, &info, nullptr, pipeline) != VK_SUCCESS)
+		{
+			throw std::runtime_error(error);
+		}
+		loadedCacheTime += std::chrono::high_resolution_clock::now() - start;
+	};
+
+	createPipeline(pipelineInfo, &mPipeline, "ERROR: Failed to create graphics pipeline");
+	std::cout << "Graphics pipeline created in " << loadedCacheTime.count() << "ms ("
+		<< (mPipelineCache->isWarm() ? "warm" : "cold") << " pipeline cache)" << std::endl;
+
+	//the depth prepass: the same vertex stage, no fragment shader and no colour
+	if (mOcclusionCulling)
 	{
-		throw std::runtime_error("ERROR: Failed to create graphics pipeline");
+		VkPipelineColorBlendStateCreateInfo noColor{};
+		noColor.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		noColor.attachmentCount = 0;
+
+		VkPipelineRenderingCreateInfo depthRenderingInfo = renderingInfo;
+		depthRenderingInfo.colorAttachmentCount = 0;
+		depthRenderingInfo.pColorAttachmentFormats = nullptr;
+
+		VkGraphicsPipelineCreateInfo depthPipelineInfo = pipelineInfo;
+		depthPipelineInfo.pNext = mDynamicRendering ? &depthRenderingInfo : nullptr;
+		depthPipelineInfo.stageCount = 1;
+		depthPipelineInfo.pColorBlendState = &noColor;
+		depthPipelineInfo.renderPass = mDepthPrepassRenderpass;
+		createPipeline(depthPipelineInfo, &mDepthPipeline, "ERROR: Failed to create depth prepass pipeline");
+	}
+
+	//the mesh shader path shares everything after the vertex stage, VBO.frag included
+	if (mMeshletMode == VulkanEngine::MeshletPass::Mode::MeshShader)
+	{
+		auto taskShad = readShaderFile(SHADER_PATH "meshlet_task.spv");
+		auto meshShad = readShaderFile(SHADER_PATH "meshlet_mesh.spv");
+		VkShaderModule taskShaderMod = createShaderModule(taskShad);
+		VkShaderModule meshShaderMod = createShaderModule(meshShad);
+
+		VkPipelineShaderStageCreateInfo taskCreateInfo{};
+		taskCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		taskCreateInfo.stage = VK_SHADER_STAGE_TASK_BIT_EXT;
+		taskCreateInfo.module = taskShaderMod;
+		taskCreateInfo.pName = "main";
+
+		//QUANTIZED_VERTICES in meshlet.mesh, same constant id and value as for VBO.vert
+		VkPipelineShaderStageCreateInfo meshCreateInfo{};
+		meshCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		meshCreateInfo.stage = VK_SHADER_STAGE_MESH_BIT_EXT;
+		meshCreateInfo.module = meshShaderMod;
+		meshCreateInfo.pName = "main";
+		meshCreateInfo.pSpecializationInfo = &specialization;
+
+		VkPipelineShaderStageCreateInfo meshletStages[] = { taskCreateInfo, meshCreateInfo, FragCreateInfo };
+
+		VkPushConstantRange pushConstantRange = VulkanEngine::MeshletPass::getPushConstantRange();
+		pipelineLayCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayCreateInfo.pPushConstantRanges = &pushConstantRange;
+		if (vkCreatePipelineLayout(mDevice, &pipelineLayCreateInfo, nullptr, &mMeshletPipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("ERROR: Failed to create meshlet PipelineLayout");
+		}
+
+		pipelineInfo.stageCount = 3;
+		pipelineInfo.pStages = meshletStages;
+		pipelineInfo.pVertexInputState = nullptr;
+		pipelineInfo.pInputAssemblyState = nullptr;
+		pipelineInfo.layout = mMeshletPipelineLayout;
+		createPipeline(pipelineInfo, &mMeshletPipeline, "ERROR: Failed to create meshlet pipeline");
+
+		vkDestroyShaderModule(mDevice, meshShaderMod, nullptr);
+		vkDestroyShaderModule(mDevice, taskShaderMod, nullptr);
+	}
+
+	if (emptyCache != VK_NULL_HANDLE)
+	{
+		vkDestroyPipelineCache(mDevice, emptyCache, nullptr);
+		std::cout << "Pipeline benchmark: empty cache " << emptyCacheTime.count() << "ms, "
+			<< (mPipelineCache->isWarm() ? "loaded" : "cold (no cache file)") << " cache " << loadedCacheTime.count() << "ms" << std::endl;
 	}
 
 	vkDestroyShaderModule(mDevice, fragShaderMod, nullptr);
@@ -827,6 +1832,32 @@ void WindowApp::createGraphicsPipeline()
 
 void WindowApp::createRenderPass()
 {
+	//the pyramid samples the depth buffer; the meshlet path culls per meshlet and has no prepass
+	mOcclusionCulling = mSettings.occlusionCulling && !mMeshletMode.has_value();
+	if (mOcclusionCulling)
+	{
+		mDepthFormat = VulkanEngine::VulkanDevice::findDepthFormat(mPhysicalDevice, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+		if (mDepthFormat == VK_FORMAT_UNDEFINED)
+		{
+			std::cerr << "no sampleable depth format, occlusion culling disabled" << std::endl;
+			mOcclusionCulling = false;
+		}
+	}
+	if (!mOcclusionCulling)
+	{
+		mDepthFormat = VulkanEngine::VulkanDevice::findDepthFormat(mPhysicalDevice);
+	}
+	if (mDepthFormat == VK_FORMAT_UNDEFINED)
+	{
+		throw std::runtime_error("ERROR: no supported depth format");
+	}
+
+	//the passes name their attachments when they begin, see recordMainPass
+	if (mDynamicRendering)
+	{
+		return;
+	}
+
 	VkAttachmentDescription colorAttachment{};
 	colorAttachment.format = mSwapChainImageFormat;
 	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -834,54 +1865,98 @@ void WindowApp::createRenderPass()
 	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	//the render graph transitions the attachments around the passes, see createRenderGraph
+	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	//with occlusion culling the prepass has already written the early objects' depth
+	VkAttachmentDescription depthAttachment{};
+	depthAttachment.format = mDepthFormat;
+	depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	depthAttachment.loadOp = mOcclusionCulling ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
 	VkAttachmentReference colorRef{};
 	colorRef.attachment = 0;
 	colorRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+	VkAttachmentReference depthRef{};
+	depthRef.attachment = 1;
+	depthRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
 	VkSubpassDescription subpass{};
 	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
 	subpass.colorAttachmentCount = 1;
 	subpass.pColorAttachments = &colorRef;
+	subpass.pDepthStencilAttachment = &depthRef;
 
-	VkSubpassDependency subpassdep{};
-	subpassdep.srcSubpass = VK_SUBPASS_EXTERNAL;
-	subpassdep.dstSubpass = 0;
-	subpassdep.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	subpassdep.srcAccessMask = 0;
-	subpassdep.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	subpassdep.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	VkAttachmentDescription attachments[] = { colorAttachment, depthAttachment };
 
 	VkRenderPassCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	createInfo.attachmentCount = 1;
-	createInfo.pAttachments = &colorAttachment;
+	createInfo.attachmentCount = 2;
+	createInfo.pAttachments = attachments;
 	createInfo.subpassCount = 1;
 	createInfo.pSubpasses = &subpass;
-	createInfo.dependencyCount = 1;
-	createInfo.pDependencies = &subpassdep;	
+	//no external dependencies either, the graph's barriers come before the pass begins
+	createInfo.dependencyCount = 0;
 
 
 	if (vkCreateRenderPass(mDevice,&createInfo,nullptr,&mRenderpass))
 	{
 		throw std::runtime_error("ERROR: failed to create render pass");
 	}
+
+	if (!mOcclusionCulling)
+	{
+		return;
+	}
+
+	//depth only, kept for the pyramid and loaded by the main pass
+	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+	depthRef.attachment = 0;
+
+	VkSubpassDescription prepassSubpass{};
+	prepassSubpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	prepassSubpass.pDepthStencilAttachment = &depthRef;
+
+	VkRenderPassCreateInfo prepassInfo{};
+	prepassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	prepassInfo.attachmentCount = 1;
+	prepassInfo.pAttachments = &depthAttachment;
+	prepassInfo.subpassCount = 1;
+	prepassInfo.pSubpasses = &prepassSubpass;
+
+	if (vkCreateRenderPass(mDevice, &prepassInfo, nullptr, &mDepthPrepassRenderpass) != VK_SUCCESS)
+	{
+		throw std::runtime_error("ERROR: failed to create depth prepass render pass");
+	}
 }
 
 void WindowApp::createFramebuffers()
 {
+	//nothing to bind the views to ahead of time with dynamic rendering
+	if (mDynamicRendering)
+	{
+		return;
+	}
+
 	swapChainFrambuffers.resize(swapChainImageViews.size());
 	
 	for (auto i = 0; i < swapChainImageViews.size(); i++)
 	{
-		VkImageView attachment[] = { swapChainImageViews[i] };
+		VkImageView attachment[] = { swapChainImageViews[i], mRenderGraph->getImageView(mGraphDepth) };
 		
 		VkFramebufferCreateInfo frambufferinfo{};
 		frambufferinfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
 		frambufferinfo.renderPass = mRenderpass;
-		frambufferinfo.attachmentCount = 1;
+		frambufferinfo.attachmentCount = 2;
 		frambufferinfo.pAttachments = attachment;
 		frambufferinfo.width = mSwapchainExtent.width;
 		frambufferinfo.height = mSwapchainExtent.height;
@@ -901,54 +1976,188 @@ void WindowApp::createCommandPool()
 
 	VkCommandPoolCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	createInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	createInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
 	createInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
 
-	if (vkCreateCommandPool(mDevice,&createInfo,nullptr,&mCommandPool) != VK_SUCCESS)
+	//one pool per frame in flight, reset as a whole once the frame's timeline value has been reached
+	mCommandPools.resize(mFramesInFlight);
+	for (auto& commandPool : mCommandPools)
 	{
-		throw std::runtime_error("ERROR: failed to create command pool");
+		if (vkCreateCommandPool(mDevice,&createInfo,nullptr,&commandPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("ERROR: failed to create command pool");
+		}
 	}
 }
 
-void WindowApp::createCommandBuffers()
+void WindowApp::createTransferQueue()
+{
+	QueueFamilyIndices queueFamilyIndices = findQueueFamily(mPhysicalDevice);
+	uint32_t graphicsFamily = queueFamilyIndices.graphicsFamily.value();
+	uint32_t transferFamily = queueFamilyIndices.isTransfereFamily() ? queueFamilyIndices.transfereFamily.value() : graphicsFamily;
+
+	mUploader = std::make_unique<VulkanEngine::TransferQueue>(mDevice, *mAllocator, mTransferQueue, transferFamily, mGraphicsQueue, graphicsFamily);
+}
+
+void WindowApp::createTextureStreamer()
 {
-	commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-	VkCommandBufferAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.commandPool = mCommandPool;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandBufferCount = (uint32_t)commandBuffers.size();
+	VkDeviceSize budget = mSettings.textureBudgetMb * 1024 * 1024;
+	mTextures = std::make_unique<VulkanEngine::TextureStreamer>(mDevice, *mAllocator, *mUploader, *mBindless, *mDeletionQueue, *mJobs, mTextureFormats, budget);
+
+	if (mSettings.textureDirectory.empty())
+	{
+		return;
+	}
+
+	//a texture is every file sharing the name up to the first dot: brick.png, brick.bc7.vtex, brick.bc1.vtex.
+	//the best cooked format the device samples wins, the source image is the fallback
+	auto rank = [](VulkanEngine::TextureFormat format)
+	{
+		switch (format)
+		{
+		case VulkanEngine::TextureFormat::Bc7: return 5;
+		case VulkanEngine::TextureFormat::Bc3: return 4;
+		case VulkanEngine::TextureFormat::Bc5: return 3;
+		case VulkanEngine::TextureFormat::Bc1: return 2;
+		default: return 1;
+		}
+	};
+	//everything stb_image can read
+	const std::set<std::string> imageExtensions = { ".png", ".jpg", ".jpeg", ".tga", ".bmp", ".psd", ".gif", ".hdr", ".pic", ".pnm" };
+
+	//sorted so the scene gets the same textures on every run
+	std::map<std::string, std::pair<int, std::filesystem::path>> chosen;
+	for (const auto& entry : std::filesystem::directory_iterator(mSettings.textureDirectory))
+	{
+		std::string extension = entry.path().extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		if (!entry.is_regular_file())
+		{
+			continue;
+		}
 
-	if (vkAllocateCommandBuffers(mDevice,&allocInfo,commandBuffers.data()) != VK_SUCCESS)
+		//source images score 0, cooked files the device cannot sample -1 so they only load (and fail) when alone
+		int score = 0;
+		if (extension == VulkanEngine::TextureFile::EXTENSION)
+		{
+			VulkanEngine::TextureFileInfo info = VulkanEngine::TextureFile::readInfo(entry.path().string());
+			score = mTextureFormats.supports(info.format, info.srgb) ? rank(info.format) : -1;
+		}
+		else if (imageExtensions.count(extension) == 0)
+		{
+			continue;
+		}
+
+		std::string filename = entry.path().filename().string();
+		std::string name = filename.substr(0, filename.find('.'));
+		auto found = chosen.find(name);
+		if (found == chosen.end() || score > found->second.first)
+		{
+			chosen[name] = { score, entry.path() };
+		}
+	}
+
+	if (chosen.empty())
 	{
-		throw std::runtime_error("ERORR: failed to allocate command buffers");
+		throw std::runtime_error("ERROR: no images found in " + mSettings.textureDirectory);
+	}
+	for (const auto& [name, choice] : chosen)
+	{
+		mTextureHandles.push_back(mTextures->load(choice.second.string()));
+	}
+}
+
+void WindowApp::createParallelRecorder()
+{
+	QueueFamilyIndices queueFamilyIndices = findQueueFamily(mPhysicalDevice);
+
+	//one slice of the draw list per thread, past eight the secondaries cost more than they save
+	uint32_t sliceCount = std::clamp(mJobs->getThreadCount(), 1u, 8u);
+	mRecorder = std::make_unique<VulkanEngine::ParallelRecorder>(mDevice, *mJobs, queueFamilyIndices.graphicsFamily.value(), mFramesInFlight, sliceCount);
+}
+
+void WindowApp::createCullingPass()
+{
+	auto cullShader = readShaderFile(SHADER_PATH "cull.spv");
+
+	mCulling = std::make_unique<VulkanEngine::CullingPass>(mDevice, *mAllocator, *mBindless, mPipelineCache->getHandle(), cullShader,
+		mFramesInFlight, OBJECT_COUNT, mRecorder->getSliceCount(), mDrawIndirectCount, mMultiDrawIndirect);
+	mCulling->setInputBuffers(mFrameRing->getBuffer(), sizeof(FrameData), sizeof(ObjectData) * OBJECT_COUNT);
+
+	mExpectedVisibleCount.resize(mFramesInFlight);
+}
+
+void WindowApp::createMeshletPass()
+{
+	if (!mMeshletMode.has_value())
+	{
+		return;
+	}
+
+	//only needed by the compute fallback, the mesh shader path culls in its task shader
+	std::vector<char> cullShader;
+	if (mMeshletMode == VulkanEngine::MeshletPass::Mode::Compute)
+	{
+		cullShader = readShaderFile(SHADER_PATH "meshlet_cull.spv");
+	}
+
+	//every object draws level 0, the meshlets replace the per object draws of the culling pass
+	mMeshlets = std::make_unique<VulkanEngine::MeshletPass>(mDevice, *mAllocator, *mUploader, *mBindless, mPipelineCache->getHandle(),
+		mMeshletMode.value(), mMesh, 0, mVertexBuffer, cullShader, mFramesInFlight, OBJECT_COUNT, mRecorder->getSliceCount());
+	mMeshlets->setInputBuffers(mFrameRing->getBuffer(), sizeof(FrameData), sizeof(ObjectData) * OBJECT_COUNT);
+}
+
+void WindowApp::createGpuProfiler()
+{
+	QueueFamilyIndices queueFamilyIndices = findQueueFamily(mPhysicalDevice);
+
+	mGpuProfiler = std::make_unique<VulkanEngine::GpuProfiler>(mPhysicalDevice, mDevice, queueFamilyIndices.graphicsFamily.value(), mFramesInFlight);
+}
+
+void WindowApp::createCommandBuffers()
+{
+	commandBuffers.resize(mFramesInFlight);
+	for (uint32_t i = 0; i < mFramesInFlight; i++)
+	{
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = mCommandPools[i];
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(mDevice,&allocInfo,&commandBuffers[i]) != VK_SUCCESS)
+		{
+			throw std::runtime_error("ERORR: failed to allocate command buffers");
+		}
 	}
 }
 
 void WindowApp::createSyncObj()
 {
-	imageAvalibleSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-	renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-	inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+	mTimelineFrame.resize(mFramesInFlight);
+	imageAvalibleSemaphores.resize(mFramesInFlight);
+	renderFinishedSemaphores.resize(mFramesInFlight);
 	VkSemaphoreCreateInfo semaphoreCreateInfo{};
 	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-	VkFenceCreateInfo fenceCreateInfo{};
-	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-	for (auto i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+	for (uint32_t i = 0; i < mFramesInFlight; i++) {
 		if (vkCreateSemaphore(mDevice, &semaphoreCreateInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS
-			|| vkCreateSemaphore(mDevice, &semaphoreCreateInfo, nullptr, &imageAvalibleSemaphores[i]) != VK_SUCCESS
-			|| vkCreateFence(mDevice, &fenceCreateInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS)
+			|| vkCreateSemaphore(mDevice, &semaphoreCreateInfo, nullptr, &imageAvalibleSemaphores[i]) != VK_SUCCESS)
 		{
-			throw std::runtime_error("ERROR: failed to create semaphore or fence");
+			throw std::runtime_error("ERROR: failed to create semaphore");
 		}
 	}
 
+	//value 0 is where the timeline starts, so every slot is free before its first frame
+	mFrameTimeline = std::make_unique<VulkanEngine::Timeline>(mDevice);
+	mFrameTimelineValue.assign(mFramesInFlight, 0);
+
 }
 
 void WindowApp::recordCommandBuffer(VkCommandBuffer buffer, uint32_t index)
 {
+	PROFILE_SCOPE("recordCommandBuffer");
+
 	VkCommandBufferBeginInfo beginInfo{};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 	beginInfo.flags = 0;
@@ -959,28 +2168,41 @@ void WindowApp::recordCommandBuffer(VkCommandBuffer buffer, uint32_t index)
 		throw std::runtime_error("ERROR: failed to record command buffer");
 	}
 
-	VkRenderPassBeginInfo renderpassBegininfo{};
+	mGpuProfiler->beginFrame(buffer, currentFrame);
+
+	//cull, prepass and pyramid, then the main pass, with the barriers between them; every pass gets a GPU scope
+	mGraphImageIndex = index;
+	mRenderGraph->setImportedImage(mGraphColorTarget, swapChainImage[index]);
+	mRenderGraph->execute(buffer, VK_NULL_HANDLE, mGpuProfiler.get());
+
+	if (mSettings.shouldDump(mFrameNumber))
+	{
+		uint32_t readbackScope = mGpuProfiler->beginScope(buffer, "Readback");
+		mOffscreen->recordReadback(buffer, index);
+		mGpuProfiler->endScope(buffer, readbackScope);
+		mReadbackFrame[currentFrame] = mFrameNumber;
+	}
+
+	mGpuProfiler->endFrame(buffer);
 
-	renderpassBegininfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	renderpassBegininfo.renderPass = mRenderpass;
-	renderpassBegininfo.framebuffer = swapChainFrambuffers[index];
-	renderpassBegininfo.renderArea.offset = { 0,0 };
-	renderpassBegininfo.renderArea.extent = mSwapchainExtent;
+	if (vkEndCommandBuffer(buffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("ERROR: failed to record command buffer");
+	}
 
-	VkClearValue clearColor = { {{0.0f,0.0f,0.0f,1.0f}} };
-	renderpassBegininfo.clearValueCount = 1;
-	renderpassBegininfo.pClearValues = &clearColor;
+}
 
-	vkCmdBeginRenderPass(buffer, &renderpassBegininfo, VK_SUBPASS_CONTENTS_INLINE);
+//state is not inherited by secondaries, so every command buffer that draws binds it all
+void WindowApp::bindDrawState(VkCommandBuffer commandBuffer, VkPipeline pipeline, VkPipelineLayout layout)
+{
 	VkBuffer vertexBuffers[] = { mVertexBuffer };
 	VkDeviceSize offsets[] = { 0 };
 
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
 
-	vkCmdBindVertexBuffers(buffer, 0, 1, vertexBuffers, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, mIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
 
-	vkCmdBindIndexBuffer(buffer, mIndexBuffer, 0, VK_INDEX_TYPE_UINT16);
-
-	vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipeline);
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 
 	VkViewport viewport{};
 	viewport.x = 0.0f;
@@ -989,26 +2211,253 @@ void WindowApp::recordCommandBuffer(VkCommandBuffer buffer, uint32_t index)
 	viewport.height = static_cast<float>(mSwapchainExtent.height);
 	viewport.minDepth = 0.0f;
 	viewport.maxDepth = 1.0f;
-	vkCmdSetViewport(buffer, 0, 1, &viewport);
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
 	VkRect2D scissor{};
 	scissor.offset = { 0,0 };
 	scissor.extent = mSwapchainExtent;
+	vkCmdSetScissor(commandBuffer,0,1,&scissor);
+
+	//dynamic offsets are in binding order
+	uint32_t dynamicOffsets[] = { mFrameDataOffset, mObjectDataOffset };
+	vkCmdBindDescriptorSets(commandBuffer,VK_PIPELINE_BIND_POINT_GRAPHICS,layout,0,1,&mDescriptorSet, 2, dynamicOffsets);
+	//draws pick their textures by index, nothing is rebound between them
+	mBindless->bind(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 1);
+}
+
+//depth of the early list only, it is short and a few draws, so no secondaries
+void WindowApp::recordDepthPrepass(VkCommandBuffer buffer)
+{
+	VkClearValue clearDepth{};
+	clearDepth.depthStencil = { 0.0f, 0 };
+
+	if (mDynamicRendering)
+	{
+		//kept for the pyramid and loaded by the main pass
+		VkRenderingAttachmentInfo depthAttachment{};
+		depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+		depthAttachment.imageView = mRenderGraph->getImageView(mGraphDepth);
+		depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		depthAttachment.clearValue = clearDepth;
+
+		VkRenderingInfo renderingInfo{};
+		renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+		renderingInfo.renderArea.offset = { 0,0 };
+		renderingInfo.renderArea.extent = mSwapchainExtent;
+		renderingInfo.layerCount = 1;
+		renderingInfo.pDepthAttachment = &depthAttachment;
+
+		mCmdBeginRendering(buffer, &renderingInfo);
+	}
+	else
+	{
+		VkRenderPassBeginInfo prepassBeginInfo{};
+		prepassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		prepassBeginInfo.renderPass = mDepthPrepassRenderpass;
+		prepassBeginInfo.framebuffer = mDepthPrepassFramebuffer;
+		prepassBeginInfo.renderArea.offset = { 0,0 };
+		prepassBeginInfo.renderArea.extent = mSwapchainExtent;
+		prepassBeginInfo.clearValueCount = 1;
+		prepassBeginInfo.pClearValues = &clearDepth;
+
+		vkCmdBeginRenderPass(buffer, &prepassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	}
 
+	bindDrawState(buffer, mDepthPipeline, mPipelinelayout);
+	for (uint32_t slice = 0; slice < mCulling->getSliceCount(); slice++)
+	{
+		mCulling->draw(buffer, currentFrame, slice, VulkanEngine::CullingPass::Phase::Early);
+	}
 
-	vkCmdSetScissor(buffer,0,1,&scissor);
+	if (mDynamicRendering)
+	{
+		mCmdEndRendering(buffer);
+	}
+	else
+	{
+		vkCmdEndRenderPass(buffer);
+	}
+}
 
-	vkCmdBindDescriptorSets(buffer,VK_PIPELINE_BIND_POINT_GRAPHICS,mPipelinelayout,0,1,&mDescriptorSets[currentFrame], 0, nullptr);
+void WindowApp::recordMainPass(VkCommandBuffer buffer)
+{
+	//depth is reversed, the far plane is 0. Ignored when the prepass filled it
+	VkClearValue clearValues[2]{};
+	clearValues[0].color = { {0.0f,0.0f,0.0f,1.0f} };
+	clearValues[1].depthStencil = { 0.0f, 0 };
+
+	VkCommandBufferInheritanceInfo inheritanceInfo{};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+
+	//the secondaries inherit the attachment formats instead of a render pass and framebuffer
+	VkCommandBufferInheritanceRenderingInfo inheritanceRenderingInfo{};
+	inheritanceRenderingInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+	inheritanceRenderingInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+	inheritanceRenderingInfo.colorAttachmentCount = 1;
+	inheritanceRenderingInfo.pColorAttachmentFormats = &mSwapChainImageFormat;
+	inheritanceRenderingInfo.depthAttachmentFormat = mDepthFormat;
+	inheritanceRenderingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	if (mDynamicRendering)
+	{
+		VkRenderingAttachmentInfo colorAttachment{};
+		colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+		colorAttachment.imageView = swapChainImageViews[mGraphImageIndex];
+		colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.clearValue = clearValues[0];
+
+		//with occlusion culling the prepass has already written the early objects' depth
+		VkRenderingAttachmentInfo depthAttachment{};
+		depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+		depthAttachment.imageView = mRenderGraph->getImageView(mGraphDepth);
+		depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthAttachment.loadOp = mOcclusionCulling ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.clearValue = clearValues[1];
+
+		VkRenderingInfo renderingInfo{};
+		renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+		renderingInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+		renderingInfo.renderArea.offset = { 0,0 };
+		renderingInfo.renderArea.extent = mSwapchainExtent;
+		renderingInfo.layerCount = 1;
+		renderingInfo.colorAttachmentCount = 1;
+		renderingInfo.pColorAttachments = &colorAttachment;
+		renderingInfo.pDepthAttachment = &depthAttachment;
+
+		mCmdBeginRendering(buffer, &renderingInfo);
+		inheritanceInfo.pNext = &inheritanceRenderingInfo;
+	}
+	else
+	{
+		VkRenderPassBeginInfo renderpassBegininfo{};
+		renderpassBegininfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderpassBegininfo.renderPass = mRenderpass;
+		renderpassBegininfo.framebuffer = swapChainFrambuffers[mGraphImageIndex];
+		renderpassBegininfo.renderArea.offset = { 0,0 };
+		renderpassBegininfo.renderArea.extent = mSwapchainExtent;
+		renderpassBegininfo.clearValueCount = 2;
+		renderpassBegininfo.pClearValues = clearValues;
+
+		vkCmdBeginRenderPass(buffer, &renderpassBegininfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		inheritanceInfo.renderPass = mRenderpass;
+		inheritanceInfo.subpass = 0;
+		inheritanceInfo.framebuffer = swapChainFrambuffers[mGraphImageIndex];
+	}
 
-	vkCmdDrawIndexed(buffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+	//every worker draws its own slice of the culled draw list
+	const auto& secondaries = mRecorder->record(currentFrame, inheritanceInfo, [this](VkCommandBuffer secondary, uint32_t slice)
+	{
+		bool meshShaders = mMeshlets && mMeshlets->getMode() == VulkanEngine::MeshletPass::Mode::MeshShader;
+		VkPipelineLayout layout = meshShaders ? mMeshletPipelineLayout : mPipelinelayout;
+		bindDrawState(secondary, meshShaders ? mMeshletPipeline : mPipeline, layout);
 
-	vkCmdEndRenderPass(buffer);
+		if (mMeshlets)
+		{
+			//the slice's meshlets, as task shader workgroups or as one indexed draw per surviving meshlet
+			mMeshlets->draw(secondary, currentFrame, slice, layout);
+		}
+		else
+		{
+			//one indirect call per phase for the slice's surviving objects, firstInstance selects its ObjectData.
+			//the early ones pass the depth test on the depth the prepass gave them
+			mCulling->draw(secondary, currentFrame, slice, VulkanEngine::CullingPass::Phase::Early);
+			mCulling->draw(secondary, currentFrame, slice, VulkanEngine::CullingPass::Phase::Late);
+		}
+	});
 
-	if (vkEndCommandBuffer(buffer) != VK_SUCCESS)
+	vkCmdExecuteCommands(buffer, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+
+	if (mDynamicRendering)
 	{
-		throw std::runtime_error("ERROR: failed to record command buffer");
+		mCmdEndRendering(buffer);
+	}
+	else
+	{
+		vkCmdEndRenderPass(buffer);
 	}
+}
+
+uint64_t WindowApp::submitFrame(VkSemaphore waitSemaphore, VkPipelineStageFlags2 waitStages, VkSemaphore signalSemaphore)
+{
+	mGpuProfiler->markSubmitted();
+
+	//the frame timeline first, the binary semaphore for the present after it
+	uint64_t timelineValue = mFrameTimeline->advance();
+	VkSemaphore signalSemaphores[] = { mFrameTimeline->getHandle(), signalSemaphore };
+	uint32_t signalCount = signalSemaphore != VK_NULL_HANDLE ? 2 : 1;
 
+	VkResult result;
+	if (mDynamicRendering)
+	{
+		VkSemaphoreSubmitInfo waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+		waitInfo.semaphore = waitSemaphore;
+		waitInfo.stageMask = waitStages;
+
+		VkSemaphoreSubmitInfo signalInfos[2]{};
+		for (uint32_t i = 0; i < signalCount; i++)
+		{
+			signalInfos[i].sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+			signalInfos[i].semaphore = signalSemaphores[i];
+			signalInfos[i].stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+		}
+		signalInfos[0].value = timelineValue;
+
+		VkCommandBufferSubmitInfo commandBufferInfo{};
+		commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+		commandBufferInfo.commandBuffer = commandBuffers[currentFrame];
+
+		VkSubmitInfo2 submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+		submitInfo.waitSemaphoreInfoCount = waitSemaphore != VK_NULL_HANDLE ? 1 : 0;
+		submitInfo.pWaitSemaphoreInfos = &waitInfo;
+		submitInfo.commandBufferInfoCount = 1;
+		submitInfo.pCommandBufferInfos = &commandBufferInfo;
+		submitInfo.signalSemaphoreInfoCount = signalCount;
+		submitInfo.pSignalSemaphoreInfos = signalInfos;
+
+		result = mQueueSubmit2(mGraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+	}
+	else
+	{
+		//only stages that exist in the original flags are waited on, their bits are the same
+		VkPipelineStageFlags legacyWaitStages = static_cast<VkPipelineStageFlags>(waitStages);
+
+		//binary semaphores ignore their value
+		uint64_t waitValue = 0;
+		uint64_t signalValues[] = { timelineValue, 0 };
+		VkTimelineSemaphoreSubmitInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.waitSemaphoreValueCount = waitSemaphore != VK_NULL_HANDLE ? 1 : 0;
+		timelineInfo.pWaitSemaphoreValues = &waitValue;
+		timelineInfo.signalSemaphoreValueCount = signalCount;
+		timelineInfo.pSignalSemaphoreValues = signalValues;
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.waitSemaphoreCount = waitSemaphore != VK_NULL_HANDLE ? 1 : 0;
+		submitInfo.pWaitSemaphores = &waitSemaphore;
+		submitInfo.pWaitDstStageMask = &legacyWaitStages;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
+		submitInfo.signalSemaphoreCount = signalCount;
+		submitInfo.pSignalSemaphores = signalSemaphores;
+
+		result = vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+	}
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("ERROR: failed to submit to queue");
+	}
+	mFrameTimelineValue[currentFrame] = timelineValue;
+	return timelineValue;
 }
 
 VkShaderModule WindowApp::createShaderModule(const std::vector<char>& code)
@@ -1049,145 +2498,116 @@ std::vector<char> WindowApp::readShaderFile(const std::string& fileName)
 		return buffer;
 }
 
-void WindowApp::createVertexBuffer()
+void WindowApp::loadMesh()
 {
-	VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	createBuffer(bufferSize,VK_BUFFER_USAGE_TRANSFER_SRC_BIT,VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,stagingBuffer,stagingBufferMemory);
-
-	void* data;
-	vkMapMemory(mDevice,stagingBufferMemory,0,bufferSize,0,&data);
-	memcpy(data,vertices.data(),(size_t)bufferSize);
-	vkUnmapMemory(mDevice,stagingBufferMemory);
-
-	createBuffer(bufferSize,VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,mVertexBuffer,mVertexBufferMemory);
-	
-	copyBuffer(stagingBuffer,mVertexBuffer,bufferSize);
-
-	vkDestroyBuffer(mDevice,stagingBuffer,nullptr);
-	vkFreeMemory(mDevice,stagingBufferMemory,nullptr);
-}
-
-void WindowApp::createIndexBuffer()
-{
-	VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
-
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	createBuffer(bufferSize,VK_BUFFER_USAGE_TRANSFER_SRC_BIT,VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | 
-		VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-	void* data;
-	vkMapMemory(mDevice,stagingBufferMemory,0,bufferSize,0,&data);
-	memcpy(data,indices.data(),(size_t)bufferSize);
-	vkUnmapMemory(mDevice,stagingBufferMemory);
-
-	createBuffer(bufferSize,VK_BUFFER_USAGE_TRANSFER_DST_BIT | 
-		VK_BUFFER_USAGE_INDEX_BUFFER_BIT,VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,mIndexBuffer,mIndexBufferMemory);
-
-	copyBuffer(stagingBuffer,mIndexBuffer,bufferSize);
+	auto start = std::chrono::steady_clock::now();
+	if (mSettings.meshPath.empty())
+	{
+		mMesh.vertices.owned.resize(vertices.size());
+		memcpy(mMesh.vertices.owned.data(), vertices.data(), sizeof(Vertex) * vertices.size());
+		mMesh.indices.owned = indices;
+		mMesh.lods.push_back({ 0, static_cast<uint32_t>(indices.size()), 0, 0, 0.0f });
+		mMesh.computeBounds();
+	}
+	else
+	{
+		//no parsing, the streams are copied from the mapped pages straight into staging
+		mMesh = VulkanEngine::MeshFile::read(mSettings.meshPath);
+	}
+	if (!mMesh.optimized)
+	{
+		VulkanEngine::MeshOptimizer::optimize(mMesh);
+	}
+	//optimizing drops the meshlets, and older or --no-optimize mesh files have none
+	if (mMeshletMode.has_value() && mMesh.lods[0].meshletCount == 0)
+	{
+		VulkanEngine::MeshletBuilder::build(mMesh);
+	}
+	const VulkanEngine::MeshLod& lod = mMesh.lods[0];
+	mMeshCacheStats = VulkanEngine::MeshOptimizer::analyzeVertexCache(mMesh.indices.data() + lod.firstIndex, lod.indexCount, mMesh.vertices.size());
 
-	vkDestroyBuffer(mDevice,stagingBuffer,nullptr);
-	vkFreeMemory(mDevice,stagingBufferMemory,nullptr);
+	createVertexBuffer();
+	createIndexBuffer();
+	mMeshLoadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 }
 
-void WindowApp::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+void WindowApp::createVertexBuffer()
 {
-	VkBufferCreateInfo bufferCreateInfo{};
-	bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	bufferCreateInfo.size = size;
-	bufferCreateInfo.usage = usage;
-	bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	VkDeviceSize bufferSize = mMesh.vertices.byteSize();
+	const void* data = mMesh.vertices.data();
 
-	if (vkCreateBuffer(mDevice, &bufferCreateInfo, nullptr, &buffer) != VK_SUCCESS)
+	std::vector<VulkanEngine::QuantizedMeshVertex> quantized;
+	if (mSettings.quantizeVertices)
 	{
-		throw std::runtime_error("ERROR: Could not create vertex buffer");
+		quantized.resize(mMesh.vertices.size());
+		VulkanEngine::MeshOptimizer::quantizeVertices(mMesh.vertices.data(), mMesh.vertices.size(), quantized.data());
+		bufferSize = sizeof(VulkanEngine::QuantizedMeshVertex) * quantized.size();
+		data = quantized.data();
 	}
+	mVertexBufferSize = bufferSize;
 
-	VkMemoryRequirements memRequirements;
-	vkGetBufferMemoryRequirements(mDevice, buffer, &memRequirements);
-
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-	if (vkAllocateMemory(mDevice, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
-	{ 
-		throw std::runtime_error("ERROR: Unable to allocate memory");
+	//the mesh shaders fetch the vertices themselves, through the bindless table
+	VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+	VkPipelineStageFlags readStages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+	VkAccessFlags readAccess = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	if (mMeshletMode == VulkanEngine::MeshletPass::Mode::MeshShader)
+	{
+		usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		readStages |= VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT;
+		readAccess |= VK_ACCESS_SHADER_READ_BIT;
 	}
-	vkBindBufferMemory(mDevice, buffer, bufferMemory, 0);
+	createBuffer(bufferSize,usage,VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,mVertexBuffer,mVertexBufferAllocation);
+	
+	mUploader->uploadBuffer(mVertexBuffer, 0, data, bufferSize, readStages, readAccess);
 }
 
-void WindowApp::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
+void WindowApp::createIndexBuffer()
 {
-	VkCommandBufferAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandBufferCount = 1;
-	allocInfo.commandPool = mCommandPool;
-
-	VkCommandBuffer commandBuffer;
-	vkAllocateCommandBuffers(mDevice, &allocInfo, &commandBuffer);
-
-	VkCommandBufferBeginInfo beginInfo{};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-	vkBeginCommandBuffer(commandBuffer,&beginInfo);
-
-	VkBufferCopy copyRegion{};
-	copyRegion.srcOffset = 0;
-	copyRegion.dstOffset = 0;
-	copyRegion.size = size;
-	
-	vkCmdCopyBuffer(commandBuffer,srcBuffer,dstBuffer,1,&copyRegion);
+	VkDeviceSize bufferSize = mMesh.indices.byteSize();
 
-	vkEndCommandBuffer(commandBuffer);
-	VkSubmitInfo submitInfo{};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
-	
-	vkQueueSubmit(mGraphicsQueue,1,&submitInfo,VK_NULL_HANDLE);
-	vkQueueWaitIdle(mGraphicsQueue);
+	createBuffer(bufferSize,VK_BUFFER_USAGE_TRANSFER_DST_BIT | 
+		VK_BUFFER_USAGE_INDEX_BUFFER_BIT,VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,mIndexBuffer,mIndexBufferAllocation);
 
-	vkFreeCommandBuffers(mDevice,mCommandPool,1,&commandBuffer);
+	mUploader->uploadBuffer(mIndexBuffer, 0, mMesh.indices.data(), bufferSize, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
 }
 
-uint32_t WindowApp::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+void WindowApp::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VulkanEngine::GpuAllocation& allocation)
 {
-	VkPhysicalDeviceMemoryProperties memProperties;
-	vkGetPhysicalDeviceMemoryProperties(mPhysicalDevice,&memProperties);
+	mAllocator->createBuffer(size, usage, properties, buffer, allocation);
+}
 
-	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) 
+VkShaderStageFlags WindowApp::getMeshletStages() const
+{
+	if (mMeshletMode == VulkanEngine::MeshletPass::Mode::MeshShader)
 	{
-		if(typeFilter & (1 << i)&&(memProperties.memoryTypes[i].propertyFlags & properties) == properties)
-		{
-			return i;
-		}
+		return VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
 	}
-	throw std::runtime_error("ERROR: failed to find suitable memory type");
-
-  
+	return 0;
 }
 
 void WindowApp::createDescriptorSetLayout()
 {
 	VkDescriptorSetLayoutBinding uboLayoutBinding{};
 	uboLayoutBinding.binding = 0;	
-	uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	uboLayoutBinding.descriptorCount = 1;
-	uboLayoutBinding.stageFlags =  VK_SHADER_STAGE_VERTEX_BIT;
+	//the task and mesh shaders read both bindings too when they draw
+	uboLayoutBinding.stageFlags =  VK_SHADER_STAGE_VERTEX_BIT | getMeshletStages();
 	uboLayoutBinding.pImmutableSamplers = nullptr;
 
+	VkDescriptorSetLayoutBinding objectLayoutBinding{};
+	objectLayoutBinding.binding = 1;
+	objectLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	objectLayoutBinding.descriptorCount = 1;
+	objectLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | getMeshletStages();
+	objectLayoutBinding.pImmutableSamplers = nullptr;
+
+	VkDescriptorSetLayoutBinding bindings[] = { uboLayoutBinding, objectLayoutBinding };
+
 	VkDescriptorSetLayoutCreateInfo layoutCreateInfo{};
 	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	layoutCreateInfo.bindingCount = 1;
-	layoutCreateInfo.pBindings = &uboLayoutBinding;
+	layoutCreateInfo.bindingCount = 2;
+	layoutCreateInfo.pBindings = bindings;
 
 	if (vkCreateDescriptorSetLayout(mDevice,&layoutCreateInfo,nullptr, &mDescriptorSetLayout) != VK_SUCCESS)
 	{
@@ -1195,49 +2615,212 @@ void WindowApp::createDescriptorSetLayout()
 	}
 }
 
-void WindowApp::createUniformBuffers()
+void WindowApp::createFrameRingBuffer()
 {
-	VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-
-	mUniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-	mUniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-	mUniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+	mFrameRing = std::make_unique<VulkanEngine::FrameRingBuffer>(mPhysicalDevice, mDevice, *mAllocator, mFramesInFlight);
+}
 
-	for(size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+void WindowApp::createScene()
+{
+	//a grid of spinning copies of the mesh, each row hanging off its own pivot node, all drawing level 0.
+	//meshes are scaled to the quad's size so any of them fits the grid
+	const VulkanEngine::MeshLod& lod = mMesh.lods[0];
+	const VulkanEngine::MeshBounds& meshBounds = mMesh.bounds;
+	const float meshScale = meshBounds.radius > 0.0f ? 0.7072f / meshBounds.radius : 1.0f;
+	const float spacing = 1.5f;
+	const float gridOffset = (OBJECT_GRID_SIZE - 1) * spacing * 0.5f;
+	for (uint32_t row = 0; row < OBJECT_GRID_SIZE; row++)
 	{
-		createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, mUniformBuffers[i], mUniformBuffersMemory[i]);
-	
-		vkMapMemory(mDevice, mUniformBuffersMemory[i], 0, bufferSize, 0, &mUniformBuffersMapped[i]);
+		VulkanEngine::LocalTransform pivot;
+		pivot.position = glm::vec3(0.0f, row * spacing - gridOffset, 0.0f);
+		VulkanEngine::TransformNodeId rowNode = mTransforms.createNode(VulkanEngine::INVALID_TRANSFORM_NODE, pivot);
+
+		for (uint32_t column = 0; column < OBJECT_GRID_SIZE; column++)
+		{
+			uint32_t i = row * OBJECT_GRID_SIZE + column;
+			VulkanEngine::LocalTransform local;
+			local.position = glm::vec3(column * spacing - gridOffset, 0.0f, 0.0f);
+			local.scale = glm::vec3(meshScale);
+
+			VulkanEngine::TransformNode node{ mTransforms.createNode(rowNode, local) };
+			VulkanEngine::Spin spin{ i * 0.1f, glm::radians(90.0f) };
+			uint32_t texture = mTextureHandles.empty() ? VulkanEngine::TextureStreamer::INVALID_TEXTURE : mTextureHandles[i % mTextureHandles.size()];
+			VulkanEngine::MeshRef mesh{ lod.indexCount, lod.firstIndex, 0, texture };
+			//object space, the culling scales it with the model matrix
+			VulkanEngine::Bounds bounds{ glm::vec4(meshBounds.center[0], meshBounds.center[1], meshBounds.center[2], meshBounds.radius) };
+
+			mScene.create(node, spin, mesh, bounds);
+		}
 	}
 }
 
-void WindowApp::updateUniformBuffer(uint32_t currentImage)
+void WindowApp::updateFrameData(uint32_t currentImage)
 {
+	PROFILE_SCOPE("updateFrameData");
+
 	static auto startTime = std::chrono::high_resolution_clock::now();
 
 	auto currentTime = std::chrono::high_resolution_clock::now();
 	float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+	if (mSettings.headless)
+	{
+		//a fixed 60Hz step so dumped frames are the same on every run and every machine
+		time = mFrameNumber / 60.0f;
+	}
+
+	FrameData frame{};
+	frame.view = glm::lookAt(glm::vec3(0.0f,-60.0f,80.0f),glm::vec3(0.0f,0.0f,0.0f),glm::vec3(0.0f,0.0f,1.0f));
+	//reversed depth, 1 at the near plane and 0 at the far one, in vulkan's 0 to 1 range with y down.
+	//cull.comp reads near and view depth back out of [2][2] and [3][2]
+	const float nearPlane = 0.1f;
+	const float farPlane = 200.0f;
+	const float focal = 1.0f / std::tan(glm::radians(45.0f) * 0.5f);
+	frame.proj = glm::mat4(0.0f);
+	frame.proj[0][0] = focal / (mSwapchainExtent.width / (float)mSwapchainExtent.height);
+	frame.proj[1][1] = -focal;
+	frame.proj[2][2] = nearPlane / (farPlane - nearPlane);
+	frame.proj[2][3] = -1.0f;
+	frame.proj[3][2] = farPlane * nearPlane / (farPlane - nearPlane);
+
+	//frustum planes from the rows of proj * view, normalized so the distance test works on sphere radii
+	glm::mat4 viewProj = frame.proj * frame.view;
+	glm::vec4 row0(viewProj[0][0], viewProj[1][0], viewProj[2][0], viewProj[3][0]);
+	glm::vec4 row1(viewProj[0][1], viewProj[1][1], viewProj[2][1], viewProj[3][1]);
+	glm::vec4 row2(viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]);
+	glm::vec4 row3(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+	frame.frustumPlanes[0] = row3 + row0;
+	frame.frustumPlanes[1] = row3 - row0;
+	frame.frustumPlanes[2] = row3 + row1;
+	frame.frustumPlanes[3] = row3 - row1;
+	frame.frustumPlanes[4] = row2;
+	frame.frustumPlanes[5] = row3 - row2;
+	for (auto& plane : frame.frustumPlanes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
 
-	UniformBufferObject ubo{};
-	ubo.model = glm::rotate(glm::mat4(1.0f),time * glm::radians(90.0f),glm::vec3(0.0f,0.0f,1.0f));
-	ubo.view = glm::lookAt(glm::vec3(2.0f,2.0f,2.0f),glm::vec3(0.0f,0.0f,0.0f),glm::vec3(0.0f,0.0f,1.0f));
-	ubo.proj = glm::perspective(glm::radians(45.0f),mSwapchainExtent.width / (float)mSwapchainExtent.height,0.1f,10.0f);
-	ubo.proj[1][1] *= -1;
+	VulkanEngine::FrameAllocation frameAllocation = mFrameRing->allocate(sizeof(frame));
+	memcpy(frameAllocation.mapped,&frame,sizeof(frame));
+	mFrameDataOffset = static_cast<uint32_t>(frameAllocation.offset);
 
-	memcpy(mUniformBuffersMapped[currentImage],&ubo,sizeof(ubo));
+	//advance the animation and resolve the hierarchy, then stream every drawable straight from its chunk into the ring
+	mScene.parallelEachChunk<const VulkanEngine::TransformNode, const VulkanEngine::Spin>(*mJobs,
+		[this, time](uint32_t, uint32_t count, const VulkanEngine::TransformNode* nodes, const VulkanEngine::Spin* spins)
+	{
+		for (uint32_t i = 0; i < count; i++)
+		{
+			mTransforms.setRotation(nodes[i].node, glm::angleAxis(spins[i].phase + time * spins[i].speed, glm::vec3(0.0f, 0.0f, 1.0f)));
+		}
+	});
+	mTransforms.update(*mJobs);
+
+	mObjectCount = std::min(mScene.count<VulkanEngine::TransformNode, VulkanEngine::MeshRef, VulkanEngine::Bounds>(), OBJECT_COUNT);
+	VulkanEngine::FrameAllocation objectAllocation = mFrameRing->allocate(sizeof(ObjectData) * OBJECT_COUNT);
+	ObjectData* objects = static_cast<ObjectData*>(objectAllocation.mapped);
+	//rough on-screen diameter in pixels of a unit sphere at depth 1, for the texture streamer
+	const float pixelsPerUnit = std::abs(frame.proj[1][1]) * 0.5f * mSwapchainExtent.height;
+	mScene.parallelEachChunk<const VulkanEngine::TransformNode, const VulkanEngine::MeshRef, const VulkanEngine::Bounds>(*mJobs,
+		[this, objects, &frame, pixelsPerUnit](uint32_t firstIndex, uint32_t count, const VulkanEngine::TransformNode* nodes,
+			const VulkanEngine::MeshRef* meshes, const VulkanEngine::Bounds* bounds)
+	{
+		count = std::min(count, mObjectCount - std::min(firstIndex, mObjectCount));
+		//TransformNode is a bare node id, so the column doubles as the id array the store kernel wants
+		mTransforms.storeWorldMatrices(&nodes[0].node, count, &objects[firstIndex].model, sizeof(ObjectData));
+		for (uint32_t i = 0; i < count; i++)
+		{
+			ObjectData& object = objects[firstIndex + i];
+			object.boundingSphere = bounds[i].sphere;
+			object.indexCount = meshes[i].indexCount;
+			object.firstIndex = meshes[i].firstIndex;
+			object.vertexOffset = meshes[i].vertexOffset;
+			object.textureIndex = VulkanEngine::BindlessTable::INVALID_INDEX;
+			if (meshes[i].texture != VulkanEngine::TextureStreamer::INVALID_TEXTURE)
+			{
+				object.textureIndex = mTextures->getBindlessIndex(meshes[i].texture);
+
+				//from the hierarchy's copy, the mapped objects are write only
+				const glm::mat4& model = mTransforms.getWorld(nodes[i].node);
+				glm::vec4 center = frame.view * model * glm::vec4(glm::vec3(bounds[i].sphere), 1.0f);
+				float radius = bounds[i].sphere.w * glm::length(glm::vec3(model[0]));
+				float depth = std::max(-center.z, 0.1f);
+				mTextures->reportUsage(meshes[i].texture, 2.0f * radius * pixelsPerUnit / depth);
+			}
+		}
+	});
+	mObjectDataOffset = static_cast<uint32_t>(objectAllocation.offset);
+
+	if (mSettings.verifyCulling)
+	{
+		computeCullingReference(currentImage, frame);
+	}
+}
+
+void WindowApp::computeCullingReference(uint32_t currentImage, const FrameData& frame)
+{
+	PROFILE_SCOPE("computeCullingReference");
+
+	//the same test as cull.comp, from the cached world matrices rather than the write-only ring
+	const float epsilon = 1e-3f;
+	VisibleRange range;
+	mScene.eachChunk<const VulkanEngine::TransformNode, const VulkanEngine::MeshRef, const VulkanEngine::Bounds>(
+		[this, &frame, &range, epsilon](uint32_t firstIndex, uint32_t count, const VulkanEngine::TransformNode* nodes,
+			const VulkanEngine::MeshRef*, const VulkanEngine::Bounds* bounds)
+	{
+		count = std::min(count, mObjectCount - std::min(firstIndex, mObjectCount));
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const glm::mat4& model = mTransforms.getWorld(nodes[i].node);
+			glm::vec3 center = glm::vec3(model * glm::vec4(glm::vec3(bounds[i].sphere), 1.0f));
+			float scale = std::max(std::max(glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1]))), glm::length(glm::vec3(model[2])));
+			float radius = bounds[i].sphere.w * scale;
+
+			//clearly inside every plane counts for both bounds, clearly outside one for neither
+			bool inside = true;
+			bool outside = false;
+			for (const auto& plane : frame.frustumPlanes)
+			{
+				float distance = glm::dot(glm::vec3(plane), center) + plane.w + radius;
+				inside = inside && distance > epsilon;
+				outside = outside || distance < -epsilon;
+			}
+			range.min += inside ? 1 : 0;
+			range.max += outside ? 0 : 1;
+		}
+	});
+	mExpectedVisibleCount[currentImage] = range;
+}
+
+void WindowApp::verifyCulling(uint32_t frameIndex)
+{
+	//checked once the frame's counters are back, occlusion has no reference and is left out
+	if (!mExpectedVisibleCount[frameIndex].has_value())
+	{
+		return;
+	}
+	VisibleRange expected = mExpectedVisibleCount[frameIndex].value();
+	mExpectedVisibleCount[frameIndex].reset();
+
+	uint32_t visible = mCulling->getFrustumVisibleCount(frameIndex);
+	if (visible < expected.min || visible > expected.max)
+	{
+		std::cerr << "culling mismatch: gpu " << visible << " in the frustum, cpu " << expected.min << " to " << expected.max << std::endl;
+		mCullingMismatches++;
+	}
 }
 
 void WindowApp::createDescriptorPool()
 {
-	VkDescriptorPoolSize poolSize{};
-	poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	poolSize.descriptorCount = static_cast<uint32_t>(swapChainImage.size());
+	VkDescriptorPoolSize poolSizes[2]{};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	poolSizes[0].descriptorCount = 1;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	poolSizes[1].descriptorCount = 1;
 
 	VkDescriptorPoolCreateInfo poolCreateInfo{};
 	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	poolCreateInfo.poolSizeCount = 1;
-	poolCreateInfo.pPoolSizes = &poolSize;
-	poolCreateInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	poolCreateInfo.poolSizeCount = 2;
+	poolCreateInfo.pPoolSizes = poolSizes;
+	poolCreateInfo.maxSets = 1;
 
 	if (vkCreateDescriptorPool(mDevice, &poolCreateInfo, nullptr, &mDescriptorPool) != VK_SUCCESS)
 	{
@@ -1247,39 +2830,44 @@ void WindowApp::createDescriptorPool()
 
 void WindowApp::createDescriptorSets()
 {
-	std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, mDescriptorSetLayout);
-
 	VkDescriptorSetAllocateInfo allocInfo{};
 	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 	allocInfo.descriptorPool = mDescriptorPool;
-	allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-	allocInfo.pSetLayouts = layouts.data();
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &mDescriptorSetLayout;
 
-	mDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
-
-	if (vkAllocateDescriptorSets(mDevice,&allocInfo,mDescriptorSets.data()) != VK_SUCCESS)
+	if (vkAllocateDescriptorSets(mDevice,&allocInfo,&mDescriptorSet) != VK_SUCCESS)
 	{
 		throw std::runtime_error("ERROR: Failed to allocate descriptor sets");
 	}
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-	{
-		VkDescriptorBufferInfo bufferInfo{};
-		bufferInfo.buffer = mUniformBuffers[i];
-		bufferInfo.offset = 0;
-		bufferInfo.range = sizeof(UniformBufferObject);
-
-		VkWriteDescriptorSet descriptorWrite{};
-		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrite.dstSet = mDescriptorSets[i];
-		descriptorWrite.dstBinding = 0;
-		descriptorWrite.dstArrayElement = 0;
-		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrite.descriptorCount = 1;
-		descriptorWrite.pBufferInfo = &bufferInfo;
-		descriptorWrite.pImageInfo = nullptr;
-		descriptorWrite.pTexelBufferView = nullptr;
-
-		vkUpdateDescriptorSets(mDevice, 1, &descriptorWrite, 0, nullptr);
-	}
+	//one set for every frame, the frame's data is picked with dynamic offsets into the ring
+	VkDescriptorBufferInfo frameBufferInfo{};
+	frameBufferInfo.buffer = mFrameRing->getBuffer();
+	frameBufferInfo.offset = 0;
+	frameBufferInfo.range = sizeof(FrameData);
+
+	VkDescriptorBufferInfo objectBufferInfo{};
+	objectBufferInfo.buffer = mFrameRing->getBuffer();
+	objectBufferInfo.offset = 0;
+	objectBufferInfo.range = sizeof(ObjectData) * OBJECT_COUNT;
+
+	VkWriteDescriptorSet descriptorWrites[2]{};
+	descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[0].dstSet = mDescriptorSet;
+	descriptorWrites[0].dstBinding = 0;
+	descriptorWrites[0].dstArrayElement = 0;
+	descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	descriptorWrites[0].descriptorCount = 1;
+	descriptorWrites[0].pBufferInfo = &frameBufferInfo;
+
+	descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[1].dstSet = mDescriptorSet;
+	descriptorWrites[1].dstBinding = 1;
+	descriptorWrites[1].dstArrayElement = 0;
+	descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	descriptorWrites[1].descriptorCount = 1;
+	descriptorWrites[1].pBufferInfo = &objectBufferInfo;
+
+	vkUpdateDescriptorSets(mDevice, 2, descriptorWrites, 0, nullptr);
 }
@@ -1,10 +1,14 @@
 #pragma once
 
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
+#endif
 #define GLFW_INCLUDE_VULKAN
 #include "GLFW/glfw3.h"
+#ifdef _WIN32
 #define GLFW_EXPOSE_NATIVE_WIN32
 #include "GLFW/glfw3native.h"
+#endif
 
 #include "vulkan/vulkan.h"
 #include "Vertex.h"
@@ -14,19 +18,56 @@
 #include <vector>
 #include <optional>
 #include <set>
-
+#include <memory>
+#include <deque>
+
+#include "Core/AppSettings.h"
+#include "Core/JobSystem.h"
+#include "Core/Profiler.h"
+#include "Core/FramePacer.h"
+#include "Core/EntityRegistry.h"
+#include "Core/TransformHierarchy.h"
+#include "Core/SceneComponents.h"
+#include "Core/MeshOptimizer.h"
+#include "Core/MeshletBuilder.h"
 #include "VulkanCore/VulkanDevice.h"
-
-struct UniformBufferObject {
-	alignas(16) glm::mat4 model;
+#include "VulkanCore/PipelineCache.h"
+#include "VulkanCore/TransferQueue.h"
+#include "VulkanCore/FrameRingBuffer.h"
+#include "VulkanCore/CullingPass.h"
+#include "VulkanCore/DepthPyramid.h"
+#include "VulkanCore/MeshletPass.h"
+#include "VulkanCore/ParallelRecorder.h"
+#include "VulkanCore/OffscreenTarget.h"
+#include "VulkanCore/GpuProfiler.h"
+#include "VulkanCore/DeletionQueue.h"
+#include "VulkanCore/BindlessTable.h"
+#include "VulkanCore/TextureStreamer.h"
+#include "VulkanCore/RenderGraph.h"
+#include "VulkanCore/Timeline.h"
+
+//set 0 binding 0, written once per frame
+struct FrameData {
 	alignas(16) glm::mat4 view;
 	alignas(16) glm::mat4 proj;
+	alignas(16) glm::vec4 frustumPlanes[6];
 };
-constexpr int WIDTH =800;
-constexpr int HEIGHT = 600;
 
-const int MAX_FRAMES_IN_FLIGHT = 2;
+//set 0 binding 1, one entry per object indexed with gl_InstanceIndex
+//also read by Shader/cull.comp to build the indirect draws, keep the layouts in sync
+struct ObjectData {
+	alignas(16) glm::mat4 model;
+	alignas(16) glm::vec4 boundingSphere;
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+	//slot in the bindless texture array, BindlessTable::INVALID_INDEX for none
+	uint32_t textureIndex;
+};
 
+//the per-frame object array and the culling pass hold at most OBJECT_COUNT objects
+constexpr uint32_t OBJECT_GRID_SIZE = 64;
+constexpr uint32_t OBJECT_COUNT = OBJECT_GRID_SIZE * OBJECT_GRID_SIZE;
 struct QueueFamilyIndices
 {
 	std::optional<uint32_t> graphicsFamily;
@@ -49,6 +90,7 @@ class WindowApp
 
 private:
 
+	VulkanEngine::AppSettings mSettings;
 
 	GLFWwindow* mWindow = nullptr;
 	VkInstance mInstance;
@@ -56,48 +98,149 @@ private:
 	VkDevice mDevice;
 	VkQueue mGraphicsQueue;
 	VkQueue mPresentQueue;
+	VkQueue mTransferQueue;
 	VkSurfaceKHR mSurface;
 	VkSwapchainKHR mSwapChain;
 	VkPipelineLayout mPipelinelayout;
-	VkRenderPass mRenderpass;
+	//null with dynamic rendering, as is the prepass render pass
+	VkRenderPass mRenderpass = VK_NULL_HANDLE;
 	VkPipeline mPipeline;
-	VkCommandPool mCommandPool;
+	std::vector<VkCommandPool> mCommandPools;
 	VkCommandBuffer mCommandBuffer;
 	std::vector<VkCommandBuffer> commandBuffers;
 
 	VkDescriptorSetLayout mDescriptorSetLayout;
 	VkPipelineLayout mPipelineLayout;
 
+	std::unique_ptr<VulkanEngine::JobSystem> mJobs;
+	std::unique_ptr<VulkanEngine::GpuAllocator> mAllocator;
+	std::unique_ptr<VulkanEngine::PipelineCache> mPipelineCache;
+	std::unique_ptr<VulkanEngine::TransferQueue> mUploader;
+
+	//what every object draws, the built in quad or --mesh. Streams of mesh files stay in the mapping
+	//unless the mesh still has to be optimized
+	VulkanEngine::MeshData mMesh;
+	double mMeshLoadMs = 0.0;
+	VulkanEngine::MeshOptimizer::VertexCacheStats mMeshCacheStats{};
+	VkDeviceSize mVertexBufferSize = 0;
 	VkBuffer mVertexBuffer;
-	VkDeviceMemory mVertexBufferMemory;
+	VulkanEngine::GpuAllocation mVertexBufferAllocation;
 	VkBuffer mIndexBuffer;
-	VkDeviceMemory mIndexBufferMemory;
-
-	std::vector<VkBuffer> mUniformBuffers;
-	std::vector<VkDeviceMemory> mUniformBuffersMemory;
-	std::vector<void*> mUniformBuffersMapped;
+	VulkanEngine::GpuAllocation mIndexBufferAllocation;
+
+	std::unique_ptr<VulkanEngine::FrameRingBuffer> mFrameRing;
+	std::unique_ptr<VulkanEngine::CullingPass> mCulling;
+	//--no-occlusion as createRenderPass resolved it, off with meshlets and without a sampleable depth format
+	bool mOcclusionCulling = false;
+	//depth is reversed, cleared to 0 and tested with GREATER_OR_EQUAL, see updateFrameData
+	VkFormat mDepthFormat = VK_FORMAT_UNDEFINED;
+	//the frame's passes, built once per swapchain and executed every frame. Owns the depth buffer
+	std::unique_ptr<VulkanEngine::RenderGraph> mRenderGraph;
+	VulkanEngine::RenderGraph::Resource mGraphColorTarget = VulkanEngine::RenderGraph::INVALID_RESOURCE;
+	VulkanEngine::RenderGraph::Resource mGraphDepth = VulkanEngine::RenderGraph::INVALID_RESOURCE;
+	//swapchain image the graph is being recorded for
+	uint32_t mGraphImageIndex = 0;
+	//the early draws write depth here, the pyramid is built from it and the main pass keeps it
+	VkRenderPass mDepthPrepassRenderpass = VK_NULL_HANDLE;
+	VkFramebuffer mDepthPrepassFramebuffer = VK_NULL_HANDLE;
+	VkPipeline mDepthPipeline = VK_NULL_HANDLE;
+	std::unique_ptr<VulkanEngine::DepthPyramid> mDepthPyramid;
+	//--meshlets as createLogicalDevice resolved it, empty when every object is drawn whole
+	std::optional<VulkanEngine::MeshletPass::Mode> mMeshletMode;
+	std::unique_ptr<VulkanEngine::MeshletPass> mMeshlets;
+	VkPipelineLayout mMeshletPipelineLayout = VK_NULL_HANDLE;
+	//task, mesh and the regular fragment shader, MeshShader mode only
+	VkPipeline mMeshletPipeline = VK_NULL_HANDLE;
+	std::unique_ptr<VulkanEngine::ParallelRecorder> mRecorder;
+	std::unique_ptr<VulkanEngine::GpuProfiler> mGpuProfiler;
+	//--verify-culling: per frame slot, how many objects the cpu puts in the frustum. Spheres that touch a
+	//plane within float rounding may land on either side, so the gpu count has to fall inside [min, max]
+	struct VisibleRange
+	{
+		uint32_t min = 0;
+		uint32_t max = 0;
+	};
+	std::vector<std::optional<VisibleRange>> mExpectedVisibleCount;
+	uint64_t mCullingMismatches = 0;
+	VulkanEngine::EntityRegistry mScene;
+	VulkanEngine::TransformHierarchy mTransforms;
+	uint32_t mObjectCount = 0;
+	bool mDrawIndirectCount = false;
+	bool mMultiDrawIndirect = false;
+	uint32_t mFrameDataOffset = 0;
+	uint32_t mObjectDataOffset = 0;
 
 	VkDescriptorPool mDescriptorPool;
-	std::vector<VkDescriptorSet> mDescriptorSets;
+	VkDescriptorSet mDescriptorSet;
+
+	//set 1, every texture, sampler and storage buffer addressed by index from the shaders
+	std::unique_ptr<VulkanEngine::BindlessTable> mBindless;
+	VkSampler mDefaultSampler;
+	//what createLogicalDevice found the device can sample, cooked textures are chosen by it
+	VulkanEngine::TextureFormatSupport mTextureFormats;
+	//everything --textures pointed at, handed out round robin over the scene
+	std::unique_ptr<VulkanEngine::TextureStreamer> mTextures;
+	std::vector<VulkanEngine::TextureHandle> mTextureHandles;
 
 	VkFormat mSwapChainImageFormat;
 	VkExtent2D mSwapchainExtent;
 
+	//headless mode renders into these instead of the swapchain, one image per frame in flight
+	std::unique_ptr<VulkanEngine::OffscreenTarget> mOffscreen;
+	//frame number waiting in each frame's readback slot
+	std::vector<std::optional<uint64_t>> mReadbackFrame;
+	uint64_t mFrameNumber = 0;
+
 	VkSemaphore imageAvalibleSemaphore;
 	VkSemaphore renderFinishedSemaphore;
-	VkFence infligthFence;
 
+	//binary, acquire and present take nothing else
 	std::vector<VkSemaphore> imageAvalibleSemaphores;
 	std::vector<VkSemaphore> renderFinishedSemaphores;
-	std::vector<VkFence> inFlightFences;
+	//every frame submit signals the next value, a slot is free again once its last value is reached
+	std::unique_ptr<VulkanEngine::Timeline> mFrameTimeline;
+	std::vector<uint64_t> mFrameTimelineValue;
 
 	uint32_t currentFrame = 0;
+	//chosen at launch, see AppSettings::framesInFlight
+	uint32_t mFramesInFlight;
+
+	VulkanEngine::FramePacer mPacer;
+	//VK_KHR_dynamic_rendering and VK_KHR_synchronization2 as createLogicalDevice resolved them, both or
+	//neither. The passes begin on image views, there are no render pass objects or framebuffers
+	bool mDynamicRendering = false;
+	PFN_vkCmdBeginRenderingKHR mCmdBeginRendering = nullptr;
+	PFN_vkCmdEndRenderingKHR mCmdEndRendering = nullptr;
+	PFN_vkCmdPipelineBarrier2KHR mCmdPipelineBarrier2 = nullptr;
+	PFN_vkQueueSubmit2KHR mQueueSubmit2 = nullptr;
+
+	//with VK_KHR_present_wait latency runs to the actual present, otherwise to the frame's timeline value
+	bool mPresentWait = false;
+	PFN_vkWaitForPresentKHR mWaitForPresent = nullptr;
+	std::deque<uint64_t> mPendingPresents;
+	std::vector<std::optional<uint64_t>> mTimelineFrame;
+	//swapchains replaced by recreateSwapChain. The presentation engine may hold their images past the
+	//frame timeline, so they go once their presents are confirmed, or a ring of frames after the last one
+	struct RetiredSwapchain
+	{
+		VkSwapchainKHR swapchain;
+		std::deque<uint64_t> pendingPresents;
+		uint64_t lastFrame;
+		bool presentWaitFailed = false;
+	};
+	std::vector<RetiredSwapchain> mRetiredSwapchains;
+
+	bool mFramebufferResized = false;
+	//resources replaced while frames are in flight, freed once the frames using them have finished
+	std::unique_ptr<VulkanEngine::DeletionQueue> mDeletionQueue;
 
 	VkDebugUtilsMessengerEXT mDebugMessenger;
 
 
 public:
-	void run();
+	explicit WindowApp(const VulkanEngine::AppSettings& settings = VulkanEngine::AppSettings());
+	//returns the process exit code, non-zero when --verify-culling saw a mismatch
+	int run();
 private:
 	//setting up vulkan
 	void initWindow();
@@ -112,7 +255,7 @@ private:
 	//setting up physical device
 	void PhysicalDevice();
 	bool isDeviceSuitable(VkPhysicalDevice Device);
-	int rateDevice(VkPhysicalDevice device);
+	uint32_t rateDevice(VkPhysicalDevice device);
 
 
 	//setting up queue families
@@ -138,6 +281,14 @@ private:
 	//setting up logical device
 	void createLogicalDevice();
 
+	void createJobSystem();
+
+	void createAllocator();
+
+	void createPipelineCache();
+
+	void createBindlessTable();
+
 	//creating surface
 	void createSurface();
 
@@ -146,13 +297,23 @@ private:
 	VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
 	VkPresentModeKHR choosePresentMode(const std::vector<VkPresentModeKHR> &availablePresentModes);
 	VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
-	void createSwapChain();
+	void createSwapChain(VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE);
 	void recreateSwapChain();
+	void releaseRetiredSwapchains(bool waitedIdle);
 	void cleanUpSwapChain();
+	static void framebufferResizeCallback(GLFWwindow* window, int width, int height);
+
+	//headless
+	void createOffscreenTarget();
+	void processReadback(uint32_t frameIndex);
 
 	//image view
 	void createImageVeiw();
 
+	//render graph with the depth buffer, and the pyramid, recreated with the swapchain
+	void createRenderGraph();
+	void destroyRenderGraph();
+
 	void createGraphicsPipeline();
 
 	void createRenderPass();
@@ -161,31 +322,59 @@ private:
 
 	void createCommandPool();
 
+	void createTransferQueue();
+
+	void createTextureStreamer();
+
 	void createCommandBuffers();
 
 	void createSyncObj();
 
 	void recordCommandBuffer(VkCommandBuffer buffer, uint32_t index);
+	void bindDrawState(VkCommandBuffer commandBuffer, VkPipeline pipeline, VkPipelineLayout layout);
+	void recordDepthPrepass(VkCommandBuffer buffer);
+	void recordMainPass(VkCommandBuffer buffer);
+	//the frame's command buffer, through vkQueueSubmit2 when synchronization2 is on. Signals the frame
+	//timeline and the binary semaphores given, either may be null. Returns the timeline value
+	uint64_t submitFrame(VkSemaphore waitSemaphore, VkPipelineStageFlags2 waitStages, VkSemaphore signalSemaphore);
 
 	VkShaderModule createShaderModule(const std::vector<char>& code);
 
 	static std::vector<char> readShaderFile(const std::string& fileName);
 
+	void loadMesh();
+
 	void createVertexBuffer();
 
 	void createIndexBuffer();
 
-	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VulkanEngine::GpuAllocation& allocation);
 
-	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+	void createDescriptorSetLayout();
 
-	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+	void createFrameRingBuffer();
 
-	void createDescriptorSetLayout();
+	void createParallelRecorder();
+
+	void createCullingPass();
+
+	void createMeshletPass();
+
+	//stages beyond vertex and fragment that read set 0 and 1
+	VkShaderStageFlags getMeshletStages() const;
+
+	void createGpuProfiler();
+
+	void printFrameStats();
+
+	void pollPresentCompletion();
+	bool pollPresents(VkSwapchainKHR swapchain, std::deque<uint64_t>& pendingPresents);
 
-	void createUniformBuffers();
+	void createScene();
 
-	void updateUniformBuffer(uint32_t currentImage);
+	void updateFrameData(uint32_t currentImage);
+	void computeCullingReference(uint32_t currentImage, const FrameData& frame);
+	void verifyCulling(uint32_t frameIndex);
 
 	void createDescriptorPool();
 	void createDescriptorSets();
@@ -194,7 +383,8 @@ private:
 		"VK_LAYER_KHRONOS_validation"
 	};
 
-	const std::vector<const char*> deviceExtensions = {
+	//emptied in headless mode, there is nothing to present to
+	std::vector<const char*> deviceExtensions = {
 		VK_KHR_SWAPCHAIN_EXTENSION_NAME
 	};
 
@@ -202,14 +392,15 @@ private:
 	std::vector<VkImageView> swapChainImageViews;
 	std::vector<VkFramebuffer> swapChainFrambuffers;
 
+	//drawn when no --mesh is given
 	const std::vector<Vertex> vertices = {
-		{{-0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}},
-		{{0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}},
-		{{0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}},
-		{{-0.5f, 0.5f}, {1.0f, 1.0f, 1.0f}}
+		{{-0.5f, -0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}},
+		{{0.5f, -0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f}, {0.0f, 1.0f, 0.0f}},
+		{{0.5f, 0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {1.0f, 1.0f}, {0.0f, 0.0f, 1.0f}},
+		{{-0.5f, 0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f}, {1.0f, 1.0f, 1.0f}}
 	};
 
-	const std::vector<uint16_t> indices = {0, 1, 2, 2, 3, 0};
+	const std::vector<uint32_t> indices = {0, 1, 2, 2, 3, 0};
 #ifdef NDEBUG
 	const bool enableValidationLayers = false;
 #else
@@ -4,12 +4,43 @@
 #include "Window.h"
 #include <filesystem>
 #include <EABase/eabase.h>
-int main()
+#include <new>
+#include <cassert>
+
+//EASTL's default allocator routes through these two overloads, the engine has to provide them
+void* operator new[](size_t size, const char* pName, int flags, unsigned debugFlags, const char* file, int line)
+{
+	return ::operator new[](size);
+}
+
+void* operator new[](size_t size, size_t alignment, size_t alignmentOffset, const char* pName, int flags, unsigned debugFlags, const char* file, int line)
 {
+	//EASTL frees everything with a plain delete[], so only alignments new[] already guarantees can be honoured
+	assert(alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__ && alignmentOffset == 0);
+	return ::operator new[](size);
+}
+
+int main(int argc, char** argv)
+{
+	//dump paths on the command line are relative to where the engine was started
+	VulkanEngine::AppSettings settings = VulkanEngine::AppSettings::fromCommandLine(argc, argv);
+	if (!settings.dumpDirectory.empty())
+	{
+		settings.dumpDirectory = std::filesystem::absolute(settings.dumpDirectory).string();
+	}
+	if (!settings.tracePath.empty())
+	{
+		settings.tracePath = std::filesystem::absolute(settings.tracePath).string();
+	}
+	if (!settings.meshPath.empty())
+	{
+		settings.meshPath = std::filesystem::absolute(settings.meshPath).string();
+	}
+
 #ifdef PROJECT_DIR
 	std::filesystem::current_path(PROJECT_DIR);
 #endif // PROJECT_DIR
 
-	WindowApp* Window = new WindowApp();
-	Window->run();
+	WindowApp* Window = new WindowApp(settings);
+	return Window->run();
 }